@@ -0,0 +1,404 @@
+/* agentqueue.c - Asynchronous commands for the gpg-agent.
+   Copyright (C) 2026 g10 Code GmbH.
+
+   This file is part of GPA
+
+   GPA is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   GPA is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+   License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.  */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <string.h>
+
+#include "gpa.h"
+#include "gpacontext.h"
+#include "agentqueue.h"
+
+
+/* A queued command.  */
+struct command_s
+{
+  void *owner;
+  char *command;
+  unsigned int timeout;
+  gpgme_assuan_data_cb_t data_cb;
+  gpgme_assuan_inquire_cb_t inq_cb;
+  gpgme_assuan_status_cb_t status_cb;
+  gpa_agent_queue_done_t done_cb;
+  void *opaque;
+  GDestroyNotify release;
+  int canceled;       /* Don't call the callbacks anymore.  */
+  int timed_out;      /* The timeout expired.  */
+};
+
+
+struct gpa_agent_queue_s
+{
+  /* The context for the connection.  A canceled operation leaves the
+     connection in an undefined state; thus the context is then
+     marked as stale and replaced before the next command.  */
+  GpaContext *context;
+  int stale;
+
+  GQueue *pending;             /* The commands waiting to be sent.  */
+  struct command_s *running;   /* The command being processed.  */
+
+  guint start_id;              /* Idle source to start the next command.  */
+  guint timeout_id;            /* Timeout source of the running command.  */
+
+  int dispatching;             /* Set while calling a done callback.  */
+  int released;                /* Release has been deferred.  */
+};
+
+
+static void schedule_next (gpa_agent_queue_t queue);
+
+
+
+/* Call the callbacks of the finished command CMD and free it.  */
+static void
+finish_command (struct command_s *cmd, gpg_error_t err)
+{
+  if (!cmd->canceled && cmd->done_cb)
+    cmd->done_cb (err, cmd->opaque);
+  if (cmd->release)
+    cmd->release (cmd->opaque);
+  g_free (cmd->command);
+  g_free (cmd);
+}
+
+
+static void
+free_queue (gpa_agent_queue_t queue)
+{
+  if (queue->context)
+    g_object_unref (queue->context);
+  g_queue_free (queue->pending);
+  g_free (queue);
+}
+
+
+static gpgme_error_t
+command_data_cb (void *opaque, const void *data, size_t datalen)
+{
+  struct command_s *cmd = opaque;
+
+  if (cmd->canceled)
+    return 0;
+  return cmd->data_cb (cmd->opaque, data, datalen);
+}
+
+
+static gpgme_error_t
+command_inq_cb (void *opaque, const char *name, const char *args,
+                gpgme_data_t *r_data)
+{
+  struct command_s *cmd = opaque;
+
+  if (cmd->canceled)
+    return gpg_error (GPG_ERR_CANCELED);
+  return cmd->inq_cb (cmd->opaque, name, args, r_data);
+}
+
+
+static gpgme_error_t
+command_status_cb (void *opaque, const char *status, const char *args)
+{
+  struct command_s *cmd = opaque;
+
+  if (cmd->canceled)
+    return 0;
+  return cmd->status_cb (cmd->opaque, status, args);
+}
+
+
+/* Handler for the "done" signal of the context.  */
+static void
+done_cb (GpaContext *context, gpg_error_t err, gpointer user_data)
+{
+  gpa_agent_queue_t queue = user_data;
+  struct command_s *cmd = queue->running;
+
+  if (!cmd)
+    return;
+  queue->running = NULL;
+  if (queue->timeout_id)
+    {
+      g_source_remove (queue->timeout_id);
+      queue->timeout_id = 0;
+    }
+  if (cmd->timed_out)
+    err = gpg_error (GPG_ERR_TIMEOUT);
+
+  schedule_next (queue);
+
+  /* The done callback may release the queue.  */
+  queue->dispatching++;
+  finish_command (cmd, err);
+  queue->dispatching--;
+  if (queue->released && !queue->dispatching)
+    free_queue (queue);
+}
+
+
+/* Create the context for the connection.  */
+static gpg_error_t
+new_context (gpa_agent_queue_t queue)
+{
+  gpg_error_t err;
+
+  queue->context = gpa_context_new ();
+  err = gpgme_set_protocol (queue->context->ctx, GPGME_PROTOCOL_ASSUAN);
+  if (err)
+    {
+      g_object_unref (queue->context);
+      queue->context = NULL;
+      return err;
+    }
+  g_signal_connect (G_OBJECT (queue->context), "done",
+                    G_CALLBACK (done_cb), queue);
+  return 0;
+}
+
+
+/* Abort the running command.  */
+static void
+cancel_running (gpa_agent_queue_t queue)
+{
+  struct command_s *cmd = queue->running;
+
+  queue->stale = 1;
+  gpgme_cancel (queue->context->ctx);
+
+  /* Canceling emits the done signal, which finishes the command.  In
+     case it didn't we do it here.  */
+  if (queue->running == cmd)
+    done_cb (queue->context, gpg_error (GPG_ERR_CANCELED), queue);
+}
+
+
+static gboolean
+timeout_cb (gpointer user_data)
+{
+  gpa_agent_queue_t queue = user_data;
+
+  queue->timeout_id = 0;
+  if (queue->running)
+    {
+      g_debug ("assuan command `%s' timed out", queue->running->command);
+      queue->running->timed_out = 1;
+      cancel_running (queue);
+    }
+
+  return FALSE;
+}
+
+
+/* Idle callback to send the next command.  */
+static gboolean
+start_next_cb (gpointer user_data)
+{
+  gpa_agent_queue_t queue = user_data;
+  struct command_s *cmd;
+  gpg_error_t err = 0;
+
+  queue->start_id = 0;
+  if (queue->running)
+    return FALSE;
+  cmd = g_queue_pop_head (queue->pending);
+  if (!cmd)
+    return FALSE;
+
+  if (queue->stale)
+    {
+      g_object_unref (queue->context);
+      queue->context = NULL;
+      queue->stale = 0;
+    }
+  if (!queue->context)
+    err = new_context (queue);
+  if (!err)
+    err = gpgme_op_assuan_transact_start
+      (queue->context->ctx, cmd->command,
+       cmd->data_cb? command_data_cb : NULL, cmd,
+       cmd->inq_cb? command_inq_cb : NULL, cmd,
+       cmd->status_cb? command_status_cb : NULL, cmd);
+  if (err)
+    {
+      g_debug ("assuan command `%s' failed to start: %s <%s>",
+               cmd->command, gpg_strerror (err), gpg_strsource (err));
+      schedule_next (queue);
+      finish_command (cmd, err);
+      return FALSE;
+    }
+
+  queue->running = cmd;
+  if (cmd->timeout)
+    queue->timeout_id = g_timeout_add (cmd->timeout * 1000,
+                                       timeout_cb, queue);
+
+  return FALSE;
+}
+
+
+/* Make sure the next command is started from the main loop.  */
+static void
+schedule_next (gpa_agent_queue_t queue)
+{
+  if (!queue->start_id && !queue->running
+      && !g_queue_is_empty (queue->pending))
+    queue->start_id = g_idle_add (start_next_cb, queue);
+}
+
+
+
+/* API */
+
+gpg_error_t
+gpa_agent_queue_new (gpa_agent_queue_t *r_queue)
+{
+  gpa_agent_queue_t queue;
+  gpg_error_t err;
+
+  *r_queue = NULL;
+  queue = g_malloc0 (sizeof *queue);
+  queue->pending = g_queue_new ();
+
+  /* Create the context now so that the caller learns whether gpgme
+     supports the Assuan protocol at all.  */
+  err = new_context (queue);
+  if (err)
+    {
+      free_queue (queue);
+      return err;
+    }
+
+  *r_queue = queue;
+  return 0;
+}
+
+
+void
+gpa_agent_queue_release (gpa_agent_queue_t queue)
+{
+  struct command_s *cmd;
+
+  if (!queue || queue->released)
+    return;
+
+  if (queue->start_id)
+    {
+      g_source_remove (queue->start_id);
+      queue->start_id = 0;
+    }
+  while ((cmd = g_queue_pop_head (queue->pending)))
+    {
+      cmd->canceled = 1;
+      finish_command (cmd, gpg_error (GPG_ERR_CANCELED));
+    }
+  if (queue->running)
+    {
+      queue->running->canceled = 1;
+      cancel_running (queue);
+    }
+  if (queue->start_id)
+    {
+      g_source_remove (queue->start_id);
+      queue->start_id = 0;
+    }
+
+  if (queue->context)
+    g_signal_handlers_disconnect_by_func (G_OBJECT (queue->context),
+                                          G_CALLBACK (done_cb), queue);
+  if (queue->dispatching)
+    queue->released = 1;
+  else
+    free_queue (queue);
+}
+
+
+void
+gpa_agent_queue_push (gpa_agent_queue_t queue, void *owner,
+                      const char *command, unsigned int timeout,
+                      gpgme_assuan_data_cb_t data_cb,
+                      gpgme_assuan_inquire_cb_t inq_cb,
+                      gpgme_assuan_status_cb_t status_cb,
+                      gpa_agent_queue_done_t done_cb,
+                      void *opaque, GDestroyNotify release)
+{
+  struct command_s *cmd;
+
+  g_return_if_fail (queue && !queue->released);
+  g_return_if_fail (command);
+
+  cmd = g_malloc0 (sizeof *cmd);
+  cmd->owner = owner;
+  cmd->command = g_strdup (command);
+  cmd->timeout = timeout;
+  cmd->data_cb = data_cb;
+  cmd->inq_cb = inq_cb;
+  cmd->status_cb = status_cb;
+  cmd->done_cb = done_cb;
+  cmd->opaque = opaque;
+  cmd->release = release;
+  g_queue_push_tail (queue->pending, cmd);
+
+  schedule_next (queue);
+}
+
+
+void
+gpa_agent_queue_cancel (gpa_agent_queue_t queue, void *owner)
+{
+  GList *item, *next;
+  struct command_s *cmd;
+
+  if (!queue || queue->released)
+    return;
+
+  for (item = queue->pending->head; item; item = next)
+    {
+      next = item->next;
+      cmd = item->data;
+      if (cmd->owner == owner)
+        {
+          g_queue_delete_link (queue->pending, item);
+          cmd->canceled = 1;
+          finish_command (cmd, gpg_error (GPG_ERR_CANCELED));
+        }
+    }
+
+  if (queue->running && queue->running->owner == owner)
+    {
+      queue->running->canceled = 1;
+      cancel_running (queue);
+    }
+}
+
+
+gboolean
+gpa_agent_queue_pending (gpa_agent_queue_t queue, void *owner)
+{
+  GList *item;
+
+  if (!queue)
+    return FALSE;
+  if (queue->running && queue->running->owner == owner)
+    return TRUE;
+  for (item = queue->pending->head; item; item = item->next)
+    if (((struct command_s *) item->data)->owner == owner)
+      return TRUE;
+  return FALSE;
+}
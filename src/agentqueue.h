@@ -0,0 +1,73 @@
+/* agentqueue.h - Asynchronous commands for the gpg-agent.
+   Copyright (C) 2026 g10 Code GmbH.
+
+   This file is part of GPA
+
+   GPA is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   GPA is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+   License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.  */
+
+/* The agent queue runs Assuan commands on a connection to the
+   gpg-agent without blocking the main loop.  The commands are sent
+   one after the other in the order they have been pushed; the
+   callbacks are called from the main loop as the responses arrive.
+   Each command may have a timeout and all commands pushed on behalf
+   of an owner may be canceled at once.  */
+
+#ifndef AGENTQUEUE_H
+#define AGENTQUEUE_H
+
+#include <glib.h>
+#include <gpgme.h>
+
+typedef struct gpa_agent_queue_s *gpa_agent_queue_t;
+
+/* Called when a command has finished.  ERR is the error returned by
+   the agent or GPG_ERR_TIMEOUT if the command did not finish in
+   time.  */
+typedef void (*gpa_agent_queue_done_t) (gpg_error_t err, void *opaque);
+
+/* Timeout in seconds for commands which merely read the card.
+   Commands which may ask the user for a PIN should not use a
+   timeout.  */
+#define GPA_AGENT_QUEUE_TIMEOUT 30
+
+/* Create a new queue connected to the gpg-agent and store it at
+   R_QUEUE.  */
+gpg_error_t gpa_agent_queue_new (gpa_agent_queue_t *r_queue);
+
+/* Cancel all commands and release QUEUE.  */
+void gpa_agent_queue_release (gpa_agent_queue_t queue);
+
+/* Queue the Assuan COMMAND on behalf of OWNER.  DATA_CB, INQ_CB and
+   STATUS_CB are the usual gpgme callbacks and may be NULL; they and
+   DONE_CB are called with OPAQUE.  If TIMEOUT is not 0 the command is
+   canceled after that many seconds.  RELEASE, if not NULL, is called
+   with OPAQUE after DONE_CB or after the command has been canceled.
+   The callbacks are never called before this function returns.  */
+void gpa_agent_queue_push (gpa_agent_queue_t queue, void *owner,
+                           const char *command, unsigned int timeout,
+                           gpgme_assuan_data_cb_t data_cb,
+                           gpgme_assuan_inquire_cb_t inq_cb,
+                           gpgme_assuan_status_cb_t status_cb,
+                           gpa_agent_queue_done_t done_cb,
+                           void *opaque, GDestroyNotify release);
+
+/* Cancel all commands of OWNER.  Their callbacks, except for
+   RELEASE, are not called anymore.  This must be called before OWNER
+   is destroyed.  */
+void gpa_agent_queue_cancel (gpa_agent_queue_t queue, void *owner);
+
+/* Return true if commands of OWNER are queued or running.  */
+gboolean gpa_agent_queue_pending (gpa_agent_queue_t queue, void *owner);
+
+#endif /*AGENTQUEUE_H*/
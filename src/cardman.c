@@ -39,6 +39,7 @@
 #include "cardman.h"
 #include "convert.h"
 #include "membuf.h"
+#include "agentqueue.h"
 
 #include "gpagenkeycardop.h"
 
@@ -81,12 +82,21 @@ struct _GpaCardManager
   gpa_filewatch_id_t watch;  /* For watching the reader status file.  */
   int in_card_reload;        /* Sentinel for card_reload.  */
 
+  /* State of the running card reload.  */
+  struct {
+    char *command;           /* The SERIALNO command.  */
+    int auto_app;            /* No application has been selected.  */
+    int restarted;           /* SCD RESTART has been tried.  */
+    gpg_error_t err;         /* The error of the first SERIALNO.  */
+  } reload;
+
 
-  gpgme_ctx_t gpgagent;      /* Gpgme context for the assuan
-                                connection with the gpg-agent.  */
+  gpa_agent_queue_t agent_queue;  /* Queue for the assuan connection
+                                     with the gpg-agent.  */
 
 
   guint ticker_timeout_id;   /* Source Id of the timeout ticker or 0.  */
+  guint ticker_interval;     /* Seconds until the next tick.  */
 
 
   struct {
@@ -101,6 +111,13 @@ struct _GpaCardManager
 static GpaCardManager *this_instance;
 
 
+/* The ticker is only used if the reader status file can't be
+   watched.  It polls at the minimum interval after a card event and
+   backs off to the maximum interval while nothing happens.  */
+#define TICKER_MIN_INTERVAL 1
+#define TICKER_MAX_INTERVAL 32
+
+
 /* Local prototypes */
 static void start_ticker (GpaCardManager *cardman);
 static void update_card_widget (GpaCardManager *cardman, const char *err_desc);
@@ -198,24 +215,6 @@ update_info_visibility (GpaCardManager *cardman)
 
 
 
-static gpg_error_t
-scd_data_cb (void *opaque, const void *data, size_t datalen)
-{
-/*   g_debug ("DATA_CB: datalen=%d", (int)datalen); */
-  return 0;
-}
-
-
-static gpg_error_t
-scd_inq_cb (void *opaque, const char *name, const char *args,
-            gpgme_data_t *r_data)
-{
-/*   g_debug ("INQ_CB: name=`%s' args=`%s'", name, args); */
-
-  return 0;
-}
-
-
 static gpg_error_t
 scd_status_cb (void *opaque, const char *status, const char *args)
 {
@@ -285,19 +284,183 @@ card_reload_finish_idle_cb (void *user_data)
 }
 
 
-/* This function is called to trigger a card-reload.  */
+/* Last step of a card reload: show the card widget for the detected
+   application or ERR_DESC.  */
+static void
+card_reload_finish (GpaCardManager *cardman, const char *err_desc)
+{
+  g_free (cardman->reload.command);
+  cardman->reload.command = NULL;
+
+  update_card_widget (cardman, err_desc);
+  update_title (cardman);
+
+  update_info_visibility (cardman);
+  /* We decrement our lock using a idle handler with lo priority.
+     This gives us a better chance not to do a reload a second
+     time on behalf of the file watcher or ticker.  */
+  g_object_ref (cardman);
+  g_idle_add_full (G_PRIORITY_LOW,
+                   card_reload_finish_idle_cb, cardman, NULL);
+}
+
+
+/* Called when the APPTYPE of the card is known.  */
+static void
+card_reload_apptype_done_cb (gpg_error_t err, void *opaque)
+{
+  GpaCardManager *cardman = opaque;
+
+  if (gpg_err_code (err) == GPG_ERR_CARD_NOT_PRESENT
+      || gpg_err_code (err) == GPG_ERR_CARD_REMOVED)
+    statusbar_update (cardman, _("No card"));
+  else if (err)
+    {
+      g_debug ("assuan command `SCD GETATTR APPTYPE' failed: %s <%s>\n",
+               gpg_strerror (err), gpg_strsource (err));
+      statusbar_update (cardman, _("Error accessing card"));
+    }
+
+  card_reload_finish (cardman, NULL);
+}
+
+
+/* The card has been initialized; find out what it is.  */
+static void
+card_reload_get_apptype (GpaCardManager *cardman)
+{
+  /* Get the event counter to avoid a duplicate reload due to the
+     ticker.  */
+  gpa_agent_queue_push (cardman->agent_queue, cardman,
+                        "GETEVENTCOUNTER", GPA_AGENT_QUEUE_TIMEOUT,
+                        NULL, NULL, scd_status_cb, NULL, cardman, NULL);
+
+  /* Now we need to get the APPTYPE of the card so that the correct
+     GpaCM* object can can act on the data.  */
+  gpa_agent_queue_push (cardman->agent_queue, cardman,
+                        "SCD GETATTR APPTYPE", GPA_AGENT_QUEUE_TIMEOUT,
+                        NULL, NULL, scd_status_cb,
+                        card_reload_apptype_done_cb, cardman, NULL);
+}
+
+
+/* Called when the application has been reset after an error.  */
+static void
+card_reload_undefined_done_cb (gpg_error_t err, void *opaque)
+{
+  GpaCardManager *cardman = opaque;
+
+  if (!err)
+    card_reload_get_apptype (cardman);
+  else
+    {
+      statusbar_update (cardman, _("Error accessing card"));
+      card_reload_finish (cardman, _("Error accessing the card."));
+    }
+}
+
+
+/* Evaluate the result ERR of the SERIALNO command.  */
+static void
+card_reload_serialno_checked (GpaCardManager *cardman, gpg_error_t err)
+{
+  const char *err_desc = NULL;
+  int auto_app = cardman->reload.auto_app;
+
+  if (gpg_err_code (err) == GPG_ERR_CARD_NOT_PRESENT
+      || gpg_err_code (err) == GPG_ERR_CARD_REMOVED)
+    {
+      err_desc = _("No card found.");
+    }
+  else if (gpg_err_source (err) == GPG_ERR_SOURCE_SCD
+           && gpg_err_code (err) == GPG_ERR_CONFLICT)
+    {
+      err_desc = auto_app
+        ? _("The selected card application is currently not available.")
+        : _("Another process is using a different card application "
+            "than the selected one.\n\n"
+            "You may change the application selection mode to "
+            "\"Auto\" to select the active application.");
+    }
+  else if (!auto_app
+           && gpg_err_source (err) == GPG_ERR_SOURCE_SCD
+           && gpg_err_code (err) == GPG_ERR_NOT_SUPPORTED)
+    {
+      err_desc =
+        _("The selected card application is not available.");
+    }
+  else if (err)
+    {
+      g_debug ("assuan command `%s' failed: %s <%s>\n",
+               cardman->reload.command, gpg_strerror (err),
+               gpg_strsource (err));
+      gpa_agent_queue_push (cardman->agent_queue, cardman,
+                            "SCD SERIALNO undefined",
+                            GPA_AGENT_QUEUE_TIMEOUT, NULL, NULL, NULL,
+                            card_reload_undefined_done_cb, cardman, NULL);
+      return;
+    }
+
+  if (err)
+    card_reload_finish (cardman, err_desc);
+  else
+    card_reload_get_apptype (cardman);
+}
+
+
+static void card_reload_serialno_done_cb (gpg_error_t err, void *opaque);
+
+/* Called when scdaemon has been restarted due to a conflict.  */
+static void
+card_reload_restart_done_cb (gpg_error_t err, void *opaque)
+{
+  GpaCardManager *cardman = opaque;
+
+  if (err)
+    card_reload_serialno_checked (cardman, cardman->reload.err);
+  else
+    gpa_agent_queue_push (cardman->agent_queue, cardman,
+                          cardman->reload.command, GPA_AGENT_QUEUE_TIMEOUT,
+                          NULL, NULL, scd_status_cb,
+                          card_reload_serialno_done_cb, cardman, NULL);
+}
+
+
+static void
+card_reload_serialno_done_cb (gpg_error_t err, void *opaque)
+{
+  GpaCardManager *cardman = opaque;
+
+  if (!cardman->reload.auto_app && !cardman->reload.restarted
+      && gpg_err_source (err) == GPG_ERR_SOURCE_SCD
+      && gpg_err_code (err) == GPG_ERR_CONFLICT)
+    {
+      /* Not in auto select mode and the scdaemon told us about a
+         conflicting use.  We now do a restart and try again to
+         display an application selection conflict error only if it
+         is not due to our own connection to the scdaemon.  */
+      cardman->reload.restarted = 1;
+      cardman->reload.err = err;
+      gpa_agent_queue_push (cardman->agent_queue, cardman,
+                            "SCD RESTART", GPA_AGENT_QUEUE_TIMEOUT,
+                            NULL, NULL, NULL,
+                            card_reload_restart_done_cb, cardman, NULL);
+      return;
+    }
+
+  card_reload_serialno_checked (cardman, err);
+}
+
+
+/* This function is called to trigger a card-reload.  The reload is
+   done by a chain of agent commands; the in_card_reload lock is held
+   until the last one has finished.  */
 static void
 card_reload (GpaCardManager *cardman)
 {
-  gpg_error_t err, operr;
   const char *application;
-  char *command_buf = NULL;
-  const char *command;
-  const char *err_desc = NULL;
-  char *err_desc_buffer = NULL;
-  int auto_app;
 
-  if (!cardman->gpgagent)
+  if (!cardman->agent_queue)
     return;  /* No support for GPGME_PROTOCOL_ASSUAN.  */
 
   /* Start the ticker if not yet done.  */
@@ -314,141 +477,30 @@ card_reload (GpaCardManager *cardman)
       /* The first thing we need to do is to issue the SERIALNO
          command; this makes sure that scdaemon initalizes the card if
          that has not yet been done.  */
-      command = "SCD SERIALNO";
+      g_free (cardman->reload.command);
       if (cardman->app_selector
           && (gtk_combo_box_get_active
               (GTK_COMBO_BOX (cardman->app_selector)) > 0)
           && (application = gtk_combo_box_get_active_text
               (GTK_COMBO_BOX (cardman->app_selector))))
         {
-          command_buf = g_strdup_printf ("%s %s", command, application);
-          command = command_buf;
-          auto_app = 0;
+          cardman->reload.command = g_strdup_printf ("SCD SERIALNO %s",
+                                                     application);
+          cardman->reload.auto_app = 0;
         }
       else
-        auto_app = 1;
-      err = gpgme_op_assuan_transact_ext (cardman->gpgagent,
-                                          command,
-                                          scd_data_cb, NULL,
-                                          scd_inq_cb, NULL,
-                                          scd_status_cb, cardman, &operr);
-      if (!err)
-        {
-          err = operr;
-          if (!auto_app
-              && gpg_err_source (err) == GPG_ERR_SOURCE_SCD
-              && gpg_err_code (err) == GPG_ERR_CONFLICT)
-            {
-              /* Not in auto select mode and the scdaemon told us
-                 about a conflicting use.  We now do a restart and try
-                 again to display an application selection conflict
-                 error only if it is not due to our own connection to
-                 the scdaemon.  */
-              if (!gpgme_op_assuan_transact_ext (cardman->gpgagent,
-                                                 "SCD RESTART",
-                                                 NULL, NULL, NULL, NULL,
-                                                 NULL, NULL, &operr)
-                  && !operr)
-                {
-                  err = gpgme_op_assuan_transact_ext (cardman->gpgagent,
-                                                      command,
-                                                      scd_data_cb, NULL,
-                                                      scd_inq_cb, NULL,
-                                                      scd_status_cb, cardman,
-                                                      &operr);
-                  if (!err)
-                    err = operr;
-                }
-            }
-        }
-
-
-      if (gpg_err_code (err) == GPG_ERR_CARD_NOT_PRESENT
-          || gpg_err_code (err) == GPG_ERR_CARD_REMOVED)
-        {
-          err_desc = _("No card found.");
-        }
-      else if (gpg_err_source (err) == GPG_ERR_SOURCE_SCD
-               && gpg_err_code (err) == GPG_ERR_CONFLICT)
         {
-          err_desc = auto_app
-            ? _("The selected card application is currently not available.")
-            : _("Another process is using a different card application "
-                "than the selected one.\n\n"
-                "You may change the application selection mode to "
-                "\"Auto\" to select the active application.");
+          cardman->reload.command = g_strdup ("SCD SERIALNO");
+          cardman->reload.auto_app = 1;
         }
-      else if (!auto_app
-               && gpg_err_source (err) == GPG_ERR_SOURCE_SCD
-               && gpg_err_code (err) == GPG_ERR_NOT_SUPPORTED)
-        {
-          err_desc =
-            _("The selected card application is not available.");
-        }
-      else if (err)
-        {
-          g_debug ("assuan command `%s' failed: %s <%s>\n",
-                   command, gpg_strerror (err), gpg_strsource (err));
-          if (!gpgme_op_assuan_transact_ext (cardman->gpgagent,
-                                             "SCD SERIALNO undefined",
-                                             NULL, NULL, NULL, NULL,
-                                             NULL, NULL, &operr) && !operr)
-            err = 0;
-          else
-            {
-              err_desc = _("Error accessing the card.");
-              statusbar_update (cardman, _("Error accessing card"));
-            }
-        }
-      g_free (command_buf);
-
-
-      if (!err)
-        {
-          /* Get the event counter to avoid a duplicate reload due to
-             the ticker.  */
-          gpgme_op_assuan_transact_ext (cardman->gpgagent,
-                                        "GETEVENTCOUNTER",
-                                        NULL, NULL,
-                                        NULL, NULL,
-                                        scd_status_cb, cardman, NULL);
-
-          /* Now we need to get the APPTYPE of the card so that the
-             correct GpaCM* object can can act on the data.  */
-          command = "SCD GETATTR APPTYPE";
-          err = gpgme_op_assuan_transact_ext (cardman->gpgagent,
-                                              command,
-                                              scd_data_cb, NULL,
-                                              scd_inq_cb, NULL,
-                                              scd_status_cb, cardman, &operr);
-          if (!err)
-            err = operr;
-
-          if (gpg_err_code (err) == GPG_ERR_CARD_NOT_PRESENT
-              || gpg_err_code (err) == GPG_ERR_CARD_REMOVED)
-            statusbar_update (cardman, _("No card"));
-          else if (err)
-            {
-              g_debug ("assuan command `%s' failed: %s <%s>\n",
-                       command, gpg_strerror (err), gpg_strsource (err));
-              statusbar_update (cardman, _("Error accessing card"));
-            }
-        }
-
-
-      update_card_widget (cardman, err_desc);
-      g_free (err_desc_buffer);
-      err_desc_buffer = NULL;
-      err_desc = NULL;
-      update_title (cardman);
-
-      update_info_visibility (cardman);
-      /* We decrement our lock using a idle handler with lo priority.
-         This gives us a better chance not to do a reload a second
-         time on behalf of the file watcher or ticker.  */
-      g_object_ref (cardman);
-      g_idle_add_full (G_PRIORITY_LOW,
-                       card_reload_finish_idle_cb, cardman, NULL);
+      cardman->reload.restarted = 0;
+      cardman->reload.err = 0;
+
+      gpa_agent_queue_push (cardman->agent_queue, cardman,
+                            cardman->reload.command,
+                            GPA_AGENT_QUEUE_TIMEOUT,
+                            NULL, NULL, scd_status_cb,
+                            card_reload_serialno_done_cb, cardman, NULL);
     }
 }
 
@@ -509,6 +561,22 @@ geteventcounter_status_cb (void *opaque, const char *status, const char *args)
   return 0;
 }
 
+static gboolean ticker_cb (gpointer user_data);
+
+/* Arm the ticker for the current interval.  */
+static void
+schedule_tick (GpaCardManager *cardman)
+{
+#if GTK_CHECK_VERSION (2, 14, 0)
+  cardman->ticker_timeout_id = g_timeout_add_seconds
+    (cardman->ticker_interval, ticker_cb, cardman);
+#else
+  cardman->ticker_timeout_id = g_timeout_add
+    (cardman->ticker_interval * 1000, ticker_cb, cardman);
+#endif
+}
+
+
 /* This function is called by the timeout ticker started by
    start_ticker.  It is used to poll scdaemon to detect a card status
    change.  */
@@ -517,39 +585,83 @@ ticker_cb (gpointer user_data)
 {
   GpaCardManager *cardman = user_data;
 
-  if (!cardman || !cardman->ticker_timeout_id || !cardman->gpgagent
-      || cardman->in_card_reload)
-    return TRUE;  /* Keep on ticking.  */
+  cardman->ticker_timeout_id = 0;
+  if (!cardman->agent_queue)
+    return FALSE;
 
-  /* Note that we are single threaded and thus there is no need to
-     lock the assuan context.  */
+  /* Don't pile up requests if the agent is slow to answer.  */
+  if (!cardman->in_card_reload
+      && !gpa_agent_queue_pending (cardman->agent_queue, cardman))
+    gpa_agent_queue_push (cardman->agent_queue, cardman,
+                          "GETEVENTCOUNTER", GPA_AGENT_QUEUE_TIMEOUT,
+                          NULL, NULL, geteventcounter_status_cb,
+                          NULL, cardman, NULL);
 
-  gpgme_op_assuan_transact_ext (cardman->gpgagent,
-                                "GETEVENTCOUNTER",
-                                NULL, NULL,
-                                NULL, NULL,
-                                geteventcounter_status_cb, cardman, NULL);
+  /* Back off while nothing happens.  A detected change triggers a
+     reload which restarts the ticker at the minimum interval.  */
+  if (!cardman->ticker_timeout_id)
+    {
+      cardman->ticker_interval = MIN (cardman->ticker_interval * 2,
+                                      TICKER_MAX_INTERVAL);
+      schedule_tick (cardman);
+    }
 
-  return TRUE;  /* Keep on ticking.  */
+  return FALSE;
 }
 
 
-/* If no ticker is active start one.  */
+static void watcher_cb (void *opaque, const char *filename,
+                        const char *reason);
+
+/* Try to watch the reader status file.  Scdaemon updates the file on
+   each card event; thus we don't need to poll if this works.  */
+static void
+add_reader_watch (GpaCardManager *cardman)
+{
+  char *fname;
+
+  fname = g_build_filename (gnupg_homedir, "reader_0.status", NULL);
+  cardman->watch = gpa_add_filewatch (fname, "wx", watcher_cb, cardman);
+  xfree (fname);
+}
+
+
+/* Make sure that card changes are detected soon.  If the reader
+   status file can't be watched, the ticker is (re)started at its
+   minimum interval.  */
 static void
 start_ticker (GpaCardManager *cardman)
 {
-  if (disable_ticker)
-    return;
+  /* The status file is created by scdaemon, which may have been
+     started only by the last reload.  */
+  if (!cardman->watch)
+    add_reader_watch (cardman);
 
-  if (!cardman->ticker_timeout_id)
+  if (cardman->ticker_timeout_id)
     {
-#if GTK_CHECK_VERSION (2, 14, 0)
-      cardman->ticker_timeout_id = g_timeout_add_seconds (1,
-                                                          ticker_cb, cardman);
-#else
-      cardman->ticker_timeout_id = g_timeout_add (1000, ticker_cb, cardman);
-#endif
+      g_source_remove (cardman->ticker_timeout_id);
+      cardman->ticker_timeout_id = 0;
     }
+
+  if (disable_ticker || cardman->watch || !cardman->agent_queue)
+    return;
+
+  cardman->ticker_interval = TICKER_MIN_INTERVAL;
+  schedule_tick (cardman);
+}
+
+
+/* The card manager got the focus.  The user might be about to
+   insert a card, so we don't want to wait for a slow tick.  */
+static gboolean
+focus_in_cb (GtkWidget *widget, GdkEventFocus *event, gpointer user_data)
+{
+  GpaCardManager *cardman = user_data;
+
+  if (cardman->ticker_timeout_id)
+    start_ticker (cardman);
+
+  return FALSE;
 }
 
 
@@ -562,31 +674,14 @@ card_genkey_completed (GpaCardManager *cardman, gpg_error_t err)
 }
 
 
-/* This function is called to triggers a key-generation.  */
+/* Called with the result of the deny_admin check of card_genkey.  */
 static void
-card_genkey (GpaCardManager *cardman)
+card_genkey_deny_admin_done_cb (gpg_error_t err, void *opaque)
 {
-  gpg_error_t err, operr;
+  GpaCardManager *cardman = opaque;
   GpaGenKeyCardOperation *op;
   char *keyattr;
 
-  if (cardman->cardtype != GPA_CM_OPENPGP_TYPE)
-    return;  /* Not possible.  */
-  if (!cardman->gpgagent)
-    {
-      g_debug ("Ooops: no assuan context");
-      return;
-    }
-
-  /* Note: This test works only with GnuPG > 2.0.10 but that version
-     is anyway required for the card manager to work correctly.  */
-  err = gpgme_op_assuan_transact_ext (cardman->gpgagent,
-                                      "SCD GETINFO deny_admin",
-                                      NULL, NULL, NULL, NULL, NULL, NULL,
-                                      &operr);
-  if (!err)
-    err = operr;
-
   if (!err)
     {
       gpa_window_error ("Admin commands are disabled in scdamon.\n"
@@ -606,6 +701,27 @@ card_genkey (GpaCardManager *cardman)
 }
 
 
+/* This function is called to triggers a key-generation.  */
+static void
+card_genkey (GpaCardManager *cardman)
+{
+  if (cardman->cardtype != GPA_CM_OPENPGP_TYPE)
+    return;  /* Not possible.  */
+  if (!cardman->agent_queue)
+    {
+      g_debug ("Ooops: no assuan context");
+      return;
+    }
+
+  /* Note: This test works only with GnuPG > 2.0.10 but that version
+     is anyway required for the card manager to work correctly.  */
+  gpa_agent_queue_push (cardman->agent_queue, cardman,
+                        "SCD GETINFO deny_admin", GPA_AGENT_QUEUE_TIMEOUT,
+                        NULL, NULL, NULL,
+                        card_genkey_deny_admin_done_cb, cardman, NULL);
+}
+
+
 /* This function is called when the user triggers a key-generation.  */
 static void
 card_genkey_action (GtkAction *action, gpointer param)
@@ -621,7 +737,17 @@ watcher_cb (void *opaque, const char *filename, const char *reason)
 {
   GpaCardManager *cardman = opaque;
 
-  if (cardman && strchr (reason, 'w') && !cardman->in_card_reload)
+  if (!cardman)
+    return;
+
+  if (strchr (reason, 'x'))
+    {
+      /* The file has been removed, for example by a restart of
+         scdaemon.  Poll until it shows up again.  */
+      cardman->watch = NULL;
+      start_ticker (cardman);
+    }
+  else if (strchr (reason, 'w') && !cardman->in_card_reload)
     {
       card_reload (cardman);
     }
@@ -754,6 +880,10 @@ cardman_action_new (GpaCardManager *cardman, GtkWidget **menubar,
 static void
 card_manager_closed (GtkWidget *widget, gpointer param)
 {
+  GpaCardManager *cardman = param;
+
+  /* The callbacks of our commands expect the widgets to exist.  */
+  gpa_agent_queue_cancel (cardman->agent_queue, cardman);
   this_instance = NULL;
 }
 
@@ -812,11 +942,11 @@ update_card_widget (GpaCardManager *cardman, const char *error_description)
 
       /* Fixme: We should use a signal to reload the card widget
          instead of using a class test in each reload fucntion.  */
-      gpa_cm_openpgp_reload (cardman->card_widget, cardman->gpgagent);
-      gpa_cm_geldkarte_reload (cardman->card_widget, cardman->gpgagent);
-      gpa_cm_netkey_reload (cardman->card_widget, cardman->gpgagent);
-      gpa_cm_dinsig_reload (cardman->card_widget, cardman->gpgagent);
-      gpa_cm_unknown_reload (cardman->card_widget, cardman->gpgagent);
+      gpa_cm_openpgp_reload (cardman->card_widget, cardman->agent_queue);
+      gpa_cm_geldkarte_reload (cardman->card_widget, cardman->agent_queue);
+      gpa_cm_netkey_reload (cardman->card_widget, cardman->agent_queue);
+      gpa_cm_dinsig_reload (cardman->card_widget, cardman->agent_queue);
+      gpa_cm_unknown_reload (cardman->card_widget, cardman->agent_queue);
     }
 }
 
@@ -832,44 +962,51 @@ app_selector_changed_cb (GtkComboBox *cbox, void *opaque)
 }
 
 
+/* Parameter for the callbacks of setup_app_selector.  */
+struct app_selector_parm
+{
+  GpaCardManager *cardman;
+  membuf_t mb;
+};
+
+
 /* Assuan data callback used by setup_app_selector.  */
 static gpg_error_t
 setup_app_selector_data_cb (void *opaque, const void *data, size_t datalen)
 {
-  membuf_t *mb = opaque;
+  struct app_selector_parm *parm = opaque;
 
-  put_membuf (mb, data, datalen);
+  put_membuf (&parm->mb, data, datalen);
 
   return 0;
 }
 
 
-/* Fill the app_selection box with the available applications.  */
 static void
-setup_app_selector (GpaCardManager *cardman)
+setup_app_selector_release (void *opaque)
 {
-  gpg_error_t err, operr;
-  membuf_t mb;
+  struct app_selector_parm *parm = opaque;
+
+  g_free (get_membuf (&parm->mb, NULL));
+  g_free (parm);
+}
+
+
+/* Called when the list of applications has been received.  */
+static void
+setup_app_selector_done_cb (gpg_error_t err, void *opaque)
+{
+  struct app_selector_parm *parm = opaque;
+  GpaCardManager *cardman = parm->cardman;
   char *string;
   char *p, *p0, *p1;
 
-  if (!cardman->gpgagent || !cardman->app_selector)
+  if (err)
     return;
 
-  init_membuf (&mb, 256);
-
-  err = gpgme_op_assuan_transact_ext (cardman->gpgagent,
-                                      "SCD GETINFO app_list",
-                                      setup_app_selector_data_cb, &mb,
-                                      NULL, NULL, NULL, NULL, &operr);
-  if (err || operr)
-    {
-      g_free (get_membuf (&mb, NULL));
-      return;
-    }
   /* Make sure the data is a string and get it. */
-  put_membuf (&mb, "", 1);
-  string = get_membuf (&mb, NULL);
+  put_membuf (&parm->mb, "", 1);
+  string = get_membuf (&parm->mb, NULL);
   if (!string)
     return; /* Out of core.  */
 
@@ -892,6 +1029,27 @@ setup_app_selector (GpaCardManager *cardman)
 }
 
 
+/* Fill the app_selection box with the available applications.  */
+static void
+setup_app_selector (GpaCardManager *cardman)
+{
+  struct app_selector_parm *parm;
+
+  if (!cardman->agent_queue || !cardman->app_selector)
+    return;
+
+  parm = g_malloc0 (sizeof *parm);
+  parm->cardman = cardman;
+  init_membuf (&parm->mb, 256);
+
+  gpa_agent_queue_push (cardman->agent_queue, cardman,
+                        "SCD GETINFO app_list", GPA_AGENT_QUEUE_TIMEOUT,
+                        setup_app_selector_data_cb, NULL, NULL,
+                        setup_app_selector_done_cb, parm,
+                        setup_app_selector_release);
+}
+
+
 static void
 construct_widgets (GpaCardManager *cardman)
 {
@@ -988,7 +1146,6 @@ gpa_card_manager_init (GTypeInstance *instance, void *class_ptr)
 {
   GpaCardManager *cardman = GPA_CARD_MANAGER (instance);
   gpg_error_t err;
-  char *fname;
 
   cardman->cardtype = G_TYPE_NONE;
   cardman->cardtypename = "Unknown";
@@ -998,20 +1155,16 @@ gpa_card_manager_init (GTypeInstance *instance, void *class_ptr)
 
   g_signal_connect (cardman, "destroy",
                     G_CALLBACK (card_manager_closed), cardman);
+  g_signal_connect (cardman, "focus-in-event",
+                    G_CALLBACK (focus_in_cb), cardman);
 
 
-  /* We use the file watcher to speed up card change detection.  If it
-     does not work (i.e. on non Linux based systems) the ticker takes
-     care of it.  */
-  fname = g_build_filename (gnupg_homedir, "reader_0.status", NULL);
-  cardman->watch = gpa_add_filewatch (fname, "w", watcher_cb, cardman);
-  xfree (fname);
-
-  err = gpgme_new (&cardman->gpgagent);
-  if (err)
-    gpa_gpgme_error (err);
+  /* We use the file watcher to detect card changes.  If it does not
+     work (i.e. on non Linux based systems or if scdaemon has not yet
+     been started) the ticker takes care of it.  */
+  add_reader_watch (cardman);
 
-  err = gpgme_set_protocol (cardman->gpgagent, GPGME_PROTOCOL_ASSUAN);
+  err = gpa_agent_queue_new (&cardman->agent_queue);
   if (err)
     {
       if (gpg_err_code (err) == GPG_ERR_INV_VALUE)
@@ -1019,8 +1172,6 @@ gpa_card_manager_init (GTypeInstance *instance, void *class_ptr)
                             "support smartcards."), NULL);
       else
         gpa_gpgme_warning (err);
-      gpgme_release (cardman->gpgagent);
-      cardman->gpgagent = NULL;
     }
 
   setup_app_selector (cardman);
@@ -1037,11 +1188,12 @@ gpa_card_manager_finalize (GObject *object)
 {
   GpaCardManager *cardman = GPA_CARD_MANAGER (object);
 
-  if (cardman->gpgagent)
+  if (cardman->agent_queue)
     {
-      gpgme_release (cardman->gpgagent);
-      cardman->gpgagent = NULL;
+      gpa_agent_queue_release (cardman->agent_queue);
+      cardman->agent_queue = NULL;
     }
+  g_free (cardman->reload.command);
 
   if (cardman->ticker_timeout_id)
     {
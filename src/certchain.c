@@ -26,6 +26,8 @@
 #include "gpa.h"
 #include "gtktools.h"
 #include "format-dn.h"
+#include "gpacontext.h"
+#include "keytable.h"
 #include "certchain.h"
 
 enum
@@ -102,26 +104,152 @@ append_row (GtkListStore *store, GtkTreeIter *iter,
 }
 
 
+/* The cache of issuer certificates.  It maps the chain ID of a
+   certificate to the issuer's certificate or to NULL if the issuer
+   is not known.  Certificates with the same issuers share the
+   entries.  */
+static GHashTable *issuer_cache;
+
+/* The context used to look up an issuer and the chain ID being
+   looked up.  Only one lookup runs at a time.  */
+static GpaContext *lookup_ctx;
+static char *lookup_id;
+static gpgme_key_t lookup_key;
+
+/* The generation of the cache, incremented each time the cache is
+   cleared, and the generation at the start of the running lookup.
+   The result of a lookup started before the cache was cleared may
+   be outdated and is not cached.  */
+static unsigned int cache_generation;
+static unsigned int lookup_generation;
+
+/* The lists waiting for the lookup to finish.  A list is removed
+   when it is destroyed.  */
+static GList *waiting_lists;
+
+
+static void certchain_update (GtkWidget *tview);
+
+
+/* A key has been listed.  We own KEY; the first one is taken as the
+   issuer.  */
+static void
+lookup_next_key_cb (GpaContext *context, gpgme_key_t key, gpointer user_data)
+{
+  if (!lookup_key)
+    lookup_key = key;
+  else
+    gpgme_key_unref (key);
+}
+
+
+/* A waiting list is being destroyed.  */
+static void
+waiting_list_destroy_cb (GtkWidget *tview, gpointer user_data)
+{
+  waiting_lists = g_list_remove (waiting_lists, tview);
+}
+
+
 static void
-certchain_update (GtkWidget *tview, gpgme_key_t key)
+lookup_done_cb (GpaContext *context, gpg_error_t err, gpointer user_data)
+{
+  GList *list;
+  GtkWidget *tview;
+
+  if (err && gpg_err_code (err) != GPG_ERR_EOF)
+    g_debug ("issuer lookup failed: %s <%s>",
+             gpg_strerror (err), gpg_strsource (err));
+
+  /* A failed lookup is cached as well; the cache is cleared when the
+     keyring changes.  */
+  if (lookup_generation == cache_generation)
+    g_hash_table_replace (issuer_cache, lookup_id, lookup_key);
+  else
+    {
+      g_free (lookup_id);
+      if (lookup_key)
+        gpgme_key_unref (lookup_key);
+    }
+  lookup_id = NULL;
+  lookup_key = NULL;
+
+  /* Show the chains again; this starts the next lookup if needed.  */
+  list = waiting_lists;
+  waiting_lists = NULL;
+  while (list)
+    {
+      tview = list->data;
+      list = g_list_delete_link (list, list);
+      g_signal_handlers_disconnect_by_func (tview, waiting_list_destroy_cb,
+                                            NULL);
+      certchain_update (tview);
+    }
+}
+
+
+/* Look up the issuer certificate with CHAIN_ID and update TVIEW when
+   it is known.  */
+static void
+lookup_issuer (GtkWidget *tview, const char *chain_id)
+{
+  gpg_error_t err;
+
+  if (!g_list_find (waiting_lists, tview))
+    {
+      g_signal_connect (tview, "destroy",
+                        G_CALLBACK (waiting_list_destroy_cb), NULL);
+      waiting_lists = g_list_prepend (waiting_lists, tview);
+    }
+  if (lookup_id)
+    return;
+
+  if (!lookup_ctx)
+    {
+      lookup_ctx = gpa_context_new ();
+      gpgme_set_protocol (lookup_ctx->ctx, GPGME_PROTOCOL_CMS);
+      g_signal_connect (G_OBJECT (lookup_ctx), "next_key",
+                        G_CALLBACK (lookup_next_key_cb), NULL);
+      g_signal_connect (G_OBJECT (lookup_ctx), "done",
+                        G_CALLBACK (lookup_done_cb), NULL);
+    }
+
+  lookup_id = g_strdup (chain_id);
+  lookup_generation = cache_generation;
+  err = gpgme_op_keylist_start (lookup_ctx->ctx, lookup_id, 0);
+  if (err)
+    lookup_done_cb (lookup_ctx, err, NULL);
+}
+
+
+/* Show the chain of the key attached to TVIEW as far as the issuers
+   are known and look up the first missing one.  */
+static void
+certchain_update (GtkWidget *tview)
 {
-  gpgme_error_t err;
-  gpgme_ctx_t listctx;
   GtkListStore *store;
   GtkTreeIter iter;
+  gpgme_key_t key, issuer;
   int maxdepth = 20;
 
-  err = gpgme_new (&listctx);
-  if (err)
-    gpa_gpgme_error (err);
-  gpgme_set_protocol (listctx, key->protocol);
-
   store = GTK_LIST_STORE (gtk_tree_view_get_model (GTK_TREE_VIEW (tview)));
   gtk_list_store_clear (store);
-  
+
+  key = g_object_get_data (G_OBJECT (tview), "gpa-certchain-key");
+  if (!key)
+    return;
+
+  if (!issuer_cache)
+    {
+      issuer_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                            (GDestroyNotify) gpgme_key_unref);
+      g_signal_connect (gpa_keytable_get_public_instance (),
+                        "keyring_changed",
+                        G_CALLBACK (gpa_certchain_clear_cache), NULL);
+    }
+
   append_row (store, &iter, key, NULL);
 
-  gpgme_key_ref (key);
   while (key && key->chain_id
          && key->subkeys && strcmp (key->chain_id, key->subkeys->fpr))
     {
@@ -130,19 +258,19 @@ certchain_update (GtkWidget *tview, gpgme_key_t key)
           append_row (store, &iter, NULL, _("[chain too long]"));
           break;
         }
-      err = gpgme_op_keylist_start (listctx, key->chain_id, 0);
-      gpgme_key_unref (key);
-      key = NULL;
-      if (!err)
-	err = gpgme_op_keylist_next (listctx, &key);
-      gpgme_op_keylist_end (listctx);
-      if (err)
-        append_row (store, &iter, NULL, _("[issuer not found]"));
+      if (!g_hash_table_lookup_extended (issuer_cache, key->chain_id,
+                                         NULL, (gpointer *) &issuer))
+        {
+          append_row (store, &iter, NULL, _("[looking up issuer...]"));
+          lookup_issuer (tview, key->chain_id);
+          break;
+        }
+      if (issuer)
+        append_row (store, &iter, issuer, NULL);
       else
-        append_row (store, &iter, key, NULL);
+        append_row (store, &iter, NULL, _("[issuer not found]"));
+      key = issuer;
     }
-  gpgme_key_unref (key);
-  gpgme_release (listctx);
 }
 
 
@@ -168,11 +296,23 @@ gpa_certchain_new (void)
 void
 gpa_certchain_update (GtkWidget *list, gpgme_key_t key)
 {
-  GtkListStore *store;
-
-  store = GTK_LIST_STORE (gtk_tree_view_get_model (GTK_TREE_VIEW (list)));
   if (key && key->protocol == GPGME_PROTOCOL_CMS)
-    certchain_update (list, key);
+    {
+      gpgme_key_ref (key);
+      g_object_set_data_full (G_OBJECT (list), "gpa-certchain-key", key,
+                              (GDestroyNotify) gpgme_key_unref);
+    }
   else
-    gtk_list_store_clear (store);
+    g_object_set_data (G_OBJECT (list), "gpa-certchain-key", NULL);
+  certchain_update (list);
+}
+
+
+/* Forget all cached issuer certificates.  */
+void
+gpa_certchain_clear_cache (void)
+{
+  cache_generation++;
+  if (issuer_cache)
+    g_hash_table_remove_all (issuer_cache);
 }
@@ -22,6 +22,7 @@
 
 GtkWidget *gpa_certchain_new (void);
 void gpa_certchain_update (GtkWidget *list, gpgme_key_t key);
+void gpa_certchain_clear_cache (void);
 
 
 
@@ -79,6 +79,28 @@ struct _GpaClipboard
   GList *selection_sensitive_actions;
   GList *paste_sensitive_actions;
   gboolean paste_p;
+
+  /* The state of an operation on the text.  Its output is inserted
+     after the text while it is written and the text is hidden.  Once
+     the operation has finished the text is deleted.  */
+  struct
+  {
+    int busy;              /* An operation is running or its output is
+                              still being inserted.  */
+    GpaFileOperation *op;  /* The operation.  Signals of other
+                              operations are ignored.  */
+    gpa_text_rope_t rope;  /* The output of the operation.  */
+    int done;              /* The operation has finished and we own
+                              ROPE.  */
+    guint idle_id;         /* The idle handler inserting the output.  */
+    GtkTextMark *start;    /* The start of the output in the buffer.  */
+    GtkTextTag *hidden;    /* The tag to hide the text.  */
+    gsize offset;          /* Bytes of the output processed so far.  */
+    int latin1;            /* The output is not valid UTF-8.  */
+    gsize bad_offset;      /* The offset of the first invalid byte.  */
+    gchar split[8];        /* A character split between two pieces.  */
+    gsize nsplit;
+  } output;
 };
 
 struct _GpaClipboardClass
@@ -258,42 +280,322 @@ clipboard_owner_change_cb (GtkClipboard *clip, GdkEventOwnerChange *event,
 }
 
 
-/* Add a file created by an operation to the list */
+/* The time in seconds the idle handler may spend inserting output
+   before it yields to the main loop.  */
+#define OUTPUT_TIME_BUDGET 0.008
+
+/* The number of bytes of output inserted at once.  */
+#define OUTPUT_PIECE_SIZE 16384
+
+
+/* Append the UTF-8 text (TEXT,LEN) to the text buffer.  */
 static void
-file_created_cb (GpaFileOperation *op, gpa_file_item_t item, gpointer data)
+append_text (GpaClipboard *clipboard, const gchar *text, gsize len)
 {
-  GpaClipboard *clipboard = data;
-  gboolean suc;
+  GtkTextIter iter;
+
+  gtk_text_buffer_get_end_iter (clipboard->text_buffer, &iter);
+  gtk_text_buffer_insert (clipboard->text_buffer, &iter, text, len);
+}
+
+
+/* Append the Latin-1 text (TEXT,LEN) to the text buffer.  */
+static void
+append_latin1 (GpaClipboard *clipboard, const gchar *text, gsize len)
+{
+  GString *str;
+
+  str = g_string_sized_new (2 * len);
+  for (; len; text++, len--)
+    g_string_append_unichar (str, (guchar) *text);
+  append_text (clipboard, str->str, str->len);
+  g_string_free (str, TRUE);
+}
+
+
+/* Insert the piece (DATA,LEN) of the output.  Each piece is validated
+   on its own; once invalid UTF-8 is found the rest of the output is
+   taken as Latin-1.  */
+static void
+insert_output (GpaClipboard *clipboard, const gchar *data, gsize len)
+{
+  gchar *split = clipboard->output.split;
   const gchar *end;
+  gsize n;
 
-  suc = g_utf8_validate (item->direct_out, item->direct_out_len, &end);
-  if (! suc)
+  if (clipboard->output.nsplit)
+    {
+      /* Complete the character split by the last piece.  */
+      n = g_utf8_skip[(guchar) split[0]] - clipboard->output.nsplit;
+      n = MIN (n, len);
+      memcpy (split + clipboard->output.nsplit, data, n);
+      clipboard->output.nsplit += n;
+      clipboard->output.offset += n;
+      data += n;
+      len -= n;
+      if (clipboard->output.nsplit < g_utf8_skip[(guchar) split[0]])
+	return;
+
+      if (g_utf8_validate (split, clipboard->output.nsplit, NULL))
+	append_text (clipboard, split, clipboard->output.nsplit);
+      else
+	{
+	  clipboard->output.latin1 = 1;
+	  clipboard->output.bad_offset = (clipboard->output.offset
+					  - clipboard->output.nsplit);
+	  append_latin1 (clipboard, split, clipboard->output.nsplit);
+	}
+      clipboard->output.nsplit = 0;
+    }
+
+  if (clipboard->output.latin1)
+    {
+      append_latin1 (clipboard, data, len);
+      clipboard->output.offset += len;
+      return;
+    }
+
+  if (g_utf8_validate (data, len, &end))
+    append_text (clipboard, data, len);
+  else
+    {
+      append_text (clipboard, data, end - data);
+      n = data + len - end;
+      if (g_utf8_get_char_validated (end, n) == (gunichar) -2)
+	{
+	  /* The character is continued in the next piece.  */
+	  memcpy (split, end, n);
+	  clipboard->output.nsplit = n;
+	}
+      else
+	{
+	  clipboard->output.latin1 = 1;
+	  clipboard->output.bad_offset = (clipboard->output.offset
+					  + (end - data));
+	  append_latin1 (clipboard, end, n);
+	}
+    }
+  clipboard->output.offset += len;
+}
+
+
+/* Hide the text and mark the start of the output.  */
+static void
+begin_output (GpaClipboard *clipboard)
+{
+  GtkTextIter begin, end;
+
+  gtk_text_buffer_get_bounds (clipboard->text_buffer, &begin, &end);
+  clipboard->output.start = gtk_text_buffer_create_mark
+    (clipboard->text_buffer, NULL, &end, TRUE);
+  gtk_text_buffer_apply_tag (clipboard->text_buffer,
+			     clipboard->output.hidden, &begin, &end);
+}
+
+
+/* Reset the state of the operation and allow editing again.  */
+static void
+end_output (GpaClipboard *clipboard)
+{
+  if (clipboard->output.idle_id)
+    g_source_remove (clipboard->output.idle_id);
+  clipboard->output.idle_id = 0;
+
+  if (clipboard->output.rope)
+    {
+      if (clipboard->output.done)
+	gpa_text_rope_release (clipboard->output.rope);
+      else
+	gpa_text_rope_set_notify (clipboard->output.rope, NULL, NULL);
+    }
+  clipboard->output.rope = NULL;
+  clipboard->output.done = 0;
+
+  if (clipboard->output.start)
+    gtk_text_buffer_delete_mark (clipboard->text_buffer,
+				 clipboard->output.start);
+  clipboard->output.start = NULL;
+  clipboard->output.offset = 0;
+  clipboard->output.latin1 = 0;
+  clipboard->output.nsplit = 0;
+
+  clipboard->output.op = NULL;
+  clipboard->output.busy = 0;
+  gtk_text_view_set_editable (GTK_TEXT_VIEW (clipboard->text_view), TRUE);
+}
+
+
+/* All output has been inserted.  Replace the text by the output.  */
+static void
+finish_output (GpaClipboard *clipboard)
+{
+  GtkTextIter begin, end;
+  int latin1;
+  gsize bad_offset;
+
+  if (clipboard->output.nsplit)
+    {
+      /* The output ends with an incomplete character.  */
+      clipboard->output.latin1 = 1;
+      clipboard->output.bad_offset = (clipboard->output.offset
+				      - clipboard->output.nsplit);
+      append_latin1 (clipboard, clipboard->output.split,
+		     clipboard->output.nsplit);
+      clipboard->output.nsplit = 0;
+    }
+
+  gtk_text_buffer_get_start_iter (clipboard->text_buffer, &begin);
+  gtk_text_buffer_get_iter_at_mark (clipboard->text_buffer, &end,
+				    clipboard->output.start);
+  gtk_text_buffer_delete (clipboard->text_buffer, &begin, &end);
+  gtk_text_buffer_place_cursor (clipboard->text_buffer, &begin);
+
+  latin1 = clipboard->output.latin1;
+  bad_offset = clipboard->output.bad_offset;
+  end_output (clipboard);
+
+  if (latin1)
     {
       gchar *str;
-      gsize len;
 
       str = g_strdup_printf ("No valid UTF-8 encoding at position %i.\n"
                              "Assuming Latin-1 encoding instead.",
-			     ((int) (end - item->direct_out)));
+			     ((int) bad_offset));
       gpa_window_message (str, GTK_WIDGET (clipboard));
       g_free (str);
+    }
+}
+
+
+/* The operation failed.  Remove its output and show the text
+   again.  */
+static void
+abort_output (GpaClipboard *clipboard)
+{
+  GtkTextIter begin, end;
 
-      str = g_convert (item->direct_out, item->direct_out_len,
-                       "UTF-8", "ISO-8859-1",
-                       NULL, &len, NULL);
-      if (str)
-        {
-          gtk_text_buffer_set_text (clipboard->text_buffer, str, len);
-          g_free (str);
-          return;
-        }
-      gpa_window_error ("Error converting Latin-1 to UTF-8",
-                        GTK_WIDGET (clipboard));
-      /* Enough warnings: Try to show even with invalid encoding.  */
+  if (clipboard->output.start)
+    {
+      gtk_text_buffer_get_iter_at_mark (clipboard->text_buffer, &begin,
+					clipboard->output.start);
+      gtk_text_buffer_get_end_iter (clipboard->text_buffer, &end);
+      gtk_text_buffer_delete (clipboard->text_buffer, &begin, &end);
+      gtk_text_buffer_get_bounds (clipboard->text_buffer, &begin, &end);
+      gtk_text_buffer_remove_tag (clipboard->text_buffer,
+				  clipboard->output.hidden, &begin, &end);
     }
+  end_output (clipboard);
+}
 
-  gtk_text_buffer_set_text (clipboard->text_buffer,
-			    item->direct_out, item->direct_out_len);
+
+/* Idle handler to insert the output written so far.  It inserts
+   output until the time budget is used up and then yields to the
+   main loop so that the view is redrawn.  */
+static gboolean
+insert_output_cb (gpointer data)
+{
+  GpaClipboard *clipboard = data;
+  gpa_text_rope_t rope = clipboard->output.rope;
+  GTimer *timer;
+  const gchar *text;
+  gsize len;
+
+  if (!clipboard->output.start)
+    begin_output (clipboard);
+
+  timer = g_timer_new ();
+  for (;;)
+    {
+      text = gpa_text_rope_peek (rope, &len);
+      if (!len)
+	break;
+      len = MIN (len, OUTPUT_PIECE_SIZE);
+      insert_output (clipboard, text, len);
+      gpa_text_rope_consume (rope, len);
+      if (g_timer_elapsed (timer, NULL) > OUTPUT_TIME_BUDGET)
+	break;
+    }
+  g_timer_destroy (timer);
+
+  if (gpa_text_rope_length (rope))
+    return TRUE;  /* Continue in the next idle slot.  */
+
+  clipboard->output.idle_id = 0;
+  if (clipboard->output.done)
+    finish_output (clipboard);
+  return FALSE;
+}
+
+
+/* Called by the rope whenever the operation has written output.  */
+static void
+output_written_cb (gpa_text_rope_t rope, void *opaque)
+{
+  GpaClipboard *clipboard = opaque;
+
+  if (!clipboard->output.idle_id)
+    clipboard->output.idle_id = g_idle_add (insert_output_cb, clipboard);
+}
+
+
+/* Add a file created by an operation to the list */
+static void
+file_created_cb (GpaFileOperation *op, gpa_file_item_t item, gpointer data)
+{
+  GpaClipboard *clipboard = data;
+
+  if (op != clipboard->output.op
+      || !clipboard->output.rope || item->direct_out != clipboard->output.rope)
+    return;
+
+  /* Take over the output.  The rest of it is inserted by the idle
+     handler, which then replaces the text.  */
+  item->direct_out = NULL;
+  clipboard->output.done = 1;
+  if (!clipboard->output.idle_id)
+    clipboard->output.idle_id = g_idle_add (insert_output_cb, clipboard);
+}
+
+
+/* Handler for the "completed" signal of an operation.  Without a
+   result the text is shown again.  An operation may complete long
+   after its output has been taken over (e.g. verify, once its dialog
+   is closed); by then another operation may be running.  */
+static void
+operation_completed_cb (GpaFileOperation *op, gpg_error_t err,
+			gpointer data)
+{
+  GpaClipboard *clipboard = data;
+
+  if (op != clipboard->output.op)
+    return;
+  if (clipboard->output.busy && !clipboard->output.done)
+    abort_output (clipboard);
+  else
+    clipboard->output.op = NULL;  /* OP is released now.  */
+}
+
+
+/* Return a new file item for an operation on the text.  */
+static gpa_file_item_t
+new_file_item (GpaClipboard *clipboard)
+{
+  gpa_file_item_t file_item;
+
+  /* The operations read the text directly from the text buffer,
+     thus it must not be modified until they are done.  */
+  clipboard->output.busy = 1;
+  gtk_text_view_set_editable (GTK_TEXT_VIEW (clipboard->text_view), FALSE);
+
+  clipboard->output.rope = gpa_text_rope_new ();
+  gpa_text_rope_set_notify (clipboard->output.rope,
+			    output_written_cb, clipboard);
+
+  file_item = g_malloc0 (sizeof (*file_item));
+  file_item->direct_name = g_strdup (_("Clipboard"));
+  file_item->direct_in = g_object_ref (clipboard->text_buffer);
+  file_item->direct_out = clipboard->output.rope;
+  return file_item;
 }
 
 
@@ -301,8 +603,11 @@ file_created_cb (GpaFileOperation *op, gpa_file_item_t item, gpointer data)
 static void
 register_operation (GpaClipboard *clipboard, GpaFileOperation *op)
 {
+  clipboard->output.op = op;
   g_signal_connect (G_OBJECT (op), "created_file",
 		    G_CALLBACK (file_created_cb), clipboard);
+  g_signal_connect (G_OBJECT (op), "completed",
+		    G_CALLBACK (operation_completed_cb), clipboard);
   g_signal_connect (G_OBJECT (op), "completed",
 		    G_CALLBACK (g_object_unref), NULL);
 }
@@ -318,6 +623,8 @@ file_clear (GtkAction *action, gpointer param)
 {
   GpaClipboard *clipboard = param;
 
+  if (clipboard->output.busy)
+    return;
   gtk_text_buffer_set_text (clipboard->text_buffer, "", -1);
 }
 
@@ -382,6 +689,8 @@ file_open (GtkAction *action, gpointer param)
   GError *err = NULL;
   const gchar *end;
 
+  if (clipboard->output.busy)
+    return;
   filename = get_load_file_name (GTK_WIDGET (clipboard), _("Open File"));
   if (! filename)
     return;
@@ -580,18 +889,11 @@ file_verify (GtkAction *action, gpointer param)
   GpaFileVerifyOperation *op;
   GList *files = NULL;
   gpa_file_item_t file_item;
-  GtkTextIter begin;
-  GtkTextIter end;
 
-  gtk_text_buffer_get_bounds (clipboard->text_buffer, &begin, &end);
+  if (clipboard->output.busy)
+    return;
 
-  file_item = g_malloc0 (sizeof (*file_item));
-  file_item->direct_name = g_strdup (_("Clipboard"));
-  file_item->direct_in
-    = gtk_text_buffer_get_slice (clipboard->text_buffer, &begin, &end, TRUE);
-  /* FIXME: One would think there exists a function to get the number
-     of bytes between two GtkTextIter, but no, that's too obvious.  */
-  file_item->direct_in_len = strlen (file_item->direct_in);
+  file_item = new_file_item (clipboard);
 
   files = g_list_append (files, file_item);
 
@@ -610,18 +912,11 @@ file_sign (GtkAction *action, gpointer param)
   GpaFileSignOperation *op;
   GList *files = NULL;
   gpa_file_item_t file_item;
-  GtkTextIter begin;
-  GtkTextIter end;
 
-  gtk_text_buffer_get_bounds (clipboard->text_buffer, &begin, &end);
+  if (clipboard->output.busy)
+    return;
 
-  file_item = g_malloc0 (sizeof (*file_item));
-  file_item->direct_name = g_strdup (_("Clipboard"));
-  file_item->direct_in
-    = gtk_text_buffer_get_text (clipboard->text_buffer, &begin, &end, FALSE);
-  /* FIXME: One would think there exists a function to get the number
-     of bytes between two GtkTextIter, but no, that's too obvious.  */
-  file_item->direct_in_len = strlen (file_item->direct_in);
+  file_item = new_file_item (clipboard);
 
   files = g_list_append (files, file_item);
 
@@ -640,18 +935,11 @@ file_encrypt (GtkAction *action, gpointer param)
   GpaFileEncryptOperation *op;
   GList *files = NULL;
   gpa_file_item_t file_item;
-  GtkTextIter begin;
-  GtkTextIter end;
 
-  gtk_text_buffer_get_bounds (clipboard->text_buffer, &begin, &end);
+  if (clipboard->output.busy)
+    return;
 
-  file_item = g_malloc0 (sizeof (*file_item));
-  file_item->direct_name = g_strdup (_("Clipboard"));
-  file_item->direct_in
-    = gtk_text_buffer_get_text (clipboard->text_buffer, &begin, &end, FALSE);
-  /* FIXME: One would think there exists a function to get the number
-     of bytes between two GtkTextIter, but no, that's too obvious.  */
-  file_item->direct_in_len = strlen (file_item->direct_in);
+  file_item = new_file_item (clipboard);
 
   files = g_list_append (files, file_item);
 
@@ -670,18 +958,11 @@ file_decrypt (GtkAction *action, gpointer param)
   GpaFileDecryptOperation *op;
   GList *files = NULL;
   gpa_file_item_t file_item;
-  GtkTextIter begin;
-  GtkTextIter end;
 
-  gtk_text_buffer_get_bounds (clipboard->text_buffer, &begin, &end);
+  if (clipboard->output.busy)
+    return;
 
-  file_item = g_malloc0 (sizeof (*file_item));
-  file_item->direct_name = g_strdup (_("Clipboard"));
-  file_item->direct_in
-    = gtk_text_buffer_get_text (clipboard->text_buffer, &begin, &end, FALSE);
-  /* FIXME: One would think there exists a function to get the number
-     of bytes between two GtkTextIter, but no, that's too obvious.  */
-  file_item->direct_in_len = strlen (file_item->direct_in);
+  file_item = new_file_item (clipboard);
 
   files = g_list_append (files, file_item);
 
@@ -942,6 +1223,10 @@ clipboard_action_new (GpaClipboard *clipboard,
 static void
 clipboard_closed (GtkWidget *widget, gpointer param)
 {
+  GpaClipboard *clipboard = param;
+
+  if (clipboard->output.busy)
+    end_output (clipboard);
   instance = NULL;
 }
 
@@ -960,6 +1245,9 @@ clipboard_text_new (GpaClipboard *clipboard)
 
   clipboard->text_buffer
     = gtk_text_view_get_buffer (GTK_TEXT_VIEW (clipboard->text_view));
+  clipboard->output.hidden
+    = gtk_text_buffer_create_tag (clipboard->text_buffer, NULL,
+				  "invisible", TRUE, NULL);
 
 #ifndef MY_GTK_TEXT_BUFFER_NO_HAS_SELECTION
   /* A change in selection status causes a property change, which we
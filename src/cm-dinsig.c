@@ -107,45 +107,65 @@ clear_card_data (GpaCMDinsig *card)
 
 
 
-struct scd_getattr_parm
-{
-  GpaCMDinsig *card;  /* The object.  */
-  const char *name;   /* Name of expected attribute.  */
-  int entry_id;       /* The identifier for the entry.  */
+/* The attributes shown by the widget.  */
+static struct {
+  const char *name;
+  int entry_id;
   void (*updfnc) (GpaCMDinsig *card, int entry_id, char *string);
+} attrtbl[] = {
+  { "SERIALNO",    ENTRY_SERIALNO },
+  { NULL }
 };
 
 
-static gpg_error_t
-scd_getattr_cb (void *opaque, const char *status, const char *args)
+/* Called by gpa_cm_object_load_attrs for the attribute ATTRIDX of
+   ATTRTBL.  */
+static void
+scd_getattr_cb (void *opaque, int attridx, const char *args)
 {
-  struct scd_getattr_parm *parm = opaque;
+  GpaCMDinsig *card = opaque;
   int entry_id;
 
-/*   g_debug ("STATUS_CB: status=`%s'  args=`%s'", status, args); */
+/*   g_debug ("STATUS_CB: status=`%s'  args=`%s'", */
+/*            attrtbl[attridx].name, args); */
 
-  if (!strcmp (status, parm->name) )
+  entry_id = attrtbl[attridx].entry_id;
+  if (entry_id < ENTRY_LAST)
     {
-      entry_id = parm->entry_id;
+      char *tmp = xstrdup (args);
+
+      percent_unescape (tmp, 1);
+      if (attrtbl[attridx].updfnc)
+        attrtbl[attridx].updfnc (card, entry_id, tmp);
+      else if (GTK_IS_LABEL (card->entries[entry_id]))
+        gtk_label_set_text (GTK_LABEL (card->entries[entry_id]), tmp);
+      else
+        gtk_entry_set_text (GTK_ENTRY (card->entries[entry_id]), tmp);
+      xfree (tmp);
+    }
+}
 
-      if (entry_id < ENTRY_LAST)
+
+/* Called by gpa_cm_object_load_attrs after all attributes have been
+   loaded.  */
+static void
+reload_data_done_cb (void *opaque, gpg_error_t err, int attridx)
+{
+  GpaCMDinsig *card = opaque;
+
+  if (err)
+    {
+      if (gpg_err_code (err) == GPG_ERR_CARD_NOT_PRESENT)
+        ; /* Lost the card.  */
+      else
         {
-          char *tmp = xstrdup (args);
-
-          percent_unescape (tmp, 1);
-          if (parm->updfnc)
-            parm->updfnc (parm->card, entry_id, tmp);
-          else if (GTK_IS_LABEL (parm->card->entries[entry_id]))
-            gtk_label_set_text
-              (GTK_LABEL (parm->card->entries[entry_id]), tmp);
-          else
-            gtk_entry_set_text
-              (GTK_ENTRY (parm->card->entries[entry_id]), tmp);
-          xfree (tmp);
+          g_debug ("loading attribute `%s' failed: %s <%s>\n",
+                   attridx < 0? "[all]" : attrtbl[attridx].name,
+                   gpg_strerror (err), gpg_strsource (err));
         }
+      clear_card_data (card);
     }
-
-  return 0;
+  card->reloading--;
 }
 
 
@@ -153,53 +173,18 @@ scd_getattr_cb (void *opaque, const char *status, const char *args)
 static void
 reload_data (GpaCMDinsig *card)
 {
-  static struct {
-    const char *name;
-    int entry_id;
-    void (*updfnc) (GpaCMDinsig *card, int entry_id, char *string);
-  } attrtbl[] = {
-    { "SERIALNO",    ENTRY_SERIALNO },
-    { NULL }
-  };
+  const char *names[DIM (attrtbl)];
   int attridx;
-  gpg_error_t err, operr;
-  char command[100];
-  struct scd_getattr_parm parm;
-  gpgme_ctx_t gpgagent;
 
-  gpgagent = GPA_CM_OBJECT (card)->agent_ctx;
-  g_return_if_fail (gpgagent);
+  g_return_if_fail (GPA_CM_OBJECT (card)->agent_queue);
 
   card->reloading++;
-  parm.card = card;
   for (attridx=0; attrtbl[attridx].name; attridx++)
-    {
-      parm.name     = attrtbl[attridx].name;
-      parm.entry_id = attrtbl[attridx].entry_id;
-      parm.updfnc   = attrtbl[attridx].updfnc;
-      snprintf (command, sizeof command, "SCD GETATTR %s", parm.name);
-      err = gpgme_op_assuan_transact_ext (gpgagent,
-                                          command,
-                                          NULL, NULL,
-                                          NULL, NULL,
-                                          scd_getattr_cb, &parm, &operr);
-      if (!err)
-        err = operr;
-
-      if (err)
-        {
-          if (gpg_err_code (err) == GPG_ERR_CARD_NOT_PRESENT)
-            ; /* Lost the card.  */
-          else
-            {
-              g_debug ("assuan command `%s' failed: %s <%s>\n",
-                       command, gpg_strerror (err), gpg_strsource (err));
-            }
-          clear_card_data (card);
-          break;
-        }
-    }
-  card->reloading--;
+    names[attridx] = attrtbl[attridx].name;
+  names[attridx] = NULL;
+
+  gpa_cm_object_load_attrs (GPA_CM_OBJECT (card), names, scd_getattr_cb,
+                            reload_data_done_cb, card);
 }
 
 
@@ -373,12 +358,12 @@ gpa_cm_dinsig_new ()
 /* If WIDGET is of Type GpaCMDinsig do a data reload through the
    assuan connection.  */
 void
-gpa_cm_dinsig_reload (GtkWidget *widget, gpgme_ctx_t gpgagent)
+gpa_cm_dinsig_reload (GtkWidget *widget, gpa_agent_queue_t agent_queue)
 {
   if (GPA_IS_CM_DINSIG (widget))
     {
-      GPA_CM_OBJECT (widget)->agent_ctx = gpgagent;
-      if (gpgagent)
+      GPA_CM_OBJECT (widget)->agent_queue = agent_queue;
+      if (agent_queue)
         reload_data (GPA_CM_DINSIG (widget));
     }
 }
@@ -65,7 +65,8 @@ GType gpa_cm_dinsig_get_type (void) G_GNUC_CONST;
 
 /* The class specific API.  */
 GtkWidget *gpa_cm_dinsig_new (void);
-void gpa_cm_dinsig_reload (GtkWidget *widget, gpgme_ctx_t gpgagent);
+void gpa_cm_dinsig_reload (GtkWidget *widget,
+                           gpa_agent_queue_t agent_queue);
 
 
 
@@ -109,97 +109,85 @@ clear_card_data (GpaCMGeldkarte *card)
 }
 
 
-struct scd_getattr_parm
-{
-  GpaCMGeldkarte *card;  /* The object.  */
-  const char *name;      /* Name of expected attribute.  */
-  int entry_id;          /* The identifier for the entry.  */
-  void (*updfnc) (GpaCMGeldkarte *card, int entry_id, const char *string);
+/* The attributes shown by the widget.  */
+static struct {
+  const char *name;
+  int entry_id;
+  void (*updfnc) (GpaCMGeldkarte *card, int entry_id,  const char *string);
+} attrtbl[] = {
+  { "X-KBLZ",      ENTRY_KBLZ },
+  { "X-BANKINFO",  ENTRY_BANKTYPE },
+  { "X-CARDNO",    ENTRY_CARDNO },
+  { "X-EXPIRES",   ENTRY_EXPIRES },
+  { "X-VALIDFROM", ENTRY_VALIDFROM },
+  { "X-COUNTRY",   ENTRY_COUNTRY },
+  { "X-CURRENCY",  ENTRY_CURRENCY },
+  { "X-ZKACHIPID", ENTRY_ZKACHIPID },
+  { "X-OSVERSION", ENTRY_OSVERSION },
+  { "X-BALANCE",   ENTRY_BALANCE },
+  { "X-MAXAMOUNT", ENTRY_MAXAMOUNT },
+  { "X-MAXAMOUNT1",ENTRY_MAXAMOUNT1 },
+  { NULL }
 };
 
 
-static gpg_error_t
-scd_getattr_cb (void *opaque, const char *status, const char *args)
+/* Called by gpa_cm_object_load_attrs for the attribute ATTRIDX of
+   ATTRTBL.  */
+static void
+scd_getattr_cb (void *opaque, int attridx, const char *args)
 {
-  struct scd_getattr_parm *parm = opaque;
+  GpaCMGeldkarte *card = opaque;
   int entry_id;
 
-/*   g_debug ("STATUS_CB: status=`%s'  args=`%s'", status, args); */
+/*   g_debug ("STATUS_CB: status=`%s'  args=`%s'", */
+/*            attrtbl[attridx].name, args); */
 
-  if (!strcmp (status, parm->name) )
+  entry_id = attrtbl[attridx].entry_id;
+  if (entry_id < ENTRY_LAST)
     {
-      entry_id = parm->entry_id;
+      if (attrtbl[attridx].updfnc)
+        attrtbl[attridx].updfnc (card, entry_id, args);
+      else
+        gtk_label_set_text (GTK_LABEL (card->entries[entry_id]), args);
+    }
+}
 
-      if (entry_id < ENTRY_LAST)
+
+/* Called by gpa_cm_object_load_attrs after all attributes have been
+   loaded.  */
+static void
+reload_data_done_cb (void *opaque, gpg_error_t err, int attridx)
+{
+  GpaCMGeldkarte *card = opaque;
+
+  if (err)
+    {
+      if (gpg_err_code (err) == GPG_ERR_CARD_NOT_PRESENT)
+        ; /* Lost the card.  */
+      else
         {
-          if (parm->updfnc)
-            parm->updfnc (parm->card, entry_id, args);
-          else
-            gtk_label_set_text
-              (GTK_LABEL (parm->card->entries[entry_id]), args);
+          g_debug ("loading attribute `%s' failed: %s <%s>\n",
+                   attridx < 0? "[all]" : attrtbl[attridx].name,
+                   gpg_strerror (err), gpg_strsource (err));
         }
+      clear_card_data (card);
     }
-
-  return 0;
 }
 
 
 /* Use the assuan machinery to load the bulk of the OpenPGP card data.  */
 static void
-reload_data (GpaCMGeldkarte *card, gpgme_ctx_t gpgagent)
+reload_data (GpaCMGeldkarte *card)
 {
-  static struct {
-    const char *name;
-    int entry_id;
-    void (*updfnc) (GpaCMGeldkarte *card, int entry_id,  const char *string);
-  } attrtbl[] = {
-    { "X-KBLZ",      ENTRY_KBLZ },
-    { "X-BANKINFO",  ENTRY_BANKTYPE },
-    { "X-CARDNO",    ENTRY_CARDNO },
-    { "X-EXPIRES",   ENTRY_EXPIRES },
-    { "X-VALIDFROM", ENTRY_VALIDFROM },
-    { "X-COUNTRY",   ENTRY_COUNTRY },
-    { "X-CURRENCY",  ENTRY_CURRENCY },
-    { "X-ZKACHIPID", ENTRY_ZKACHIPID },
-    { "X-OSVERSION", ENTRY_OSVERSION },
-    { "X-BALANCE",   ENTRY_BALANCE },
-    { "X-MAXAMOUNT", ENTRY_MAXAMOUNT },
-    { "X-MAXAMOUNT1",ENTRY_MAXAMOUNT1 },
-    { NULL }
-  };
+  const char *names[DIM (attrtbl)];
   int attridx;
-  gpg_error_t err, operr;
-  char command[100];
-  struct scd_getattr_parm parm;
 
-  parm.card = card;
   for (attridx=0; attrtbl[attridx].name; attridx++)
-    {
-      parm.name     = attrtbl[attridx].name;
-      parm.entry_id = attrtbl[attridx].entry_id;
-      parm.updfnc   = attrtbl[attridx].updfnc;
-      snprintf (command, sizeof command, "SCD GETATTR %s", parm.name);
-      err = gpgme_op_assuan_transact_ext (gpgagent,
-                                          command,
-                                          NULL, NULL,
-                                          NULL, NULL,
-                                          scd_getattr_cb, &parm, &operr);
-      if (!err)
-        err = operr;
-
-      if (err)
-        {
-          if (gpg_err_code (err) == GPG_ERR_CARD_NOT_PRESENT)
-            ; /* Lost the card.  */
-          else
-            {
-              g_debug ("assuan command `%s' failed: %s <%s>\n",
-                       command, gpg_strerror (err), gpg_strsource (err));
-            }
-          clear_card_data (card);
-          break;
-        }
-    }
+    names[attridx] = attrtbl[attridx].name;
+  names[attridx] = NULL;
+
+  gpa_cm_object_load_attrs (GPA_CM_OBJECT (card), names, scd_getattr_cb,
+                            reload_data_done_cb, card);
 }
 
 
@@ -396,8 +384,12 @@ gpa_cm_geldkarte_new ()
 /* If WIDGET is of Type GpaCMGeldkarte do a data reload through the
    assuan connection.  */
 void
-gpa_cm_geldkarte_reload (GtkWidget *widget, gpgme_ctx_t gpgagent)
+gpa_cm_geldkarte_reload (GtkWidget *widget, gpa_agent_queue_t agent_queue)
 {
   if (GPA_IS_CM_GELDKARTE (widget))
-    reload_data (GPA_CM_GELDKARTE (widget), gpgagent);
+    {
+      GPA_CM_OBJECT (widget)->agent_queue = agent_queue;
+      if (agent_queue)
+        reload_data (GPA_CM_GELDKARTE (widget));
+    }
 }
@@ -248,8 +248,8 @@ update_entry_chv_status (GpaCMNetkey *card, int entry_id, char *string)
 }
 
 
-/* Structure form comminucation between reload_more_data and
-   reload_more_data_cb.  */
+/* Structure form comminucation between reload_more_data and its
+   callbacks.  */
 struct reload_more_data_parm
 {
   GpaCMNetkey *card; /* self  */
@@ -325,58 +325,30 @@ reload_more_data_cb (void *opaque, const char *status, const char *args)
 }
 
 
-/* Reload more data.  This function is called from the idle handler.  */
+/* Release the parameter of reload_more_data.  */
 static void
-reload_more_data (GpaCMNetkey *card)
+reload_more_data_release (void *opaque)
 {
-  gpg_error_t err, operr;
-  gpgme_ctx_t gpgagent;
-  GtkWidget *vbox;
-  struct reload_more_data_parm parm;
-
-  g_debug ("start reload_more_data (count=%d)", card->reloading);
-  gpgagent = GPA_CM_OBJECT (card)->agent_ctx;
-  g_return_if_fail (gpgagent);
-  g_return_if_fail (card->keys_frame);
-  g_debug ("  gpgagent=%p", gpgagent);
-
-  /* We remove any existing children of the keys frame and then we add
-     a new vbox to be filled with new widgets by the callback.  */
-  vbox = gtk_bin_get_child (GTK_BIN (card->keys_frame));
-  if (vbox)
-    gtk_widget_destroy (vbox);
-  vbox = gtk_vbox_new (FALSE, 5);
-  gtk_container_add (GTK_CONTAINER (card->keys_frame), vbox);
+  struct reload_more_data_parm *parm = opaque;
 
-  /* Create a context for key listings.  */
-  parm.any_unknown = 0;
-  parm.card = card;
-  err = gpgme_new (&parm.ctx);
-  if (err)
-    {
-      /* We don't want an error window because we are run from an idle
-         handler and the information is not that important.  */
-      g_debug ("failed to create a context: %s", gpg_strerror (err));
-      return;
-    }
-  gpgme_set_protocol (parm.ctx, GPGME_PROTOCOL_CMS);
-  /* We include ephemeral keys in the listing.  */
-  gpgme_set_keylist_mode (parm.ctx, GPGME_KEYLIST_MODE_EPHEMERAL);
+  gpgme_release (parm->ctx);
+  xfree (parm);
+}
 
-  g_debug ("  parm.ctx=%p", parm.ctx);
 
-  err = gpgme_op_assuan_transact_ext (gpgagent,
-                                      "SCD LEARN --keypairinfo",
-                                      NULL, NULL, NULL, NULL,
-                                      reload_more_data_cb, &parm, &operr);
-  g_debug ("  assuan ret=%d", err);
-  if (!err)
-    err = operr;
+/* Called after all keys of the card have been listed.  */
+static void
+reload_more_data_done_cb (gpg_error_t err, void *opaque)
+{
+  struct reload_more_data_parm *parm = opaque;
+  GpaCMNetkey *card = parm->card;
+  GtkWidget *vbox;
 
   if (err)
     g_debug ("SCD LEARN failed: %s", gpg_strerror (err));
 
-  if (parm.any_unknown)
+  vbox = gtk_bin_get_child (GTK_BIN (card->keys_frame));
+  if (parm->any_unknown && vbox)
     {
       GtkWidget *button, *align;
 
@@ -403,10 +375,55 @@ reload_more_data (GpaCMNetkey *card)
                         G_CALLBACK (learn_keys_clicked_cb), card);
     }
 
-  gpgme_release (parm.ctx);
   gtk_widget_show_all (card->keys_frame);
+  card->reloading--;
   g_debug ("end   reload_more_data (count=%d)", card->reloading);
-  return;
+}
+
+
+/* Reload more data.  This function is called from the idle handler.  */
+static void
+reload_more_data (GpaCMNetkey *card)
+{
+  gpg_error_t err;
+  gpa_agent_queue_t queue;
+  GtkWidget *vbox;
+  struct reload_more_data_parm *parm;
+
+  g_debug ("start reload_more_data (count=%d)", card->reloading);
+  queue = GPA_CM_OBJECT (card)->agent_queue;
+  g_return_if_fail (queue);
+  g_return_if_fail (card->keys_frame);
+
+  /* We remove any existing children of the keys frame and then we add
+     a new vbox to be filled with new widgets by the callback.  */
+  vbox = gtk_bin_get_child (GTK_BIN (card->keys_frame));
+  if (vbox)
+    gtk_widget_destroy (vbox);
+  vbox = gtk_vbox_new (FALSE, 5);
+  gtk_container_add (GTK_CONTAINER (card->keys_frame), vbox);
+
+  /* Create a context for key listings.  */
+  parm = xcalloc (1, sizeof *parm);
+  parm->card = card;
+  err = gpgme_new (&parm->ctx);
+  if (err)
+    {
+      /* We don't want an error window because we are run from an idle
+         handler and the information is not that important.  */
+      g_debug ("failed to create a context: %s", gpg_strerror (err));
+      xfree (parm);
+      return;
+    }
+  gpgme_set_protocol (parm->ctx, GPGME_PROTOCOL_CMS);
+  /* We include ephemeral keys in the listing.  */
+  gpgme_set_keylist_mode (parm->ctx, GPGME_KEYLIST_MODE_EPHEMERAL);
+
+  card->reloading++;
+  gpa_agent_queue_push (queue, card, "SCD LEARN --keypairinfo",
+                        GPA_AGENT_QUEUE_TIMEOUT, NULL, NULL,
+                        reload_more_data_cb, reload_more_data_done_cb,
+                        parm, reload_more_data_release);
 }
 
 
@@ -418,125 +435,90 @@ reload_more_data_idle_cb (void *user_data)
 
   if (card->reloading)
     {
+      /* The commands of the running reload are still queued; don't
+         spin the idle queue while waiting for them.  */
       g_debug ("already reloading (count=%d)", card->reloading);
-    return TRUE; /* Just in case we are still reloading, wait for the
-                    next idle slot.  */
+      g_timeout_add (100, reload_more_data_idle_cb, card);
+      return FALSE;
     }
 
-  card->reloading++;
   reload_more_data (card);
   g_object_unref (card);
-  card->reloading--;
 
   return FALSE;  /* Remove us from the idle queue.  */
 }
 
 
-struct scd_getattr_parm
-{
-  GpaCMNetkey *card;  /* The object.  */
-  const char *name;   /* Name of expected attribute.  */
-  int entry_id;       /* The identifier for the entry.  */
+/* The attributes shown by the widget.  NKS-VERSION must be the last
+   one; see reload_data.  */
+static struct {
+  const char *name;
+  int entry_id;
   void (*updfnc) (GpaCMNetkey *card, int entry_id, char *string);
+} attrtbl[] = {
+  { "SERIALNO",    ENTRY_SERIALNO },
+  { "CHV-STATUS",  ENTRY_PIN_RETRYCOUNTER, update_entry_chv_status },
+  { "NKS-VERSION", ENTRY_NKS_VERSION },
+  { NULL }
 };
 
 
-static gpg_error_t
-scd_getattr_cb (void *opaque, const char *status, const char *args)
+/* Called by gpa_cm_object_load_attrs for the attribute ATTRIDX of
+   ATTRTBL.  */
+static void
+scd_getattr_cb (void *opaque, int attridx, const char *args)
 {
-  struct scd_getattr_parm *parm = opaque;
+  GpaCMNetkey *card = opaque;
   int entry_id;
 
-/*   g_debug ("STATUS_CB: status=`%s'  args=`%s'", status, args); */
+/*   g_debug ("STATUS_CB: status=`%s'  args=`%s'", */
+/*            attrtbl[attridx].name, args); */
 
-  if (!strcmp (status, parm->name) )
+  entry_id = attrtbl[attridx].entry_id;
+  if (entry_id < ENTRY_LAST)
     {
-      entry_id = parm->entry_id;
+      char *tmp = xstrdup (args);
 
-      if (entry_id < ENTRY_LAST)
-        {
-          char *tmp = xstrdup (args);
-
-          percent_unescape (tmp, 1);
-          if (parm->updfnc)
-            parm->updfnc (parm->card, entry_id, tmp);
-          else if (GTK_IS_LABEL (parm->card->entries[entry_id]))
-            gtk_label_set_text
-              (GTK_LABEL (parm->card->entries[entry_id]), tmp);
-          else
-            gtk_entry_set_text
-              (GTK_ENTRY (parm->card->entries[entry_id]), tmp);
-          xfree (tmp);
-        }
+      percent_unescape (tmp, 1);
+      if (attrtbl[attridx].updfnc)
+        attrtbl[attridx].updfnc (card, entry_id, tmp);
+      else if (GTK_IS_LABEL (card->entries[entry_id]))
+        gtk_label_set_text (GTK_LABEL (card->entries[entry_id]), tmp);
+      else
+        gtk_entry_set_text (GTK_ENTRY (card->entries[entry_id]), tmp);
+      xfree (tmp);
     }
-
-  return 0;
 }
 
 
-/* Use the assuan machinery to load the bulk of the OpenPGP card data.  */
+/* Called by gpa_cm_object_load_attrs after all attributes have been
+   loaded.  */
 static void
-reload_data (GpaCMNetkey *card)
+reload_data_done_cb (void *opaque, gpg_error_t err, int attridx)
 {
-  static struct {
-    const char *name;
-    int entry_id;
-    void (*updfnc) (GpaCMNetkey *card, int entry_id, char *string);
-  } attrtbl[] = {
-    { "SERIALNO",    ENTRY_SERIALNO },
-    { "NKS-VERSION", ENTRY_NKS_VERSION },
-    { "CHV-STATUS",  ENTRY_PIN_RETRYCOUNTER, update_entry_chv_status },
-    { NULL }
-  };
-  int attridx;
-  gpg_error_t err = 0;
-  gpg_error_t operr;
-  char command[100];
-  struct scd_getattr_parm parm;
-  gpgme_ctx_t gpgagent;
-
-  gpgagent = GPA_CM_OBJECT (card)->agent_ctx;
-  g_return_if_fail (gpgagent);
+  GpaCMNetkey *card = opaque;
 
-  card->reloading++;
-  g_debug ("uped reloading counter (count=%d)", card->reloading);
-
-  /* Show all attributes.  */
-  parm.card = card;
-  for (attridx=0; attrtbl[attridx].name; attridx++)
+  if (err && attridx >= 0 && attrtbl[attridx].entry_id == ENTRY_NKS_VERSION)
     {
-      parm.name     = attrtbl[attridx].name;
-      parm.entry_id = attrtbl[attridx].entry_id;
-      parm.updfnc   = attrtbl[attridx].updfnc;
-      snprintf (command, sizeof command, "SCD GETATTR %s", parm.name);
-      err = gpgme_op_assuan_transact_ext (gpgagent,
-                                          command,
-                                          NULL, NULL,
-                                          NULL, NULL,
-                                          scd_getattr_cb, &parm, &operr);
-      if (!err)
-        err = operr;
-
-      if (err && attrtbl[attridx].entry_id == ENTRY_NKS_VERSION)
-        {
-          /* The NKS-VERSION is only supported by GnuPG > 2.0.11
-             thus we ignore the error.  */
-          gtk_label_set_text
-            (GTK_LABEL (card->entries[attrtbl[attridx].entry_id]),
-             _("unknown"));
-        }
-      else if (err)
+      /* The NKS-VERSION is only supported by GnuPG > 2.0.11 thus we
+         ignore the error.  Being the last attribute, all others
+         have already been loaded.  */
+      gtk_label_set_text
+        (GTK_LABEL (card->entries[attrtbl[attridx].entry_id]),
+         _("unknown"));
+      err = 0;
+    }
+  else if (err)
+    {
+      if (gpg_err_code (err) == GPG_ERR_CARD_NOT_PRESENT)
+        ; /* Lost the card.  */
+      else
         {
-          if (gpg_err_code (err) == GPG_ERR_CARD_NOT_PRESENT)
-            ; /* Lost the card.  */
-          else
-            {
-              g_debug ("assuan command `%s' failed: %s <%s>\n",
-                       command, gpg_strerror (err), gpg_strsource (err));
-            }
-          clear_card_data (card);
-          break;
+          g_debug ("loading attribute `%s' failed: %s <%s>\n",
+                   attridx < 0? "[all]" : attrtbl[attridx].name,
+                   gpg_strerror (err), gpg_strsource (err));
         }
+      clear_card_data (card);
     }
   if (!err)
     {
@@ -548,6 +530,28 @@ reload_data (GpaCMNetkey *card)
 }
 
 
+/* Use the assuan machinery to load the bulk of the OpenPGP card data.  */
+static void
+reload_data (GpaCMNetkey *card)
+{
+  const char *names[DIM (attrtbl)];
+  int attridx;
+
+  g_return_if_fail (GPA_CM_OBJECT (card)->agent_queue);
+
+  card->reloading++;
+  g_debug ("uped reloading counter (count=%d)", card->reloading);
+
+  /* Show all attributes.  */
+  for (attridx=0; attrtbl[attridx].name; attridx++)
+    names[attridx] = attrtbl[attridx].name;
+  names[attridx] = NULL;
+
+  gpa_cm_object_load_attrs (GPA_CM_OBJECT (card), names, scd_getattr_cb,
+                            reload_data_done_cb, card);
+}
+
+
 /* A structure used to pass data to the learn_keys_gpg_status_cb.  */
 struct learn_keys_gpg_status_parm
 {
@@ -624,19 +628,38 @@ learn_keys_clicked_cb (GtkButton *button, void *user_data)
 }
 
 
+/* Called when the NullPIN has been changed.  */
+static void
+change_nullpin_done_cb (gpg_error_t err, void *opaque)
+{
+  GpaCMNetkey *card = opaque;
+
+  if (gpg_err_code (err) == GPG_ERR_CANCELED)
+    return; /* No need to reload the data.  */
+  else if (err)
+    {
+      char *message = g_strdup_printf
+        (_("Error changing the NullPIN.\n"
+           "(%s <%s>)"), gpg_strerror (err), gpg_strsource (err));
+      gpa_window_error (message, NULL);
+      xfree (message);
+    }
+  reload_data (card);
+}
+
+
 /* Run the dialog to change the NullPIN.  */
 static void
 change_nullpin (GpaCMNetkey *card)
 {
-  gpg_error_t err, operr;
   GtkWidget *dialog;
-  gpgme_ctx_t gpgagent;
+  gpa_agent_queue_t queue;
   int is_sigg;
   char *string;
   int okay;
 
-  gpgagent = GPA_CM_OBJECT (card)->agent_ctx;
-  g_return_if_fail (gpgagent);
+  queue = GPA_CM_OBJECT (card)->agent_queue;
+  g_return_if_fail (queue);
 
   if (card->pininfo[0].valid && card->pininfo[0].nullpin)
     is_sigg = 0;
@@ -678,48 +701,52 @@ change_nullpin (GpaCMNetkey *card)
   okay = (gtk_dialog_run (GTK_DIALOG (dialog)) == GTK_RESPONSE_OK);
   if (okay)
     {
-      err = gpgme_op_assuan_transact_ext (gpgagent,
-                                          is_sigg
-                                          ? "SCD PASSWD --nullpin PW1.CH.SIG"
-                                          : "SCD PASSWD --nullpin PW1.CH",
-                                          NULL, NULL,
-                                          NULL, NULL,
-                                          NULL, NULL, &operr);
-      if (!err)
-        err = operr;
-
-      if (gpg_err_code (err) == GPG_ERR_CANCELED)
-        okay = 0; /* No need to reload the data.  */
-      else if (err)
-        {
-          char *message = g_strdup_printf
-            (_("Error changing the NullPIN.\n"
-               "(%s <%s>)"), gpg_strerror (err), gpg_strsource (err));
-          gpa_window_error (message, NULL);
-          xfree (message);
-        }
+      /* Pinentry waits for the user; thus no timeout.  */
+      gpa_agent_queue_push (queue, card,
+                            is_sigg
+                            ? "SCD PASSWD --nullpin PW1.CH.SIG"
+                            : "SCD PASSWD --nullpin PW1.CH",
+                            0, NULL, NULL, NULL,
+                            change_nullpin_done_cb, card, NULL);
     }
   gtk_widget_destroy (GTK_WIDGET (dialog));
-  if (okay)
-    reload_data (card);
 }
 
 
 
+/* Called when a PIN or PUK has been changed or reset.  */
+static void
+change_pin_done_cb (gpg_error_t err, void *opaque)
+{
+  GpaCMNetkey *card = opaque;
+
+  if (gpg_err_code (err) == GPG_ERR_CANCELED)
+    return; /* No need to reload the data.  */
+  else if (err)
+    {
+      char *message = g_strdup_printf
+        (_("Error changing or resetting the PIN/PUK.\n"
+           "(%s <%s>)"), gpg_strerror (err), gpg_strsource (err));
+      gpa_window_error (message, NULL);
+      xfree (message);
+    }
+  reload_data (card);
+}
+
+
 static void
 change_or_reset_pin (GpaCMNetkey *card, int info_idx)
 {
-  gpg_error_t err, operr;
   GtkWidget *dialog;
-  gpgme_ctx_t gpgagent;
+  gpa_agent_queue_t queue;
   int reset_mode;
   const char *string;
   int is_puk;
   int okay;
   const char *pwidstr;
 
-  gpgagent = GPA_CM_OBJECT (card)->agent_ctx;
-  g_return_if_fail (gpgagent);
+  queue = GPA_CM_OBJECT (card)->agent_queue;
+  g_return_if_fail (queue);
   g_return_if_fail (info_idx < DIM (card->pininfo));
 
   if (!card->pininfo[info_idx].valid
@@ -794,26 +821,11 @@ change_or_reset_pin (GpaCMNetkey *card, int info_idx)
 
       snprintf (command, sizeof command, "SCD PASSWD%s %s",
                 reset_mode? " --reset":"", pwidstr);
-      err = gpgme_op_assuan_transact_ext (gpgagent, command,
-                                          NULL, NULL, NULL, NULL, NULL, NULL,
-                                          &operr);
-      if (!err)
-        err = operr;
-
-      if (gpg_err_code (err) == GPG_ERR_CANCELED)
-        okay = 0; /* No need to reload the data.  */
-      else if (err)
-        {
-          char *message = g_strdup_printf
-            (_("Error changing or resetting the PIN/PUK.\n"
-               "(%s <%s>)"), gpg_strerror (err), gpg_strsource (err));
-          gpa_window_error (message, NULL);
-          xfree (message);
-        }
+      /* Pinentry waits for the user; thus no timeout.  */
+      gpa_agent_queue_push (queue, card, command, 0, NULL, NULL, NULL,
+                            change_pin_done_cb, card, NULL);
     }
   gtk_widget_destroy (GTK_WIDGET (dialog));
-  if (okay)
-    reload_data (card);
 }
 
 
@@ -1084,12 +1096,12 @@ gpa_cm_netkey_new ()
 /* If WIDGET is of Type GpaCMNetkey do a data reload through the
    assuan connection.  */
 void
-gpa_cm_netkey_reload (GtkWidget *widget, gpgme_ctx_t gpgagent)
+gpa_cm_netkey_reload (GtkWidget *widget, gpa_agent_queue_t agent_queue)
 {
   if (GPA_IS_CM_NETKEY (widget))
     {
-      GPA_CM_OBJECT (widget)->agent_ctx = gpgagent;
-      if (gpgagent)
+      GPA_CM_OBJECT (widget)->agent_queue = agent_queue;
+      if (agent_queue)
         reload_data (GPA_CM_NETKEY (widget));
     }
 }
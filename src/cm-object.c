@@ -66,6 +66,132 @@ static void gpa_cm_object_finalize (GObject *object);
  *******************   Implementation   *********************
  ************************************************************/
 
+/* Parameter for the commands of gpa_cm_object_load_attrs.  */
+struct load_attrs_parm
+{
+  GpaCMObject *obj;
+  const char **names;        /* The attributes to load.  */
+  char *seen;                /* Flags telling which ones arrived.  */
+  int learning;              /* Set while running LEARN.  */
+  int next;                  /* Next attribute to check for GETATTR.  */
+  int chained;               /* Another command has been queued.  */
+  gpa_cm_object_attr_cb_t cb;
+  gpa_cm_object_attrs_done_t done_cb;
+  void *opaque;
+};
+
+
+static gpg_error_t
+load_attrs_status_cb (void *opaque, const char *status, const char *args)
+{
+  struct load_attrs_parm *parm = opaque;
+  int idx;
+
+  /* Older versions of scdaemon append a time stamp to the serial
+     number in the LEARN output; we use GETATTR for it.  */
+  if (parm->learning && !strcmp (status, "SERIALNO"))
+    return 0;
+
+  for (idx = 0; parm->names[idx]; idx++)
+    if (!strcmp (status, parm->names[idx]))
+      {
+        parm->seen[idx] = 1;
+        parm->cb (parm->opaque, idx, args);
+        break;
+      }
+
+  return 0;
+}
+
+
+/* Release the parameter unless another command uses it.  */
+static void
+load_attrs_release (void *opaque)
+{
+  struct load_attrs_parm *parm = opaque;
+
+  if (parm->chained)
+    {
+      parm->chained = 0;
+      return;
+    }
+  g_free (parm->names);
+  g_free (parm->seen);
+  g_free (parm);
+}
+
+
+static void load_attrs_getattr_done_cb (gpg_error_t err, void *opaque);
+
+/* Request the next attribute not seen so far.  */
+static void
+load_attrs_next (struct load_attrs_parm *parm)
+{
+  char command[100];
+
+  while (parm->names[parm->next] && parm->seen[parm->next])
+    parm->next++;
+  if (!parm->names[parm->next])
+    {
+      parm->done_cb (parm->opaque, 0, -1);
+      return;
+    }
+
+  snprintf (command, sizeof command, "SCD GETATTR %s",
+            parm->names[parm->next]);
+  parm->chained = 1;
+  gpa_agent_queue_push (parm->obj->agent_queue, parm->obj, command,
+                        GPA_AGENT_QUEUE_TIMEOUT, NULL, NULL,
+                        load_attrs_status_cb, load_attrs_getattr_done_cb,
+                        parm, load_attrs_release);
+}
+
+
+static void
+load_attrs_getattr_done_cb (gpg_error_t err, void *opaque)
+{
+  struct load_attrs_parm *parm = opaque;
+
+  if (err)
+    parm->done_cb (parm->opaque, err, parm->next);
+  else
+    {
+      parm->next++;
+      load_attrs_next (parm);
+    }
+}
+
+
+static void
+load_attrs_learn_done_cb (gpg_error_t err, void *opaque)
+{
+  struct load_attrs_parm *parm = opaque;
+
+  parm->learning = 0;
+  if (gpg_err_code (err) == GPG_ERR_CARD_NOT_PRESENT
+      || gpg_err_code (err) == GPG_ERR_CARD_REMOVED)
+    {
+      parm->done_cb (parm->opaque, err, -1);
+      return;
+    }
+  if (err)
+    g_debug ("assuan command `SCD LEARN' failed: %s <%s>\n",
+             gpg_strerror (err), gpg_strsource (err));
+
+  load_attrs_next (parm);
+}
+
+
+/* Handler for the "destroy" signal.  */
+static void
+destroy_cb (GtkObject *object, void *opaque)
+{
+  GpaCMObject *card = GPA_CM_OBJECT (object);
+
+  /* The callbacks of our commands expect the widgets to exist.  */
+  gpa_agent_queue_cancel (card->agent_queue, card);
+}
+
 
 
 
@@ -105,8 +231,9 @@ gpa_cm_object_class_init (void *class_ptr, void *class_data)
 static void
 gpa_cm_object_init (GTypeInstance *instance, void *class_ptr)
 {
-/*   GpaCMObject *card = GPA_CM_OBJECT (instance); */
+  GpaCMObject *card = GPA_CM_OBJECT (instance);
 
+  g_signal_connect (card, "destroy", G_CALLBACK (destroy_cb), NULL);
 }
 
 
@@ -168,6 +295,42 @@ gpa_cm_object_update_status (GpaCMObject *obj, const char *text)
   g_signal_emit (obj, signals[UPDATE_STATUS], 0, text);
 }
 
+/* Load the attributes NAMES, a NULL terminated array, of the current
+   card through the agent queue of OBJ.  CB is called with OPAQUE for
+   each status line of an attribute as soon as it arrives; IDX is the
+   index of the attribute and ARGS its value.  The data of most cards
+   is returned by a single LEARN command; only attributes not
+   included in its output are requested by GETATTR.  DONE_CB is called
+   with OPAQUE at the end; on error FAILED is the index of the failed
+   attribute or -1.  Nothing is called if OBJ is destroyed before.  */
+void
+gpa_cm_object_load_attrs (GpaCMObject *obj, const char **names,
+                          gpa_cm_object_attr_cb_t cb,
+                          gpa_cm_object_attrs_done_t done_cb, void *opaque)
+{
+  struct load_attrs_parm *parm;
+  int n;
+
+  g_return_if_fail (obj->agent_queue);
+
+  for (n = 0; names[n]; n++)
+    ;
+  parm = g_malloc0 (sizeof *parm);
+  parm->obj = obj;
+  parm->names = g_memdup (names, (n + 1) * sizeof *names);
+  parm->seen = g_malloc0 (n + 1);
+  parm->cb = cb;
+  parm->done_cb = done_cb;
+  parm->opaque = opaque;
+
+  parm->learning = 1;
+  gpa_agent_queue_push (obj->agent_queue, obj, "SCD LEARN --force",
+                        GPA_AGENT_QUEUE_TIMEOUT, NULL, NULL,
+                        load_attrs_status_cb, load_attrs_learn_done_cb,
+                        parm, load_attrs_release);
+}
+
+
 /* Emit the error message MSG.  */
 void
 gpa_cm_object_alert_dialog (GpaCMObject *obj, const gchar *messageg)
@@ -32,6 +32,8 @@
 
 #include <gtk/gtk.h>
 
+#include "agentqueue.h"
+
 /* Declare the Object. */
 typedef struct _GpaCMObject      GpaCMObject;
 typedef struct _GpaCMObjectClass GpaCMObjectClass;
@@ -75,7 +77,7 @@ struct _GpaCMObject
   GtkVBox  parent_instance;
 
   /* Private.  Fixme:  Hide them.  */
-  gpgme_ctx_t agent_ctx;
+  gpa_agent_queue_t agent_queue;
 };
 
 
@@ -86,5 +88,14 @@ struct _GpaCMObject
 void gpa_cm_object_update_status (GpaCMObject *obj, const char *text);
 void gpa_cm_object_alert_dialog (GpaCMObject *obj, const gchar *messageg);
 
+typedef void (*gpa_cm_object_attr_cb_t) (void *opaque, int idx,
+                                         const char *args);
+typedef void (*gpa_cm_object_attrs_done_t) (void *opaque, gpg_error_t err,
+                                            int failed);
+void gpa_cm_object_load_attrs (GpaCMObject *obj, const char **names,
+                               gpa_cm_object_attr_cb_t cb,
+                               gpa_cm_object_attrs_done_t done_cb,
+                               void *opaque);
+
 
 #endif /*CM_OBJECT_H*/
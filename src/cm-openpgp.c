@@ -513,159 +513,191 @@ update_entry_key_attr (GpaCMOpenpgp *card, int entry_id, const char *string)
 }
 
 
-struct scd_getattr_parm
-{
-  GpaCMOpenpgp *card;  /* The object.  */
-  const char *name;     /* Name of expected attribute.  */
-  int entry_id;        /* The identifier for the entry.  */
-  void (*updfnc) (GpaCMOpenpgp *card, int entry_id, const char *string);
+/* The attributes shown by the widget.  */
+static struct {
+  const char *name;
+  int entry_id;
+  void (*updfnc) (GpaCMOpenpgp *card, int entry_id,  const char *string);
+} attrtbl[] = {
+  { "SERIALNO",   ENTRY_SERIALNO, update_entry_serialno },
+  { "DISP-NAME",  ENTRY_LAST_NAME, update_entry_name },
+  { "DISP-LANG",  ENTRY_LANGUAGE },
+  { "DISP-SEX",   ENTRY_SEX, update_entry_sex },
+  { "PUBKEY-URL", ENTRY_PUBKEY_URL },
+  { "LOGIN-DATA", ENTRY_LOGIN },
+  { "SIG-COUNTER",ENTRY_SIG_COUNTER },
+  { "CHV-STATUS", ENTRY_PIN_RETRYCOUNTER,  update_entry_chv_status },
+  { "KEY-FPR",    ENTRY_LAST, update_entry_fpr },
+/*   { "CA-FPR", }, */
+  { "KEY-ATTR",   ENTRY_LAST, update_entry_key_attr },
+  { NULL }
 };
 
 
-static gpg_error_t
-scd_getattr_cb (void *opaque, const char *status, const char *args)
+/* Called by gpa_cm_object_load_attrs for the attribute ATTRIDX of
+   ATTRTBL.  */
+static void
+scd_getattr_cb (void *opaque, int attridx, const char *args)
 {
-  struct scd_getattr_parm *parm = opaque;
+  GpaCMOpenpgp *card = opaque;
+  const char *status = attrtbl[attridx].name;
+  void (*updfnc) (GpaCMOpenpgp *card, int entry_id, const char *string);
   int entry_id;
 
 /*   g_debug ("STATUS_CB: status=`%s'  args=`%s'", status, args); */
 
-  if (!strcmp (status, parm->name) )
+  updfnc = attrtbl[attridx].updfnc;
+  entry_id = attrtbl[attridx].entry_id;
+  if (entry_id == ENTRY_LAST && !strcmp (status, "KEY-FPR"))
     {
-      entry_id = parm->entry_id;
-      if (entry_id == ENTRY_LAST && !strcmp (status, "KEY-FPR"))
+      /* Special entry ID for the fingerprints: We need to figure
+         out what entry is actually to be used.  */
+      if (*args == '1')
+        entry_id = ENTRY_KEY_SIG;
+      else if (*args == '2')
+        entry_id = ENTRY_KEY_ENC;
+      else if (*args == '3')
+        entry_id = ENTRY_KEY_AUTH;
+      else
         {
-          /* Special entry ID for the fingerprints: We need to figure
-             out what entry is actually to be used.  */
-          if (*args == '1')
-            entry_id = ENTRY_KEY_SIG;
-          else if (*args == '2')
-            entry_id = ENTRY_KEY_ENC;
-          else if (*args == '3')
-            entry_id = ENTRY_KEY_AUTH;
-          else
-            {
-              /* Ooops.  */
-            }
-          if (*args)
-            {
-              for (args++; spacep (args); args++)
-                ;
-            }
+          /* Ooops.  */
         }
-
-      if (entry_id < ENTRY_LAST)
+      if (*args)
         {
-          char *tmp = xstrdup (args);
-
-          percent_unescape (tmp, 1);
-          if (parm->updfnc)
-            parm->updfnc (parm->card, entry_id, tmp);
-          else if (GTK_IS_LABEL (parm->card->entries[entry_id]))
-            gtk_label_set_text
-              (GTK_LABEL (parm->card->entries[entry_id]), tmp);
-          else
-            gtk_entry_set_text
-              (GTK_ENTRY (parm->card->entries[entry_id]), tmp);
-          xfree (tmp);
+          for (args++; spacep (args); args++)
+            ;
         }
-      else if (entry_id == ENTRY_LAST && parm->updfnc)
-        {
-          char *tmp = xstrdup (args);
+    }
 
-          percent_unescape (tmp, 1);
-          parm->updfnc (parm->card, entry_id, tmp);
-          xfree (tmp);
-        }
+  if (entry_id < ENTRY_LAST)
+    {
+      char *tmp = xstrdup (args);
+
+      percent_unescape (tmp, 1);
+      if (updfnc)
+        updfnc (card, entry_id, tmp);
+      else if (GTK_IS_LABEL (card->entries[entry_id]))
+        gtk_label_set_text
+          (GTK_LABEL (card->entries[entry_id]), tmp);
+      else
+        gtk_entry_set_text
+          (GTK_ENTRY (card->entries[entry_id]), tmp);
+      xfree (tmp);
     }
+  else if (entry_id == ENTRY_LAST && updfnc)
+    {
+      char *tmp = xstrdup (args);
 
-  return 0;
+      percent_unescape (tmp, 1);
+      updfnc (card, entry_id, tmp);
+      xfree (tmp);
+    }
 }
 
 
 
+/* Called by gpa_cm_object_load_attrs after all attributes have been
+   loaded.  */
+static void
+reload_data_done_cb (void *opaque, gpg_error_t err, int attridx)
+{
+  GpaCMOpenpgp *card = opaque;
+
+  if (err)
+    {
+      if (gpg_err_code (err) == GPG_ERR_CARD_NOT_PRESENT)
+        ; /* Lost the card.  */
+      else
+        {
+          g_debug ("loading attribute `%s' failed: %s <%s>\n",
+                   attridx < 0? "[all]" : attrtbl[attridx].name,
+                   gpg_strerror (err), gpg_strsource (err));
+        }
+      clear_card_data (card);
+    }
+  update_entry_key_attr (card, 0, NULL);  /* Append ky attributes.  */
+  clear_changed_flags (card);
+  card->reloading--;
+}
+
+
 /* Use the assuan machinery to load the bulk of the OpenPGP card data.  */
 static void
 reload_data (GpaCMOpenpgp *card)
 {
-  static struct {
-    const char *name;
-    int entry_id;
-    void (*updfnc) (GpaCMOpenpgp *card, int entry_id,  const char *string);
-  } attrtbl[] = {
-    { "SERIALNO",   ENTRY_SERIALNO, update_entry_serialno },
-    { "DISP-NAME",  ENTRY_LAST_NAME, update_entry_name },
-    { "DISP-LANG",  ENTRY_LANGUAGE },
-    { "DISP-SEX",   ENTRY_SEX, update_entry_sex },
-    { "PUBKEY-URL", ENTRY_PUBKEY_URL },
-    { "LOGIN-DATA", ENTRY_LOGIN },
-    { "SIG-COUNTER",ENTRY_SIG_COUNTER },
-    { "CHV-STATUS", ENTRY_PIN_RETRYCOUNTER,  update_entry_chv_status },
-    { "KEY-FPR",    ENTRY_LAST, update_entry_fpr },
-/*     { "CA-FPR", }, */
-    { "KEY-ATTR",   ENTRY_LAST, update_entry_key_attr },
-    { NULL }
-  };
+  const char *names[DIM (attrtbl)];
   int attridx;
-  gpg_error_t err, operr;
-  char command[100];
-  struct scd_getattr_parm parm;
-  gpgme_ctx_t gpgagent;
 
   show_edit_error (card, NULL);
 
-  gpgagent = GPA_CM_OBJECT (card)->agent_ctx;
-  g_return_if_fail (gpgagent);
+  g_return_if_fail (GPA_CM_OBJECT (card)->agent_queue);
 
   card->reloading++;
-  parm.card = card;
   for (attridx=0; attrtbl[attridx].name; attridx++)
+    names[attridx] = attrtbl[attridx].name;
+  names[attridx] = NULL;
+
+  gpa_cm_object_load_attrs (GPA_CM_OBJECT (card), names, scd_getattr_cb,
+                            reload_data_done_cb, card);
+}
+
+
+/* Parameter for save_attr_done_cb.  */
+struct save_attr_parm
+{
+  GpaCMOpenpgp *card;
+  int entry_id;
+};
+
+
+static void
+save_attr_done_cb (gpg_error_t err, void *opaque)
+{
+  struct save_attr_parm *parm = opaque;
+  GpaCMOpenpgp *card = parm->card;
+
+  if (!err)
+    return;
+
+  if (!(gpg_err_code (err) == GPG_ERR_CANCELED
+        && gpg_err_source (err) == GPG_ERR_SOURCE_PINENTRY))
     {
-      parm.name     = attrtbl[attridx].name;
-      parm.entry_id = attrtbl[attridx].entry_id;
-      parm.updfnc   = attrtbl[attridx].updfnc;
-      snprintf (command, sizeof command, "SCD GETATTR %s", parm.name);
-
-      err = gpgme_op_assuan_transact_ext (gpgagent,
-                                          command,
-                                          NULL, NULL,
-                                          NULL, NULL,
-                                          scd_getattr_cb, &parm, &operr);
-      if (!err)
-        err = operr;
-
-      if (err)
-        {
-          if (gpg_err_code (err) == GPG_ERR_CARD_NOT_PRESENT)
-            ; /* Lost the card.  */
-          else
-            {
-              g_debug ("assuan command `%s' failed: %s <%s>\n",
-                       command, gpg_strerror (err), gpg_strsource (err));
-            }
-          clear_card_data (card);
-          break;
-        }
+      char *message = g_strdup_printf
+        (_("Error saving the changed values.\n"
+           "(%s <%s>)"), gpg_strerror (err), gpg_strsource (err));
+      gpa_cm_object_alert_dialog (GPA_CM_OBJECT (card), message);
+      xfree (message);
+    }
+  show_edit_error (card, _("Saving the field failed."));
 
+  /* Keep the field marked as changed so that leaving it again retries
+     the save.  The combo box is saved on each change instead.  */
+  if (parm->entry_id == ENTRY_FIRST_NAME
+      || parm->entry_id == ENTRY_LAST_NAME)
+    {
+      card->changed[ENTRY_FIRST_NAME] = TRUE;
+      card->changed[ENTRY_LAST_NAME] = TRUE;
     }
-  update_entry_key_attr (card, 0, NULL);  /* Append ky attributes.  */
-  clear_changed_flags (card);
-  card->reloading--;
+  else if (parm->entry_id != ENTRY_SEX)
+    card->changed[parm->entry_id] = TRUE;
 }
 
 
+/* Queue the command to save the value of the field ENTRY_ID as the
+   attribute NAME.  Errors are reported as soon as the card answered;
+   only a cancellation by the user is returned.  */
 static gpg_error_t
-save_attr (GpaCMOpenpgp *card, const char *name,
+save_attr (GpaCMOpenpgp *card, int entry_id, const char *name,
            const char *value, int is_escaped)
 {
-  gpg_error_t err, operr;
+  struct save_attr_parm *parm;
   char *command;
-  gpgme_ctx_t gpgagent;
+  gpa_agent_queue_t queue;
 
   g_return_val_if_fail (*name && value, gpg_error (GPG_ERR_BUG));
 
-  gpgagent = GPA_CM_OBJECT (card)->agent_ctx;
-  g_return_val_if_fail (gpgagent,gpg_error (GPG_ERR_BUG));
+  queue = GPA_CM_OBJECT (card)->agent_queue;
+  g_return_val_if_fail (queue, gpg_error (GPG_ERR_BUG));
 
   if (!show_admin_pin_notice (card))
     return gpg_error (GPG_ERR_CANCELED);
@@ -680,25 +712,15 @@ save_attr (GpaCMOpenpgp *card, const char *name,
       command = g_strdup_printf ("SCD SETATTR %s %s", name, p);
       xfree (p);
     }
-  err = gpgme_op_assuan_transact_ext (gpgagent,
-                                      command,
-                                      NULL, NULL,
-                                      NULL, NULL,
-                                      NULL, NULL, &operr);
-  if (!err)
-    err = operr;
 
-  if (err && !(gpg_err_code (err) == GPG_ERR_CANCELED
-               && gpg_err_source (err) == GPG_ERR_SOURCE_PINENTRY))
-    {
-      char *message = g_strdup_printf
-        (_("Error saving the changed values.\n"
-           "(%s <%s>)"), gpg_strerror (err), gpg_strsource (err));
-      gpa_cm_object_alert_dialog (GPA_CM_OBJECT (card), message);
-      xfree (message);
-    }
+  /* The agent may ask for the Admin-PIN; thus no timeout.  */
+  parm = g_malloc0 (sizeof *parm);
+  parm->card = card;
+  parm->entry_id = entry_id;
+  gpa_agent_queue_push (queue, card, command, 0, NULL, NULL, NULL,
+                        save_attr_done_cb, parm, g_free);
   xfree (command);
-  return err;
+  return 0;
 }
 
 
@@ -753,7 +775,7 @@ save_entry_name (GpaCMOpenpgp *card)
       if (strlen (buffer) > 39)
         errstr = _("Total length of first and last name "
                    "may not be longer than 39 characters.");
-      else if (save_attr (card, "DISP-NAME", buffer, 0))
+      else if (save_attr (card, ENTRY_FIRST_NAME, "DISP-NAME", buffer, 0))
         errstr = _("Saving the field failed.");
       g_free (buffer);
     }
@@ -791,7 +813,7 @@ save_entry_language (GpaCMOpenpgp *card)
       goto leave;
     }
 
-  if (save_attr (card, "DISP-LANG", value, 0))
+  if (save_attr (card, ENTRY_LANGUAGE, "DISP-LANG", value, 0))
     errstr = _("Saving the field failed.");
 
 leave:
@@ -818,7 +840,7 @@ save_entry_sex (GpaCMOpenpgp *card)
   else
     string = "9";
 
-  if (save_attr (card, "DISP-SEX", string, 0))
+  if (save_attr (card, ENTRY_SEX, "DISP-SEX", string, 0))
     errstr = _("Saving the field failed.");
 
   if (errstr)
@@ -842,7 +864,7 @@ save_entry_pubkey_url (GpaCMOpenpgp *card)
       goto leave;
     }
 
-  if (save_attr (card, "PUBKEY-URL", value, 0))
+  if (save_attr (card, ENTRY_PUBKEY_URL, "PUBKEY-URL", value, 0))
     errstr = _("Saving the field failed.");
 
 leave:
@@ -867,7 +889,7 @@ save_entry_login (GpaCMOpenpgp *card)
       goto leave;
     }
 
-  if (save_attr (card, "LOGIN-DATA", value, 0))
+  if (save_attr (card, ENTRY_LOGIN, "LOGIN-DATA", value, 0))
     errstr = _("Saving the field failed.");
 
 leave:
@@ -888,7 +910,8 @@ save_entry_sig_force_pin (GpaCMOpenpgp *card)
   value = gtk_toggle_button_get_active
     (GTK_TOGGLE_BUTTON (card->entries[ENTRY_SIG_FORCE_PIN]));
 
-  if (save_attr (card, "CHV-STATUS-1", value? "%00":"%01", 1))
+  if (save_attr (card, ENTRY_SIG_FORCE_PIN, "CHV-STATUS-1",
+                 value? "%00":"%01", 1))
     errstr = _("Saving the field failed.");
 
   if (errstr)
@@ -1056,21 +1079,40 @@ edit_focus_cb (GtkWidget *widget, GtkDirectionType direction, void *opaque)
 
 
 
+/* Called when the PIN has been changed or reset.  */
+static void
+change_pin_done_cb (gpg_error_t err, void *opaque)
+{
+  GpaCMOpenpgp *card = opaque;
+
+  if (gpg_err_code (err) == GPG_ERR_CANCELED)
+    return; /* No need to reload the data.  */
+  else if (err)
+    {
+      char *message = g_strdup_printf
+        (_("Error changing or resetting the PIN/PUK.\n"
+           "(%s <%s>)"), gpg_strerror (err), gpg_strsource (err));
+      gpa_window_error (message, NULL);
+      xfree (message);
+    }
+  reload_data (card);
+}
+
+
 /* The button to change the PIN with number PINNO has been clicked.  */
 static void
 change_pin (GpaCMOpenpgp *card, int pinno)
 {
-  gpg_error_t err, operr;
   GtkWidget *dialog;
-  gpgme_ctx_t gpgagent;
+  gpa_agent_queue_t queue;
   int reset_mode = 0;
   int unblock_pin = 0;
   const char *string;
   int okay;
 
 
-  gpgagent = GPA_CM_OBJECT (card)->agent_ctx;
-  g_return_if_fail (gpgagent);
+  queue = GPA_CM_OBJECT (card)->agent_queue;
+  g_return_if_fail (queue);
   g_return_if_fail (pinno >= 0 && pinno < DIM (card->change_pin_btn));
 
   if (!card->is_v2 && pinno == 1)
@@ -1181,26 +1223,11 @@ change_pin (GpaCMOpenpgp *card, int pinno)
 
       snprintf (command, sizeof command, "SCD PASSWD%s %d",
                 reset_mode? " --reset":"", pinno+1);
-      err = gpgme_op_assuan_transact_ext (gpgagent, command,
-                                          NULL, NULL, NULL, NULL, NULL, NULL,
-                                          &operr);
-      if (!err)
-        err = operr;
-
-      if (gpg_err_code (err) == GPG_ERR_CANCELED)
-        okay = 0; /* No need to reload the data.  */
-      else if (err)
-        {
-          char *message = g_strdup_printf
-            (_("Error changing or resetting the PIN/PUK.\n"
-               "(%s <%s>)"), gpg_strerror (err), gpg_strsource (err));
-          gpa_window_error (message, NULL);
-          xfree (message);
-        }
+      /* Pinentry waits for the user; thus no timeout.  */
+      gpa_agent_queue_push (queue, card, command, 0, NULL, NULL, NULL,
+                            change_pin_done_cb, card, NULL);
     }
   gtk_widget_destroy (GTK_WIDGET (dialog));
-  if (okay)
-    reload_data (card);
 }
 
 
@@ -1707,12 +1734,12 @@ gpa_cm_openpgp_new ()
    reference to GPGAGENT for later processing.  Passing NULL for
    GPGAGENT removes this reference. */
 void
-gpa_cm_openpgp_reload (GtkWidget *widget, gpgme_ctx_t gpgagent)
+gpa_cm_openpgp_reload (GtkWidget *widget, gpa_agent_queue_t agent_queue)
 {
   if (GPA_IS_CM_OPENPGP (widget))
     {
-      GPA_CM_OBJECT (widget)->agent_ctx = gpgagent;
-      if (gpgagent)
+      GPA_CM_OBJECT (widget)->agent_queue = agent_queue;
+      if (agent_queue)
         reload_data (GPA_CM_OPENPGP (widget));
     }
 }
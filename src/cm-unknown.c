@@ -82,50 +82,52 @@ static void gpa_cm_unknown_finalize (GObject *object);
  *******************   Implementation   *********************
  ************************************************************/
 
+/* Parameter for the ATR callbacks.  */
+struct reload_data_parm
+{
+  GpaCMUnknown *card;
+  membuf_t mb;
+};
+
+
 static gpg_error_t
 scd_atr_data_cb (void *opaque, const void *data, size_t datalen)
 {
-  membuf_t *mb = opaque;
+  struct reload_data_parm *parm = opaque;
 
-  put_membuf (mb, data, datalen);
+  put_membuf (&parm->mb, data, datalen);
   return 0;
 }
 
 
-/* Use the assuan machinery to read the ATR.  */
 static void
-reload_data (GpaCMUnknown *card)
+reload_data_release (void *opaque)
 {
-  gpg_error_t err, operr;
-  char command[100];
-  gpgme_ctx_t gpgagent;
-  membuf_t mb;
-  char *buf;
-
-  gpgagent = GPA_CM_OBJECT (card)->agent_ctx;
-  g_return_if_fail (gpgagent);
+  struct reload_data_parm *parm = opaque;
 
-  card->reloading++;
+  g_free (get_membuf (&parm->mb, NULL));
+  g_free (parm);
+}
 
-  init_membuf (&mb, 512);
 
-  err = gpgme_op_assuan_transact_ext (gpgagent,
-                                      "SCD APDU --dump-atr",
-                                      scd_atr_data_cb, &mb,
-                                      NULL, NULL, NULL, NULL, &operr);
-  if (!err)
-    err = operr;
+static void
+reload_data_done_cb (gpg_error_t err, void *opaque)
+{
+  struct reload_data_parm *parm = opaque;
+  GpaCMUnknown *card = parm->card;
+  char *buf;
 
   if (!err)
     {
-      put_membuf (&mb, "", 1);
-      buf = get_membuf (&mb, NULL);
+      put_membuf (&parm->mb, "", 1);
+      buf = get_membuf (&parm->mb, NULL);
       if (buf)
         {
-          buf = g_strdup_printf ("\n%s\n%s",
-                                 _("The ATR of the card is:"),
-                                 buf);
-          gtk_label_set_text (GTK_LABEL (card->label), buf);
+          char *tmp = g_strdup_printf ("\n%s\n%s",
+                                       _("The ATR of the card is:"),
+                                       buf);
+          gtk_label_set_text (GTK_LABEL (card->label), tmp);
+          g_free (tmp);
           g_free (buf);
         }
       else
@@ -133,19 +135,39 @@ reload_data (GpaCMUnknown *card)
     }
   else
     {
-      g_free (get_membuf (&mb, NULL));
-
       if (gpg_err_code (err) == GPG_ERR_CARD_NOT_PRESENT)
         ; /* Lost the card.  */
       else
-        g_debug ("assuan command `%s' failed: %s <%s>\n",
-                 command, gpg_strerror (err), gpg_strsource (err));
+        g_debug ("assuan command `SCD APDU' failed: %s <%s>\n",
+                 gpg_strerror (err), gpg_strsource (err));
       gtk_label_set_text (GTK_LABEL (card->label), "");
     }
   card->reloading--;
 }
 
 
+/* Use the assuan machinery to read the ATR.  */
+static void
+reload_data (GpaCMUnknown *card)
+{
+  struct reload_data_parm *parm;
+  gpa_agent_queue_t queue;
+
+  queue = GPA_CM_OBJECT (card)->agent_queue;
+  g_return_if_fail (queue);
+
+  card->reloading++;
+
+  parm = g_malloc0 (sizeof *parm);
+  parm->card = card;
+  init_membuf (&parm->mb, 512);
+
+  gpa_agent_queue_push (queue, card, "SCD APDU --dump-atr",
+                        GPA_AGENT_QUEUE_TIMEOUT, scd_atr_data_cb, NULL, NULL,
+                        reload_data_done_cb, parm, reload_data_release);
+}
+
+
 
 
 /* This function constructs the container holding all widgets making
@@ -252,12 +274,12 @@ gpa_cm_unknown_new ()
 /* If WIDGET is of Type GpaCMUnknown do a data reload through the
    assuan connection.  */
 void
-gpa_cm_unknown_reload (GtkWidget *widget, gpgme_ctx_t gpgagent)
+gpa_cm_unknown_reload (GtkWidget *widget, gpa_agent_queue_t agent_queue)
 {
   if (GPA_IS_CM_UNKNOWN (widget))
     {
-      GPA_CM_OBJECT (widget)->agent_ctx = gpgagent;
-      if (gpgagent)
+      GPA_CM_OBJECT (widget)->agent_queue = agent_queue;
+      if (agent_queue)
         reload_data (GPA_CM_UNKNOWN (widget));
     }
 }
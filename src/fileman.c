@@ -43,7 +43,7 @@
 #include "icons.h"
 #include "fileman.h"
 
-#include "gpafiledecryptop.h"
+#include "gpafilebatchop.h"
 #include "gpafileencryptop.h"
 #include "gpafilesignop.h"
 #include "gpafileverifyop.h"
@@ -62,6 +62,14 @@ struct _GpaFileManager
   GtkWidget *window;
   GtkWidget *list_files;
   GList *selection_sensitive_actions;
+
+  /* The canonical names of the files in the list.  */
+  GHashTable *files;
+
+  /* The files created by operations but not yet added to the list
+     and the idle handler to add them.  */
+  GSList *created_files;
+  guint created_idle_id;
 };
 
 struct _GpaFileManagerClass
@@ -91,6 +99,10 @@ enum
 
 #define DND_TARGET_URI_LIST 1
 
+/* Detach the model from the view if at least this many files are
+   added at once.  */
+#define DETACH_THRESHOLD 100
+
 
 /* Drag and drop target list. */
 static GtkTargetEntry dnd_target_list[] =
@@ -115,6 +127,12 @@ static GObject *gpa_file_manager_constructor
 static void
 gpa_file_manager_finalize (GObject *object)
 {
+  GpaFileManager *fileman = GPA_FILE_MANAGER (object);
+
+  g_hash_table_destroy (fileman->files);
+  g_slist_foreach (fileman->created_files, (GFunc) g_free, NULL);
+  g_slist_free (fileman->created_files);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -123,6 +141,8 @@ static void
 gpa_file_manager_init (GpaFileManager *fileman)
 {
   fileman->selection_sensitive_actions = NULL;
+  fileman->files = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                          g_free, NULL);
 }
 
 static void
@@ -206,17 +226,13 @@ get_selected_files (GtkWidget *list)
 }
 
 
-/* Add file FILENAME to the file list of FILEMAN and select it */
-static gboolean
-add_file (GpaFileManager *fileman, const gchar *filename)
+/* Return FILENAME in the UTF-8 encoding.  The caller must free the
+   result.  */
+static gchar *
+filename_to_utf8 (const gchar *filename)
 {
-  GtkListStore *store;
-  GtkTreeIter iter;
-  GtkTreePath *path;
-  GtkTreeSelection *sel;
   gchar *filename_utf8;
 
-  /* The tree contains filenames in the UTF-8 encoding.  */
   filename_utf8 = g_filename_to_utf8 (filename, -1, NULL, NULL, NULL);
 
   /* Try to convert from the current locale as fallback. This is important
@@ -234,52 +250,182 @@ add_file (GpaFileManager *fileman, const gchar *filename)
       filename_utf8 = g_filename_display_name (filename);
     }
 
-  store = GTK_LIST_STORE (gtk_tree_view_get_model
-                          (GTK_TREE_VIEW (fileman->list_files)));
-
-  /* Check for duplicates. */
-  path = gtk_tree_path_new_first ();
-  if (gtk_tree_model_get_iter (GTK_TREE_MODEL (store), &iter, path))
-    do
-      {
-	gchar *tmp;
-	gboolean exists;
-
-	gtk_tree_model_get (GTK_TREE_MODEL (store), &iter, FILE_NAME_COLUMN,
-			    &tmp, -1);
-	exists = g_str_equal (filename_utf8, tmp);
-	g_free (tmp);
-	if (exists)
-	  {
-	    g_free (filename_utf8);
-	    gtk_tree_path_free (path);
-	    return FALSE; /* This file is already in our list.  */
-	  }
-      }
-    while (gtk_tree_model_iter_next (GTK_TREE_MODEL (store), &iter));
-  gtk_tree_path_free (path);
-
-  /* Append it to our list.  */
-  gtk_list_store_append (store, &iter);
-
-  /* FIXME: Add the file status when/if gpgme supports it */
-  gtk_list_store_set (store, &iter, FILE_NAME_COLUMN, filename_utf8, -1);
-
-  /* Select the row */
-  sel = gtk_tree_view_get_selection (GTK_TREE_VIEW (fileman->list_files));
-  gtk_tree_selection_select_iter (sel, &iter);
+  return filename_utf8;
+}
+
+
+/* Return the canonical form of the UTF-8 file name FILENAME, which is
+   used to detect duplicates: the absolute name without empty and "."
+   components.  ".." is kept because of symbolic links.  The caller
+   must free the result.  */
+static gchar *
+canonical_name (const gchar *filename)
+{
+  gchar *absolute;
+  const gchar *root;
+  gchar **parts;
+  GString *result;
+  gsize root_len;
+  int i;
+
+  if (g_path_is_absolute (filename))
+    absolute = g_strdup (filename);
+  else
+    {
+      gchar *cwd = g_get_current_dir ();
+      gchar *cwd_utf8 = filename_to_utf8 (cwd);
+
+      absolute = g_build_filename (cwd_utf8, filename, NULL);
+      g_free (cwd_utf8);
+      g_free (cwd);
+    }
+
+  root = g_path_skip_root (absolute);
+  if (!root)
+    return absolute;
+
+  root_len = root - absolute;
+  result = g_string_new_len (absolute, root_len);
+  parts = g_strsplit_set (root, "/" G_DIR_SEPARATOR_S, -1);
+  for (i = 0; parts[i]; i++)
+    {
+      if (!*parts[i] || !strcmp (parts[i], "."))
+        continue;
+      if (result->len > root_len)
+        g_string_append_c (result, G_DIR_SEPARATOR);
+      g_string_append (result, parts[i]);
+    }
+  g_strfreev (parts);
+  g_free (absolute);
+
+  return g_string_free (result, FALSE);
+}
+
+
+/* Add the files in the list FILENAMES to the file list of FILEMAN and
+   select them.  Files already in the list are skipped.  Returns the
+   number of files added.  */
+static int
+add_files (GpaFileManager *fileman, GSList *filenames)
+{
+  GtkTreeView *view = GTK_TREE_VIEW (fileman->list_files);
+  GtkTreeModel *model = gtk_tree_view_get_model (view);
+  GtkTreeSelection *sel = gtk_tree_view_get_selection (view);
+  GList *selected = NULL;
+  GList *item;
+  GtkTreePath *first, *last;
+  gboolean detached = FALSE;
+  gchar *filename_utf8;
+  gchar *key;
+  gint n_rows;
+  int added = 0;
+
+  n_rows = gtk_tree_model_iter_n_children (model, NULL);
+
+  /* Detach the model while adding many files; this saves the view
+     from updating itself for each row.  Detaching clears the
+     selection, thus it is restored afterwards.  */
+  if (g_slist_length (filenames) >= DETACH_THRESHOLD)
+    {
+      selected = gtk_tree_selection_get_selected_rows (sel, NULL);
+      g_object_ref (model);
+      gtk_tree_view_set_model (view, NULL);
+      detached = TRUE;
+    }
+
+  for (; filenames; filenames = g_slist_next (filenames))
+    {
+      /* The tree contains filenames in the UTF-8 encoding.  */
+      filename_utf8 = filename_to_utf8 (filenames->data);
+
+      key = canonical_name (filename_utf8);
+      if (g_hash_table_lookup_extended (fileman->files, key, NULL, NULL))
+        {
+          /* This file is already in our list.  */
+          g_free (key);
+          g_free (filename_utf8);
+          continue;
+        }
+      g_hash_table_insert (fileman->files, key, NULL);
+
+      /* FIXME: Add the file status when/if gpgme supports it */
+      gtk_list_store_insert_with_values (GTK_LIST_STORE (model), NULL, -1,
+                                         FILE_NAME_COLUMN, filename_utf8,
+                                         -1);
+      g_free (filename_utf8);
+      added++;
+    }
+
+  if (detached)
+    {
+      gtk_tree_view_set_model (view, model);
+      g_object_unref (model);
+      for (item = selected; item; item = g_list_next (item))
+        gtk_tree_selection_select_path (sel, item->data);
+      g_list_foreach (selected, (GFunc) gtk_tree_path_free, NULL);
+      g_list_free (selected);
+    }
+
+  /* Select the new rows.  */
+  if (added)
+    {
+      first = gtk_tree_path_new_from_indices (n_rows, -1);
+      last = gtk_tree_path_new_from_indices (n_rows + added - 1, -1);
+      gtk_tree_selection_select_range (sel, first, last);
+      gtk_tree_path_free (first);
+      gtk_tree_path_free (last);
+    }
+
+  return added;
+}
+
+
+/* Add file FILENAME to the file list of FILEMAN and select it */
+static gboolean
+add_file (GpaFileManager *fileman, const gchar *filename)
+{
+  GSList *filenames;
+  int added;
+
+  filenames = g_slist_prepend (NULL, (gpointer) filename);
+  added = add_files (fileman, filenames);
+  g_slist_free (filenames);
+
+  return added > 0;
+}
+
 
-  return TRUE;
+/* Idle handler to add the files created by operations.  */
+static gboolean
+add_created_files (gpointer data)
+{
+  GpaFileManager *fileman = data;
+  GSList *filenames;
+
+  fileman->created_idle_id = 0;
+  filenames = g_slist_reverse (fileman->created_files);
+  fileman->created_files = NULL;
+
+  add_files (fileman, filenames);
+  g_slist_foreach (filenames, (GFunc) g_free, NULL);
+  g_slist_free (filenames);
+
+  return FALSE;
 }
 
 
-/* Add a file created by an operation to the list */
+/* Add a file created by an operation to the list.  The files are
+   collected and added together from the main loop; an operation on
+   many files thus updates the list only once.  */
 static void
 file_created_cb (GpaFileOperation *op, gpa_file_item_t item, gpointer data)
 {
   GpaFileManager *fileman = data;
 
-  add_file (fileman, item->filename_out);
+  fileman->created_files = g_slist_prepend (fileman->created_files,
+                                            g_strdup (item->filename_out));
+  if (!fileman->created_idle_id)
+    fileman->created_idle_id = g_idle_add (add_created_files, fileman);
 }
 
 
@@ -381,19 +527,6 @@ get_load_file_name (GtkWidget *parent, const gchar *title,
 
 
 /* Handle menu item "File/Open".  */
-
-void
-open_file_one (gpointer data, gpointer user_data)
-{
-  GpaFileManager *fileman = user_data;
-  gchar *filename = (gchar *) data;
-
-  /* FIXME: We are ignoring errors here.  */
-  add_file (fileman, filename);
-  g_free (filename);
-}
-
-
 static void
 file_open (GtkAction *action, gpointer param)
 {
@@ -404,7 +537,8 @@ file_open (GtkAction *action, gpointer param)
   if (! filenames)
     return;
 
-  g_slist_foreach (filenames, open_file_one, fileman);
+  add_files (fileman, filenames);
+  g_slist_foreach (filenames, (GFunc) g_free, NULL);
   g_slist_free (filenames);
 }
 
@@ -418,6 +552,7 @@ file_clear (GtkAction *action, gpointer param)
                                         (GTK_TREE_VIEW (fileman->list_files)));
 
   gtk_list_store_clear (store);
+  g_hash_table_remove_all (fileman->files);
 }
 
 
@@ -481,13 +616,14 @@ file_decrypt (GtkAction *action, gpointer param)
 {
   GpaFileManager *fileman = param;
   GList *files;
-  GpaFileDecryptOperation *op;
+  GpaFileBatchOperation *op;
 
   files = get_selected_files (fileman->list_files);
   if (!files)
     return;
 
-  op = gpa_file_decrypt_verify_operation_new (GTK_WIDGET (fileman), files);
+  /* Each file is decrypted or verified as appropriate.  */
+  op = gpa_file_batch_operation_new (GTK_WIDGET (fileman), files);
 
   register_operation (fileman, GPA_FILE_OPERATION (op));
 }
@@ -708,6 +844,7 @@ dnd_data_received_handler (GtkWidget *widget, GdkDragContext *context,
         {
           char *p = (char *) selection_data->data;
           char **list;
+          GSList *names = NULL;
           int i;
 
           list = g_uri_list_extract_uris (p);
@@ -719,11 +856,15 @@ dnd_data_received_handler (GtkWidget *widget, GdkDragContext *context,
                   /* Canonical line endings are required for an uri-list. */
                   if ((p = strchr (name, '\r')))
                     *p = 0;
-                  add_file (fileman, name);
-                  g_free (name);
+                  names = g_slist_prepend (names, name);
                 }
             }
           g_strfreev (list);
+
+          names = g_slist_reverse (names);
+          add_files (fileman, names);
+          g_slist_foreach (names, (GFunc) g_free, NULL);
+          g_slist_free (names);
           dnd_success = TRUE;
         }
     }
@@ -782,6 +923,11 @@ file_list_new (GpaFileManager * fileman)
 static void
 file_manager_closed (GtkWidget *widget, gpointer param)
 {
+  GpaFileManager *fileman = param;
+
+  if (fileman->created_idle_id)
+    g_source_remove (fileman->created_idle_id);
+  fileman->created_idle_id = 0;
   instance = NULL;
 }
 
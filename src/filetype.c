@@ -95,6 +95,71 @@ detect_cms (const char *data, size_t datalen)
 #endif /*!HAVE_GPGME_DATA_IDENTIFY*/
 
 
+#if !defined(HAVE_GPGME_DATA_IDENTIFY) || GPGME_VERSION_NUMBER < 0x010700
+/* Return true if the data (DATA,DATALEN) starts like a detached
+   OpenPGP signature: either with a signature packet or with the armor
+   line of a signature.  */
+static int
+detect_pgp_signature (const char *data, size_t datalen)
+{
+  const char *s, *end;
+  unsigned int ctb;
+
+  if (!datalen)
+    return 0;
+
+  ctb = (unsigned char) *data;
+  if ((ctb & 0x80))
+    {
+      /* A binary message.  The packet tag is in bits 0..5 for the new
+         and in bits 2..5 for the old packet format.  */
+      if ((ctb & 0x40))
+        return (ctb & 0x3f) == 2;
+      return ((ctb >> 2) & 0x0f) == 2;
+    }
+
+  /* The first armor line tells the type; a clear signed message also
+     has the armor line of a signature but only after its own.  */
+  end = data + datalen;
+  for (s = data; s < end; s++)
+    {
+      if (end - s >= 11 && !strncmp (s, "-----BEGIN ", 11))
+        return (end - s >= 29
+                && !strncmp (s + 11, "PGP SIGNATURE-----", 18));
+      s = memchr (s, '\n', end - s);
+      if (!s)
+        break;
+    }
+
+  return 0;
+}
+
+
+/* Read the start of the data object DH into BUFFER of size SIZE and
+   return the number of bytes read.  The read position of DH is not
+   changed.  */
+static size_t
+peek_data (gpgme_data_t dh, char *buffer, size_t size)
+{
+  off_t pos;
+  ssize_t n;
+  size_t datalen = 0;
+
+  pos = gpgme_data_seek (dh, 0, SEEK_CUR);
+  if (pos < 0)
+    return 0;
+  while (datalen < size
+         && (n = gpgme_data_read (dh, buffer + datalen,
+                                  size - datalen)) > 0)
+    datalen += n;
+  if (gpgme_data_seek (dh, pos, SEEK_SET) < 0)
+    return 0;
+
+  return datalen;
+}
+#endif
+
+
 /* Return true if the file FNAME looks like an CMS file.  There is no
    error return, just a best effort try to identify CMS in a file with
    a CMS object.  */
@@ -201,9 +266,9 @@ is_cms_data (const char *data, size_t datalen)
 #endif
 }
 
-/* New version of is_cms_data which requires a decent version of
-   gpgme.  In contrast to is_cms_data this works directly on a gpgme
-   data object.  */
+/* Version of is_cms_data which works directly on a gpgme data object.
+   The read position of DH is not changed.  Without a decent version
+   of gpgme the start of the data is read and given to is_cms_data.  */
 int
 is_cms_data_ext (gpgme_data_t dh)
 {
@@ -220,6 +285,108 @@ is_cms_data_ext (gpgme_data_t dh)
       return 0;
     }
 #else
-  return 0;
+  char buffer[CMS_BUFFER_SIZE];
+
+  return is_cms_data (buffer, peek_data (dh, buffer, sizeof buffer));
+#endif
+}
+
+
+/* Return the class of the data object DH and store true at R_IS_CMS
+   if it is a CMS object.  The read position of DH is not changed.
+   Without gpgme_data_identify only detached OpenPGP signatures are
+   recognized by their first bytes; everything else is reported as
+   unknown.  */
+data_class_t
+classify_data (gpgme_data_t dh, int *r_is_cms)
+{
+#if !defined(HAVE_GPGME_DATA_IDENTIFY) || GPGME_VERSION_NUMBER < 0x010700
+  char buffer[CMS_BUFFER_SIZE];
+#endif
+
+  *r_is_cms = 0;
+#ifdef HAVE_GPGME_DATA_IDENTIFY
+  switch (gpgme_data_identify (dh, 0))
+    {
+    case GPGME_DATA_TYPE_PGP_ENCRYPTED:
+      return DATA_CLASS_ENCRYPTED;
+    case GPGME_DATA_TYPE_PGP_SIGNED:
+#if GPGME_VERSION_NUMBER < 0x010700
+      /* This gpgme does not tell detached signatures apart.  */
+      if (detect_pgp_signature (buffer,
+                                peek_data (dh, buffer, sizeof buffer)))
+        return DATA_CLASS_SIGNATURE;
+#endif
+      return DATA_CLASS_SIGNED;
+#if GPGME_VERSION_NUMBER >= 0x010700
+    case GPGME_DATA_TYPE_PGP_SIGNATURE:
+      return DATA_CLASS_SIGNATURE;
+#endif
+    case GPGME_DATA_TYPE_PGP_OTHER:
+    case GPGME_DATA_TYPE_PGP_KEY:
+      return DATA_CLASS_OTHER;
+    case GPGME_DATA_TYPE_CMS_ENCRYPTED:
+      *r_is_cms = 1;
+      return DATA_CLASS_ENCRYPTED;
+    case GPGME_DATA_TYPE_CMS_SIGNED:
+      *r_is_cms = 1;
+      return DATA_CLASS_SIGNED;
+    case GPGME_DATA_TYPE_CMS_OTHER:
+    case GPGME_DATA_TYPE_X509_CERT:
+    case GPGME_DATA_TYPE_PKCS12:
+      *r_is_cms = 1;
+      return DATA_CLASS_OTHER;
+    default:
+      return DATA_CLASS_UNKNOWN;
+    }
+#else
+  if (detect_pgp_signature (buffer, peek_data (dh, buffer, sizeof buffer)))
+    return DATA_CLASS_SIGNATURE;
+  *r_is_cms = is_cms_data_ext (dh);
+  return DATA_CLASS_UNKNOWN;
+#endif
+}
+
+
+/* Return the class of the file FNAME and store true at R_IS_CMS if it
+   is a CMS file.  A file which can't be read is reported as
+   unknown.  */
+data_class_t
+classify_file (const char *fname, int *r_is_cms)
+{
+#ifdef HAVE_GPGME_DATA_IDENTIFY
+  FILE *fp;
+  gpgme_data_t dh;
+  data_class_t result;
+
+  *r_is_cms = 0;
+  fp = fopen (fname, "rb");
+  if (!fp)
+    return DATA_CLASS_UNKNOWN;
+  if (gpgme_data_new_from_stream (&dh, fp))
+    {
+      fclose (fp);
+      return DATA_CLASS_UNKNOWN;
+    }
+  result = classify_data (dh, r_is_cms);
+  gpgme_data_release (dh);
+  fclose (fp);
+  return result;
+#else
+  FILE *fp;
+  char buffer[CMS_BUFFER_SIZE];
+  size_t datalen;
+
+  *r_is_cms = 0;
+  fp = fopen (fname, "rb");
+  if (!fp)
+    return DATA_CLASS_UNKNOWN;
+  datalen = fread (buffer, 1, sizeof buffer, fp);
+  fclose (fp);
+
+  if (detect_pgp_signature (buffer, datalen))
+    return DATA_CLASS_SIGNATURE;
+  *r_is_cms = is_cms_data (buffer, datalen);
+  return DATA_CLASS_UNKNOWN;
 #endif
 }
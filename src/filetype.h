@@ -22,5 +22,20 @@ int is_cms_file (const char *fname);
 int is_cms_data (const char *data, size_t datalen);
 int is_cms_data_ext (gpgme_data_t dh);
 
+/* The kind of data as far as decryption and verification are
+   concerned.  */
+typedef enum
+  {
+    DATA_CLASS_UNKNOWN = 0,  /* Not identified; maybe plain data.  */
+    DATA_CLASS_ENCRYPTED,    /* Encrypted and possibly signed.  */
+    DATA_CLASS_SIGNED,       /* Signed data; for CMS this might also
+                                be a detached signature.  */
+    DATA_CLASS_SIGNATURE,    /* A detached signature.  */
+    DATA_CLASS_OTHER         /* Other OpenPGP or CMS data.  */
+  } data_class_t;
+
+data_class_t classify_data (gpgme_data_t dh, int *r_is_cms);
+data_class_t classify_file (const char *fname, int *r_is_cms);
+
 
 #endif /*FILETYPE_H*/
@@ -94,6 +94,7 @@ static GObjectClass *parent_class;
 
 
 /* Local prototypes */
+static void gpa_key_details_dispose (GObject *object);
 static void gpa_key_details_finalize (GObject *object);
 
 
@@ -120,16 +121,19 @@ signatures_uid_changed (GtkComboBox *combo, gpointer user_data)
 }
 
 
-/* Fill the details page with the properties of the public key.  */
+/* Show whether the current key has a private part.  This is called
+   by the secret keytable with the secret key SECKEY for FPR.  */
 static void
-details_page_fill_key (GpaKeyDetails *kdt, gpgme_key_t key)
+details_page_secret_key_cb (const char *fpr, gpgme_key_t seckey,
+                            gpointer user_data)
 {
-  gpgme_user_id_t uid;
-  gpgme_key_t seckey;
-  char *text;
+  GpaKeyDetails *kdt = user_data;
+
+  if (!kdt->current_key || !kdt->current_key->subkeys
+      || !kdt->current_key->subkeys->fpr || !fpr
+      || strcmp (kdt->current_key->subkeys->fpr, fpr))
+    return;  /* Another key is shown meanwhile.  */
 
-  seckey = gpa_keytable_lookup_key (gpa_keytable_get_secret_instance(),
-                                    key->subkeys->fpr);
   if (seckey)
     {
       if (seckey->subkeys && seckey->subkeys->is_cardkey)
@@ -143,6 +147,22 @@ details_page_fill_key (GpaKeyDetails *kdt, gpgme_key_t key)
   else
     gtk_label_set_text (GTK_LABEL (kdt->detail_public_private),
 			_("The key has only a public part"));
+}
+
+
+/* Fill the details page with the properties of the public key.  */
+static void
+details_page_fill_key (GpaKeyDetails *kdt, gpgme_key_t key)
+{
+  GpaKeyTable *secret = gpa_keytable_get_secret_instance ();
+  gpgme_user_id_t uid;
+  char *text;
+
+  /* The label is set as soon as the secret keys are known.  */
+  gpa_keytable_cancel_lookups (secret, kdt);
+  gtk_label_set_text (GTK_LABEL (kdt->detail_public_private), "");
+  gpa_keytable_lookup_key_async (secret, key->subkeys->fpr,
+                                 details_page_secret_key_cb, kdt);
 
   gtk_label_set_text (GTK_LABEL (kdt->detail_capabilities),
 		      gpa_get_key_capabilities_text (key));
@@ -602,6 +622,7 @@ gpa_key_details_class_init (void *class_ptr, void *class_data)
 
   parent_class = g_type_class_peek_parent (klass);
 
+  G_OBJECT_CLASS (klass)->dispose = gpa_key_details_dispose;
   G_OBJECT_CLASS (klass)->finalize = gpa_key_details_finalize;
 }
 
@@ -615,6 +636,17 @@ gpa_key_details_init (GTypeInstance *instance, void *class_ptr)
 }
 
 
+static void
+gpa_key_details_dispose (GObject *object)
+{
+  GpaKeyDetails *kdt = GPA_KEY_DETAILS (object);
+
+  gpa_keytable_cancel_lookups (gpa_keytable_get_secret_instance (), kdt);
+
+  parent_class->dispose (object);
+}
+
+
 static void
 gpa_key_details_finalize (GObject *object)
 {
@@ -37,6 +37,7 @@
 #include "clipboard.h"
 #include "cardman.h"
 #include "keyserver.h"
+#include "keyrefresh.h"
 #include "settingsdlg.h"
 #include "confdialog.h"
 #include "icons.h"
@@ -439,6 +440,12 @@ main (int argc, char *argv[])
   args.enable_logging = 1;
 #endif
 
+#if !GLIB_CHECK_VERSION (2, 32, 0)
+  /* The UI server may run commands in threads.  */
+  if (!g_thread_supported ())
+    g_thread_init (NULL);
+#endif
+
   /* Set locale before option parsing for UTF-8 conversion.  */
   i18n_init ();
 
@@ -617,6 +624,11 @@ main (int argc, char *argv[])
   /* Initialize the file watch facility.  */
   gpa_init_filewatch ();
 
+#ifdef ENABLE_KEYSERVER_SUPPORT
+  /* Refresh the keys from the keyserver in the background.  */
+  gpa_key_refresher_start (gpa_key_refresher_get_instance ());
+#endif
+
   /* Startup whatever has been requested by the user.  */
   if (!args.start_only_server)
     open_requested_window (argc, argv, 0);
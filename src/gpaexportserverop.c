@@ -210,7 +210,7 @@ send_keys (GpaExportServerOperation *op, GList *keylist)
 
   keyarray = g_malloc0_n (g_list_length (keylist)+1, sizeof *keyarray);
   i = 0;
-  for (item = keylist; item; i++, item = g_list_next (item))
+  for (item = keylist; item; item = g_list_next (item))
     {
       key = (gpgme_key_t) item->data;
       if (!key || key->protocol != GPGME_PROTOCOL_OpenPGP)
@@ -0,0 +1,859 @@
+/* gpafilebatchop.c - Decrypt or verify a mixed list of files.
+   Copyright (C) 2026 g10 Code GmbH.
+
+   This file is part of GPA.
+
+   GPA is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   GPA is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+   License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.  */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#ifdef G_OS_UNIX
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#else
+#include <io.h>
+#endif
+
+#include "gpa.h"
+#include "gtktools.h"
+#include "gpgmetools.h"
+#include "filetype.h"
+#include "gpafilebatchop.h"
+#include "verifydlg.h"
+
+
+/* The way an input is processed.  */
+typedef enum
+  {
+    BATCH_DECRYPT,          /* Decrypt and verify.  */
+    BATCH_VERIFY,           /* Verify a signature with included data.  */
+    BATCH_VERIFY_DETACHED   /* Verify a detached signature.  */
+  } batch_kind_t;
+
+/* An input after classification.  */
+struct batch_item_s
+{
+  gpa_file_item_t file_item;
+  batch_kind_t kind;
+  data_class_t data_class;
+  gboolean is_cms;
+  /* For BATCH_VERIFY_DETACHED the signed file and the signature.  */
+  gchar *signed_file;
+  gchar *signature_file;
+};
+
+/* A worker of the pool.  */
+struct batch_worker_s
+{
+  GpaFileBatchOperation *op;
+  GpaContext *context;
+  /* The item being processed or NULL if the worker is idle.  */
+  struct batch_item_s *item;
+  int in_fd, signed_fd, out_fd;
+  gpgme_data_t in, signed_text, out;
+};
+
+/* The extensions of detached signatures.  */
+static const gchar *sig_extension[] = {".sig", ".asc", ".sign"};
+
+
+/* Internal functions */
+static gboolean gpa_file_batch_operation_idle_cb (gpointer data);
+static void gpa_file_batch_operation_response_cb (GtkDialog *dialog,
+						  gint response,
+						  gpointer user_data);
+static void worker_done_cb (GpaContext *context, gpg_error_t err,
+                            struct batch_worker_s *worker);
+
+/* GObject */
+
+static GObjectClass *parent_class = NULL;
+
+
+static void
+free_item (struct batch_item_s *item)
+{
+  g_free (item->signed_file);
+  g_free (item->signature_file);
+  g_free (item);
+}
+
+
+static void
+gpa_file_batch_operation_finalize (GObject *object)
+{
+  GpaFileBatchOperation *op = GPA_FILE_BATCH_OPERATION (object);
+  GList *cur;
+
+  for (cur = op->workers; cur; cur = g_list_next (cur))
+    {
+      struct batch_worker_s *worker = cur->data;
+
+      g_signal_handlers_disconnect_by_func
+        (worker->context, G_CALLBACK (worker_done_cb), worker);
+      if (worker->context != GPA_OPERATION (op)->context)
+        g_object_unref (worker->context);
+      g_free (worker);
+    }
+  g_list_free (op->workers);
+  op->workers = NULL;
+
+  g_list_foreach (op->items, (GFunc) free_item, NULL);
+  g_list_free (op->items);
+  op->items = NULL;
+
+  gtk_widget_destroy (op->dialog);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+
+static void
+gpa_file_batch_operation_init (GpaFileBatchOperation *op)
+{
+  op->items = NULL;
+  op->next_item = NULL;
+  op->workers = NULL;
+  op->max_workers = 1;
+  op->running = 0;
+  op->items_total = 0;
+  op->items_done = 0;
+  op->err = 0;
+  op->starting = FALSE;
+  op->serialize = FALSE;
+  op->signed_files = 0;
+  op->dialog = NULL;
+}
+
+
+static GObject*
+gpa_file_batch_operation_constructor
+(GType type,
+ guint n_construct_properties,
+ GObjectConstructParam *construct_properties)
+{
+  GObject *object;
+  GpaFileBatchOperation *op;
+
+  /* Invoke parent's constructor */
+  object = parent_class->constructor (type,
+				      n_construct_properties,
+				      construct_properties);
+  op = GPA_FILE_BATCH_OPERATION (object);
+  /* Initialize */
+  /* Start with the files after going back into the main loop */
+  g_idle_add (gpa_file_batch_operation_idle_cb, op);
+  /* Give a title to the progress dialog */
+  gtk_window_set_title (GTK_WINDOW (GPA_FILE_OPERATION (op)->progress_dialog),
+			_("Decrypting and verifying..."));
+
+  /* Create the verification dialog */
+  op->dialog = gpa_file_verify_dialog_new (GPA_OPERATION (op)->window);
+  g_signal_connect (G_OBJECT (op->dialog), "response",
+		    G_CALLBACK (gpa_file_batch_operation_response_cb), op);
+
+  return object;
+}
+
+
+static void
+gpa_file_batch_operation_class_init (GpaFileBatchOperationClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  parent_class = g_type_class_peek_parent (klass);
+
+  object_class->constructor = gpa_file_batch_operation_constructor;
+  object_class->finalize = gpa_file_batch_operation_finalize;
+}
+
+GType
+gpa_file_batch_operation_get_type (void)
+{
+  static GType file_batch_operation_type = 0;
+
+  if (!file_batch_operation_type)
+    {
+      static const GTypeInfo file_batch_operation_info =
+      {
+        sizeof (GpaFileBatchOperationClass),
+        (GBaseInitFunc) NULL,
+        (GBaseFinalizeFunc) NULL,
+        (GClassInitFunc) gpa_file_batch_operation_class_init,
+        NULL,           /* class_finalize */
+        NULL,           /* class_data */
+        sizeof (GpaFileBatchOperation),
+        0,              /* n_preallocs */
+        (GInstanceInitFunc) gpa_file_batch_operation_init,
+      };
+
+      file_batch_operation_type = g_type_register_static
+	(GPA_FILE_OPERATION_TYPE, "GpaFileBatchOperation",
+	 &file_batch_operation_info, 0);
+    }
+
+  return file_batch_operation_type;
+}
+
+/* API */
+
+GpaFileBatchOperation*
+gpa_file_batch_operation_new (GtkWidget *window, GList *files)
+{
+  GpaFileBatchOperation *op;
+
+  op = g_object_new (GPA_FILE_BATCH_OPERATION_TYPE,
+		     "window", window,
+		     "input_files", files,
+		     NULL);
+
+  return op;
+}
+
+/* Internal */
+
+static gchar *
+destination_filename (const gchar *filename)
+{
+  gchar *extension, *plain_filename;
+
+  /* Find out the destination file */
+  extension = g_strrstr (filename, ".");
+  if (extension && (g_str_equal (extension, ".asc") ||
+		    g_str_equal (extension, ".gpg") ||
+		    g_str_equal (extension, ".pgp")))
+    {
+      /* Remove the extension */
+      plain_filename = g_strdup (filename);
+      *(plain_filename + (extension-filename)) = '\0';
+    }
+  else
+    {
+      plain_filename = g_strconcat (filename, ".txt", NULL);
+    }
+
+  return plain_filename;
+}
+
+
+/* Return the class of FILE_ITEM and store whether it is a CMS object
+   at R_IS_CMS.  */
+static data_class_t
+classify_file_item (gpa_file_item_t file_item, int *r_is_cms)
+{
+  gpgme_data_t dh;
+  data_class_t data_class;
+
+  if (!file_item->direct_in)
+    return classify_file (file_item->filename_in, r_is_cms);
+
+  *r_is_cms = 0;
+  if (gpa_text_data_new_reader (&dh, file_item->direct_in))
+    return DATA_CLASS_UNKNOWN;
+  data_class = classify_data (dh, r_is_cms);
+  gpgme_data_release (dh);
+  return data_class;
+}
+
+
+/* Return true if data of class DATA_CLASS may be a detached
+   signature.  CMS signatures can't be told apart from other signed
+   CMS data; without gpgme_data_identify not even from other CMS
+   data.  */
+static gboolean
+maybe_detached_sig (data_class_t data_class, int is_cms)
+{
+#ifdef HAVE_GPGME_DATA_IDENTIFY
+  return (data_class == DATA_CLASS_SIGNATURE
+          || (data_class == DATA_CLASS_SIGNED && is_cms));
+#else
+  return data_class == DATA_CLASS_SIGNATURE || is_cms;
+#endif
+}
+
+
+/* If FILENAME has the extension of a detached signature, return the
+   name of the signed file.  Return NULL otherwise.  */
+static gchar *
+strip_sig_extension (const gchar *filename)
+{
+  const gchar *extension;
+  int i;
+
+  extension = g_strrstr (filename, ".");
+  if (!extension)
+    return NULL;
+  for (i = 0; i < DIM (sig_extension); i++)
+    if (g_str_equal (extension, sig_extension[i]))
+      return g_strndup (filename, extension - filename);
+  return NULL;
+}
+
+
+/* Look for a detached signature of FILENAME on disk.  Return its name
+   and store whether it is a CMS signature at R_IS_CMS, or return
+   NULL.  */
+static gchar *
+find_detached_sig (const gchar *filename, int *r_is_cms)
+{
+  int i;
+
+  for (i = 0; i < DIM (sig_extension); i++)
+    {
+      gchar *sig = g_strconcat (filename, sig_extension[i], NULL);
+
+      if (g_file_test (sig, G_FILE_TEST_EXISTS)
+          && maybe_detached_sig (classify_file (sig, r_is_cms), *r_is_cms))
+        return sig;
+      g_free (sig);
+    }
+
+  return NULL;
+}
+
+
+/* Classify all inputs of OP and build the list of items.  A detached
+   signature is paired with its signed file; if that file is also in
+   the list it is not processed on its own.  */
+static void
+classify_items (GpaFileBatchOperation *op)
+{
+  GHashTable *inputs;
+  GHashTable *paired;
+  GList *cur, *next;
+
+  /* Map the input file names to their items.  */
+  inputs = g_hash_table_new (g_str_hash, g_str_equal);
+  for (cur = GPA_FILE_OPERATION (op)->input_files; cur;
+       cur = g_list_next (cur))
+    {
+      gpa_file_item_t file_item = cur->data;
+
+      if (!file_item->direct_in)
+        g_hash_table_insert (inputs, file_item->filename_in, file_item);
+    }
+
+  /* The file items used as the signed file of a pair.  */
+  paired = g_hash_table_new (NULL, NULL);
+
+  for (cur = GPA_FILE_OPERATION (op)->input_files; cur;
+       cur = g_list_next (cur))
+    {
+      gpa_file_item_t file_item = cur->data;
+      struct batch_item_s *item;
+      gchar *signed_file = NULL;
+      int is_cms;
+
+      item = g_malloc0 (sizeof *item);
+      item->file_item = file_item;
+      item->data_class = classify_file_item (file_item, &is_cms);
+      item->is_cms = is_cms;
+
+      if (!file_item->direct_in
+          && maybe_detached_sig (item->data_class, is_cms)
+          && (signed_file = strip_sig_extension (file_item->filename_in)))
+        {
+          gpa_file_item_t data_item;
+
+          data_item = g_hash_table_lookup (inputs, signed_file);
+          if (data_item || g_file_test (signed_file, G_FILE_TEST_EXISTS))
+            {
+              item->kind = BATCH_VERIFY_DETACHED;
+              item->signed_file = signed_file;
+              item->signature_file = g_strdup (file_item->filename_in);
+              if (data_item)
+                g_hash_table_insert (paired, data_item, data_item);
+            }
+          else
+            {
+              g_free (signed_file);
+              item->kind = BATCH_VERIFY;
+            }
+        }
+      else if (item->data_class == DATA_CLASS_SIGNED
+               || item->data_class == DATA_CLASS_SIGNATURE)
+        item->kind = BATCH_VERIFY;
+      else
+        item->kind = BATCH_DECRYPT;
+
+      op->items = g_list_prepend (op->items, item);
+    }
+  op->items = g_list_reverse (op->items);
+
+  /* Drop the signed files of the pairs and look for the detached
+     signatures of the other plain files.  */
+  for (cur = op->items; cur; cur = next)
+    {
+      struct batch_item_s *item = cur->data;
+      gpa_file_item_t file_item = item->file_item;
+      gchar *sig;
+      int is_cms;
+
+      next = g_list_next (cur);
+      if (g_hash_table_lookup (paired, file_item))
+        {
+          free_item (item);
+          op->items = g_list_delete_link (op->items, cur);
+          continue;
+        }
+
+      if (item->kind == BATCH_DECRYPT
+          && item->data_class == DATA_CLASS_UNKNOWN
+          && !file_item->direct_in
+          && (sig = find_detached_sig (file_item->filename_in, &is_cms)))
+        {
+          item->kind = BATCH_VERIFY_DETACHED;
+          item->is_cms = is_cms;
+          item->signed_file = g_strdup (file_item->filename_in);
+          item->signature_file = sig;
+        }
+    }
+
+  g_hash_table_destroy (paired);
+  g_hash_table_destroy (inputs);
+
+  op->next_item = op->items;
+  op->items_total = g_list_length (op->items);
+}
+
+
+/* Return the number of workers to use for OP.  */
+static int
+pool_size (GpaFileBatchOperation *op)
+{
+  int n;
+
+  if (op->serialize)
+    return 1;
+  n = gpa_options_get_max_jobs (gpa_options_get_instance ());
+  if (n > op->items_total)
+    n = op->items_total;
+  return n > 0 ? n : 1;
+}
+
+
+/* Create a new worker for OP.  The first worker uses the context of
+   the operation.  */
+static struct batch_worker_s *
+add_worker (GpaFileBatchOperation *op)
+{
+  struct batch_worker_s *worker;
+
+  worker = g_malloc0 (sizeof *worker);
+  worker->op = op;
+  worker->context = op->workers ? gpa_context_new ()
+                                : GPA_OPERATION (op)->context;
+  worker->in_fd = -1;
+  worker->signed_fd = -1;
+  worker->out_fd = -1;
+  g_signal_connect (G_OBJECT (worker->context), "done",
+                    G_CALLBACK (worker_done_cb), worker);
+  op->workers = g_list_append (op->workers, worker);
+
+  return worker;
+}
+
+
+/* Return an idle worker or NULL if all workers are busy and no more
+   workers may be created.  */
+static struct batch_worker_s *
+get_idle_worker (GpaFileBatchOperation *op)
+{
+  GList *cur;
+
+  for (cur = op->workers; cur; cur = g_list_next (cur))
+    {
+      struct batch_worker_s *worker = cur->data;
+
+      if (!worker->item)
+        return worker;
+    }
+  if (g_list_length (op->workers) < op->max_workers)
+    return add_worker (op);
+  return NULL;
+}
+
+
+/* Release the data objects and close the files of WORKER.  */
+static void
+release_worker_data (struct batch_worker_s *worker)
+{
+  gpgme_data_release (worker->in);
+  worker->in = NULL;
+  if (worker->in_fd != -1)
+    close (worker->in_fd);
+  worker->in_fd = -1;
+  gpgme_data_release (worker->signed_text);
+  worker->signed_text = NULL;
+  if (worker->signed_fd != -1)
+    close (worker->signed_fd);
+  worker->signed_fd = -1;
+  gpgme_data_release (worker->out);
+  worker->out = NULL;
+  if (worker->out_fd != -1)
+    close (worker->out_fd);
+  worker->out_fd = -1;
+}
+
+
+/* Show the progress of OP in the progress dialog.  */
+static void
+update_progress (GpaFileBatchOperation *op)
+{
+  GpaProgressDialog *dialog = GPA_PROGRESS_DIALOG
+    (GPA_FILE_OPERATION (op)->progress_dialog);
+
+  if (!op->running)
+    return;
+
+  if (op->items_total > 1)
+    {
+      gchar *label;
+
+      label = g_strdup_printf (_("%d of %d files processed"),
+                               op->items_done, op->items_total);
+      gpa_progress_dialog_set_label (dialog, label);
+      g_free (label);
+      gtk_progress_bar_set_fraction
+        (GTK_PROGRESS_BAR (dialog->pbar),
+         (gdouble) op->items_done / (gdouble) op->items_total);
+    }
+  else
+    {
+      struct batch_worker_s *worker = op->workers->data;
+      gpa_file_item_t file_item = worker->item->file_item;
+
+      gpa_progress_dialog_set_label (dialog,
+                                     file_item->direct_name
+                                     ? file_item->direct_name
+                                     : file_item->filename_in);
+    }
+  gtk_widget_show_all (GTK_WIDGET (dialog));
+}
+
+
+static gpg_error_t
+worker_start (struct batch_worker_s *worker, struct batch_item_s *item)
+{
+  GpaFileBatchOperation *op = worker->op;
+  gpa_file_item_t file_item = item->file_item;
+  GtkWidget *window = GPA_OPERATION (op)->window;
+  gpgme_ctx_t ctx = worker->context->ctx;
+  gpg_error_t err;
+
+  gpgme_set_protocol (ctx, item->is_cms ?
+                      GPGME_PROTOCOL_CMS : GPGME_PROTOCOL_OpenPGP);
+
+  if (file_item->direct_in)
+    {
+      /* The text is read directly from the buffer.  */
+      err = gpa_text_data_new_reader (&worker->in, file_item->direct_in);
+      if (!err)
+        {
+          if (!file_item->direct_out)
+            file_item->direct_out = gpa_text_rope_new ();
+          err = gpa_text_data_new_writer (&worker->out,
+                                          file_item->direct_out);
+        }
+      if (err)
+	{
+	  gpa_gpgme_warning (err);
+          release_worker_data (worker);
+	  return err;
+	}
+    }
+  else if (item->kind == BATCH_VERIFY_DETACHED)
+    {
+      worker->in_fd = gpa_open_input (item->signature_file, &worker->in,
+                                      window);
+      if (worker->in_fd == -1)
+	/* FIXME: Error value.  */
+	return gpg_error (GPG_ERR_GENERAL);
+      worker->signed_fd = gpa_open_input (item->signed_file,
+                                          &worker->signed_text, window);
+      if (worker->signed_fd == -1)
+        {
+          release_worker_data (worker);
+	  return gpg_error (GPG_ERR_GENERAL);
+        }
+    }
+  else if (item->kind == BATCH_VERIFY)
+    {
+      worker->in_fd = gpa_open_input (file_item->filename_in, &worker->in,
+                                      window);
+      if (worker->in_fd == -1)
+	return gpg_error (GPG_ERR_GENERAL);
+      /* The signed text is not kept.  */
+      err = gpgme_data_new (&worker->out);
+      if (err)
+        {
+	  gpa_gpgme_warning (err);
+          release_worker_data (worker);
+          return err;
+        }
+    }
+  else
+    {
+      char *filename_used;
+
+      file_item->filename_out = destination_filename (file_item->filename_in);
+      worker->in_fd = gpa_open_input (file_item->filename_in, &worker->in,
+                                      window);
+      if (worker->in_fd == -1)
+	return gpg_error (GPG_ERR_GENERAL);
+      worker->out_fd = gpa_open_output (file_item->filename_out,
+                                        &worker->out, window,
+                                        &filename_used);
+      if (worker->out_fd == -1)
+	{
+          release_worker_data (worker);
+          xfree (filename_used);
+	  return gpg_error (GPG_ERR_GENERAL);
+	}
+
+      xfree (file_item->filename_out);
+      file_item->filename_out = filename_used;
+    }
+
+  /* Start the operation.  */
+  if (item->kind == BATCH_DECRYPT)
+    err = gpgme_op_decrypt_verify_start (ctx, worker->in, worker->out);
+  else
+    err = gpgme_op_verify_start (ctx, worker->in, worker->signed_text,
+                                 worker->out);
+  if (err)
+    {
+      gpa_gpgme_warning (err);
+      release_worker_data (worker);
+      return err;
+    }
+
+  return 0;
+}
+
+
+/* Start items on idle workers until all items have been started or
+   all workers are busy.  When no worker is busy anymore, show the
+   signatures or complete the operation.  */
+static void
+fill_pool (GpaFileBatchOperation *op)
+{
+  struct batch_worker_s *worker;
+  struct batch_item_s *item;
+  gpg_error_t err;
+
+  /* Opening the output file may ask the user whether to overwrite
+     it, and a worker may finish meanwhile.  */
+  if (op->starting)
+    return;
+
+  op->starting = TRUE;
+  while (!op->err && op->next_item && (worker = get_idle_worker (op)))
+    {
+      item = op->next_item->data;
+      op->next_item = g_list_next (op->next_item);
+
+      worker->item = item;
+      err = worker_start (worker, item);
+      if (err)
+        {
+          worker->item = NULL;
+          op->err = err;
+        }
+      else
+        op->running++;
+    }
+  op->starting = FALSE;
+
+  if (op->running)
+    update_progress (op);
+  else
+    {
+      gtk_widget_hide (GPA_FILE_OPERATION (op)->progress_dialog);
+      if (op->signed_files)
+        /* The "completed" signal is emitted when the dialog is
+           closed.  */
+        gtk_widget_show_all (op->dialog);
+      else
+        g_signal_emit_by_name (GPA_OPERATION (op), "completed", op->err);
+    }
+}
+
+
+/* Start processing the items.  */
+static void
+start_pool (GpaFileBatchOperation *op)
+{
+  GList *cur;
+
+  /* Process one item at a time until a file has been decrypted so
+     that the passphrase is asked for only once.  */
+  for (cur = op->items; cur; cur = g_list_next (cur))
+    if (((struct batch_item_s *) cur->data)->kind == BATCH_DECRYPT)
+      op->serialize = TRUE;
+  op->max_workers = pool_size (op);
+
+  /* The progress bar shows the number of processed files instead of
+     the progress of a single context.  */
+  if (op->items_total > 1)
+    gpa_progress_bar_set_context
+      (GPA_PROGRESS_DIALOG (GPA_FILE_OPERATION (op)->progress_dialog)->pbar,
+       NULL);
+
+  fill_pool (op);
+}
+
+
+static void
+report_error (GpaFileBatchOperation *op, gpa_file_item_t file_item,
+              gpg_error_t err)
+{
+  gchar *message;
+
+  switch (gpg_err_code (err))
+    {
+    case GPG_ERR_NO_ERROR:
+    case GPG_ERR_CANCELED:
+      /* Ignore these */
+      break;
+    case GPG_ERR_NO_DATA:
+      message = g_strdup_printf (file_item->direct_name
+				 ? _("\"%s\" contained no OpenPGP data.")
+				 : _("The file \"%s\" contained no OpenPGP"
+				     "data."),
+				 file_item->direct_name
+				 ? file_item->direct_name
+				 : file_item->filename_in);
+      gpa_window_error (message, GPA_OPERATION (op)->window);
+      g_free (message);
+      break;
+    case GPG_ERR_DECRYPT_FAILED:
+      message = g_strdup_printf (file_item->direct_name
+				 ? _("\"%s\" contained no valid "
+				     "encrypted data.")
+				 : _("The file \"%s\" contained no valid "
+				     "encrypted data."),
+				 file_item->direct_name
+				 ? file_item->direct_name
+				 : file_item->filename_in);
+      gpa_window_error (message, GPA_OPERATION (op)->window);
+      g_free (message);
+      break;
+    case GPG_ERR_BAD_PASSPHRASE:
+      gpa_window_error (_("Wrong passphrase!"), GPA_OPERATION (op)->window);
+      break;
+    default:
+      gpa_gpgme_warning (err);
+      break;
+    }
+}
+
+
+static void
+worker_done_cb (GpaContext *context, gpg_error_t err,
+                struct batch_worker_s *worker)
+{
+  GpaFileBatchOperation *op = worker->op;
+  struct batch_item_s *item = worker->item;
+  gpa_file_item_t file_item;
+
+  if (!item)
+    return;
+  file_item = item->file_item;
+
+  /* Do clean up on the worker.  */
+  release_worker_data (worker);
+  worker->item = NULL;
+  op->running--;
+  op->items_done++;
+
+  if (err)
+    {
+      /* Report only the first error; the items still being processed
+	 are finished but no new ones are started.  */
+      if (!op->err)
+	{
+	  op->err = err;
+	  report_error (op, file_item, err);
+	}
+      if (item->kind == BATCH_DECRYPT && ! file_item->direct_in)
+	{
+	  /* Delete the created file.  */
+	  g_unlink (file_item->filename_out);
+	  g_free (file_item->filename_out);
+	  file_item->filename_out = NULL;
+	}
+    }
+  else
+    {
+      gpgme_verify_result_t result;
+
+      /* We've just created a file, or a "file" in direct mode.  */
+      if (item->kind == BATCH_DECRYPT || file_item->direct_in)
+	g_signal_emit_by_name (GPA_OPERATION (op), "created_file", file_item);
+
+      /* Add the file to the result dialog.  Decrypted files are only
+	 shown if they were signed.  */
+      result = gpgme_op_verify_result (context->ctx);
+      if (result && (result->signatures || item->kind != BATCH_DECRYPT))
+	{
+	  gpa_file_verify_dialog_add_file (GPA_FILE_VERIFY_DIALOG (op->dialog),
+					   file_item->direct_name
+					   ? file_item->direct_name
+					   : file_item->filename_in,
+					   item->signed_file,
+					   item->signature_file,
+					   result->signatures);
+	  op->signed_files++;
+	}
+
+      if (item->kind == BATCH_DECRYPT && op->serialize)
+        {
+          /* The passphrase is now cached, so use all workers.  */
+          op->serialize = FALSE;
+          op->max_workers = pool_size (op);
+        }
+    }
+
+  fill_pool (op);
+}
+
+
+static gboolean
+gpa_file_batch_operation_idle_cb (gpointer data)
+{
+  GpaFileBatchOperation *op = data;
+
+  classify_items (op);
+  start_pool (op);
+
+  return FALSE;
+}
+
+
+static void
+gpa_file_batch_operation_response_cb (GtkDialog *dialog,
+				      gint response,
+				      gpointer user_data)
+{
+  GpaFileBatchOperation *op = GPA_FILE_BATCH_OPERATION (user_data);
+
+  g_signal_emit_by_name (GPA_OPERATION (op), "completed", op->err);
+}
@@ -0,0 +1,81 @@
+/* gpafilebatchop.h - The GpaFileBatchOperation object.
+   Copyright (C) 2026 g10 Code GmbH.
+
+   This file is part of GPA.
+
+   GPA is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   GPA is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+   License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.  */
+
+/* The batch operation decrypts or verifies each file of a mixed list
+   as appropriate.  All inputs are classified first; detached
+   signatures are paired with their signed files.  The items are then
+   processed by a pool of contexts and all signatures are shown in a
+   single verify dialog.  */
+
+#ifndef GPA_FILE_BATCH_OP_H
+#define GPA_FILE_BATCH_OP_H
+
+#include <glib.h>
+#include <glib-object.h>
+#include "gpafileop.h"
+
+/* GObject stuff */
+#define GPA_FILE_BATCH_OPERATION_TYPE	  (gpa_file_batch_operation_get_type ())
+#define GPA_FILE_BATCH_OPERATION(obj)	  (G_TYPE_CHECK_INSTANCE_CAST ((obj), GPA_FILE_BATCH_OPERATION_TYPE, GpaFileBatchOperation))
+#define GPA_FILE_BATCH_OPERATION_CLASS(klass)  (G_TYPE_CHECK_CLASS_CAST ((klass), GPA_FILE_BATCH_OPERATION_TYPE, GpaFileBatchOperationClass))
+#define GPA_IS_FILE_BATCH_OPERATION(obj)	  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GPA_FILE_BATCH_OPERATION_TYPE))
+#define GPA_IS_FILE_BATCH_OPERATION_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), GPA_FILE_BATCH_OPERATION_TYPE))
+#define GPA_FILE_BATCH_OPERATION_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), GPA_FILE_BATCH_OPERATION_TYPE, GpaFileBatchOperationClass))
+
+typedef struct _GpaFileBatchOperation GpaFileBatchOperation;
+typedef struct _GpaFileBatchOperationClass GpaFileBatchOperationClass;
+
+struct _GpaFileBatchOperation {
+  GpaFileOperation parent;
+
+  /* The classified inputs and the next one to process.  */
+  GList *items;
+  GList *next_item;
+
+  /* The pool of workers, each with its own context.  The first
+     worker uses the operation's context.  */
+  GList *workers;
+  int max_workers;
+  int running;          /* Number of busy workers.  */
+  int items_total;
+  int items_done;
+  gpg_error_t err;      /* The first error; no new items are started
+                           after an error.  */
+  gboolean starting;    /* A worker is being started.  */
+  gboolean serialize;   /* Run one item at a time until the first
+                           decryption succeeded; this caches the
+                           passphrase.  */
+
+  int signed_files;
+  GtkWidget *dialog;
+};
+
+struct _GpaFileBatchOperationClass {
+  GpaFileOperationClass parent_class;
+};
+
+GType gpa_file_batch_operation_get_type (void) G_GNUC_CONST;
+
+/* API */
+
+/* Creates a new operation which decrypts or verifies each of FILES.
+ */
+GpaFileBatchOperation *gpa_file_batch_operation_new (GtkWidget *window,
+						     GList *files);
+
+#endif
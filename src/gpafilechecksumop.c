@@ -0,0 +1,890 @@
+/* gpafilechecksumop.c - The GpaFileChecksumOperation object.
+   Copyright (C) 2026 g10 Code GmbH.
+
+   This file is part of GPA.
+
+   GPA is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   GPA is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+   License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.  */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <glib.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+
+#ifdef G_OS_UNIX
+#include <unistd.h>
+#else
+#include <io.h>
+#endif
+
+#include "gpa.h"
+#include "gtktools.h"
+#include "gpgmetools.h"
+#include "gpafilechecksumop.h"
+
+#ifndef O_BINARY
+#ifdef _O_BINARY
+#define O_BINARY	_O_BINARY
+#else
+#define O_BINARY	0
+#endif
+#endif
+
+/* The size of the buffer used to read the files.  */
+#define HASH_BUFFER_SIZE (256 * 1024)
+
+/* The maximum number of problems listed in the final report.  */
+#define MAX_REPORT_LINES 20
+
+/* The name of the checksum files we create.  */
+#define SUMFILE_NAME "SHA256SUMS"
+
+/* The names of checksum files looked for in a directory.  */
+static const char *sumfile_names[] =
+  {
+    "SHA256SUMS",
+    "SHA512SUMS",
+    "sha256sum.txt",
+    "sha512sum.txt",
+    NULL
+  };
+
+
+/* A checksum file.  */
+struct sumfile_s
+{
+  /* The name of the checksum file.  */
+  gchar *filename;
+
+  /* The directory the names in the checksum file are relative to.  */
+  gchar *dir;
+
+  /* The entries in the order of the file.  */
+  GList *jobs;
+};
+
+
+/* A file to hash.  Once the job has been pushed to the pool only the
+   worker thread may access it until it is handed back.  */
+struct hash_job_s
+{
+  GpaFileChecksumOperation *op;
+  struct sumfile_s *sumfile;
+
+  /* The name as used in the checksum file and the actual file.  */
+  gchar *name;
+  gchar *filename;
+  goffset size;
+
+  GChecksumType type;
+
+  /* VERIFY: The expected digest.  */
+  gchar *expected;
+
+  /* The computed digest or NULL on error.  In the latter case ERR_NO
+     gives the reason.  */
+  gchar *digest;
+  int err_no;
+};
+
+
+/* Internal functions */
+static gboolean gpa_file_checksum_operation_idle_cb (gpointer data);
+
+
+/* GObject */
+
+static GObjectClass *parent_class = NULL;
+
+
+static void
+release_job (struct hash_job_s *job)
+{
+  g_free (job->name);
+  g_free (job->filename);
+  g_free (job->expected);
+  g_free (job->digest);
+  g_free (job);
+}
+
+
+static void
+release_sumfile (struct sumfile_s *sumfile)
+{
+  g_free (sumfile->filename);
+  g_free (sumfile->dir);
+  g_list_free (sumfile->jobs);
+  g_free (sumfile);
+}
+
+
+static void
+gpa_file_checksum_operation_finalize (GObject *object)
+{
+  GpaFileChecksumOperation *op = GPA_FILE_CHECKSUM_OPERATION (object);
+
+  if (op->pool)
+    g_thread_pool_free (op->pool, FALSE, TRUE);
+  g_list_foreach (op->jobs, (GFunc) release_job, NULL);
+  g_list_free (op->jobs);
+  g_list_foreach (op->sumfiles, (GFunc) release_sumfile, NULL);
+  g_list_free (op->sumfiles);
+  g_string_free (op->report, TRUE);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+
+static void
+gpa_file_checksum_operation_init (GpaFileChecksumOperation *op)
+{
+  op->verify = FALSE;
+  op->sumfiles = NULL;
+  op->jobs = NULL;
+  op->jobs_total = 0;
+  op->jobs_done = 0;
+  op->pool = NULL;
+  op->files_ok = 0;
+  op->files_failed = 0;
+  op->errors = 0;
+  op->report = g_string_new (NULL);
+}
+
+
+static GObject*
+gpa_file_checksum_operation_constructor
+	(GType type,
+	 guint n_construct_properties,
+	 GObjectConstructParam *construct_properties)
+{
+  GObject *object;
+  GpaFileChecksumOperation *op;
+
+  /* Invoke parent's constructor */
+  object = parent_class->constructor (type,
+				      n_construct_properties,
+				      construct_properties);
+  op = GPA_FILE_CHECKSUM_OPERATION (object);
+
+  /* The context is not used; detach it from the progress bar.  */
+  gpa_progress_bar_set_context
+    (GPA_PROGRESS_DIALOG (GPA_FILE_OPERATION (op)->progress_dialog)->pbar,
+     NULL);
+
+  /* Start with the first file after going back into the main loop */
+  g_idle_add (gpa_file_checksum_operation_idle_cb, op);
+
+  return object;
+}
+
+
+static void
+gpa_file_checksum_operation_class_init
+	(GpaFileChecksumOperationClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  parent_class = g_type_class_peek_parent (klass);
+
+  object_class->constructor = gpa_file_checksum_operation_constructor;
+  object_class->finalize = gpa_file_checksum_operation_finalize;
+}
+
+
+GType
+gpa_file_checksum_operation_get_type (void)
+{
+  static GType file_checksum_operation_type = 0;
+
+  if (!file_checksum_operation_type)
+    {
+      static const GTypeInfo file_checksum_operation_info =
+      {
+        sizeof (GpaFileChecksumOperationClass),
+        (GBaseInitFunc) NULL,
+        (GBaseFinalizeFunc) NULL,
+        (GClassInitFunc) gpa_file_checksum_operation_class_init,
+        NULL,           /* class_finalize */
+        NULL,           /* class_data */
+        sizeof (GpaFileChecksumOperation),
+        0,              /* n_preallocs */
+        (GInstanceInitFunc) gpa_file_checksum_operation_init,
+      };
+
+      file_checksum_operation_type = g_type_register_static
+	(GPA_FILE_OPERATION_TYPE, "GpaFileChecksumOperation",
+	 &file_checksum_operation_info, 0);
+    }
+
+  return file_checksum_operation_type;
+}
+
+
+/* API */
+
+GpaFileChecksumOperation*
+gpa_file_checksum_operation_new (GtkWidget *window, GList *files,
+                                 gboolean verify)
+{
+  GpaFileChecksumOperation *op;
+
+  op = g_object_new (GPA_FILE_CHECKSUM_OPERATION_TYPE,
+		     "window", window,
+		     "input_files", files,
+		     NULL);
+  op->verify = verify;
+
+  return op;
+}
+
+
+/* Internal */
+
+/* Add a line to the report of problems.  This is called after the
+   counter for the problem has been bumped.  */
+static void
+add_report (GpaFileChecksumOperation *op, const char *name,
+            const char *problem)
+{
+  int count = op->files_failed + op->errors;
+
+  if (count <= MAX_REPORT_LINES)
+    g_string_append_printf (op->report, "%s: %s\n", name, problem);
+  else if (count == MAX_REPORT_LINES + 1)
+    g_string_append (op->report, "...\n");
+}
+
+
+/* Compute the digest of FILENAME using the algorithm TYPE.  Returns
+   the digest as a hex string or NULL with the error stored at
+   R_ERRNO.  This is called in a worker thread.  */
+static gchar *
+hash_file (const char *filename, GChecksumType type, int *r_errno)
+{
+  GChecksum *checksum;
+  guchar *buffer;
+  gchar *digest = NULL;
+  int fd;
+  gssize nread;
+
+  fd = g_open (filename, O_RDONLY | O_BINARY, 0);
+  if (fd == -1)
+    {
+      *r_errno = errno;
+      return NULL;
+    }
+
+  checksum = g_checksum_new (type);
+  buffer = g_malloc (HASH_BUFFER_SIZE);
+  for (;;)
+    {
+      nread = read (fd, buffer, HASH_BUFFER_SIZE);
+      if (nread > 0)
+        g_checksum_update (checksum, buffer, nread);
+      else if (!nread)
+        {
+          digest = g_strdup (g_checksum_get_string (checksum));
+          break;
+        }
+      else if (errno != EINTR)
+        {
+          *r_errno = errno;
+          break;
+        }
+    }
+  g_free (buffer);
+  g_checksum_free (checksum);
+  close (fd);
+
+  return digest;
+}
+
+
+static gboolean job_done_cb (gpointer data);
+
+/* The worker thread function.  */
+static void
+hash_worker (gpointer data, gpointer user_data)
+{
+  struct hash_job_s *job = data;
+
+  (void)user_data;
+
+  job->digest = hash_file (job->filename, job->type, &job->err_no);
+  g_idle_add (job_done_cb, job);
+}
+
+
+/* Add the file FILENAME to be hashed for the entry NAME of SUMFILE.
+   EXPECTED is the expected digest or NULL.  */
+static void
+add_job (GpaFileChecksumOperation *op, struct sumfile_s *sumfile,
+         const char *name, const char *filename, GChecksumType type,
+         const char *expected)
+{
+  struct hash_job_s *job;
+  struct stat st;
+
+  job = g_malloc0 (sizeof *job);
+  job->op = op;
+  job->sumfile = sumfile;
+  job->name = g_strdup (name);
+  job->filename = g_strdup (filename);
+  job->type = type;
+  job->expected = g_strdup (expected);
+  if (!g_stat (filename, &st))
+    job->size = st.st_size;
+
+  sumfile->jobs = g_list_prepend (sumfile->jobs, job);
+  op->jobs = g_list_prepend (op->jobs, job);
+  op->jobs_total++;
+}
+
+
+static struct sumfile_s *
+add_sumfile (GpaFileChecksumOperation *op, const char *filename,
+             const char *dir)
+{
+  struct sumfile_s *sumfile;
+
+  sumfile = g_malloc0 (sizeof *sumfile);
+  sumfile->filename = g_strdup (filename);
+  sumfile->dir = g_strdup (dir);
+  op->sumfiles = g_list_append (op->sumfiles, sumfile);
+
+  return sumfile;
+}
+
+
+/* Return true if NAME is the name of a checksum file.  */
+static gboolean
+is_sumfile_name (const char *name)
+{
+  int i;
+
+  for (i = 0; sumfile_names[i]; i++)
+    if (!strcmp (name, sumfile_names[i]))
+      return TRUE;
+  return FALSE;
+}
+
+
+/* Add all files below DIR to SUMFILE.  PREFIX is the name of DIR
+   relative to the directory of SUMFILE.  */
+static void
+collect_dir (GpaFileChecksumOperation *op, struct sumfile_s *sumfile,
+             const char *dir, const char *prefix)
+{
+  GDir *gdir;
+  GError *error = NULL;
+  const gchar *entry;
+  GList *names = NULL;
+  GList *item;
+
+  gdir = g_dir_open (dir, 0, &error);
+  if (!gdir)
+    {
+      op->errors++;
+      add_report (op, dir, error->message);
+      g_error_free (error);
+      return;
+    }
+  while ((entry = g_dir_read_name (gdir)))
+    names = g_list_prepend (names, g_strdup (entry));
+  g_dir_close (gdir);
+
+  /* Sort the names to get a stable checksum file.  */
+  names = g_list_sort (names, (GCompareFunc) strcmp);
+  for (item = names; item; item = g_list_next (item))
+    {
+      gchar *filename = g_build_filename (dir, item->data, NULL);
+      gchar *name = (*prefix? g_strconcat (prefix, "/", item->data, NULL)
+                     : g_strdup (item->data));
+
+      /* Do not follow symbolic links to directories to avoid
+         loops.  */
+      if (g_file_test (filename, G_FILE_TEST_IS_SYMLINK)
+          && g_file_test (filename, G_FILE_TEST_IS_DIR))
+        ;
+      else if (g_file_test (filename, G_FILE_TEST_IS_DIR))
+        collect_dir (op, sumfile, filename, name);
+      else if (g_file_test (filename, G_FILE_TEST_IS_REGULAR)
+               && !(!*prefix && is_sumfile_name (item->data)))
+        add_job (op, sumfile, name, filename, G_CHECKSUM_SHA256, NULL);
+
+      g_free (name);
+      g_free (filename);
+      g_free (item->data);
+    }
+  g_list_free (names);
+}
+
+
+/* Plan the creation of a checksum file for FILENAME.  */
+static void
+plan_create (GpaFileChecksumOperation *op, const char *filename)
+{
+  struct sumfile_s *sumfile = NULL;
+  gchar *dir;
+  gchar *name;
+  GList *item;
+
+  if (g_file_test (filename, G_FILE_TEST_IS_DIR))
+    {
+      name = g_build_filename (filename, SUMFILE_NAME, NULL);
+      sumfile = add_sumfile (op, name, filename);
+      g_free (name);
+      collect_dir (op, sumfile, filename, "");
+      return;
+    }
+
+  /* Files from the same directory go into one checksum file.  */
+  dir = g_path_get_dirname (filename);
+  name = g_build_filename (dir, SUMFILE_NAME, NULL);
+  for (item = op->sumfiles; item; item = g_list_next (item))
+    if (!strcmp (((struct sumfile_s *) item->data)->filename, name))
+      {
+        sumfile = item->data;
+        break;
+      }
+  if (!sumfile)
+    sumfile = add_sumfile (op, name, dir);
+  g_free (name);
+  g_free (dir);
+
+  name = g_path_get_basename (filename);
+  add_job (op, sumfile, name, filename, G_CHECKSUM_SHA256, NULL);
+  g_free (name);
+}
+
+
+/* Return the algorithm for a hex digest of LENGTH.  Returns -1 for
+   an unsupported length.  */
+static int
+digest_type (size_t length)
+{
+  switch (length)
+    {
+    case 32: return G_CHECKSUM_MD5;
+    case 40: return G_CHECKSUM_SHA1;
+    case 64: return G_CHECKSUM_SHA256;
+#if GLIB_CHECK_VERSION (2, 36, 0)
+    case 128: return G_CHECKSUM_SHA512;
+#endif
+    default: return -1;
+    }
+}
+
+
+/* Undo the escaping of a name in a checksum file.  */
+static void
+unescape_name (char *name)
+{
+  char *dst = name;
+
+  for (; *name; name++)
+    {
+      if (*name == '\\' && name[1] == 'n')
+        {
+          *dst++ = '\n';
+          name++;
+        }
+      else if (*name == '\\' && name[1] == '\\')
+        {
+          *dst++ = '\\';
+          name++;
+        }
+      else
+        *dst++ = *name;
+    }
+  *dst = '\0';
+}
+
+
+/* Parse LINE of a checksum file.  Both, the format of sha256sum(1)
+   and the BSD format ("SHA256 (NAME) = DIGEST") are supported.  On
+   success the digest and the name are stored at R_DIGEST and R_NAME,
+   both point into the modified LINE.  */
+static gboolean
+parse_line (char *line, char **r_digest, char **r_name)
+{
+  gboolean escaped = FALSE;
+  char *p, *q;
+
+  if (*line == '\\')
+    {
+      escaped = TRUE;
+      line++;
+    }
+
+  p = line;
+  while (g_ascii_isxdigit (*p))
+    p++;
+  if (p != line && p[0] == ' ' && (p[1] == ' ' || p[1] == '*') && p[2])
+    {
+      /* The sha256sum format.  */
+      *p = '\0';
+      *r_digest = line;
+      *r_name = p + 2;
+    }
+  else if ((p = strstr (line, " (")) && (q = g_strrstr (line, ") = "))
+           && q > p)
+    {
+      /* The BSD format.  */
+      *q = '\0';
+      *r_name = p + 2;
+      *r_digest = q + 4;
+      for (p = *r_digest; g_ascii_isxdigit (*p); p++)
+        ;
+      if (*p || p == *r_digest)
+        return FALSE;
+    }
+  else
+    return FALSE;
+
+  if (escaped)
+    unescape_name (*r_name);
+  return TRUE;
+}
+
+
+/* Plan the verification of the checksum file FILENAME.  */
+static void
+plan_verify_file (GpaFileChecksumOperation *op, const char *filename)
+{
+  struct sumfile_s *sumfile;
+  GError *error = NULL;
+  gchar *contents;
+  gchar **lines;
+  gchar *dir;
+  int bad_lines = 0;
+  int i;
+
+  if (!g_file_get_contents (filename, &contents, NULL, &error))
+    {
+      op->errors++;
+      add_report (op, filename, error->message);
+      g_error_free (error);
+      return;
+    }
+
+  dir = g_path_get_dirname (filename);
+  sumfile = add_sumfile (op, filename, dir);
+
+  lines = g_strsplit (contents, "\n", -1);
+  g_free (contents);
+  for (i = 0; lines[i]; i++)
+    {
+      char *line = lines[i];
+      char *digest, *name;
+      size_t len = strlen (line);
+      int type;
+
+      if (len && line[len - 1] == '\r')
+        line[--len] = '\0';
+      if (!*line || *line == '#')
+        continue;
+
+      if (!parse_line (line, &digest, &name)
+          || (type = digest_type (strlen (digest))) == -1)
+        {
+          bad_lines++;
+          continue;
+        }
+
+      if (g_path_is_absolute (name))
+        add_job (op, sumfile, name, name, type, digest);
+      else
+        {
+          gchar *fname = g_build_filename (dir, name, NULL);
+
+          add_job (op, sumfile, name, fname, type, digest);
+          g_free (fname);
+        }
+    }
+  g_strfreev (lines);
+  g_free (dir);
+
+  if (bad_lines)
+    {
+      gchar *msg = g_strdup_printf (_("%d lines are improperly formatted"),
+                                    bad_lines);
+      op->errors++;
+      add_report (op, filename, msg);
+      g_free (msg);
+    }
+}
+
+
+/* Plan the verification of FILENAME, which is either a checksum file
+   or a directory with checksum files.  */
+static void
+plan_verify (GpaFileChecksumOperation *op, const char *filename)
+{
+  gboolean found = FALSE;
+  int i;
+
+  if (!g_file_test (filename, G_FILE_TEST_IS_DIR))
+    {
+      plan_verify_file (op, filename);
+      return;
+    }
+
+  for (i = 0; sumfile_names[i]; i++)
+    {
+      gchar *name = g_build_filename (filename, sumfile_names[i], NULL);
+
+      if (g_file_test (name, G_FILE_TEST_IS_REGULAR))
+        {
+          plan_verify_file (op, name);
+          found = TRUE;
+        }
+      g_free (name);
+    }
+  if (!found)
+    {
+      op->errors++;
+      add_report (op, filename, _("No checksum file found"));
+    }
+}
+
+
+/* Write the checksum file SUMFILE.  */
+static void
+write_sumfile (GpaFileChecksumOperation *op, struct sumfile_s *sumfile)
+{
+  FILE *fp;
+  gchar *filename_used;
+  GList *item;
+
+  fp = gpa_fopen (sumfile->filename, GPA_OPERATION (op)->window,
+                  &filename_used);
+  if (!fp)
+    {
+      op->errors++;
+      add_report (op, sumfile->filename, _("Not created"));
+      xfree (filename_used);
+      return;
+    }
+
+  for (item = sumfile->jobs; item; item = g_list_next (item))
+    {
+      struct hash_job_s *job = item->data;
+      const char *s;
+
+      if (!job->digest)
+        continue;
+
+      /* Escape the name like sha256sum does.  */
+      if (strchr (job->name, '\\') || strchr (job->name, '\n'))
+        {
+          putc ('\\', fp);
+          fputs (job->digest, fp);
+          fputs ("  ", fp);
+          for (s = job->name; *s; s++)
+            if (*s == '\\')
+              fputs ("\\\\", fp);
+            else if (*s == '\n')
+              fputs ("\\n", fp);
+            else
+              putc (*s, fp);
+          putc ('\n', fp);
+        }
+      else
+        fprintf (fp, "%s  %s\n", job->digest, job->name);
+    }
+
+  if (ferror (fp) || fclose (fp))
+    {
+      op->errors++;
+      add_report (op, filename_used, g_strerror (errno));
+    }
+  else
+    op->files_ok++;
+  xfree (filename_used);
+}
+
+
+static void
+update_progress (GpaFileChecksumOperation *op)
+{
+  GpaProgressDialog *dialog = GPA_PROGRESS_DIALOG
+    (GPA_FILE_OPERATION (op)->progress_dialog);
+  gchar *label;
+
+  label = g_strdup_printf (_("%d of %d files hashed"),
+                           op->jobs_done, op->jobs_total);
+  gpa_progress_dialog_set_label (dialog, label);
+  g_free (label);
+  gtk_progress_bar_set_fraction
+    (GTK_PROGRESS_BAR (dialog->pbar),
+     op->jobs_total? (gdouble) op->jobs_done / (gdouble) op->jobs_total : 0);
+}
+
+
+/* All files have been hashed.  Write the checksum files and show the
+   results.  */
+static void
+finish (GpaFileChecksumOperation *op)
+{
+  GtkWidget *window = GPA_OPERATION (op)->window;
+  gpg_error_t err = 0;
+  gchar *summary;
+  GList *item;
+
+  if (op->pool)
+    {
+      g_thread_pool_free (op->pool, FALSE, TRUE);
+      op->pool = NULL;
+    }
+  gtk_widget_hide (GPA_FILE_OPERATION (op)->progress_dialog);
+
+  /* This is done only now because gpa_fopen may run a dialog, which
+     would let further jobs finish in between.  */
+  if (!op->verify)
+    for (item = op->sumfiles; item; item = g_list_next (item))
+      write_sumfile (op, item->data);
+
+  if (op->verify)
+    summary = g_strdup_printf (_("%d file(s) verified\n"
+                                 "%d file(s) with a wrong checksum\n"
+                                 "%d error(s)"),
+                               op->files_ok, op->files_failed, op->errors);
+  else
+    summary = g_strdup_printf (_("%d checksum file(s) created\n"
+                                 "%d error(s)"),
+                               op->files_ok, op->errors);
+
+  if (op->files_failed || op->errors)
+    {
+      gpa_show_warning (window, "%s\n\n%s", summary, op->report->str);
+      err = gpg_error (op->files_failed? GPG_ERR_CHECKSUM : GPG_ERR_GENERAL);
+    }
+  else
+    gpa_show_info (window, "%s", summary);
+  g_free (summary);
+
+  g_signal_emit_by_name (GPA_OPERATION (op), "completed", err);
+}
+
+
+/* A worker has finished hashing the file of JOB.  */
+static gboolean
+job_done_cb (gpointer data)
+{
+  struct hash_job_s *job = data;
+  GpaFileChecksumOperation *op = job->op;
+
+  op->jobs_done++;
+
+  if (!job->digest)
+    {
+      op->errors++;
+      add_report (op, job->filename, g_strerror (job->err_no));
+    }
+  else if (op->verify)
+    {
+      if (g_ascii_strcasecmp (job->digest, job->expected))
+        {
+          op->files_failed++;
+          add_report (op, job->filename, _("Wrong checksum"));
+        }
+      else
+        op->files_ok++;
+    }
+
+  if (op->jobs_done < op->jobs_total)
+    update_progress (op);
+  else
+    finish (op);
+
+  return FALSE;
+}
+
+
+/* Compare jobs by decreasing size.  */
+static gint
+compare_job_size (gconstpointer a, gconstpointer b)
+{
+  const struct hash_job_s *job_a = a;
+  const struct hash_job_s *job_b = b;
+
+  return (job_a->size < job_b->size) - (job_a->size > job_b->size);
+}
+
+
+static gboolean
+gpa_file_checksum_operation_idle_cb (gpointer data)
+{
+  GpaFileChecksumOperation *op = data;
+  GError *error = NULL;
+  GList *item;
+
+  for (item = GPA_FILE_OPERATION (op)->input_files; item;
+       item = g_list_next (item))
+    {
+      gpa_file_item_t file_item = item->data;
+
+      if (!file_item->filename_in)
+        continue;
+      if (op->verify)
+        plan_verify (op, file_item->filename_in);
+      else
+        plan_create (op, file_item->filename_in);
+    }
+
+  /* Restore the order of the entries.  */
+  for (item = op->sumfiles; item; item = g_list_next (item))
+    {
+      struct sumfile_s *sumfile = item->data;
+
+      sumfile->jobs = g_list_reverse (sumfile->jobs);
+    }
+
+  if (!op->jobs)
+    {
+      finish (op);
+      return FALSE;
+    }
+
+  op->pool = g_thread_pool_new (hash_worker, NULL,
+                                gpa_options_get_max_jobs
+                                (gpa_options_get_instance ()),
+                                FALSE, &error);
+  if (!op->pool)
+    {
+      gpa_show_warning (GPA_OPERATION (op)->window, "%s", error->message);
+      g_error_free (error);
+      g_signal_emit_by_name (GPA_OPERATION (op), "completed",
+                             gpg_error (GPG_ERR_GENERAL));
+      return FALSE;
+    }
+
+  /* Hash the largest files first so that the threads are kept busy
+     until the end.  */
+  op->jobs = g_list_sort (op->jobs, compare_job_size);
+  for (item = op->jobs; item; item = g_list_next (item))
+    g_thread_pool_push (op->pool, item->data, NULL);
+
+  update_progress (op);
+  gtk_widget_show_all (GPA_FILE_OPERATION (op)->progress_dialog);
+
+  return FALSE;
+}
@@ -0,0 +1,82 @@
+/* gpafilechecksumop.h - The GpaFileChecksumOperation object.
+   Copyright (C) 2026 g10 Code GmbH.
+
+   This file is part of GPA.
+
+   GPA is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   GPA is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+   License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.  */
+
+/* The checksum operation creates or verifies checksum files in the
+   format of sha256sum(1).  When creating, a file "SHA256SUMS" is
+   written into the directory of each given file; a given directory
+   gets a checksum file covering all files below it.  When verifying,
+   each given file is read as a checksum file; for a given directory
+   the checksum files inside it are used.  The files are hashed by a
+   pool of threads.  */
+
+#ifndef GPA_FILE_CHECKSUM_OP_H
+#define GPA_FILE_CHECKSUM_OP_H
+
+#include <glib.h>
+#include <glib-object.h>
+#include "gpafileop.h"
+
+/* GObject stuff */
+#define GPA_FILE_CHECKSUM_OPERATION_TYPE	  (gpa_file_checksum_operation_get_type ())
+#define GPA_FILE_CHECKSUM_OPERATION(obj)	  (G_TYPE_CHECK_INSTANCE_CAST ((obj), GPA_FILE_CHECKSUM_OPERATION_TYPE, GpaFileChecksumOperation))
+#define GPA_FILE_CHECKSUM_OPERATION_CLASS(klass)  (G_TYPE_CHECK_CLASS_CAST ((klass), GPA_FILE_CHECKSUM_OPERATION_TYPE, GpaFileChecksumOperationClass))
+#define GPA_IS_FILE_CHECKSUM_OPERATION(obj)	  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GPA_FILE_CHECKSUM_OPERATION_TYPE))
+#define GPA_IS_FILE_CHECKSUM_OPERATION_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), GPA_FILE_CHECKSUM_OPERATION_TYPE))
+#define GPA_FILE_CHECKSUM_OPERATION_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), GPA_FILE_CHECKSUM_OPERATION_TYPE, GpaFileChecksumOperationClass))
+
+typedef struct _GpaFileChecksumOperation GpaFileChecksumOperation;
+typedef struct _GpaFileChecksumOperationClass GpaFileChecksumOperationClass;
+
+struct _GpaFileChecksumOperation {
+  GpaFileOperation parent;
+
+  gboolean verify;
+
+  /* The checksum files to create or verify.  */
+  GList *sumfiles;
+
+  /* The files to hash, largest first.  */
+  GList *jobs;
+  int jobs_total;
+  int jobs_done;
+
+  /* The pool of hashing threads.  */
+  GThreadPool *pool;
+
+  /* Counters and a list of the problems for the final report.  */
+  int files_ok;
+  int files_failed;
+  int errors;
+  GString *report;
+};
+
+struct _GpaFileChecksumOperationClass {
+  GpaFileOperationClass parent_class;
+};
+
+GType gpa_file_checksum_operation_get_type (void) G_GNUC_CONST;
+
+/* API */
+
+/* Creates a new operation which creates checksum files for FILES or,
+   with VERIFY set, verifies the checksum files FILES.  */
+GpaFileChecksumOperation *
+gpa_file_checksum_operation_new (GtkWidget *window, GList *files,
+                                 gboolean verify);
+
+#endif
@@ -40,13 +40,22 @@
 #include "encryptdlg.h"
 #include "gpawidgets.h"
 
+/* A worker of the pool.  */
+struct encrypt_worker_s
+{
+  GpaFileEncryptOperation *op;
+  GpaContext *context;
+  /* The file being encrypted or NULL if the worker is idle.  */
+  gpa_file_item_t file_item;
+  int cipher_fd, plain_fd;
+  gpgme_data_t cipher, plain;
+};
+
 /* Internal functions */
-static void gpa_file_encrypt_operation_done_error_cb (GpaContext *context,
-						      gpg_error_t err,
-						      GpaFileEncryptOperation *op);
-static void gpa_file_encrypt_operation_done_cb (GpaContext *context,
-						gpg_error_t err,
-						GpaFileEncryptOperation *op);
+static void gpa_file_encrypt_operation_done_error_cb
+                        (GpaFileEncryptOperation *op, gpg_error_t err);
+static void worker_done_cb (GpaContext *context, gpg_error_t err,
+                            struct encrypt_worker_s *worker);
 static void gpa_file_encrypt_operation_response_cb (GtkDialog *dialog,
 						    gint response,
 						    gpointer user_data);
@@ -102,6 +111,20 @@ static void
 gpa_file_encrypt_operation_finalize (GObject *object)
 {
   GpaFileEncryptOperation *op = GPA_FILE_ENCRYPT_OPERATION (object);
+  GList *item;
+
+  for (item = op->workers; item; item = g_list_next (item))
+    {
+      struct encrypt_worker_s *worker = item->data;
+
+      g_signal_handlers_disconnect_by_func
+        (worker->context, G_CALLBACK (worker_done_cb), worker);
+      if (worker->context != GPA_OPERATION (op)->context)
+        g_object_unref (worker->context);
+      g_free (worker);
+    }
+  g_list_free (op->workers);
+  op->workers = NULL;
 
   /* FIXME: The use of RSET is messed up.  There is no clear concept
      on who owns the key.  This should be fixed by refing the keys
@@ -117,12 +140,15 @@ static void
 gpa_file_encrypt_operation_init (GpaFileEncryptOperation *op)
 {
   op->rset = NULL;
-  op->cipher_fd = -1;
-  op->plain_fd = -1;
-  op->cipher = NULL;
-  op->plain = NULL;
   op->encrypt_dialog = NULL;
   op->force_armor = FALSE;
+  op->workers = NULL;
+  op->max_workers = 1;
+  op->running = 0;
+  op->files_total = 0;
+  op->files_done = 0;
+  op->err = 0;
+  op->starting = FALSE;
 }
 
 static GObject*
@@ -145,11 +171,6 @@ gpa_file_encrypt_operation_constructor
     (GPA_OPERATION (op)->window, op->force_armor);
   g_signal_connect (G_OBJECT (op->encrypt_dialog), "response",
 		    G_CALLBACK (gpa_file_encrypt_operation_response_cb), op);
-  /* Connect to the "done" signal */
-  g_signal_connect (G_OBJECT (GPA_OPERATION (op)->context), "done",
-		    G_CALLBACK (gpa_file_encrypt_operation_done_error_cb), op);
-  g_signal_connect (G_OBJECT (GPA_OPERATION (op)->context), "done",
-		    G_CALLBACK (gpa_file_encrypt_operation_done_cb), op);
   /* Give a title to the progress dialog */
   gtk_window_set_title (GTK_WINDOW (GPA_FILE_OPERATION (op)->progress_dialog),
 			_("Encrypting..."));
@@ -281,29 +302,165 @@ destination_filename (const gchar *filename, gboolean armor)
 }
 
 
+/* Return the number of workers to use for the files of OP.  */
+static int
+pool_size (GpaFileEncryptOperation *op)
+{
+  int n;
+
+  n = gpa_options_get_max_jobs (gpa_options_get_instance ());
+  if (n > op->files_total)
+    n = op->files_total;
+  return n > 0 ? n : 1;
+}
+
+
+/* Return true if the files of OP are also signed.  */
+static gboolean
+is_signing (GpaFileEncryptOperation *op)
+{
+  return gpa_file_encrypt_dialog_get_sign
+    (GPA_FILE_ENCRYPT_DIALOG (op->encrypt_dialog));
+}
+
+
+/* Create a new worker for OP.  The first worker uses the context of
+   the operation, the other ones get a new context which is set up
+   like the first one.  */
+static struct encrypt_worker_s *
+add_worker (GpaFileEncryptOperation *op)
+{
+  struct encrypt_worker_s *worker;
+  GpaContext *context;
+
+  if (!op->workers)
+    context = GPA_OPERATION (op)->context;
+  else
+    {
+      gpgme_ctx_t ctx = GPA_OPERATION (op)->context->ctx;
+      gpgme_key_t key;
+      int i;
+
+      context = gpa_context_new ();
+      gpgme_set_protocol (context->ctx, gpgme_get_protocol (ctx));
+      gpgme_set_armor (context->ctx, gpgme_get_armor (ctx));
+      for (i = 0; (key = gpgme_signers_enum (ctx, i)); i++)
+        {
+          gpgme_signers_add (context->ctx, key);
+          gpgme_key_unref (key);
+        }
+    }
+
+  worker = g_malloc0 (sizeof *worker);
+  worker->op = op;
+  worker->context = context;
+  worker->cipher_fd = -1;
+  worker->plain_fd = -1;
+  g_signal_connect (G_OBJECT (context), "done",
+                    G_CALLBACK (worker_done_cb), worker);
+  op->workers = g_list_append (op->workers, worker);
+
+  return worker;
+}
+
+
+/* Return an idle worker or NULL if all workers are busy and no more
+   workers may be created.  */
+static struct encrypt_worker_s *
+get_idle_worker (GpaFileEncryptOperation *op)
+{
+  GList *item;
+
+  for (item = op->workers; item; item = g_list_next (item))
+    {
+      struct encrypt_worker_s *worker = item->data;
+
+      if (!worker->file_item)
+        return worker;
+    }
+  if (g_list_length (op->workers) < op->max_workers)
+    return add_worker (op);
+  return NULL;
+}
+
+
+/* Release the data objects and close the files of WORKER.  */
+static void
+release_worker_data (struct encrypt_worker_s *worker)
+{
+  gpgme_data_release (worker->plain);
+  worker->plain = NULL;
+  if (worker->plain_fd != -1)
+    close (worker->plain_fd);
+  worker->plain_fd = -1;
+  gpgme_data_release (worker->cipher);
+  worker->cipher = NULL;
+  if (worker->cipher_fd != -1)
+    close (worker->cipher_fd);
+  worker->cipher_fd = -1;
+}
+
+
+/* Show the progress of OP in the progress dialog.  */
+static void
+update_progress (GpaFileEncryptOperation *op)
+{
+  GpaProgressDialog *dialog = GPA_PROGRESS_DIALOG
+    (GPA_FILE_OPERATION (op)->progress_dialog);
+
+  if (!op->running)
+    return;
+
+  if (op->files_total > 1)
+    {
+      gchar *label;
+
+      label = g_strdup_printf (_("%d of %d files encrypted"),
+                               op->files_done, op->files_total);
+      gpa_progress_dialog_set_label (dialog, label);
+      g_free (label);
+      gtk_progress_bar_set_fraction
+        (GTK_PROGRESS_BAR (dialog->pbar),
+         (gdouble) op->files_done / (gdouble) op->files_total);
+    }
+  else
+    {
+      struct encrypt_worker_s *worker = op->workers->data;
+      gpa_file_item_t file_item = worker->file_item;
+
+      gpa_progress_dialog_set_label (dialog,
+                                     file_item->direct_name
+                                     ? file_item->direct_name
+                                     : file_item->filename_in);
+    }
+  gtk_widget_show_all (GTK_WIDGET (dialog));
+}
+
+
 static gpg_error_t
-gpa_file_encrypt_operation_start (GpaFileEncryptOperation *op,
-				  gpa_file_item_t file_item)
+worker_start (struct encrypt_worker_s *worker, gpa_file_item_t file_item)
 {
+  GpaFileEncryptOperation *op = worker->op;
   gpg_error_t err;
 
   if (file_item->direct_in)
     {
-      /* No copy is made.  */
-      err = gpgme_data_new_from_mem (&op->plain, file_item->direct_in,
-				     file_item->direct_in_len, 0);
+      /* The text is read directly from the buffer.  */
+      err = gpa_text_data_new_reader (&worker->plain, file_item->direct_in);
       if (err)
 	{
 	  gpa_gpgme_warning (err);
 	  return err;
 	}
 
-      err = gpgme_data_new (&op->cipher);
+      if (!file_item->direct_out)
+        file_item->direct_out = gpa_text_rope_new ();
+      err = gpa_text_data_new_writer (&worker->cipher, file_item->direct_out);
       if (err)
 	{
 	  gpa_gpgme_warning (err);
-	  gpgme_data_release (op->plain);
-	  op->plain = NULL;
+	  gpgme_data_release (worker->plain);
+	  worker->plain = NULL;
 	  return err;
 	}
     }
@@ -313,22 +470,24 @@ gpa_file_encrypt_operation_start (GpaFileEncryptOperation *op,
       char *filename_used;
 
       file_item->filename_out = destination_filename
-	(plain_filename, gpgme_get_armor (GPA_OPERATION (op)->context->ctx));
+	(plain_filename, gpgme_get_armor (worker->context->ctx));
       /* Open the files */
-      op->plain_fd = gpa_open_input (plain_filename, &op->plain,
-				     GPA_OPERATION (op)->window);
-      if (op->plain_fd == -1)
+      worker->plain_fd = gpa_open_input (plain_filename, &worker->plain,
+                                         GPA_OPERATION (op)->window);
+      if (worker->plain_fd == -1)
 	/* FIXME: Error value.  */
 	return gpg_error (GPG_ERR_GENERAL);
 
-      op->cipher_fd = gpa_open_output (file_item->filename_out, &op->cipher,
-				       GPA_OPERATION (op)->window,
-                                       &filename_used);
-      if (op->cipher_fd == -1)
+      worker->cipher_fd = gpa_open_output (file_item->filename_out,
+                                           &worker->cipher,
+                                           GPA_OPERATION (op)->window,
+                                           &filename_used);
+      if (worker->cipher_fd == -1)
 	{
-	  gpgme_data_release (op->plain);
-	  close (op->plain_fd);
-	  op->plain_fd = -1;
+	  gpgme_data_release (worker->plain);
+	  worker->plain = NULL;
+	  close (worker->plain_fd);
+	  worker->plain_fd = -1;
           xfree (filename_used);
 	  /* FIXME: Error value.  */
 	  return gpg_error (GPG_ERR_GENERAL);
@@ -341,125 +500,138 @@ gpa_file_encrypt_operation_start (GpaFileEncryptOperation *op,
   /* Start the operation.  */
   /* Always trust keys, because any untrusted keys were already
      confirmed by the user.  */
-  if (gpa_file_encrypt_dialog_get_sign
-      (GPA_FILE_ENCRYPT_DIALOG (op->encrypt_dialog)))
-    err = gpgme_op_encrypt_sign_start (GPA_OPERATION (op)->context->ctx,
+  if (is_signing (op))
+    err = gpgme_op_encrypt_sign_start (worker->context->ctx,
 				       op->rset, GPGME_ENCRYPT_ALWAYS_TRUST,
-				       op->plain, op->cipher);
+				       worker->plain, worker->cipher);
   else
-    err = gpgme_op_encrypt_start (GPA_OPERATION (op)->context->ctx,
+    err = gpgme_op_encrypt_start (worker->context->ctx,
 				  op->rset, GPGME_ENCRYPT_ALWAYS_TRUST,
-				  op->plain, op->cipher);
+				  worker->plain, worker->cipher);
 
   if (err)
     {
       gpa_gpgme_warning (err);
-
-      gpgme_data_release (op->plain);
-      op->plain = NULL;
-      close (op->plain_fd);
-      op->plain_fd = -1;
-      gpgme_data_release (op->cipher);
-      op->cipher = NULL;
-      close (op->cipher_fd);
-      op->cipher_fd = -1;
-
+      release_worker_data (worker);
       return err;
     }
 
-  /* Show and update the progress dialog.  */
-  gtk_widget_show_all (GPA_FILE_OPERATION (op)->progress_dialog);
-  gpa_progress_dialog_set_label (GPA_PROGRESS_DIALOG
-				 (GPA_FILE_OPERATION (op)->progress_dialog),
-				 file_item->direct_name
-				 ? file_item->direct_name
-				 : file_item->filename_in);
   return 0;
 }
 
+
+/* Start files on idle workers until all files have been started or
+   all workers are busy.  Emit the "completed" signal when no worker
+   is busy anymore.  */
 static void
-gpa_file_encrypt_operation_next (GpaFileEncryptOperation *op)
+fill_pool (GpaFileEncryptOperation *op)
 {
+  struct encrypt_worker_s *worker;
+  gpa_file_item_t file_item;
   gpg_error_t err;
 
-  if (! GPA_FILE_OPERATION (op)->current)
+  /* Opening the output file may ask the user whether to overwrite
+     it, and a worker may finish meanwhile.  */
+  if (op->starting)
+    return;
+
+  op->starting = TRUE;
+  while (!op->err && GPA_FILE_OPERATION (op)->current
+         && (worker = get_idle_worker (op)))
     {
-      g_signal_emit_by_name (GPA_OPERATION (op), "completed", 0);
-      return;
+      file_item = GPA_FILE_OPERATION (op)->current->data;
+      GPA_FILE_OPERATION (op)->current = g_list_next
+	(GPA_FILE_OPERATION (op)->current);
+
+      worker->file_item = file_item;
+      err = worker_start (worker, file_item);
+      if (err)
+        {
+          worker->file_item = NULL;
+          op->err = err;
+        }
+      else
+        op->running++;
     }
+  op->starting = FALSE;
 
-  err = gpa_file_encrypt_operation_start
-    (op, GPA_FILE_OPERATION (op)->current->data);
-  if (err)
-    g_signal_emit_by_name (GPA_OPERATION (op), "completed", err);
+  if (op->running)
+    update_progress (op);
+  else
+    {
+      gtk_widget_hide (GPA_FILE_OPERATION (op)->progress_dialog);
+      g_signal_emit_by_name (GPA_OPERATION (op), "completed", op->err);
+    }
 }
 
 
+/* Start encrypting the files.  */
 static void
-gpa_file_encrypt_operation_done_cb (GpaContext *context,
-				    gpg_error_t err,
-				    GpaFileEncryptOperation *op)
+start_pool (GpaFileEncryptOperation *op)
 {
-  gpa_file_item_t file_item = GPA_FILE_OPERATION (op)->current->data;
+  op->files_total = g_list_length (GPA_FILE_OPERATION (op)->current);
+  op->files_done = 0;
+  op->err = 0;
+
+  /* When signing, the first file is encrypted alone so that the
+     passphrase is asked for only once.  */
+  op->max_workers = is_signing (op) ? 1 : pool_size (op);
+
+  /* The progress bar shows the number of processed files instead of
+     the progress of a single context.  */
+  if (op->files_total > 1)
+    gpa_progress_bar_set_context
+      (GPA_PROGRESS_DIALOG (GPA_FILE_OPERATION (op)->progress_dialog)->pbar,
+       NULL);
+
+  fill_pool (op);
+}
 
-  if (file_item->direct_in)
-    {
-      size_t len;
-      char *cipher_gpgme = gpgme_data_release_and_get_mem (op->cipher,
-							   &len);
-      op->cipher = NULL;
-      /* Do the memory allocation dance.  */
 
-      if (cipher_gpgme)
-	{
-	  /* Conveniently make ASCII stuff into a string.  */
-	  file_item->direct_out = g_malloc (len + 1);
-	  memcpy (file_item->direct_out, cipher_gpgme, len);
-	  gpgme_free (cipher_gpgme);
-	  file_item->direct_out[len] = '\0';
-	  /* Yep, excluding the trailing zero.  */
-	  file_item->direct_out_len = len;
-	}
-      else
-	{
-	  file_item->direct_out = NULL;
-	  file_item->direct_out_len = 0;
-	}
-    }
+static void
+worker_done_cb (GpaContext *context, gpg_error_t err,
+                struct encrypt_worker_s *worker)
+{
+  GpaFileEncryptOperation *op = worker->op;
+  gpa_file_item_t file_item = worker->file_item;
+
+  if (!file_item)
+    return;
 
-  /* Do clean up on the operation */
-  gpgme_data_release (op->plain);
-  op->plain = NULL;
-  close (op->plain_fd);
-  op->plain_fd = -1;
-  gpgme_data_release (op->cipher);
-  op->cipher = NULL;
-  close (op->cipher_fd);
-  op->cipher_fd = -1;
-  gtk_widget_hide (GPA_FILE_OPERATION (op)->progress_dialog);
+  /* Do clean up on the worker.  */
+  release_worker_data (worker);
+  worker->file_item = NULL;
+  op->running--;
+  op->files_done++;
 
   if (err)
     {
+      /* Report only the first error; the files still being encrypted
+	 are finished but no new ones are started.  */
+      if (!op->err)
+	{
+	  op->err = err;
+	  gpa_file_encrypt_operation_done_error_cb (op, err);
+	}
       if (! file_item->direct_in)
 	{
 	  /* If an error happened, (or the user canceled) delete the
-	    created file and abort further encryptions.  */
+	    created file.  */
 	  g_unlink (file_item->filename_out);
 	  g_free (file_item->filename_out);
 	  file_item->filename_out = NULL;
 	}
-      g_signal_emit_by_name (GPA_OPERATION (op), "completed", err);
     }
   else
     {
       /* We've just created a file */
       g_signal_emit_by_name (GPA_OPERATION (op), "created_file", file_item);
 
-      /* Go to the next file in the list and encrypt it */
-      GPA_FILE_OPERATION (op)->current = g_list_next
-	(GPA_FILE_OPERATION (op)->current);
-      gpa_file_encrypt_operation_next (op);
+      /* The passphrase is now cached, so use all workers.  */
+      op->max_workers = pool_size (op);
     }
+
+  fill_pool (op);
 }
 
 /*
@@ -744,7 +916,7 @@ static void gpa_file_encrypt_operation_response_cb (GtkDialog *dialog,
 
       /* Actually run the operation or abort.  */
       if (success)
-	gpa_file_encrypt_operation_next (op);
+	start_pool (op);
       else
 	g_signal_emit_by_name (GPA_OPERATION (op), "completed",
 				 gpg_error (GPG_ERR_GENERAL));
@@ -762,8 +934,8 @@ static void gpa_file_encrypt_operation_response_cb (GtkDialog *dialog,
 }
 
 static void
-gpa_file_encrypt_operation_done_error_cb (GpaContext *context, gpg_error_t err,
-					  GpaFileEncryptOperation *op)
+gpa_file_encrypt_operation_done_error_cb (GpaFileEncryptOperation *op,
+                                          gpg_error_t err)
 {
   switch (gpg_err_code (err))
     {
@@ -57,10 +57,19 @@ struct _GpaFileEncryptOperation
   
   GtkWidget *encrypt_dialog;
   gpgme_key_t *rset;
-  int cipher_fd, plain_fd;
-  gpgme_data_t cipher, plain;
 
   gboolean force_armor;
+
+  /* The files are encrypted by a pool of workers, each with its own
+     context.  The first worker uses the operation's context.  */
+  GList *workers;
+  int max_workers;
+  int running;          /* Number of busy workers.  */
+  int files_total;
+  int files_done;
+  gpg_error_t err;      /* The first error; no new files are started
+                           after an error.  */
+  gboolean starting;    /* A worker is being started.  */
 };
 
 
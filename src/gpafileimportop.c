@@ -36,6 +36,7 @@
 #include "gpgmetools.h"
 #include "filetype.h"
 #include "gpafileimportop.h"
+#include "keytable.h"
 
 
 /* Internal functions */
@@ -166,9 +167,8 @@ proc_one_file (GpaFileImportOperation *op, gpa_file_item_t file_item)
 
   if (file_item->direct_in)
     {
-      /* No copy is made.  */
-      err = gpgme_data_new_from_mem (&data, file_item->direct_in,
-				     file_item->direct_in_len, 0);
+      /* The text is read directly from the buffer.  */
+      err = gpa_text_data_new_reader (&data, file_item->direct_in);
       if (err)
 	{
 	  gpa_gpgme_warning (err);
@@ -176,8 +176,7 @@ proc_one_file (GpaFileImportOperation *op, gpa_file_item_t file_item)
 	}
 
       gpgme_set_protocol (GPA_OPERATION (op)->context->ctx,
-                          is_cms_data (file_item->direct_in,
-                                       file_item->direct_in_len) ?
+                          is_cms_data_ext (data) ?
                           GPGME_PROTOCOL_CMS : GPGME_PROTOCOL_OpenPGP);
     }
   else
@@ -224,6 +223,7 @@ gpa_file_import_operation_next (GpaFileImportOperation *op)
       gtk_widget_hide (GPA_FILE_OPERATION (op)->progress_dialog);
       if (op->counters.imported > 0)
         {
+          gpa_keytable_keyring_changed ();
           if (op->counters.secret_imported)
             g_signal_emit_by_name (GPA_OPERATION (op), "imported_secret_keys");
           else
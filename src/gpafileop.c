@@ -92,9 +92,9 @@ free_file_item (gpa_file_item_t item)
   if (item->direct_name)
     g_free (item->direct_name);
   if (item->direct_in)
-    g_free (item->direct_in);
+    g_object_unref (item->direct_in);
   if (item->direct_out)
-    g_free (item->direct_out);
+    gpa_text_rope_release (item->direct_out);
 }
 
 
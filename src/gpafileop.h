@@ -27,6 +27,7 @@
 #include <glib-object.h>
 #include "gpaoperation.h"
 #include "gpaprogressdlg.h"
+#include "textdata.h"
 
 /* GObject stuff */
 #define GPA_FILE_OPERATION_TYPE	  (gpa_file_operation_get_type ())
@@ -41,12 +42,12 @@ typedef struct _GpaFileOperationClass GpaFileOperationClass;
 
 struct gpa_file_item_s
 {
-  /* If not NULL, the text to operate on.  */
-  gchar *direct_in;
-  gsize direct_in_len;
-  gchar *direct_out;
-  /* Length of DIRECT_OUT (minus trailing zero).  */
-  gsize direct_out_len;
+  /* If not NULL, the text buffer to operate on.  The item holds a
+     reference to it.  */
+  GtkTextBuffer *direct_in;
+  /* The output of the operation on DIRECT_IN.  It may be set by the
+     caller to consume the output while it is written.  */
+  gpa_text_rope_t direct_out;
   /* A displayable string identifying the text.  */
   gchar *direct_name;
 
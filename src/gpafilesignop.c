@@ -264,16 +264,17 @@ gpa_file_sign_operation_start (GpaFileSignOperation *op,
 
   if (file_item->direct_in)
     {
-      /* No copy is made.  */
-      err = gpgme_data_new_from_mem (&op->plain, file_item->direct_in,
-				     file_item->direct_in_len, 0);
+      /* The text is read directly from the buffer.  */
+      err = gpa_text_data_new_reader (&op->plain, file_item->direct_in);
       if (err)
 	{
 	  gpa_gpgme_warning (err);
 	  return err;
 	}
 
-      err = gpgme_data_new (&op->sig);
+      if (!file_item->direct_out)
+        file_item->direct_out = gpa_text_rope_new ();
+      err = gpa_text_data_new_writer (&op->sig, file_item->direct_out);
       if (err)
 	{
 	  gpa_gpgme_warning (err);
@@ -359,30 +360,6 @@ gpa_file_sign_operation_done_cb (GpaContext *context,
 {
   gpa_file_item_t file_item = GPA_FILE_OPERATION (op)->current->data;
 
-  if (file_item->direct_in)
-    {
-      size_t len;
-      char *sig_gpgme = gpgme_data_release_and_get_mem (op->sig, &len);
-      op->sig = NULL;
-      /* Do the memory allocation dance.  */
-
-      if (sig_gpgme)
-	{
-	  /* Conveniently make ASCII stuff into a string.  */
-	  file_item->direct_out = g_malloc (len + 1);
-	  memcpy (file_item->direct_out, sig_gpgme, len);
-	  gpgme_free (sig_gpgme);
-	  file_item->direct_out[len] = '\0';
-	  /* Yep, excluding the trailing zero.  */
-	  file_item->direct_out_len = len;
-	}
-      else
-	{
-	  file_item->direct_out = NULL;
-	  file_item->direct_out_len = 0;
-	}
-    }
-
   /* Do clean up on the operation */
   gpgme_data_release (op->plain);
   op->plain = NULL;
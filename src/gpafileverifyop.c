@@ -250,16 +250,17 @@ gpa_file_verify_operation_start (GpaFileVerifyOperation *op,
     {
       /* Direct input is always an inline signature.  */
 
-      /* No copy is made.  */
-      err = gpgme_data_new_from_mem (&op->sig, file_item->direct_in,
-				     file_item->direct_in_len, 0);
+      /* The text is read directly from the buffer.  */
+      err = gpa_text_data_new_reader (&op->sig, file_item->direct_in);
       if (err)
 	{
 	  gpa_gpgme_warning (err);
 	  return FALSE;
 	}
 
-      err = gpgme_data_new (&op->plain);
+      if (!file_item->direct_out)
+        file_item->direct_out = gpa_text_rope_new ();
+      err = gpa_text_data_new_writer (&op->plain, file_item->direct_out);
       if (err)
 	{
 	  gpa_gpgme_warning (err);
@@ -269,8 +270,7 @@ gpa_file_verify_operation_start (GpaFileVerifyOperation *op,
 	}
 
       gpgme_set_protocol (GPA_OPERATION (op)->context->ctx,
-                          is_cms_data (file_item->direct_in,
-                                       file_item->direct_in_len) ?
+                          is_cms_data_ext (op->sig) ?
                           GPGME_PROTOCOL_CMS : GPGME_PROTOCOL_OpenPGP);
     }
   else
@@ -363,31 +363,6 @@ gpa_file_verify_operation_done_cb (GpaContext *context,
 {
   gpa_file_item_t file_item = GPA_FILE_OPERATION (op)->current->data;
 
-  if (file_item->direct_in)
-    {
-      size_t len;
-      char *plain_gpgme = gpgme_data_release_and_get_mem (op->plain,
-							   &len);
-      op->plain = NULL;
-      /* Do the memory allocation dance.  */
-
-      if (plain_gpgme)
-	{
-	  /* Conveniently make ASCII stuff into a string.  */
-	  file_item->direct_out = g_malloc (len + 1);
-	  memcpy (file_item->direct_out, plain_gpgme, len);
-	  gpgme_free (plain_gpgme);
-	  file_item->direct_out[len] = '\0';
-	  /* Yep, excluding the trailing zero.  */
-	  file_item->direct_out_len = len;
-	}
-      else
-	{
-	  file_item->direct_out = NULL;
-	  file_item->direct_out_len = 0;
-	}
-    }
-
   /* Do clean up on the operation */
   gpgme_data_release (op->plain);
   op->plain = NULL;
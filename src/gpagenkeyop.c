@@ -25,6 +25,7 @@
 #include "i18n.h"
 #include "gtktools.h"
 #include "gpagenkeyop.h"
+#include "keytable.h"
 
 static GObjectClass *parent_class = NULL;
 
@@ -49,6 +50,14 @@ gpa_gen_key_operation_finalize (GObject *object)
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
+/* Default handler for the "generated_key" signal.  */
+static void
+gpa_gen_key_operation_generated_key (GpaGenKeyOperation *op,
+                                     const char *fpr)
+{
+  gpa_keytable_keyring_changed ();
+}
+
 static void
 gpa_gen_key_operation_class_init (GpaGenKeyOperationClass *klass)
 {
@@ -59,7 +68,7 @@ gpa_gen_key_operation_class_init (GpaGenKeyOperationClass *klass)
   object_class->finalize = gpa_gen_key_operation_finalize;
   
   /* Signals */
-  klass->generated_key = NULL;
+  klass->generated_key = gpa_gen_key_operation_generated_key;
   signals[GENERATED_KEY] =
     g_signal_new ("generated_key",
 		  G_TYPE_FROM_CLASS (object_class),
@@ -42,8 +42,9 @@ gpa_import_bykeyid_operation_finalize (GObject *object)
 {
   GpaImportByKeyidOperation *op = GPA_IMPORT_BYKEYID_OPERATION (object);
 
-  gpgme_key_unref (op->key);
-  op->key = NULL;
+  g_list_foreach (op->keys, (GFunc) gpgme_key_unref, NULL);
+  g_list_free (op->keys);
+  op->keys = NULL;
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -52,7 +53,7 @@ gpa_import_bykeyid_operation_finalize (GObject *object)
 static void
 gpa_import_bykeyid_operation_init (GpaImportByKeyidOperation *op)
 {
-  op->key = NULL;
+  op->keys = NULL;
 }
 
 
@@ -121,11 +122,24 @@ gpa_import_bykeyid_operation_get_type (void)
 
 /* Virtual methods */
 
+/* Return true if KEY can be fetched from a keyserver.  */
+static gboolean
+is_refreshable (gpgme_key_t key)
+{
+  return (key
+          && key->protocol == GPGME_PROTOCOL_OpenPGP
+          && key->subkeys
+          && key->subkeys->keyid
+          && *key->subkeys->keyid);
+}
+
+
 static gboolean
 gpa_import_bykeyid_operation_get_source (GpaImportOperation *operation)
 {
   GpaImportByKeyidOperation *op = GPA_IMPORT_BYKEYID_OPERATION (operation);
-  int i;
+  GList *item;
+  int i, n;
 
   /* Better reset the source variables.  */
   gpgme_data_release (operation->source);
@@ -138,29 +152,44 @@ gpa_import_bykeyid_operation_get_source (GpaImportOperation *operation)
       operation->source2 = NULL;
     }
 
-  if (!op->key
-      || op->key->protocol != GPGME_PROTOCOL_OpenPGP
-      || !op->key->subkeys
-      || !op->key->subkeys->keyid
-      || !*op->key->subkeys->keyid)
+  n = 0;
+  for (item = op->keys; item; item = g_list_next (item))
+    if (is_refreshable (item->data))
+      n++;
+
+  if (!n)
     ;
   else if (is_gpg_version_at_least ("2.1.0"))
     {
-      operation->source2 = g_malloc0_n (1 + 1, sizeof *operation->source2);
-      gpgme_key_ref (op->key);
-      operation->source2[0] = op->key;
+      /* A large array is imported in batches by the base class.  */
+      operation->source2 = g_malloc0_n (n + 1, sizeof *operation->source2);
+      i = 0;
+      for (item = op->keys; item; item = g_list_next (item))
+        if (is_refreshable (item->data))
+          {
+            gpgme_key_ref (item->data);
+            operation->source2[i++] = item->data;
+          }
       return TRUE;
     }
   else
     {
-
-      if (server_get_key (gpa_options_get_default_keyserver
-			  (gpa_options_get_instance ()),
-			  op->key->subkeys->keyid,
-                          &operation->source, GPA_OPERATION (op)->window))
-	{
-	  return TRUE;
-	}
+      const gchar **keyids;
+      gboolean okay;
+
+      /* The keyserver helper fetches all keys in one run.  */
+      keyids = g_malloc0_n (n + 1, sizeof *keyids);
+      i = 0;
+      for (item = op->keys; item; item = g_list_next (item))
+        if (is_refreshable (item->data))
+          keyids[i++] = ((gpgme_key_t) item->data)->subkeys->keyid;
+      okay = server_get_keys (gpa_options_get_default_keyserver
+                              (gpa_options_get_instance ()),
+                              keyids, &operation->source,
+                              GPA_OPERATION (op)->window);
+      g_free (keyids);
+      if (okay)
+        return TRUE;
     }
   return FALSE;
 }
@@ -183,7 +212,21 @@ gpa_import_bykeyid_operation_new (GtkWidget *window, gpgme_key_t key)
   op = g_object_new (GPA_IMPORT_BYKEYID_OPERATION_TYPE,
 		     "window", window, NULL);
   gpgme_key_ref (key);
-  op->key = key;
+  op->keys = g_list_prepend (NULL, key);
+
+  return op;
+}
+
+
+GpaImportByKeyidOperation*
+gpa_import_bykeyid_operation_new_for_keys (GtkWidget *window, GList *keys)
+{
+  GpaImportByKeyidOperation *op;
+
+  op = g_object_new (GPA_IMPORT_BYKEYID_OPERATION_TYPE,
+		     "window", window, NULL);
+  op->keys = g_list_copy (keys);
+  g_list_foreach (op->keys, (GFunc) gpgme_key_ref, NULL);
 
   return op;
 }
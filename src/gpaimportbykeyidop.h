@@ -55,7 +55,7 @@ struct _GpaImportByKeyidOperation
 {
   GpaImportOperation parent;
 
-  gpgme_key_t key;
+  GList *keys;
 };
 
 
@@ -73,5 +73,10 @@ GType gpa_import_bykeyid_operation_get_type (void) G_GNUC_CONST;
 GpaImportByKeyidOperation *
 gpa_import_bykeyid_operation_new (GtkWidget *window, gpgme_key_t key);
 
+/* Creates a new import by keyid operation for all OpenPGP keys in
+   the list KEYS.  */
+GpaImportByKeyidOperation *
+gpa_import_bykeyid_operation_new_for_keys (GtkWidget *window, GList *keys);
+
 #endif /*ENABLE_KEYSERVER_SUPPORT*/
 #endif /*GPA_IMPORT_BYKEYID_OP_H*/
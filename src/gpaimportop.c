@@ -27,6 +27,7 @@
 #include "gpaimportop.h"
 #include "filetype.h"
 #include "gpgmetools.h"
+#include "keytable.h"
 
 static GObjectClass *parent_class = NULL;
 
@@ -39,12 +40,16 @@ enum
 };
 static guint signals [LAST_SIGNAL] = { 0 };
 
+/* The number of keys imported by one gpgme_op_import_keys_start
+   call and the maximum number of those calls running at the same
+   time.  Keyserver lookups are slow but cheap for us, thus several
+   of them are run in parallel.  */
+#define IMPORT_BATCH_SIZE   32
+#define IMPORT_MAX_CONTEXTS 4
+
 static gboolean gpa_import_operation_idle_cb (gpointer data);
 static void gpa_import_operation_done_cb (GpaContext *context, gpg_error_t err,
 			      GpaImportOperation *op);
-static void gpa_import_operation_done_error_cb (GpaContext *context,
-						gpg_error_t err,
-						GpaImportOperation *op);
 
 /* GObject boilerplate */
 
@@ -52,8 +57,25 @@ static void
 gpa_import_operation_finalize (GObject *object)
 {
   GpaImportOperation *op = GPA_IMPORT_OPERATION (object);
+  GList *item;
+  guint idx;
   int i;
 
+  for (item = op->extra_contexts; item; item = g_list_next (item))
+    {
+      g_signal_handlers_disconnect_by_func
+        (item->data, G_CALLBACK (gpa_import_operation_done_cb), op);
+      g_object_unref (item->data);
+    }
+  g_list_free (op->extra_contexts);
+  op->extra_contexts = NULL;
+  if (op->progress_dialog)
+    gtk_widget_destroy (op->progress_dialog);
+  op->progress_dialog = NULL;
+  for (idx=0; idx < op->imported->len; idx++)
+    g_free (g_ptr_array_index (op->imported, idx));
+  g_ptr_array_free (op->imported, TRUE);
+
   /* Free the data object, if it exists */
   gpgme_data_release (op->source);
   op->source = NULL;
@@ -73,6 +95,16 @@ gpa_import_operation_init (GpaImportOperation *op)
 {
   op->source = NULL;
   op->source2 = NULL;
+  op->next_key = NULL;
+  op->extra_contexts = NULL;
+  op->running = 0;
+  op->nkeys = 0;
+  op->nkeys_done = 0;
+  op->err = 0;
+  memset (&op->result, 0, sizeof op->result);
+  op->imported = g_ptr_array_new ();
+  g_ptr_array_add (op->imported, NULL);
+  op->progress_dialog = NULL;
 }
 
 static GObject*
@@ -89,8 +121,6 @@ gpa_import_operation_constructor (GType type,
 				      construct_properties);
   op = GPA_IMPORT_OPERATION (object);
 
-  g_signal_connect (G_OBJECT (GPA_OPERATION (op)->context), "done",
-		    G_CALLBACK (gpa_import_operation_done_error_cb), op);
   g_signal_connect (G_OBJECT (GPA_OPERATION (op)->context), "done",
 		    G_CALLBACK (gpa_import_operation_done_cb), op);
 
@@ -100,6 +130,14 @@ gpa_import_operation_constructor (GType type,
   return object;
 }
 
+/* Default handler for the "imported_keys" signals.  */
+static void
+gpa_import_operation_imported_keys (GpaImportOperation *op)
+{
+  gpa_keytable_keyring_changed ();
+}
+
+
 static void
 gpa_import_operation_class_init (GpaImportOperationClass *klass)
 {
@@ -115,7 +153,7 @@ gpa_import_operation_class_init (GpaImportOperationClass *klass)
   klass->complete_import = NULL;
 
   /* Signals */
-  klass->imported_keys = NULL;
+  klass->imported_keys = gpa_import_operation_imported_keys;
   signals[IMPORTED_KEYS] =
     g_signal_new ("imported_keys",
 		  G_TYPE_FROM_CLASS (object_class),
@@ -165,6 +203,157 @@ gpa_import_operation_get_type (void)
 
 /* Private functions */
 
+/* Start the import of the next batch of keys from SOURCE2 on
+   CONTEXT.  */
+static gpg_error_t
+start_next_batch (GpaImportOperation *op, GpaContext *context)
+{
+  gpgme_key_t *batch;
+  gpg_error_t err;
+  int n;
+
+  for (n = 0; n < IMPORT_BATCH_SIZE && op->next_key[n]; n++)
+    ;
+  if (!n)
+    return gpg_error (GPG_ERR_EOF);
+
+  /* The keys are owned by SOURCE2.  */
+  batch = g_malloc0_n (n + 1, sizeof *batch);
+  memcpy (batch, op->next_key, n * sizeof *batch);
+
+  /* The only protocol where an array of keys is used in GPA is
+     OpenPGP.  */
+  gpgme_set_protocol (context->ctx, GPGME_PROTOCOL_OpenPGP);
+  err = gpgme_op_import_keys_start (context->ctx, batch);
+  if (err)
+    {
+      g_free (batch);
+      return err;
+    }
+  g_object_set_data_full (G_OBJECT (context), "gpa-import-batch",
+                          batch, g_free);
+  op->next_key += n;
+  op->running++;
+  return 0;
+}
+
+
+/* Start importing the keys from SOURCE2.  */
+static gpg_error_t
+start_batches (GpaImportOperation *op)
+{
+  GpaContext *context;
+  gpg_error_t err;
+  int i;
+
+  for (op->nkeys = 0; op->source2[op->nkeys]; op->nkeys++)
+    ;
+  op->next_key = op->source2;
+
+  err = start_next_batch (op, GPA_OPERATION (op)->context);
+  if (err)
+    return err;
+  if (!*op->next_key)
+    return 0;
+
+  /* More than one batch: Run some of them in parallel and show the
+     progress.  */
+  op->progress_dialog = gpa_progress_dialog_new (GPA_OPERATION (op)->window,
+                                                 NULL);
+  gtk_window_set_title (GTK_WINDOW (op->progress_dialog),
+                        _("GPA: Receiving keys"));
+  gtk_widget_show_all (op->progress_dialog);
+
+  for (i = 1; i < IMPORT_MAX_CONTEXTS && *op->next_key; i++)
+    {
+      context = gpa_context_new ();
+      g_signal_connect (G_OBJECT (context), "done",
+                        G_CALLBACK (gpa_import_operation_done_cb), op);
+      op->extra_contexts = g_list_prepend (op->extra_contexts, context);
+      err = start_next_batch (op, context);
+      if (err)
+        {
+          /* The first batch is already running; thus we finish
+             through the normal path.  */
+          gpa_gpgme_warning (err);
+          op->err = err;
+          break;
+        }
+    }
+  return 0;
+}
+
+
+/* Update the progress dialog, if any.  */
+static void
+update_progress (GpaImportOperation *op)
+{
+  gchar *label;
+
+  if (!op->progress_dialog || !op->nkeys)
+    return;
+
+  label = g_strdup_printf (_("%d of %d keys processed"),
+                           op->nkeys_done, op->nkeys);
+  gpa_progress_dialog_set_label (GPA_PROGRESS_DIALOG (op->progress_dialog),
+                                 label);
+  g_free (label);
+  gtk_progress_bar_set_fraction
+    (GTK_PROGRESS_BAR (GPA_PROGRESS_DIALOG (op->progress_dialog)->pbar),
+     (gdouble) op->nkeys_done / (gdouble) op->nkeys);
+}
+
+
+/* Add the results of the import just finished on CONTEXT to the
+   accumulated results.  */
+static void
+collect_results (GpaImportOperation *op, GpaContext *context)
+{
+  gpgme_import_result_t res;
+  gpgme_import_status_t imp;
+
+  res = gpgme_op_import_result (context->ctx);
+  if (!res)
+    return;
+
+  gpa_gpgme_update_import_results (&op->result, 0, 0, res);
+  for (imp = res->imports; imp; imp = imp->next)
+    if (!imp->result && imp->fpr)
+      {
+        /* Replace the terminating NULL.  */
+        g_ptr_array_index (op->imported, op->imported->len - 1)
+          = g_strdup (imp->fpr);
+        g_ptr_array_add (op->imported, NULL);
+      }
+}
+
+
+/* All imports have finished.  */
+static void
+finish_import (GpaImportOperation *op)
+{
+  if (op->progress_dialog)
+    {
+      gtk_widget_destroy (op->progress_dialog);
+      op->progress_dialog = NULL;
+    }
+
+  if (!op->err)
+    GPA_IMPORT_OPERATION_GET_CLASS (op)->complete_import (op);
+
+  /* Even after an error some batches may have been imported.  */
+  if (op->result.imported > 0 && op->result.secret_imported)
+    g_signal_emit_by_name (GPA_OPERATION (op), "imported_secret_keys");
+  else if (op->result.imported > 0)
+    g_signal_emit_by_name (GPA_OPERATION (op), "imported_keys");
+
+  if (!op->err)
+    gpa_gpgme_show_import_results (GPA_OPERATION (op)->window, &op->result);
+
+  g_signal_emit_by_name (GPA_OPERATION (op), "completed", op->err);
+}
+
+
 static gboolean
 gpa_import_operation_idle_cb (gpointer data)
 {
@@ -181,16 +370,11 @@ gpa_import_operation_idle_cb (gpointer data)
                               GPGME_PROTOCOL_CMS : GPGME_PROTOCOL_OpenPGP);
           err = gpgme_op_import_start (GPA_OPERATION (op)->context->ctx,
                                        op->source);
+          if (!err)
+            op->running++;
         }
-      else if (op->source2)
-        {
-          /* The only protocol where an array of keys is used in GPA
-             is OpenPGP.  */
-          gpgme_set_protocol (GPA_OPERATION (op)->context->ctx,
-                              GPGME_PROTOCOL_OpenPGP);
-          err = gpgme_op_import_keys_start (GPA_OPERATION (op)->context->ctx,
-                                            op->source2);
-        }
+      else if (op->source2 && *op->source2)
+        err = start_batches (op);
       else
         err = gpg_error (GPG_ERR_BUG);
       if (err)
@@ -212,43 +396,54 @@ static void
 gpa_import_operation_done_cb (GpaContext *context, gpg_error_t err,
 			      GpaImportOperation *op)
 {
-  if (! err)
-    {
-      struct gpa_import_result_s result;
-      gpgme_import_result_t res;
+  gpgme_key_t *batch;
 
-      memset (&result, 0, sizeof result);
+  op->running--;
 
-      GPA_IMPORT_OPERATION_GET_CLASS (op)->complete_import (op);
+  batch = g_object_get_data (G_OBJECT (context), "gpa-import-batch");
+  if (batch)
+    {
+      for (; *batch; batch++)
+        op->nkeys_done++;
+      g_object_set_data (G_OBJECT (context), "gpa-import-batch", NULL);
+    }
 
-      res = gpgme_op_import_result (GPA_OPERATION (op)->context->ctx);
-      if (res->imported > 0 && res->secret_imported )
-	{
-	  g_signal_emit_by_name (GPA_OPERATION (op), "imported_secret_keys");
-	}
-      else if (res->imported > 0)
-	{
-	  g_signal_emit_by_name (GPA_OPERATION (op), "imported_keys");
-	}
+  if (err)
+    {
+      /* Report only the first error; after an error no new batches
+         are started.  */
+      if (!op->err)
+        {
+          gpa_gpgme_warning (err);
+          op->err = err;
+        }
+    }
+  else
+    collect_results (op, context);
 
-      gpa_gpgme_update_import_results (&result, 0, 0, res);
-      gpa_gpgme_show_import_results (GPA_OPERATION (op)->window, &result);
+  update_progress (op);
+
+  if (!op->err && op->next_key && *op->next_key)
+    {
+      err = start_next_batch (op, context);
+      if (err)
+        {
+          gpa_gpgme_warning (err);
+          op->err = err;
+        }
     }
-  g_signal_emit_by_name (GPA_OPERATION (op), "completed", err);
+
+  if (!op->running)
+    finish_import (op);
 }
 
 
-static void
-gpa_import_operation_done_error_cb (GpaContext *context, gpg_error_t err,
-				    GpaImportOperation *op)
+/* API */
+
+const char **
+gpa_import_operation_get_imported (GpaImportOperation *op)
 {
-  switch (gpg_err_code (err))
-    {
-    case GPG_ERR_NO_ERROR:
-      /* Ignore these */
-      break;
-    default:
-      gpa_gpgme_warning (err);
-      break;
-    }
+  g_return_val_if_fail (GPA_IS_IMPORT_OPERATION (op), NULL);
+
+  return (const char **) op->imported->pdata;
 }
@@ -26,6 +26,7 @@
 #include <glib-object.h>
 #include "gpaoperation.h"
 #include "gpaprogressdlg.h"
+#include "gpgmetools.h"
 
 /* GObject stuff */
 #define GPA_IMPORT_OPERATION_TYPE	  (gpa_import_operation_get_type ())
@@ -43,6 +44,21 @@ struct _GpaImportOperation {
 
   gpgme_data_t source;    /* Either a data object with the full key  */
   gpgme_key_t *source2;   /* or an array of key descriptions.  */
+
+  /* private: */
+
+  /* A large SOURCE2 is imported in batches which run concurrently
+     on the operation's context and a few additional contexts.  */
+  gpgme_key_t *next_key;  /* The first key of SOURCE2 not yet started.  */
+  GList *extra_contexts;  /* The additional contexts.  */
+  int running;            /* Number of running imports.  */
+  int nkeys;              /* Number of keys in SOURCE2.  */
+  int nkeys_done;         /* Number of keys of finished batches.  */
+  gpg_error_t err;        /* The first error of any batch.  */
+  struct gpa_import_result_s result;  /* The accumulated results.  */
+  GPtrArray *imported;    /* NULL terminated fingerprints of the keys
+                             seen by the import.  */
+  GtkWidget *progress_dialog;
 };
 
 struct _GpaImportOperationClass {
@@ -66,4 +82,12 @@ struct _GpaImportOperationClass {
 
 GType gpa_import_operation_get_type (void) G_GNUC_CONST;
 
+/* API */
+
+/* Return the fingerprints of all keys processed without error by the
+   import operation OP as a NULL terminated array.  The array is owned
+   by OP and valid until the next batch finishes; it is complete when
+   the "imported_keys" or "imported_secret_keys" signal is emitted.  */
+const char **gpa_import_operation_get_imported (GpaImportOperation *op);
+
 #endif
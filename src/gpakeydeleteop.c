@@ -49,6 +49,13 @@ static GObjectClass *parent_class = NULL;
 static void
 gpa_key_delete_operation_finalize (GObject *object)
 {
+  GpaKeyDeleteOperation *op = GPA_KEY_DELETE_OPERATION (object);
+  int idx;
+
+  for (idx = 0; idx < op->deleted->len; idx++)
+    g_free (g_ptr_array_index (op->deleted, idx));
+  g_ptr_array_free (op->deleted, TRUE);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -56,6 +63,8 @@ gpa_key_delete_operation_finalize (GObject *object)
 static void
 gpa_key_delete_operation_init (GpaKeyDeleteOperation *op)
 {
+  op->deleted = g_ptr_array_new ();
+  g_ptr_array_add (op->deleted, NULL);
 }
 
 static GObject*
@@ -140,6 +149,15 @@ gpa_key_delete_operation_new (GtkWidget *window, GList *keys)
   return op;
 }
 
+
+const char **
+gpa_key_delete_operation_get_deleted (GpaKeyDeleteOperation *op)
+{
+  g_return_val_if_fail (GPA_IS_KEY_DELETE_OPERATION (op), NULL);
+
+  return (const char **) op->deleted->pdata;
+}
+
 /* Internal */
 
 static gpg_error_t
@@ -215,6 +233,17 @@ static void gpa_key_delete_operation_done_cb (GpaContext *context,
 					      gpg_error_t err,
 					      GpaKeyDeleteOperation *op)
 {
+  gpgme_key_t key = gpa_key_operation_current_key (GPA_KEY_OPERATION (op));
+
+  /* Remember the deleted key so that only its rows need to be
+     removed from the key list.  */
+  if (! err && key && key->subkeys && key->subkeys->fpr)
+    {
+      g_ptr_array_index (op->deleted, op->deleted->len - 1)
+        = g_strdup (key->subkeys->fpr);
+      g_ptr_array_add (op->deleted, NULL);
+    }
+
   GPA_KEY_OPERATION (op)->current = g_list_next
     (GPA_KEY_OPERATION (op)->current);
   gpa_key_delete_operation_next (op);
@@ -32,6 +32,7 @@
 #define GPA_KEY_DELETE_OPERATION(obj)	  (G_TYPE_CHECK_INSTANCE_CAST ((obj), GPA_KEY_DELETE_OPERATION_TYPE, GpaKeyDeleteOperation))
 #define GPA_KEY_DELETE_OPERATION_CLASS(klass)  (G_TYPE_CHECK_CLASS_CAST ((klass), GPA_KEY_DELETE_OPERATION_TYPE, GpaKeyDeleteOperationClass))
 #define GPA_IS_KEY_DELETE_ENCRYPT_OPERATION(obj)	  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GPA_KEY_DELETE_OPERATION_TYPE))
+#define GPA_IS_KEY_DELETE_OPERATION(obj)	  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GPA_KEY_DELETE_OPERATION_TYPE))
 #define GPA_IS_KEY_DELETE_OPERATION_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), GPA_KEY_DELETE_OPERATION_TYPE))
 #define GPA_KEY_DELETE_OPERATION_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), GPA_KEY_DELETE_OPERATION_TYPE, GpaKeyDeleteOperationClass))
 
@@ -40,6 +41,9 @@ typedef struct _GpaKeyDeleteOperationClass GpaKeyDeleteOperationClass;
 
 struct _GpaKeyDeleteOperation {
   GpaKeyOperation parent;
+
+  GPtrArray *deleted;     /* NULL terminated fingerprints of the keys
+                             deleted so far.  */
 };
 
 struct _GpaKeyDeleteOperationClass {
@@ -55,4 +59,8 @@ GType gpa_key_delete_operation_get_type (void) G_GNUC_CONST;
 GpaKeyDeleteOperation*
 gpa_key_delete_operation_new (GtkWidget *window, GList *keys);
 
+/* Return the fingerprints of the keys actually deleted by OP as a
+   NULL terminated array owned by OP.  */
+const char **gpa_key_delete_operation_get_deleted (GpaKeyDeleteOperation *op);
+
 #endif
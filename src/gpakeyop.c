@@ -23,6 +23,7 @@
 #include "i18n.h"
 #include "gtktools.h"
 #include "gpakeyop.h"
+#include "keytable.h"
 
 /* Signals */
 enum
@@ -118,6 +119,14 @@ gpa_key_operation_constructor (GType type,
   return object;
 }
 
+/* Default handler for the "changed_wot" signal.  */
+static void
+gpa_key_operation_changed_wot (GpaKeyOperation *op)
+{
+  gpa_keytable_keyring_changed ();
+}
+
+
 static void
 gpa_key_operation_class_init (GpaKeyOperationClass *klass)
 {
@@ -131,6 +140,7 @@ gpa_key_operation_class_init (GpaKeyOperationClass *klass)
   object_class->get_property = gpa_key_operation_get_property;
 
   /* Signals */
+  klass->changed_wot = gpa_key_operation_changed_wot;
   signals[CHANGED_WOT] =
     g_signal_new ("changed_wot",
 		  G_TYPE_FROM_CLASS (object_class),
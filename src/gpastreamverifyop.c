@@ -25,6 +25,7 @@
 #include "gpgmetools.h"
 #include "gtktools.h"
 #include "verifydlg.h"
+#include "signercache.h"
 #include "gpastreamverifyop.h"
 
 
@@ -115,6 +116,7 @@ gpa_stream_verify_operation_finalize (GObject *object)
 {
   GpaStreamVerifyOperation *op = GPA_STREAM_VERIFY_OPERATION (object);
 
+  gpa_signercache_cancel (op);
   if (op->dialog)
     gtk_widget_destroy (op->dialog);
 
@@ -261,55 +263,10 @@ done_error_cb (GpaContext *context, gpg_error_t err,
 }
 
 
-/* Percent-Escape special characters.  */
-static gchar *
-my_percent_escape (const gchar *src)
-{
-  gchar *esc_str;
-  int new_len = 3 * strlen (src) + 1;
-  gchar *dst;
-
-  esc_str = g_malloc (new_len);
-
-  dst = esc_str;
-  while (*src)
-    {
-      if (*src == '%')
-	{
-	  *(dst++) = '%';
-	  *(dst++) = '2';
-	  *(dst++) = '5';
-	}
-      else if (*src == ':')
-	{
-	  /* The colon is used as field separator.  */
-	  *(dst++) = '%';
-	  *(dst++) = '3';
-	  *(dst++) = 'a';
-	}
-      else if (*src == ',')
-	{
-	  /* The comma is used as list separator.  */
-	  *(dst++) = '%';
-	  *(dst++) = '2';
-	  *(dst++) = 'c';
-	}
-      else
-	*(dst++) = *(src);
-      src++;
-    }
-  *dst = '\0';
-  return esc_str;
-}
-
-
-/* Operation is ready.  Tell the server.  */
+/* Tell the server about the result.  */
 static void
-done_cb (GpaContext *context, gpg_error_t err, GpaStreamVerifyOperation *op)
+report_result (GpaStreamVerifyOperation *op, gpg_error_t err)
 {
-  if (! op->silent)
-    gtk_widget_hide (GPA_STREAM_OPERATION (op)->progress_dialog);
-
   if (! err)
     {
       gpgme_verify_result_t res;
@@ -319,29 +276,13 @@ done_cb (GpaContext *context, gpg_error_t err, GpaStreamVerifyOperation *op)
 
       for (sig = res->signatures; sig; sig = sig->next)
 	{
-	  char *sigsum;
-	  char *sigdesc;
-	  char *sigdesc_esc;
-
-	  if (sig->summary & GPGME_SIGSUM_VALID)
-	    sigsum = "green";
-	  else if (sig->summary & GPGME_SIGSUM_GREEN)
-	    sigsum = "yellow";
-	  else if (sig->summary & GPGME_SIGSUM_KEY_MISSING)
-	    sigsum = "none";
-	  else
-	    sigsum = "red";
-
-          sigdesc = gpa_gpgme_get_signature_desc
-            (GPA_OPERATION (op)->context->ctx, sig, NULL, NULL);
-	  sigdesc_esc = my_percent_escape (sigdesc);
+	  char *line;
 
+	  line = gpa_gpgme_get_sigstatus (sig);
 	  /* FIXME: Error handling.  */
 	  err = gpa_operation_write_status (GPA_OPERATION (op), "SIGSTATUS",
-					    sigsum, sigdesc_esc, NULL);
-
-	  g_free (sigdesc_esc);
-	  g_free (sigdesc);
+					    line, NULL);
+	  g_free (line);
 	}
     }
 
@@ -361,6 +302,36 @@ done_cb (GpaContext *context, gpg_error_t err, GpaStreamVerifyOperation *op)
 }
 
 
+/* The keys of the signers have been looked up.  */
+static void
+signers_known_cb (gpointer data)
+{
+  report_result (data, 0);
+}
+
+
+/* Operation is ready.  Tell the server.  */
+static void
+done_cb (GpaContext *context, gpg_error_t err, GpaStreamVerifyOperation *op)
+{
+  gpgme_verify_result_t res;
+
+  if (! op->silent)
+    gtk_widget_hide (GPA_STREAM_OPERATION (op)->progress_dialog);
+
+  /* Look up the keys of the signers first so that the descriptions
+     name them.  */
+  if (! err)
+    {
+      res = gpgme_op_verify_result (GPA_OPERATION (op)->context->ctx);
+      if (! gpa_signercache_resolve (res->signatures, signers_known_cb, op))
+        return;
+    }
+
+  report_result (op, err);
+}
+
+
 static gboolean
 idle_cb (gpointer data)
 {
@@ -30,6 +30,7 @@
 static gboolean query_tooltip_cb (GtkWidget *wdiget, int x, int y,
                                   gboolean keyboard_mode,
                                   GtkTooltip *tooltip, gpointer user_data);
+static void destroy_cb (GtkWidget *widget, gpointer user_data);
 
 
 
@@ -170,6 +171,7 @@ gpa_subkey_list_new (void)
   g_object_set (list, "has-tooltip", TRUE, NULL);
   g_signal_connect (list, "query-tooltip",
                     G_CALLBACK (query_tooltip_cb), list);
+  g_signal_connect (list, "destroy", G_CALLBACK (destroy_cb), NULL);
 
   return list;
 }
@@ -201,9 +203,9 @@ subkey_status (gpgme_subkey_t subkey)
 }
 
 
-/* Set the key whose subkeys should be displayed. */
-void
-gpa_subkey_list_set_key (GtkWidget *list, gpgme_key_t key)
+/* Fill LIST with the subkeys of KEY.  */
+static void
+fill_subkeys (GtkWidget *list, gpgme_key_t key)
 {
   GtkListStore *store = GTK_LIST_STORE (gtk_tree_view_get_model
                                         (GTK_TREE_VIEW (list)));
@@ -289,6 +291,56 @@ gpa_subkey_list_set_key (GtkWidget *list, gpgme_key_t key)
 }
 
 
+/* The secret keys are now known; show the pending key again.  */
+static void
+secret_keys_ready_cb (gpointer data)
+{
+  GtkWidget *list = data;
+  gpgme_key_t key;
+
+  key = g_object_get_data (G_OBJECT (list), "gpa-pending-key");
+  if (!key)
+    return;
+  gpgme_key_ref (key);
+  g_object_set_data (G_OBJECT (list), "gpa-pending-key", NULL);
+  fill_subkeys (list, key);
+  gpgme_key_unref (key);
+}
+
+
+/* Set the key whose subkeys should be displayed. */
+void
+gpa_subkey_list_set_key (GtkWidget *list, gpgme_key_t key)
+{
+  GpaKeyTable *secret = gpa_keytable_get_secret_instance ();
+
+  gpa_keytable_cancel_lookups (secret, list);
+  g_object_set_data (G_OBJECT (list), "gpa-pending-key", NULL);
+
+  fill_subkeys (list, key);
+
+  if (key && !gpa_keytable_is_ready (secret))
+    {
+      /* The card related columns require the secret key; fill the
+         list again as soon as the secret keys have been listed.  */
+      gpgme_key_ref (key);
+      g_object_set_data_full (G_OBJECT (list), "gpa-pending-key", key,
+                              (GDestroyNotify) gpgme_key_unref);
+      gpa_keytable_when_ready (secret, secret_keys_ready_cb, list);
+    }
+}
+
+
+/* Cancel a pending update of the list.  */
+static void
+destroy_cb (GtkWidget *widget, gpointer user_data)
+{
+  (void)user_data;
+
+  gpa_keytable_cancel_lookups (gpa_keytable_get_secret_instance (), widget);
+}
+
+
 /* Tooltip display callback.  */
 static gboolean
 query_tooltip_cb (GtkWidget *widget, int x, int y, gboolean keyboard_tip,
@@ -30,6 +30,7 @@
 #include "gpa.h"
 #include "gtktools.h"
 #include "gpgmetools.h"
+#include "signercache.h"
 
 #include <fcntl.h>
 #ifdef G_OS_UNIX
@@ -1108,10 +1109,10 @@ gpa_gpgme_key_sig_get_level (gpgme_key_sig_t sig)
    (e.g.. the user ID) will be stored as a malloced string at that
    address; if no key is known, NULL will be stored.  If R_KEY is not
    NULL, a key object will be stored at that address; NULL if no key
-   is known.  CTX is used as helper to figure out the key
-   description.  */
+   is known.  The key is taken from the signer cache; use
+   gpa_signercache_resolve to make sure it has been looked up.  */
 char *
-gpa_gpgme_get_signature_desc (gpgme_ctx_t ctx, gpgme_signature_t sig,
+gpa_gpgme_get_signature_desc (gpgme_signature_t sig,
                               char **r_keydesc, gpgme_key_t *r_key)
 {
   gpgme_key_t key = NULL;
@@ -1121,9 +1122,9 @@ gpa_gpgme_get_signature_desc (gpgme_ctx_t ctx, gpgme_signature_t sig,
 
   sigstatus = sig->status? gpg_strerror (sig->status) : "";
 
-  if (sig->fpr && ctx)
+  if (sig->fpr)
     {
-      gpgme_get_key (ctx, sig->fpr, &key, 0);
+      key = gpa_signercache_lookup (sig->fpr, NULL);
       if (key)
         keydesc = gpa_gpgme_key_get_userid (key->uids);
     }
@@ -1205,6 +1206,38 @@ gpa_gpgme_get_signature_desc (gpgme_ctx_t ctx, gpgme_signature_t sig,
 }
 
 
+/* Return the text of the SIGSTATUS line the UI server sends for the
+   signature SIG: a flag followed by the percent escaped description
+   of the signature.  */
+char *
+gpa_gpgme_get_sigstatus (gpgme_signature_t sig)
+{
+  const char *sigsum;
+  char *sigdesc;
+  char *sigdesc_esc;
+  char *line;
+
+  if (sig->summary & GPGME_SIGSUM_VALID)
+    sigsum = "green";
+  else if (sig->summary & GPGME_SIGSUM_GREEN)
+    sigsum = "yellow";
+  else if (sig->summary & GPGME_SIGSUM_KEY_MISSING)
+    sigsum = "none";
+  else
+    sigsum = "red";
+
+  sigdesc = gpa_gpgme_get_signature_desc (sig, NULL, NULL);
+  /* The colon is used as field separator and the comma as list
+     separator.  */
+  sigdesc_esc = percent_escape (sigdesc, ":,", 0);
+  line = g_strconcat (sigsum, " ", sigdesc_esc, NULL);
+
+  g_free (sigdesc_esc);
+  g_free (sigdesc);
+  return line;
+}
+
+
 
 /* Return a string listing the capabilities of a key.  */
 const gchar *
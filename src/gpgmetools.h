@@ -224,10 +224,14 @@ const gchar *gpa_gpgme_key_sig_get_sig_status (gpgme_key_sig_t sig,
 const gchar *gpa_gpgme_key_sig_get_level (gpgme_key_sig_t sig);
 
 /* Return a human readable string with the status of the signature
-   SIG.  */
-char *gpa_gpgme_get_signature_desc (gpgme_ctx_t ctx, gpgme_signature_t sig,
+   SIG.  This does not block; see signercache.h.  */
+char *gpa_gpgme_get_signature_desc (gpgme_signature_t sig,
                                     char **r_keydesc, gpgme_key_t *r_key);
 
+/* Return the text of the SIGSTATUS line of the UI server for the
+   signature SIG.  */
+char *gpa_gpgme_get_sigstatus (gpgme_signature_t sig);
+
 
 /* Return a string listing the capabilities of a key.  */
 const gchar *gpa_get_key_capabilities_text (gpgme_key_t key);
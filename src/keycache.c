@@ -0,0 +1,360 @@
+/* keycache.c - Persistent snapshot of the key listing.
+   Copyright (C) 2026 g10 Code GmbH.
+
+   This file is part of GPA
+
+   GPA is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   GPA is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+   License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.  */
+
+#include <config.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "gpa.h"
+#include "membuf.h"
+#include "keycache.h"
+
+
+/* The file starts with a header, followed by NRECORDS fixed size
+   records and the string area.  All integers are stored in host byte
+   order; a cache written on a different platform is simply ignored.
+   The strings are referenced by their offset into the string area
+   which always starts with an empty string.  */
+
+#define KEYCACHE_MAGIC     "GPAKEYC"
+#define KEYCACHE_BYTEORDER 0x01020304
+#define KEYCACHE_VERSION   1
+
+/* The files whose modification times are used to detect a stale
+   cache.  They are relative to the GnuPG home directory.  */
+static const char *watched_files[] =
+  {
+    "pubring.gpg",
+    "pubring.kbx",
+    "secring.gpg",
+    "trustdb.gpg",
+    "private-keys-v1.d"
+  };
+#define N_WATCHED_FILES DIM (watched_files)
+
+struct keycache_header_s
+{
+  char magic[8];
+  guint32 byteorder;
+  guint32 version;
+  guint32 nrecords;
+  guint32 strings_size;
+  guint64 mtimes[N_WATCHED_FILES];
+  char lang[32];          /* The language used to render the rows.  */
+};
+
+struct keycache_record_s
+{
+  /* Offsets into the string area.  */
+  guint32 fpr;
+  guint32 keytype;
+  guint32 created;
+  guint32 expiry;
+  guint32 ownertrust;
+  guint32 validity;
+  guint32 userid;
+  guint32 flags;
+  guint64 created_ts;
+  guint64 expiry_ts;
+  guint64 ownertrust_value;
+  gint64 validity_value;
+};
+
+struct gpa_keycache_s
+{
+  GMappedFile *file;
+  const struct keycache_header_s *header;
+  const struct keycache_record_s *records;
+  const char *strings;
+};
+
+
+
+/* Fill MTIMES with the modification times of the watched files.  */
+static void
+get_mtimes (guint64 *mtimes)
+{
+  struct stat st;
+  int i;
+
+  for (i = 0; i < N_WATCHED_FILES; i++)
+    {
+      gchar *fname = g_build_filename (gnupg_homedir, watched_files[i], NULL);
+
+      if (!g_stat (fname, &st))
+        mtimes[i] = (guint64) st.st_mtime;
+      else
+        mtimes[i] = 0;
+      g_free (fname);
+    }
+}
+
+
+/* Copy the name of the current language to BUFFER of size LEN.  */
+static void
+get_lang (char *buffer, size_t len)
+{
+  const gchar * const *langs = g_get_language_names ();
+
+  memset (buffer, 0, len);
+  if (langs && *langs)
+    g_strlcpy (buffer, *langs, len);
+}
+
+
+static void
+release_mapped_file (GMappedFile *file)
+{
+#if GLIB_CHECK_VERSION (2, 22, 0)
+  g_mapped_file_unref (file);
+#else
+  g_mapped_file_free (file);
+#endif
+}
+
+
+
+/* Return the name of the key cache file.  It is stored next to the
+   configuration file.  The caller must free the result.  */
+gchar *
+gpa_keycache_filename (void)
+{
+  const gchar *optfile;
+  gchar *dir, *fname;
+
+  optfile = gpa_options_get_file (gpa_options_get_instance ());
+  dir = optfile? g_path_get_dirname (optfile) : g_strdup (gnupg_homedir);
+  fname = g_build_filename (dir, "gpa-keylist.cache", NULL);
+  g_free (dir);
+  return fname;
+}
+
+
+/* Map the key cache file FILENAME.  Returns NULL if the file does not
+   exist or is not usable.  */
+gpa_keycache_t
+gpa_keycache_open (const char *filename)
+{
+  GMappedFile *file;
+  const char *buffer;
+  gsize length;
+  const struct keycache_header_s *header;
+  gpa_keycache_t cache;
+  char lang[sizeof header->lang];
+  gsize nbytes;
+
+  file = g_mapped_file_new (filename, FALSE, NULL);
+  if (!file)
+    return NULL;
+
+  buffer = g_mapped_file_get_contents (file);
+  length = g_mapped_file_get_length (file);
+  header = (const struct keycache_header_s *) buffer;
+  if (length < sizeof *header
+      || memcmp (header->magic, KEYCACHE_MAGIC, sizeof header->magic)
+      || header->byteorder != KEYCACHE_BYTEORDER
+      || header->version != KEYCACHE_VERSION)
+    goto invalid;
+
+  /* Check the sizes; take care not to overflow.  */
+  nbytes = length - sizeof *header;
+  if (header->nrecords > nbytes / sizeof (struct keycache_record_s))
+    goto invalid;
+  nbytes -= header->nrecords * sizeof (struct keycache_record_s);
+  if (!header->strings_size || header->strings_size != nbytes
+      || buffer[length - 1])
+    goto invalid;
+
+  /* The strings have been rendered for a certain language.  */
+  get_lang (lang, sizeof lang);
+  if (memcmp (lang, header->lang, sizeof lang))
+    goto invalid;
+
+  cache = g_malloc0 (sizeof *cache);
+  cache->file = file;
+  cache->header = header;
+  cache->records = (const struct keycache_record_s *) (header + 1);
+  cache->strings = (const char *) (cache->records + header->nrecords);
+  return cache;
+
+ invalid:
+  g_debug ("ignoring invalid key cache `%s'", filename);
+  release_mapped_file (file);
+  return NULL;
+}
+
+
+/* Release a key cache object.  */
+void
+gpa_keycache_close (gpa_keycache_t cache)
+{
+  if (!cache)
+    return;
+  release_mapped_file (cache->file);
+  g_free (cache);
+}
+
+
+/* Return true if the keyrings have not been modified since CACHE was
+   written.  */
+gboolean
+gpa_keycache_is_current (gpa_keycache_t cache)
+{
+  guint64 mtimes[N_WATCHED_FILES];
+
+  get_mtimes (mtimes);
+  return !memcmp (mtimes, cache->header->mtimes, sizeof mtimes);
+}
+
+
+/* Return the number of rows in CACHE.  */
+unsigned int
+gpa_keycache_count (gpa_keycache_t cache)
+{
+  return cache->header->nrecords;
+}
+
+
+/* Return the string at offset OFF or NULL if it is out of range.  */
+static const char *
+get_string (gpa_keycache_t cache, guint32 off)
+{
+  if (off >= cache->header->strings_size)
+    return NULL;
+  return cache->strings + off;
+}
+
+
+/* Fill ROW with the row at IDX of CACHE.  The strings point into the
+   mapped file and are valid until CACHE is closed.  Returns FALSE if
+   IDX is out of range or the row is corrupt.  */
+gboolean
+gpa_keycache_get (gpa_keycache_t cache, unsigned int idx,
+                  gpa_keycache_row_t row)
+{
+  const struct keycache_record_s *rec;
+
+  if (idx >= cache->header->nrecords)
+    return FALSE;
+  rec = cache->records + idx;
+
+  row->fpr = get_string (cache, rec->fpr);
+  row->keytype = get_string (cache, rec->keytype);
+  row->created = get_string (cache, rec->created);
+  row->expiry = get_string (cache, rec->expiry);
+  row->ownertrust = get_string (cache, rec->ownertrust);
+  row->validity = get_string (cache, rec->validity);
+  row->userid = get_string (cache, rec->userid);
+  if (!row->fpr || !*row->fpr || !row->keytype || !row->created
+      || !row->expiry || !row->ownertrust || !row->validity || !row->userid)
+    return FALSE;
+  row->flags = rec->flags;
+  row->created_ts = (unsigned long) rec->created_ts;
+  row->expiry_ts = (unsigned long) rec->expiry_ts;
+  row->ownertrust_value = (unsigned long) rec->ownertrust_value;
+  row->validity_value = (long) rec->validity_value;
+  return TRUE;
+}
+
+
+/* Append STRING to the string area in MB and return its offset.  */
+static guint32
+put_string (membuf_t *mb, const char *string)
+{
+  guint32 off;
+
+  if (!string || !*string)
+    return 0;  /* The empty string at the start of the area.  */
+  off = get_membuf_len (mb);
+  put_membuf (mb, string, strlen (string) + 1);
+  return off;
+}
+
+
+/* Write the NROWS rows from ROWS to the key cache file FILENAME.  */
+gpg_error_t
+gpa_keycache_save (const char *filename,
+                   struct gpa_keycache_row_s *rows, unsigned int nrows)
+{
+  struct keycache_header_s header;
+  struct keycache_record_s *records;
+  membuf_t strings;
+  void *strbuf;
+  size_t strings_len;
+  gchar *buffer;
+  gsize buflen;
+  unsigned int idx;
+  GError *error = NULL;
+  gpg_error_t err = 0;
+
+  records = g_new0 (struct keycache_record_s, nrows? nrows : 1);
+  init_membuf (&strings, 4096);
+  put_membuf (&strings, "", 1);
+  for (idx = 0; idx < nrows; idx++)
+    {
+      records[idx].fpr = put_string (&strings, rows[idx].fpr);
+      records[idx].keytype = put_string (&strings, rows[idx].keytype);
+      records[idx].created = put_string (&strings, rows[idx].created);
+      records[idx].expiry = put_string (&strings, rows[idx].expiry);
+      records[idx].ownertrust = put_string (&strings, rows[idx].ownertrust);
+      records[idx].validity = put_string (&strings, rows[idx].validity);
+      records[idx].userid = put_string (&strings, rows[idx].userid);
+      records[idx].flags = rows[idx].flags;
+      records[idx].created_ts = rows[idx].created_ts;
+      records[idx].expiry_ts = rows[idx].expiry_ts;
+      records[idx].ownertrust_value = rows[idx].ownertrust_value;
+      records[idx].validity_value = rows[idx].validity_value;
+    }
+  strbuf = get_membuf (&strings, &strings_len);
+  if (!strbuf)
+    {
+      g_free (records);
+      return gpg_error_from_syserror ();
+    }
+
+  memset (&header, 0, sizeof header);
+  memcpy (header.magic, KEYCACHE_MAGIC, sizeof header.magic);
+  header.byteorder = KEYCACHE_BYTEORDER;
+  header.version = KEYCACHE_VERSION;
+  header.nrecords = nrows;
+  header.strings_size = strings_len;
+  get_mtimes (header.mtimes);
+  get_lang (header.lang, sizeof header.lang);
+
+  buflen = sizeof header + nrows * sizeof *records + strings_len;
+  buffer = g_malloc (buflen);
+  memcpy (buffer, &header, sizeof header);
+  memcpy (buffer + sizeof header, records, nrows * sizeof *records);
+  memcpy (buffer + sizeof header + nrows * sizeof *records, strbuf, strings_len);
+  g_free (records);
+  g_free (strbuf);
+
+  /* This writes to a temporary file which is then renamed.  Thus a
+     concurrent reader never sees a partial file.  */
+  if (!g_file_set_contents (filename, buffer, buflen, &error))
+    {
+      g_debug ("error writing key cache `%s': %s", filename, error->message);
+      g_error_free (error);
+      err = gpg_error (GPG_ERR_GENERAL);
+    }
+  g_free (buffer);
+  return err;
+}
@@ -0,0 +1,83 @@
+/* keycache.h - Persistent snapshot of the key listing.
+   Copyright (C) 2026 g10 Code GmbH.
+
+   This file is part of GPA
+
+   GPA is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   GPA is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+   License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.  */
+
+/* The key cache is a file with the rendered rows of the key manager's
+   key list.  It is memory mapped at startup so that the key list can
+   be shown before the real key listing, which may take quite some
+   time for large keyrings, has finished.  */
+
+#ifndef KEYCACHE_H
+#define KEYCACHE_H
+
+#include <glib.h>
+#include <gpgme.h>
+
+/* Flags for a row.  */
+#define GPA_KEYCACHE_FLAG_SECRET  1  /* A secret key is available.  */
+#define GPA_KEYCACHE_FLAG_CARDKEY 2  /* The secret key is on a card.  */
+
+/* One row of the key list.  All strings are UTF-8.  */
+struct gpa_keycache_row_s
+{
+  const char *fpr;
+  const char *keytype;
+  const char *created;
+  const char *expiry;
+  const char *ownertrust;
+  const char *validity;
+  const char *userid;
+  unsigned int flags;
+  unsigned long created_ts;
+  unsigned long expiry_ts;
+  unsigned long ownertrust_value;
+  long validity_value;
+};
+typedef struct gpa_keycache_row_s *gpa_keycache_row_t;
+
+typedef struct gpa_keycache_s *gpa_keycache_t;
+
+/* Return the name of the key cache file.  The caller must free the
+   result.  */
+gchar *gpa_keycache_filename (void);
+
+/* Map the key cache file FILENAME.  Returns NULL if the file does not
+   exist or is not usable.  */
+gpa_keycache_t gpa_keycache_open (const char *filename);
+
+/* Release a key cache object.  */
+void gpa_keycache_close (gpa_keycache_t cache);
+
+/* Return true if the keyrings have not been modified since CACHE was
+   written.  */
+gboolean gpa_keycache_is_current (gpa_keycache_t cache);
+
+/* Return the number of rows in CACHE.  */
+unsigned int gpa_keycache_count (gpa_keycache_t cache);
+
+/* Fill ROW with the row at IDX of CACHE.  The strings point into the
+   mapped file and are valid until CACHE is closed.  Returns FALSE if
+   IDX is out of range or the row is corrupt.  */
+gboolean gpa_keycache_get (gpa_keycache_t cache, unsigned int idx,
+                           gpa_keycache_row_t row);
+
+/* Write the NROWS rows from ROWS to the key cache file FILENAME.  */
+gpg_error_t gpa_keycache_save (const char *filename,
+                               struct gpa_keycache_row_s *rows,
+                               unsigned int nrows);
+
+#endif /*KEYCACHE_H*/
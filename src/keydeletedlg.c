@@ -70,6 +70,33 @@ confirm_delete_secret (GtkWidget * parent)
     }
 }
 
+/* State of the delete key dialog while the secret key is looked up.  */
+struct delete_dialog_s
+{
+  GtkWidget *window;
+  GtkWidget *secret_label;
+  GtkWidget *public_label;
+  gboolean has_secret_key;
+};
+
+
+/* Show the warning matching the secret key SECKEY and allow the user
+   to confirm the deletion.  */
+static void
+secret_key_found_cb (const char *fpr, gpgme_key_t seckey, gpointer data)
+{
+  struct delete_dialog_s *dlg = data;
+
+  dlg->has_secret_key = (seckey != NULL);
+  gtk_widget_hide (dlg->has_secret_key? dlg->public_label
+                   : dlg->secret_label);
+  gtk_widget_show (dlg->has_secret_key? dlg->secret_label
+                   : dlg->public_label);
+  gtk_dialog_set_response_sensitive (GTK_DIALOG (dlg->window),
+                                     GTK_RESPONSE_YES, TRUE);
+}
+
+
 /* Run the delete key dialog as a modal dialog and return TRUE if the
  * user chose Yes, FALSE otherwise. Display information about the public
  * key key in the dialog so that the user knows which key is to be
@@ -83,10 +110,9 @@ gpa_delete_dialog_run (GtkWidget * parent, gpgme_key_t key)
   GtkWidget * vbox;
   GtkWidget * label;
   GtkWidget * info;
-
-  gboolean has_secret_key = (gpa_keytable_lookup_key 
-			     (gpa_keytable_get_secret_instance(), 
-			      key->subkeys->fpr) != NULL);
+  GpaKeyTable *secret = gpa_keytable_get_secret_instance ();
+  struct delete_dialog_s dlg;
+  gint response;
 
   window = gtk_dialog_new_with_buttons (_("Remove Key"), GTK_WINDOW(parent),
                                         GTK_DIALOG_MODAL,
@@ -109,34 +135,46 @@ gpa_delete_dialog_run (GtkWidget * parent, gpgme_key_t key)
   info = gpa_key_info_new (key);
   gtk_box_pack_start (GTK_BOX (vbox), info, TRUE, TRUE, 5);
 
-  if (has_secret_key)
-    {
-      label = gtk_label_new (_("This key has a secret key."
-			       " Deleting this key cannot be undone,"
-			       " unless you have a backup copy."));
-      gtk_misc_set_alignment (GTK_MISC (label), 0.0, 0.5);
-      gtk_label_set_line_wrap (GTK_LABEL (label), TRUE);
-      gtk_box_pack_start (GTK_BOX (vbox), label, FALSE, FALSE, 5);
-    }
-  else
-    {
-      label = gtk_label_new (_("This key is a public key."
-			       " Deleting this key cannot be undone easily,"
-			       " although you may be able to get a new copy "
-			       " from the owner or from a key server."));
-      gtk_misc_set_alignment (GTK_MISC (label), 0.0, 0.5);
-      gtk_label_set_line_wrap (GTK_LABEL (label), TRUE);
-      gtk_box_pack_start (GTK_BOX (vbox), label, FALSE, FALSE, 5);
-    }
-  
+  /* Only one of these labels is shown, depending on whether there is
+     a secret key.  */
+  label = gtk_label_new (_("This key has a secret key."
+                           " Deleting this key cannot be undone,"
+                           " unless you have a backup copy."));
+  gtk_misc_set_alignment (GTK_MISC (label), 0.0, 0.5);
+  gtk_label_set_line_wrap (GTK_LABEL (label), TRUE);
+  gtk_widget_set_no_show_all (label, TRUE);
+  gtk_box_pack_start (GTK_BOX (vbox), label, FALSE, FALSE, 5);
+  dlg.secret_label = label;
+
+  label = gtk_label_new (_("This key is a public key."
+                           " Deleting this key cannot be undone easily,"
+                           " although you may be able to get a new copy "
+                           " from the owner or from a key server."));
+  gtk_misc_set_alignment (GTK_MISC (label), 0.0, 0.5);
+  gtk_label_set_line_wrap (GTK_LABEL (label), TRUE);
+  gtk_widget_set_no_show_all (label, TRUE);
+  gtk_box_pack_start (GTK_BOX (vbox), label, FALSE, FALSE, 5);
+  dlg.public_label = label;
+
   label = gtk_label_new (_("Are you sure you want to delete this key?"));
   gtk_box_pack_start (GTK_BOX (vbox), label, FALSE, FALSE, 5);
 
   gtk_widget_show_all (window);
 
-  if (gtk_dialog_run (GTK_DIALOG (window)) == GTK_RESPONSE_YES)
+  /* The deletion may only be confirmed after we know whether there
+     is a secret key.  */
+  dlg.window = window;
+  dlg.has_secret_key = FALSE;
+  gtk_dialog_set_response_sensitive (GTK_DIALOG (window),
+                                     GTK_RESPONSE_YES, FALSE);
+  gpa_keytable_lookup_key_async (secret, key->subkeys->fpr,
+                                 secret_key_found_cb, &dlg);
+
+  response = gtk_dialog_run (GTK_DIALOG (window));
+  gpa_keytable_cancel_lookups (secret, &dlg);
+  if (response == GTK_RESPONSE_YES)
     {
-      if (has_secret_key)
+      if (dlg.has_secret_key)
         {
           gboolean result = confirm_delete_secret (window);
           gtk_widget_destroy (window);
@@ -121,6 +121,21 @@ gpa_key_edit_dialog_finalize (GObject *object)
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
+/* Make the "Change expiration" button sensitive if there is a secret
+   key.  */
+static void
+expiry_button_secret_key_cb (const char *fpr, gpgme_key_t seckey,
+                             gpointer data)
+{
+  gtk_widget_set_sensitive (GTK_WIDGET (data), seckey != NULL);
+}
+
+static void
+expiry_button_destroy_cb (GtkWidget *button, gpointer data)
+{
+  gpa_keytable_cancel_lookups (gpa_keytable_get_secret_instance (), button);
+}
+
 static GObject*
 gpa_key_edit_dialog_constructor (GType                  type,
 				 guint                  n_construct_properties,
@@ -182,9 +197,13 @@ gpa_key_edit_dialog_constructor (GType                  type,
 
   button = gtk_button_new_with_mnemonic (_("Change _expiration"));
   gtk_box_pack_start (GTK_BOX (hbox), button, FALSE, FALSE, 0);
-  gtk_widget_set_sensitive (button,(gpa_keytable_lookup_key
-			     (gpa_keytable_get_secret_instance(),
-			      dialog->key->subkeys->fpr) != NULL));
+  /* The expiration can only be changed if we have the secret key.  */
+  gtk_widget_set_sensitive (button, FALSE);
+  g_signal_connect (G_OBJECT (button), "destroy",
+		    G_CALLBACK (expiry_button_destroy_cb), NULL);
+  gpa_keytable_lookup_key_async (gpa_keytable_get_secret_instance (),
+                                 dialog->key->subkeys->fpr,
+                                 expiry_button_secret_key_cb, button);
   g_signal_connect (G_OBJECT (button), "clicked",
 		    G_CALLBACK (gpa_key_edit_change_expiry), dialog);
 
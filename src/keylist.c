@@ -29,7 +29,8 @@
 #include "gtktools.h"
 #include "keytable.h"
 #include "icons.h"
-#include "format-dn.h"
+#include "keycache.h"
+#include "keylistmodel.h"
 
 
 /* Properties */
@@ -48,34 +49,32 @@ enum
 /* GObject */
 static GObjectClass *parent_class = NULL;
 
+/* The time in seconds the idle handler may spend inserting keys
+   before it yields to the main loop.  This keeps the list responsive
+   while a large keyring is loaded.  */
+#define INSERT_TIME_BUDGET 0.008
 
-/* Symbols to access the columns.  */
-typedef enum
-{
-  /* These are the displayed columns */
-  GPA_KEYLIST_COLUMN_IMAGE,
-  GPA_KEYLIST_COLUMN_KEYTYPE,
-  GPA_KEYLIST_COLUMN_CREATED,
-  GPA_KEYLIST_COLUMN_EXPIRY,
-  GPA_KEYLIST_COLUMN_OWNERTRUST,
-  GPA_KEYLIST_COLUMN_VALIDITY,
-  GPA_KEYLIST_COLUMN_USERID,
-  /* This column contains the gpgme_key_t */
-  GPA_KEYLIST_COLUMN_KEY,
-  /* These columns are used only internally for sorting */
-  GPA_KEYLIST_COLUMN_HAS_SECRET,
-  GPA_KEYLIST_COLUMN_CREATED_TS,
-  GPA_KEYLIST_COLUMN_EXPIRY_TS,
-  GPA_KEYLIST_COLUMN_OWNERTRUST_VALUE,
-  GPA_KEYLIST_COLUMN_VALIDITY_VALUE,
-  GPA_KEYLIST_N_COLUMNS
-} GpaKeyListColumn;
+/* Detach the model from the view if at least this many keys are to
+   be inserted into an empty list.  */
+#define DETACH_THRESHOLD 500
+
+/* Seconds to wait before the validity of all rows is refreshed;
+   further changes within this time are covered by the same pass.  */
+#define VALIDITY_DELAY 3
 
+/* Seconds to wait before the key cache file is written after a
+   partial update; a burst of updates is thus written only once.  */
+#define SNAPSHOT_DELAY 5
 
 
-static void add_trustdb_dialog (GpaKeyList * keylist);
 static void gpa_keylist_next (gpgme_key_t key, gpointer data);
 static void gpa_keylist_end (gpointer data);
+static void flush_pending_keys (GpaKeyList *list);
+static void finish_listing (GpaKeyList *list);
+static void save_snapshot (GpaKeyList *list);
+static void update_secret_end (gpointer data);
+static void update_end (gpointer data);
+static void secret_keys_ready (gpointer data);
 
 
 
@@ -164,6 +163,31 @@ gpa_keylist_dispose (GObject *object)
   GpaKeyList *list = GPA_KEYLIST (object);
 
   list->disposed = 1;
+  gpa_keytable_cancel_lookups (gpa_keytable_get_secret_instance (), list);
+  if (list->insert_idle_id)
+    {
+      g_source_remove (list->insert_idle_id);
+      list->insert_idle_id = 0;
+    }
+  if (list->validity_timeout_id)
+    {
+      g_source_remove (list->validity_timeout_id);
+      list->validity_timeout_id = 0;
+    }
+  if (list->snapshot_timeout_id)
+    {
+      /* Do not lose the pending changes.  */
+      g_source_remove (list->snapshot_timeout_id);
+      list->snapshot_timeout_id = 0;
+      if (list->snapshot_dirty && !list->listing)
+        save_snapshot (list);
+    }
+  flush_pending_keys (list);
+  if (list->detached_model)
+    {
+      g_object_unref (list->detached_model);
+      list->detached_model = NULL;
+    }
 
   G_OBJECT_CLASS (parent_class)->dispose (object);
 }
@@ -174,11 +198,11 @@ gpa_keylist_finalize (GObject *object)
 {
   GpaKeyList *list = GPA_KEYLIST (object);
 
-  /* Dereference all keys in the list */
-  g_list_foreach (list->keys, (GFunc) gpgme_key_unref, NULL);
-  g_list_free (list->keys);
-  list->keys = NULL;
   gpa_gpgme_release_keyarray (list->initial_keys);
+  g_hash_table_destroy (list->update_queue);
+  if (list->snapshot_rows)
+    g_hash_table_destroy (list->snapshot_rows);
+  g_queue_free (list->pending_keys);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -188,34 +212,26 @@ static void
 gpa_keylist_init (GTypeInstance *instance, void *class_ptr)
 {
   GpaKeyList *list = GPA_KEYLIST (instance);
-  GtkListStore *store;
+  GpaKeyListModel *model;
   GtkTreeSelection *selection;
 
+  list->update_queue = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                              g_free, NULL);
+  list->pending_keys = g_queue_new ();
+
   /* Setup the model.  */
-  store = gtk_list_store_new (GPA_KEYLIST_N_COLUMNS,
-			      G_TYPE_STRING,
-			      G_TYPE_STRING,
-			      G_TYPE_STRING,
-			      G_TYPE_STRING,
-			      G_TYPE_STRING,
-			      G_TYPE_STRING,
-			      G_TYPE_STRING,
-			      G_TYPE_POINTER,
-			      G_TYPE_INT,
-			      G_TYPE_ULONG,
-			      G_TYPE_ULONG,
-			      G_TYPE_ULONG,
-			      G_TYPE_LONG);
+  model = gpa_keylist_model_new ();
 
   /* Setup the view.  */
-  gtk_tree_view_set_model (GTK_TREE_VIEW (list), GTK_TREE_MODEL (store));
+  gtk_tree_view_set_model (GTK_TREE_VIEW (list), GTK_TREE_MODEL (model));
+  g_object_unref (model);
   gtk_tree_view_set_rules_hint (GTK_TREE_VIEW (list), TRUE);
   gpa_keylist_set_brief (list);
   selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (list));
   gtk_tree_selection_set_mode (selection, GTK_SELECTION_MULTIPLE);
 
   /* Load the keyring.  */
-  add_trustdb_dialog (list);
+  list->listing = TRUE;
   if (list->initial_keys)
     {
       /* Initialize from the provided list.  */
@@ -231,9 +247,11 @@ gpa_keylist_init (GTypeInstance *instance, void *class_ptr)
     }
   else
     {
-      /* Initialize from the global keytable.  */
-      gpa_keytable_list_keys (gpa_keytable_get_public_instance(),
-                              gpa_keylist_next, gpa_keylist_end, list);
+      /* Initialize from the global keytable.  The secret keys are
+         required to render the rows; thus we list the public keys
+         only after the secret keytable is ready.  */
+      gpa_keytable_when_ready (gpa_keytable_get_secret_instance (),
+                               secret_keys_ready, list);
     }
 
 }
@@ -339,207 +357,609 @@ gpa_keylist_get_type (void)
  ******************  Internal Functions  ********************
  ************************************************************/
 
+/* Return the model of LIST, even while it is detached from the
+   view.  */
+static GtkTreeModel *
+get_model (GpaKeyList *list)
+{
+  if (list->detached_model)
+    return list->detached_model;
+  return gtk_tree_view_get_model (GTK_TREE_VIEW (list));
+}
+
+
+/* Attach the model again after bulk loading.  */
+static void
+attach_model (GpaKeyList *list)
+{
+  if (!list->detached_model)
+    return;
+
+  gtk_tree_view_set_model (GTK_TREE_VIEW (list), list->detached_model);
+  g_object_unref (list->detached_model);
+  list->detached_model = NULL;
+}
+
+
+/* Release all keys not yet inserted.  */
+static void
+flush_pending_keys (GpaKeyList *list)
+{
+  gpgme_key_t key;
+
+  while ((key = g_queue_pop_head (list->pending_keys)))
+    gpgme_key_unref (key);
+  list->end_pending = FALSE;
+}
+
+
+/* Return true if KEY shall be shown in LIST.  */
 static gboolean
-display_dialog (GpaKeyList * keylist)
+key_is_wanted (GpaKeyList *list, gpgme_key_t key)
 {
-  gtk_widget_show_all (keylist->dialog);
+  /* Filter out keys we don't want.  */
+  if (list->protocol != GPGME_PROTOCOL_UNKNOWN
+      && key->protocol != list->protocol)
+    return FALSE;
+
+  if (list->requested_usage)
+    {
+      if ((key->can_sign && list->requested_usage & KEY_USAGE_SIGN))
+        ;
+      else if ((key->can_encrypt && list->requested_usage & KEY_USAGE_ENCR))
+        ;
+      else if ((key->can_certify && list->requested_usage & KEY_USAGE_CERT))
+        ;
+      else
+        return FALSE;
+    }
+
+  if (list->only_usable_keys
+      && (key->revoked || key->disabled || key->expired || key->invalid))
+    return FALSE;
+
+  return TRUE;
+}
+
+
+/* Insert KEY into the model of LIST.  Note that this function takes
+   ownership of KEY.  */
+static void
+insert_key (GpaKeyList *list, gpgme_key_t key)
+{
+  GpaKeyListModel *model = GPA_KEYLIST_MODEL (get_model (list));
+
+  /* The cached row may show an older state of the key, thus the
+     snapshot is saved again after any replacement.  */
+  list->snapshot_dirty = TRUE;
+
+  /* Fill the row from the key cache if there is one.  */
+  if (list->snapshot_rows)
+    {
+      GtkTreeIter *row = g_hash_table_lookup (list->snapshot_rows,
+                                              key->subkeys->fpr);
+      if (row)
+        {
+          gpa_keylist_model_set_key (model, row, key);
+          g_hash_table_remove (list->snapshot_rows, key->subkeys->fpr);
+          return;
+        }
+    }
+
+  /* Append the key to the list */
+  gpa_keylist_model_append (model, key, NULL);
+}
+
+
+/* Idle handler to insert the pending keys.  It inserts keys until
+   the time budget is used up and then yields to the main loop so
+   that the view is redrawn.  */
+static gboolean
+insert_pending_keys (gpointer data)
+{
+  GpaKeyList *list = data;
+  GTimer *timer;
+  gpgme_key_t key;
+  int count = 0;
+
+  /* Detach the model while loading many keys into an empty list;
+     this saves the view from updating itself for each row.  The
+     model stays detached until the listing has finished.  */
+  if (!list->detached_model && list->listing
+      && g_queue_get_length (list->pending_keys) >= DETACH_THRESHOLD
+      && !gtk_tree_model_iter_n_children (get_model (list), NULL))
+    {
+      list->detached_model = get_model (list);
+      g_object_ref (list->detached_model);
+      gtk_tree_view_set_model (GTK_TREE_VIEW (list), NULL);
+    }
+
+  timer = g_timer_new ();
+  while ((key = g_queue_pop_head (list->pending_keys)))
+    {
+      insert_key (list, key);
+      /* Do not look at the clock for every key.  */
+      if (!(++count % 32)
+          && g_timer_elapsed (timer, NULL) > INSERT_TIME_BUDGET)
+        break;
+    }
+  g_timer_destroy (timer);
 
-  keylist->timeout_id = 0;
+  if (!g_queue_is_empty (list->pending_keys))
+    return TRUE;  /* Continue in the next idle slot.  */
 
+  list->insert_idle_id = 0;
+  if (list->end_pending)
+    {
+      list->end_pending = FALSE;
+      finish_listing (list);
+    }
   return FALSE;
 }
 
 
+/* Called by the keytable for each key.  The key is inserted later by
+   an idle handler.  Note that this function takes ownership of
+   KEY.  */
 static void
-add_trustdb_dialog (GpaKeyList * keylist)
+gpa_keylist_next (gpgme_key_t key, gpointer data)
 {
-  /* Display this warning until the first key is received.  It may be
-     shown at times when it's not needed. But it shouldn't appear for
-     long those times.  */
-  keylist->dialog = gtk_message_dialog_new
-    (GTK_WINDOW (keylist->window), GTK_DIALOG_MODAL,
-     GTK_MESSAGE_INFO, GTK_BUTTONS_NONE,
-     _("GnuPG is rebuilding the trust database.\n"
-       "This might take a few seconds."));
+  GpaKeyList *list = data;
+
+  if (!key)
+    return;
+  if (list->disposed || !key_is_wanted (list, key))
+    {
+      /* Should not access our model anymore or not wanted.  */
+      gpgme_key_unref (key);
+      return;
+    }
 
-  /* Wait a second before displaying the dialog. This avoids most
-     "false alarms".  That is the message will not be shown if GnuPG
-     does not run a long check trustdb.  */
-  keylist->timeout_id = g_timeout_add (1000, (GSourceFunc) display_dialog,
-				       keylist);
+  g_queue_push_tail (list->pending_keys, key);
+  if (!list->insert_idle_id)
+    list->insert_idle_id = g_idle_add (insert_pending_keys, list);
 }
 
 
+/* Write all rows with a key to the key cache file.  */
 static void
-remove_trustdb_dialog (GpaKeyList * keylist)
+save_snapshot (GpaKeyList *list)
 {
-  if (keylist->timeout_id)
+  GtkTreeModel *model = get_model (list);
+  struct gpa_keycache_row_s *rows;
+  GtkTreeIter iter;
+  gboolean valid;
+  unsigned int idx, nrows;
+  gchar *fname;
+
+  nrows = gtk_tree_model_iter_n_children (model, NULL);
+  rows = g_new0 (struct gpa_keycache_row_s, nrows? nrows : 1);
+  idx = 0;
+  for (valid = gtk_tree_model_get_iter_first (model, &iter);
+       valid && idx < nrows;
+       valid = gtk_tree_model_iter_next (model, &iter))
     {
-      g_source_remove (keylist->timeout_id);
-      keylist->timeout_id = 0;
+      gpgme_key_t key;
+      gchar *image, *keytype, *created, *expiry, *ownertrust, *validity;
+      gchar *userid;
+      gint has_secret;
+      gulong created_ts, expiry_ts, ownertrust_value;
+      glong validity_value;
+
+      gtk_tree_model_get (model, &iter,
+                          GPA_KEYLIST_COLUMN_KEY, &key,
+                          GPA_KEYLIST_COLUMN_IMAGE, &image,
+                          GPA_KEYLIST_COLUMN_KEYTYPE, &keytype,
+                          GPA_KEYLIST_COLUMN_CREATED, &created,
+                          GPA_KEYLIST_COLUMN_EXPIRY, &expiry,
+                          GPA_KEYLIST_COLUMN_OWNERTRUST, &ownertrust,
+                          GPA_KEYLIST_COLUMN_VALIDITY, &validity,
+                          GPA_KEYLIST_COLUMN_USERID, &userid,
+                          GPA_KEYLIST_COLUMN_HAS_SECRET, &has_secret,
+                          GPA_KEYLIST_COLUMN_CREATED_TS, &created_ts,
+                          GPA_KEYLIST_COLUMN_EXPIRY_TS, &expiry_ts,
+                          GPA_KEYLIST_COLUMN_OWNERTRUST_VALUE,
+                          &ownertrust_value,
+                          GPA_KEYLIST_COLUMN_VALIDITY_VALUE, &validity_value,
+                          -1);
+      if (!key || !key->subkeys || !key->subkeys->fpr)
+        {
+          g_free (image);
+          g_free (keytype);
+          g_free (created);
+          g_free (expiry);
+          g_free (ownertrust);
+          g_free (validity);
+          g_free (userid);
+          continue;
+        }
+
+      rows[idx].fpr = g_strdup (key->subkeys->fpr);
+      rows[idx].keytype = keytype;
+      rows[idx].created = created;
+      rows[idx].expiry = expiry;
+      rows[idx].ownertrust = ownertrust;
+      rows[idx].validity = validity;
+      rows[idx].userid = userid;
+      if (has_secret)
+        rows[idx].flags |= GPA_KEYCACHE_FLAG_SECRET;
+      if (image && !strcmp (image, GPA_STOCK_SECRET_CARDKEY))
+        rows[idx].flags |= GPA_KEYCACHE_FLAG_CARDKEY;
+      rows[idx].created_ts = created_ts;
+      rows[idx].expiry_ts = expiry_ts;
+      rows[idx].ownertrust_value = ownertrust_value;
+      rows[idx].validity_value = validity_value;
+      g_free (image);
+      idx++;
     }
-  if (keylist->dialog)
+
+  fname = gpa_keycache_filename ();
+  if (!gpa_keycache_save (fname, rows, idx))
+    list->snapshot_dirty = FALSE;
+  g_free (fname);
+
+  nrows = idx;
+  for (idx = 0; idx < nrows; idx++)
     {
-      gtk_widget_destroy (keylist->dialog);
-      keylist->dialog = NULL;
+      g_free ((char *) rows[idx].fpr);
+      g_free ((char *) rows[idx].keytype);
+      g_free ((char *) rows[idx].created);
+      g_free ((char *) rows[idx].expiry);
+      g_free ((char *) rows[idx].ownertrust);
+      g_free ((char *) rows[idx].validity);
+      g_free ((char *) rows[idx].userid);
     }
+  g_free (rows);
+}
+
+
+/* Timeout handler to write the key cache file.  */
+static gboolean
+snapshot_timeout_cb (gpointer data)
+{
+  GpaKeyList *list = data;
+
+  list->snapshot_timeout_id = 0;
+  /* A running listing writes the file when it has finished.  */
+  if (list->snapshot_dirty && !list->listing)
+    save_snapshot (list);
+  return FALSE;
+}
+
+
+/* Mark the key cache file as outdated and write it after
+   SNAPSHOT_DELAY seconds.  This is used after partial updates.  */
+static void
+schedule_snapshot (GpaKeyList *list)
+{
+  list->snapshot_dirty = TRUE;
+  if (!list->use_snapshot || list->snapshot_timeout_id)
+    return;
+
+  list->snapshot_timeout_id
+    = g_timeout_add_seconds (SNAPSHOT_DELAY, snapshot_timeout_cb, list);
 }
 
 
-static const gchar *
-get_key_pixbuf (gpgme_key_t key)
+/* Helper for drop_snapshot_rows.  */
+static void
+remove_snapshot_row (gpointer key, gpointer value, gpointer user_data)
 {
-  gpgme_key_t seckey;
+  gpa_keylist_model_remove (GPA_KEYLIST_MODEL (user_data), value);
+}
 
-  seckey = gpa_keytable_lookup_key (gpa_keytable_get_secret_instance (),
-                                    key->subkeys->fpr);
-  if (seckey)
+
+/* Remove the rows taken from the key cache which have not been
+   listed.  */
+static void
+drop_snapshot_rows (GpaKeyList *list)
+{
+  GtkTreeModel *model;
+
+  if (!list->snapshot_rows)
+    return;
+
+  model = get_model (list);
+  if (g_hash_table_size (list->snapshot_rows))
+    {
+      list->snapshot_dirty = TRUE;
+      g_hash_table_foreach (list->snapshot_rows, remove_snapshot_row, model);
+    }
+  g_hash_table_destroy (list->snapshot_rows);
+  list->snapshot_rows = NULL;
+  gtk_widget_set_sensitive (GTK_WIDGET (list), TRUE);
+}
+
+
+/* All keys of the listing have been inserted.  */
+static void
+finish_listing (GpaKeyList *list)
+{
+  list->listing = FALSE;
+  attach_model (list);
+  drop_snapshot_rows (list);
+  if (list->use_snapshot && list->snapshot_dirty)
     {
-      if (seckey->subkeys && seckey->subkeys->is_cardkey)
-        return GPA_STOCK_SECRET_CARDKEY;
-      return GPA_STOCK_SECRET_KEY;
+      if (list->snapshot_timeout_id)
+        {
+          g_source_remove (list->snapshot_timeout_id);
+          list->snapshot_timeout_id = 0;
+        }
+      save_snapshot (list);
     }
+}
+
+
+/* Called by the keytable when the listing has finished.  */
+static void
+gpa_keylist_end (gpointer data)
+{
+  GpaKeyList *list = data;
+
+  if (list->disposed)
+    return;
+
+  if (list->insert_idle_id)
+    list->end_pending = TRUE;
   else
-    return GPA_STOCK_PUBLIC_KEY;
+    finish_listing (list);
 }
 
 
+/* The secret keytable is ready; list the public keys.  */
+static void
+secret_keys_ready (gpointer data)
+{
+  GpaKeyList *list = data;
+
+  gpa_keytable_list_keys (gpa_keytable_get_public_instance (),
+                          gpa_keylist_next, gpa_keylist_end, list);
+}
+
 
-/* For keys, gpg can't cope with, the fingerprint is set to all
-   zero. This helper function returns true for such a FPR. */
-static int
-is_zero_fpr (const char *fpr)
+/* Helper for start_update to move the queued fingerprints into the
+   array of fingerprints being updated.  */
+static gboolean
+steal_queued_fpr (gpointer key, gpointer value, gpointer user_data)
 {
-  for (; *fpr; fpr++)
-    if (*fpr != '0')
-      return 0;
-  return 1;
+  gchar ***fprp = user_data;
+
+  **fprp = key;
+  (*fprp)++;
+  return TRUE;
 }
 
 
-/* Note that this function takes ownership of KEY.  */
+/* Start updating the keys queued by gpa_keylist_update_keys.  */
 static void
-gpa_keylist_next (gpgme_key_t key, gpointer data)
+start_update (GpaKeyList *list)
+{
+  gchar **fprp;
+
+  list->update_fprs = g_new0 (gchar *,
+                              g_hash_table_size (list->update_queue) + 1);
+  fprp = list->update_fprs;
+  g_hash_table_foreach_steal (list->update_queue, steal_queued_fpr, &fprp);
+
+  /* Keep us alive until the listing has finished.  */
+  g_object_ref (list);
+  if (list->update_secret)
+    {
+      list->update_secret = FALSE;
+      gpa_keytable_reload_keys (gpa_keytable_get_secret_instance (),
+                                (const char **) list->update_fprs,
+                                NULL, update_secret_end, list);
+    }
+  else
+    gpa_keytable_reload_keys (gpa_keytable_get_public_instance (),
+                              (const char **) list->update_fprs,
+                              NULL, update_end, list);
+}
+
+
+/* The secret keys have been reloaded, continue with the public
+   keys.  */
+static void
+update_secret_end (gpointer data)
 {
   GpaKeyList *list = data;
-  GtkListStore *store;
-  GtkTreeIter iter;
-  const gchar *ownertrust, *validity;
-  gchar *userid, *created, *expiry;
-  gboolean has_secret;
-  long int val_value;
-  const char *keytype;
 
-  /* Remove the dialog if it is being displayed */
-  remove_trustdb_dialog (list);
+  gpa_keytable_reload_keys (gpa_keytable_get_public_instance (),
+                            (const char **) list->update_fprs,
+                            NULL, update_end, list);
+}
+
+
+/* The keytable has been updated; now apply the changes to the rows
+   of the affected keys.  Rows are updated in place so that the
+   selection and the scroll position are kept.  */
+static void
+update_end (gpointer data)
+{
+  GpaKeyList *list = data;
+  GpaKeyTable *keytable = gpa_keytable_get_public_instance ();
+  GtkTreeModel *model;
+  GtkTreeSelection *selection;
+  GtkTreeIter iter;
+  GHashTable *todo;
+  GList *affected = NULL, *item;
+  gboolean valid, selection_changed = FALSE;
+  int idx;
 
   if (list->disposed)
-    return;  /* Should not access our store anymore.  */
+    goto leave;
 
-  /* Filter out keys we don't want.  */
-  if (key && list->protocol != GPGME_PROTOCOL_UNKNOWN
-      && key->protocol != list->protocol)
+  model = get_model (list);
+  selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (list));
+
+  todo = g_hash_table_new (g_str_hash, g_str_equal);
+  for (idx = 0; list->update_fprs[idx]; idx++)
+    g_hash_table_insert (todo, list->update_fprs[idx], list->update_fprs[idx]);
+
+  /* Collect the rows of the affected keys first; updating a row may
+     move it if the model is sorted.  */
+  for (valid = gtk_tree_model_get_iter_first (model, &iter); valid;
+       valid = gtk_tree_model_iter_next (model, &iter))
     {
-      gpgme_key_unref (key);
-      return;
+      gpgme_key_t key;
+
+      gtk_tree_model_get (model, &iter, GPA_KEYLIST_COLUMN_KEY, &key, -1);
+      if (key && key->subkeys && key->subkeys->fpr
+          && g_hash_table_lookup (todo, key->subkeys->fpr))
+        affected = g_list_prepend (affected, gtk_tree_iter_copy (&iter));
     }
 
-  if (key && list->requested_usage)
+  /* Update or remove these rows.  The iters of our model persist,
+     thus they are still valid.  */
+  for (item = affected; item; item = g_list_next (item))
     {
-      if ((key->can_sign && list->requested_usage & KEY_USAGE_SIGN))
-        ;
-      else if ((key->can_encrypt && list->requested_usage & KEY_USAGE_ENCR))
-        ;
-      else if ((key->can_certify && list->requested_usage & KEY_USAGE_CERT))
-        ;
-      else
+      GtkTreeIter *row = item->data;
+      gpgme_key_t key, newkey;
+
+      gtk_tree_model_get (model, row, GPA_KEYLIST_COLUMN_KEY, &key, -1);
+      g_hash_table_remove (todo, key->subkeys->fpr);
+      newkey = gpa_keytable_lookup_key (keytable, key->subkeys->fpr);
+      if (newkey && key_is_wanted (list, newkey))
         {
-          gpgme_key_unref (key);
-          return;
+          gpgme_key_ref (newkey);
+          gpa_keylist_model_set_key (GPA_KEYLIST_MODEL (model), row, newkey);
+          if (!list->detached_model
+              && gtk_tree_selection_iter_is_selected (selection, row))
+            selection_changed = TRUE;
         }
+      else
+        gpa_keylist_model_remove (GPA_KEYLIST_MODEL (model), row);
+      gtk_tree_iter_free (row);
     }
+  g_list_free (affected);
 
-  if (key && list->only_usable_keys
-      && (key->revoked || key->disabled || key->expired || key->invalid))
+  /* Add the keys which are new.  */
+  for (idx = 0; list->update_fprs[idx]; idx++)
     {
-      gpgme_key_unref (key);
-      return;
+      gpgme_key_t newkey;
+
+      if (!g_hash_table_lookup (todo, list->update_fprs[idx]))
+        continue;
+      newkey = gpa_keytable_lookup_key (keytable, list->update_fprs[idx]);
+      if (newkey && key_is_wanted (list, newkey))
+        {
+          gpgme_key_ref (newkey);
+          insert_key (list, newkey);
+        }
     }
+  g_hash_table_destroy (todo);
 
-  /* Append the key to the list.  */
-  list->keys = g_list_append (list->keys, key);
-  store = GTK_LIST_STORE (gtk_tree_view_get_model (GTK_TREE_VIEW (list)));
-  /* Get the column values */
-  keytype = (key->protocol == GPGME_PROTOCOL_OpenPGP? "P" :
-             key->protocol == GPGME_PROTOCOL_CMS? "X" : "?");
-  created = gpa_creation_date_string (key->subkeys->timestamp);
-  expiry = gpa_expiry_date_string (key->subkeys->expires);
-  ownertrust = gpa_key_ownertrust_string (key);
-  validity = gpa_key_validity_string (key);
-  if (key->protocol == GPGME_PROTOCOL_CMS)
-    userid = gpa_format_dn (key->uids? key->uids->uid : NULL);
-  else
-    userid = gpa_gpgme_key_get_userid (key->uids);
-  if (list->public_only)
-    has_secret = 0;
-  else
-    has_secret = (!is_zero_fpr (key->subkeys->fpr)
-                  && gpa_keytable_lookup_key
-                  (gpa_keytable_get_secret_instance(), key->subkeys->fpr));
+  /* Let the users of the selection fetch the updated key.  */
+  if (selection_changed)
+    g_signal_emit_by_name (selection, "changed");
 
-  /* Append the key to the list */
-  gtk_list_store_append (store, &iter);
-
-  /* Set an appropiate value for sorting revoked and expired keys. This
-   * includes a hack for forcing a value to a range outside the
-   * usual validity values */
-  if (key->subkeys->revoked)
-      val_value = GPGME_VALIDITY_UNKNOWN-2;
-  else if (key->subkeys->expired)
-      val_value = GPGME_VALIDITY_UNKNOWN-1;
-  else if (key->uids)
-      val_value = key->uids->validity;
-  else
-      val_value = GPGME_VALIDITY_UNKNOWN;
-
-  gtk_list_store_set (store, &iter,
-		      GPA_KEYLIST_COLUMN_KEYTYPE, keytype,
-		      GPA_KEYLIST_COLUMN_CREATED, created,
-		      GPA_KEYLIST_COLUMN_EXPIRY, expiry,
-		      GPA_KEYLIST_COLUMN_OWNERTRUST, ownertrust,
-		      GPA_KEYLIST_COLUMN_VALIDITY, validity,
-		      GPA_KEYLIST_COLUMN_USERID, userid,
-		      GPA_KEYLIST_COLUMN_KEY, key,
-		      GPA_KEYLIST_COLUMN_HAS_SECRET, has_secret,
-		      GPA_KEYLIST_COLUMN_CREATED_TS, key->subkeys->timestamp,
-
-		      /* Set "no expiration" to a large value for sorting */
-		      GPA_KEYLIST_COLUMN_EXPIRY_TS,
-		      key->subkeys->expires ?
-		      key->subkeys->expires : G_MAXULONG,
-
-		      GPA_KEYLIST_COLUMN_OWNERTRUST_VALUE,
-		      key->owner_trust,
-		      /* Set revoked and expired keys to "never trust"
-		         for sorting.  */
-		      GPA_KEYLIST_COLUMN_VALIDITY_VALUE, val_value,
-                      /* Store the image only if enabled.  */
-		      list->public_only ? -1 : GPA_KEYLIST_COLUMN_IMAGE,
-                      list->public_only ? NULL : get_key_pixbuf (key),
-		      -1);
-  /* Clean up */
-  g_free (userid);
-  g_free (created);
-  g_free (expiry);
+  schedule_snapshot (list);
+
+ leave:
+  g_strfreev (list->update_fprs);
+  list->update_fprs = NULL;
+  if (!list->disposed && g_hash_table_size (list->update_queue))
+    start_update (list);
+  g_object_unref (list);
 }
 
 
+/* Return true if the validity shown for KEY differs from that of
+   NEWKEY.  */
+static gboolean
+validity_changed (gpgme_key_t key, gpgme_key_t newkey)
+{
+  gpgme_user_id_t uid, newuid;
+
+  if (key->owner_trust != newkey->owner_trust
+      || key->revoked != newkey->revoked
+      || key->expired != newkey->expired
+      || key->disabled != newkey->disabled
+      || key->invalid != newkey->invalid)
+    return TRUE;
+
+  for (uid = key->uids, newuid = newkey->uids; uid && newuid;
+       uid = uid->next, newuid = newuid->next)
+    if (uid->validity != newuid->validity)
+      return TRUE;
+  return uid || newuid;
+}
+
+
+/* The public keys have been listed again; update the rows whose
+   validity has changed.  */
 static void
-gpa_keylist_end (gpointer data)
+validity_end (gpointer data)
 {
   GpaKeyList *list = data;
+  GpaKeyTable *keytable = gpa_keytable_get_public_instance ();
+  GtkTreeModel *model;
+  GtkTreeSelection *selection;
+  GtkTreeIter iter;
+  GList *changed = NULL, *item;
+  gboolean valid, selection_changed = FALSE;
 
-  remove_trustdb_dialog (list);
+  if (list->disposed)
+    goto leave;
+
+  model = get_model (list);
+  selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (list));
+
+  /* Collect the rows first; updating a row may move it if the model
+     is sorted.  */
+  for (valid = gtk_tree_model_get_iter_first (model, &iter); valid;
+       valid = gtk_tree_model_iter_next (model, &iter))
+    {
+      gpgme_key_t key, newkey;
+
+      gtk_tree_model_get (model, &iter, GPA_KEYLIST_COLUMN_KEY, &key, -1);
+      if (!key || !key->subkeys || !key->subkeys->fpr)
+        continue;
+      newkey = gpa_keytable_lookup_key (keytable, key->subkeys->fpr);
+      if (newkey && newkey != key && validity_changed (key, newkey))
+        changed = g_list_prepend (changed, gtk_tree_iter_copy (&iter));
+    }
+
+  for (item = changed; item; item = g_list_next (item))
+    {
+      GtkTreeIter *row = item->data;
+      gpgme_key_t key, newkey;
+
+      gtk_tree_model_get (model, row, GPA_KEYLIST_COLUMN_KEY, &key, -1);
+      newkey = gpa_keytable_lookup_key (keytable, key->subkeys->fpr);
+      gpgme_key_ref (newkey);
+      gpa_keylist_model_set_key (GPA_KEYLIST_MODEL (model), row, newkey);
+      if (!list->detached_model
+          && gtk_tree_selection_iter_is_selected (selection, row))
+        selection_changed = TRUE;
+      gtk_tree_iter_free (row);
+    }
+
+  if (changed)
+    {
+      g_list_free (changed);
+      if (selection_changed)
+        g_signal_emit_by_name (selection, "changed");
+      schedule_snapshot (list);
+    }
+
+ leave:
+  g_object_unref (list);
+}
+
+
+/* Timeout handler to start the deferred validity pass.  */
+static gboolean
+validity_timeout_cb (gpointer data)
+{
+  GpaKeyList *list = data;
+
+  list->validity_timeout_id = 0;
+  /* Keep us alive until the listing has finished.  */
+  g_object_ref (list);
+  gpa_keytable_force_reload (gpa_keytable_get_public_instance (),
+                             NULL, validity_end, list);
+  return FALSE;
 }
 
 
@@ -580,11 +1000,37 @@ search_keylist_function (GtkTreeModel *model, gint column,
 }
 
 
+/* Give COLUMN a fixed width large enough for TITLE and SAMPLE.  With
+   fixed sizes for all columns the view needs to look only at the
+   visible rows; otherwise it would fetch all values of all rows to
+   compute the column widths.  */
+static void
+set_fixed_width (GpaKeyList *keylist, GtkTreeViewColumn *column,
+                 const char *title, const char *sample)
+{
+  PangoLayout *layout;
+  int width, title_width;
+
+  layout = gtk_widget_create_pango_layout (GTK_WIDGET (keylist), sample);
+  pango_layout_get_pixel_size (layout, &width, NULL);
+  pango_layout_set_text (layout, title, -1);
+  pango_layout_get_pixel_size (layout, &title_width, NULL);
+  g_object_unref (layout);
+
+  /* Leave room for the sort indicator and the cell padding.  */
+  gtk_tree_view_column_set_sizing (column, GTK_TREE_VIEW_COLUMN_FIXED);
+  gtk_tree_view_column_set_fixed_width (column,
+                                        MAX (width, title_width) + 24);
+  gtk_tree_view_column_set_resizable (column, TRUE);
+}
+
+
 static void
 setup_columns (GpaKeyList *keylist, gboolean detailed)
 {
   GtkCellRenderer *renderer;
   GtkTreeViewColumn *column;
+  gint icon_width;
 
   gpa_keylist_clear_columns (keylist);
 
@@ -601,6 +1047,9 @@ setup_columns (GpaKeyList *keylist, gboolean detailed)
          GPA_KEYLIST_COLUMN_IMAGE,
          NULL);
       gtk_tree_view_append_column (GTK_TREE_VIEW (keylist), column);
+      gtk_icon_size_lookup (GTK_ICON_SIZE_LARGE_TOOLBAR, &icon_width, NULL);
+      gtk_tree_view_column_set_sizing (column, GTK_TREE_VIEW_COLUMN_FIXED);
+      gtk_tree_view_column_set_fixed_width (column, icon_width + 24);
       gtk_tree_view_column_set_sort_column_id
         (column, GPA_KEYLIST_COLUMN_HAS_SECRET);
       gtk_tree_view_column_set_sort_indicator (column, TRUE);
@@ -614,6 +1063,7 @@ setup_columns (GpaKeyList *keylist, gboolean detailed)
      _("This columns lists the type of the certificate."
        "  A 'P' denotes OpenPGP and a 'X' denotes X.509 (S/MIME)."));
   gtk_tree_view_append_column (GTK_TREE_VIEW (keylist), column);
+  set_fixed_width (keylist, column, " ", "X");
 
   renderer = gtk_cell_renderer_text_new ();
   column = gtk_tree_view_column_new_with_attributes
@@ -622,6 +1072,7 @@ setup_columns (GpaKeyList *keylist, gboolean detailed)
     (column, _("Created"),
      _("The Creation Date is the date the certificate was created."));
   gtk_tree_view_append_column (GTK_TREE_VIEW (keylist), column);
+  set_fixed_width (keylist, column, _("Created"), "8888-88-88");
   gtk_tree_view_column_set_sort_column_id
     (column, GPA_KEYLIST_COLUMN_CREATED_TS);
   gtk_tree_view_column_set_sort_indicator (column, TRUE);
@@ -635,6 +1086,7 @@ setup_columns (GpaKeyList *keylist, gboolean detailed)
         (column, _("Expiry Date"),
          _("The Expiry Date is the date until the certificate is valid."));
       gtk_tree_view_append_column (GTK_TREE_VIEW (keylist), column);
+      set_fixed_width (keylist, column, _("Expiry Date"), "8888-88-88");
       gtk_tree_view_column_set_sort_column_id
         (column, GPA_KEYLIST_COLUMN_EXPIRY_TS);
       gtk_tree_view_column_set_sort_indicator (column, TRUE);
@@ -648,6 +1100,7 @@ setup_columns (GpaKeyList *keylist, gboolean detailed)
            " trust the holder of the certificate to correctly sign (certify)"
            " other certificates.  It is only meaningful for OpenPGP."));
       gtk_tree_view_append_column (GTK_TREE_VIEW (keylist), column);
+      set_fixed_width (keylist, column, _("Owner Trust"), "MMMMMMMM");
       gtk_tree_view_column_set_sort_column_id
         (column, GPA_KEYLIST_COLUMN_OWNERTRUST_VALUE);
       gtk_tree_view_column_set_sort_indicator (column, TRUE);
@@ -661,6 +1114,7 @@ setup_columns (GpaKeyList *keylist, gboolean detailed)
            " in this certificate.  That is how sure it is that the named"
            " user is actually that user."));
       gtk_tree_view_append_column (GTK_TREE_VIEW (keylist), column);
+      set_fixed_width (keylist, column, _("Validity"), "MMMMMMMM");
       gtk_tree_view_column_set_sort_column_id
         (column, GPA_KEYLIST_COLUMN_VALIDITY_VALUE);
       gtk_tree_view_column_set_sort_indicator (column, TRUE);
@@ -674,9 +1128,16 @@ setup_columns (GpaKeyList *keylist, gboolean detailed)
      _("The User Name is the name and often also the email address "
        " of the certificate."));
   gtk_tree_view_append_column (GTK_TREE_VIEW (keylist), column);
+  set_fixed_width (keylist, column, _("User Name"),
+                   "MMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMM");
+  gtk_tree_view_column_set_expand (column, TRUE);
   gtk_tree_view_column_set_sort_column_id (column, GPA_KEYLIST_COLUMN_USERID);
   gtk_tree_view_column_set_sort_indicator (column, TRUE);
 
+  /* All columns have a fixed width; thus the view needs to compute
+     the values only for the visible rows.  */
+  gtk_tree_view_set_fixed_height_mode (GTK_TREE_VIEW (keylist), TRUE);
+
   gtk_tree_view_set_enable_search (GTK_TREE_VIEW(keylist), TRUE);
   gtk_tree_view_set_search_equal_func (GTK_TREE_VIEW(keylist),
                                        search_keylist_function, NULL, NULL);
@@ -727,6 +1188,64 @@ gpa_keylist_new_with_keys (GtkWidget *window, gboolean public_only,
 
 
 
+/* Show the rows from the key cache file until the real listing has
+   finished and keep that file up to date.  This is used by the key
+   manager which shows all keys.  */
+void
+gpa_keylist_use_snapshot (GpaKeyList *keylist)
+{
+  GpaKeyListModel *model;
+  gpa_keycache_t cache;
+  struct gpa_keycache_row_s row;
+  gchar *fname;
+  unsigned int idx, count;
+
+  keylist->use_snapshot = TRUE;
+  keylist->snapshot_dirty = TRUE;
+
+  /* If the listing already delivered keys there is no need for the
+     cache.  */
+  model = GPA_KEYLIST_MODEL (get_model (keylist));
+  if (gtk_tree_model_iter_n_children (GTK_TREE_MODEL (model), NULL)
+      || !g_queue_is_empty (keylist->pending_keys))
+    return;
+
+  fname = gpa_keycache_filename ();
+  cache = gpa_keycache_open (fname);
+  g_free (fname);
+  if (!cache)
+    return;
+
+  /* The cache is always shown; it is only rewritten if it is stale
+     or the listing does not match it.  */
+  keylist->snapshot_dirty = !gpa_keycache_is_current (cache);
+  keylist->snapshot_rows = g_hash_table_new_full
+    (g_str_hash, g_str_equal, g_free, (GDestroyNotify) gtk_tree_iter_free);
+
+  count = gpa_keycache_count (cache);
+  for (idx = 0; idx < count; idx++)
+    {
+      GtkTreeIter iter;
+
+      if (!gpa_keycache_get (cache, idx, &row)
+          || g_hash_table_lookup (keylist->snapshot_rows, row.fpr))
+        {
+          keylist->snapshot_dirty = TRUE;
+          continue;
+        }
+
+      gpa_keylist_model_append_cached (model, &row, &iter);
+      g_hash_table_insert (keylist->snapshot_rows, g_strdup (row.fpr),
+                           gtk_tree_iter_copy (&iter));
+    }
+  gpa_keycache_close (cache);
+
+  /* The rows have no keys yet; do not allow any action on them.  */
+  if (g_hash_table_size (keylist->snapshot_rows))
+    gtk_widget_set_sensitive (GTK_WIDGET (keylist), FALSE);
+}
+
+
 /* Set the key list in "brief" mode.  */
 void
 gpa_keylist_set_brief (GpaKeyList *keylist)
@@ -883,51 +1402,145 @@ gpa_keylist_start_reload (GpaKeyList * keylist)
   GtkTreeSelection *selection =
     gtk_tree_view_get_selection (GTK_TREE_VIEW (keylist));
   gtk_tree_selection_unselect_all (selection);
-  gtk_list_store_clear (GTK_LIST_STORE (gtk_tree_view_get_model
-					(GTK_TREE_VIEW (keylist))));
-  g_list_foreach (keylist->keys, (GFunc) gpgme_key_unref, NULL);
-  g_list_free (keylist->keys);
-  keylist->keys = NULL;
-  add_trustdb_dialog (keylist);
+  if (keylist->snapshot_rows)
+    {
+      g_hash_table_destroy (keylist->snapshot_rows);
+      keylist->snapshot_rows = NULL;
+      gtk_widget_set_sensitive (GTK_WIDGET (keylist), TRUE);
+    }
+  keylist->snapshot_dirty = TRUE;
+  keylist->listing = TRUE;
+  flush_pending_keys (keylist);
+  gpa_keylist_model_clear (GPA_KEYLIST_MODEL (get_model (keylist)));
 
   gpa_keytable_force_reload (gpa_keytable_get_public_instance (),
 			     gpa_keylist_next, gpa_keylist_end, keylist);
 }
 
 
+/* Update the keys with the fingerprints given by the NULL terminated
+   array FPRS.  Only these keys are listed again and their rows are
+   updated, added or removed as needed.  If WITH_SECRET is set, the
+   secret keys are reloaded as well.  */
+void
+gpa_keylist_update_keys (GpaKeyList *keylist, const char **fprs,
+                         gboolean with_secret)
+{
+  int idx;
+
+  for (idx = 0; fprs[idx]; idx++)
+    g_hash_table_replace (keylist->update_queue,
+                          g_strdup (fprs[idx]), NULL);
+  if (with_secret)
+    keylist->update_secret = TRUE;
+
+  if (!keylist->update_fprs && g_hash_table_size (keylist->update_queue))
+    start_update (keylist);
+}
+
+
+/* Remove the rows of the keys with the fingerprints given by the
+   NULL terminated array FPRS, and these keys from the keytables.
+   Nothing needs to be listed for that.  */
+void
+gpa_keylist_remove_keys (GpaKeyList *keylist, const char **fprs)
+{
+  GtkTreeModel *model = get_model (keylist);
+  GtkTreeIter iter;
+  GHashTable *todo;
+  GList *rows = NULL, *item;
+  gboolean valid;
+  int idx;
+
+  g_return_if_fail (fprs != NULL);
+
+  gpa_keytable_remove_keys (gpa_keytable_get_public_instance (), fprs);
+  gpa_keytable_remove_keys (gpa_keytable_get_secret_instance (), fprs);
+
+  todo = g_hash_table_new (g_str_hash, g_str_equal);
+  for (idx = 0; fprs[idx]; idx++)
+    g_hash_table_insert (todo, (gpointer) fprs[idx], (gpointer) fprs[idx]);
+
+  for (valid = gtk_tree_model_get_iter_first (model, &iter); valid;
+       valid = gtk_tree_model_iter_next (model, &iter))
+    {
+      gpgme_key_t key;
+
+      gtk_tree_model_get (model, &iter, GPA_KEYLIST_COLUMN_KEY, &key, -1);
+      if (key && key->subkeys && key->subkeys->fpr
+          && g_hash_table_lookup (todo, key->subkeys->fpr))
+        rows = g_list_prepend (rows, gtk_tree_iter_copy (&iter));
+    }
+  g_hash_table_destroy (todo);
+
+  for (item = rows; item; item = g_list_next (item))
+    {
+      gpa_keylist_model_remove (GPA_KEYLIST_MODEL (model), item->data);
+      gtk_tree_iter_free (item->data);
+    }
+
+  if (rows)
+    {
+      g_list_free (rows);
+      schedule_snapshot (keylist);
+    }
+}
+
+
+/* Update the validity of all rows after VALIDITY_DELAY seconds.  The
+   public keys are listed again but only the rows whose validity has
+   changed are updated.  Further calls until then do not start another
+   pass.  */
+void
+gpa_keylist_refresh_validity (GpaKeyList *keylist)
+{
+  if (keylist->disposed || keylist->validity_timeout_id)
+    return;
+
+  keylist->validity_timeout_id
+    = g_timeout_add_seconds (VALIDITY_DELAY, validity_timeout_cb, keylist);
+}
+
+
 /* Let the keylist know that a new key with the given fingerprint is
    available.  */
 void
 gpa_keylist_new_key (GpaKeyList * keylist, const char *fpr)
 {
-  /* FIXME: I don't understand the code.  Investigate this and
-     implement public_only.  */
+  const char *fprs[2];
 
-  add_trustdb_dialog (keylist);
-  gpa_keytable_load_new (gpa_keytable_get_secret_instance (), fpr,
-			 NULL, (GpaKeyTableEndFunc) gtk_main_quit, NULL);
-  /* Hack. Turn the asynchronous listing into a synchronous one */
-  gtk_main ();
-  remove_trustdb_dialog (keylist);
-  /* The trustdb seems not to be updated for a --list-secret, so we
-   * cdisplay the dialog both times, just in case */
-  add_trustdb_dialog (keylist);
-  gpa_keytable_load_new (gpa_keytable_get_public_instance (), fpr,
-			 gpa_keylist_next, gpa_keylist_end, keylist);
+  if (!fpr)
+    {
+      /* We don't know the new key; reload everything.  */
+      gpa_keylist_imported_secret_key (keylist);
+      return;
+    }
+
+  fprs[0] = fpr;
+  fprs[1] = NULL;
+  gpa_keylist_update_keys (keylist, fprs, TRUE);
 }
 
 
-/* Let the keylist know that a new sceret key has been imported. */
-void
-gpa_keylist_imported_secret_key (GpaKeyList *keylist)
+/* The secret keys have been reloaded; now reload the list.  */
+static void
+imported_secret_key_end (gpointer data)
 {
-  /* KEYLIST is currently not used. */
+  GpaKeyList *keylist = data;
 
-  gpa_keytable_load_new (gpa_keytable_get_secret_instance (), NULL,
-			 NULL, (GpaKeyTableEndFunc) gtk_main_quit, NULL);
-  /* Hack. Turn the asynchronous listing into a synchronous one */
-  /* FIXME:  Does that work well with the server shutdown code? */
-  gtk_main ();
+  if (!keylist->disposed)
+    gpa_keylist_start_reload (keylist);
+  g_object_unref (keylist);
 }
 
 
+/* Let the keylist know that a new secret key has been imported.  This
+   reloads the secret keys and then the entire list.  */
+void
+gpa_keylist_imported_secret_key (GpaKeyList *keylist)
+{
+  /* Keep the list alive until the listing has finished.  */
+  g_object_ref (keylist);
+  gpa_keytable_force_reload (gpa_keytable_get_secret_instance (),
+			     NULL, imported_secret_key_end, keylist);
+}
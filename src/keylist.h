@@ -40,12 +40,6 @@ struct _GpaKeyList {
   gboolean secret;
   /* Parent window for dialogs */
   GtkWidget *window;
-  /* Keys loaded into the model */
-  GList *keys;
-  /* Dialog for warning about a trustdb rebuilding */
-  GtkWidget *dialog;
-  /* ID of the timeout that displays the dialog */
-  guint timeout_id;
 
   /* Private: Do not use!  FIXME: We should hide all instance
      variables.  */
@@ -56,6 +50,40 @@ struct _GpaKeyList {
   int requested_usage;
   gboolean only_usable_keys;
 
+  /* Fingerprints of keys to be updated by the next update run.  */
+  GHashTable *update_queue;
+  /* Reload the secret keys too in the next update run.  */
+  gboolean update_secret;
+  /* NULL terminated array with the fingerprints of the keys being
+     updated, or NULL if no update is running.  */
+  gchar **update_fprs;
+
+  /* Keep the key cache file in sync with the list.  */
+  gboolean use_snapshot;
+  /* The key cache file needs to be written.  */
+  gboolean snapshot_dirty;
+  /* ID of the timeout writing the key cache file.  */
+  guint snapshot_timeout_id;
+  /* A listing of all keys is running; the key cache file is written
+     when it has finished.  */
+  gboolean listing;
+  /* Maps the fingerprints of rows loaded from the key cache to their
+     iters, as long as the real key has not yet been listed.  */
+  GHashTable *snapshot_rows;
+
+  /* Keys delivered by the keytable but not yet inserted.  */
+  GQueue *pending_keys;
+  /* ID of the idle handler inserting the pending keys.  */
+  guint insert_idle_id;
+  /* The listing has finished; finish it once all pending keys have
+     been inserted.  */
+  gboolean end_pending;
+  /* The model while it is detached from the view during bulk
+     loading.  */
+  GtkTreeModel *detached_model;
+  /* ID of the timeout starting the deferred validity pass.  */
+  guint validity_timeout_id;
+
   int disposed;
 };
 
@@ -90,6 +118,10 @@ GpaKeyList *gpa_keylist_new_with_keys (GtkWidget *window,
                                        int requested_usage,
                                        gboolean only_usable_keys);
 
+/* Show the rows from the key cache file until the real listing has
+   finished and keep that file up to date.  */
+void gpa_keylist_use_snapshot (GpaKeyList *keylist);
+
 /* Set the key list in "brief" mode.  */
 void gpa_keylist_set_brief (GpaKeyList * keylist);
 
@@ -117,11 +149,24 @@ gpgme_key_t gpa_keylist_get_selected_key (GpaKeyList *keylist);
 /* Begin a reload of the keyring. */
 void gpa_keylist_start_reload (GpaKeyList * keylist);
 
+/* Update only the keys with the given fingerprints.  */
+void gpa_keylist_update_keys (GpaKeyList *keylist, const char **fprs,
+                              gboolean with_secret);
+
+/* Remove the rows of the keys with the given fingerprints.  This is
+   used after these keys have been deleted.  */
+void gpa_keylist_remove_keys (GpaKeyList *keylist, const char **fprs);
+
+/* Update the validity of all rows after a while.  Changing the trust
+   or the signatures of keys may change the validity of other keys.  */
+void gpa_keylist_refresh_validity (GpaKeyList *keylist);
+
 /* Let the keylist know that a new key with the given fingerprint is
    available. */
 void gpa_keylist_new_key (GpaKeyList * keylist, const char *fpr);
 
-/* Let the keylist know that a new sceret key has been imported.  */
+/* Let the keylist know that a new secret key has been imported.  This
+   reloads the secret keys and then the entire list.  */
 void gpa_keylist_imported_secret_key (GpaKeyList * keylist);
 
 
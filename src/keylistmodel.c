@@ -0,0 +1,1046 @@
+/* keylistmodel.c - The tree model of the key list.
+   Copyright (C) 2026 g10 Code GmbH.
+
+   This file is part of GPA
+
+   GPA is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   GPA is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+   License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.  */
+
+#include <config.h>
+
+#include "gpa.h"
+#include "convert.h"
+#include "gpgmetools.h"
+#include "keytable.h"
+#include "icons.h"
+#include "format-dn.h"
+#include "keylistmodel.h"
+
+
+/* The number of rows for which the formatted strings are cached.
+   This should be larger than the number of rows visible at once.  */
+#define FORMATTED_CACHE_SIZE 256
+
+
+/* Object's class definition.  */
+struct _GpaKeyListModelClass
+{
+  GObjectClass parent_class;
+};
+
+
+/* Object definition.  */
+struct _GpaKeyListModel
+{
+  GObject parent_instance;
+
+  /* Used to detect iters of another model or a stale model.  */
+  gint stamp;
+
+  /* The rows; each item is a struct row_s.  */
+  GSequence *rows;
+
+  /* The cache of formatted strings.  The queue holds struct
+     formatted_s items with the most recently used one at the head.
+     The index maps rows to their links in the queue.  */
+  GQueue *formatted;
+  GHashTable *formatted_index;
+
+  /* The sort order.  */
+  gint sort_column_id;
+  GtkSortType sort_order;
+};
+
+
+/* A row of the model.  */
+struct row_s
+{
+  /* The key or NULL for a row taken from the key cache.  */
+  gpgme_key_t key;
+
+  /* The values of a row taken from the key cache or NULL.  */
+  struct gpa_keycache_row_s *cached;
+
+  /* The position of the row before sorting.  */
+  gint old_pos;
+
+  /* The collation key of the string in the sort column or NULL if it
+     has not yet been computed.  */
+  gchar *sort_key;
+};
+
+
+/* The strings of a row which are expensive to compute.  */
+struct formatted_s
+{
+  struct row_s *row;
+  gchar *userid;
+  gchar *created;
+  gchar *expiry;
+};
+
+
+/* The parent class.  */
+static GObjectClass *parent_class;
+
+/* The column types.  */
+static GType column_types[GPA_KEYLIST_N_COLUMNS];
+
+
+
+/* Local prototypes */
+static void gpa_keylist_model_finalize (GObject *object);
+
+
+
+/************************************************************
+ *******************   Implementation   *********************
+ ************************************************************/
+
+/* For keys, gpg can't cope with, the fingerprint is set to all
+   zero. This helper function returns true for such a FPR. */
+static int
+is_zero_fpr (const char *fpr)
+{
+  for (; *fpr; fpr++)
+    if (*fpr != '0')
+      return 0;
+  return 1;
+}
+
+
+static const gchar *
+get_key_pixbuf (gpgme_key_t key)
+{
+  gpgme_key_t seckey;
+
+  seckey = gpa_keytable_lookup_key (gpa_keytable_get_secret_instance (),
+                                    key->subkeys->fpr);
+  if (seckey)
+    {
+      if (seckey->subkeys && seckey->subkeys->is_cardkey)
+        return GPA_STOCK_SECRET_CARDKEY;
+      return GPA_STOCK_SECRET_KEY;
+    }
+  else
+    return GPA_STOCK_PUBLIC_KEY;
+}
+
+
+static void
+release_formatted (struct formatted_s *fmt)
+{
+  g_free (fmt->userid);
+  g_free (fmt->created);
+  g_free (fmt->expiry);
+  g_free (fmt);
+}
+
+
+/* Return the formatted strings for ROW.  */
+static struct formatted_s *
+get_formatted (GpaKeyListModel *model, struct row_s *row)
+{
+  GList *link;
+  struct formatted_s *fmt;
+  gpgme_key_t key = row->key;
+
+  link = g_hash_table_lookup (model->formatted_index, row);
+  if (link)
+    {
+      /* Move it to the head of the queue.  */
+      g_queue_unlink (model->formatted, link);
+      g_queue_push_head_link (model->formatted, link);
+      return link->data;
+    }
+
+  fmt = g_malloc0 (sizeof *fmt);
+  fmt->row = row;
+  if (key->protocol == GPGME_PROTOCOL_CMS)
+    fmt->userid = gpa_format_dn (key->uids? key->uids->uid : NULL);
+  else
+    fmt->userid = gpa_gpgme_key_get_userid (key->uids);
+  fmt->created = gpa_creation_date_string (key->subkeys->timestamp);
+  fmt->expiry = gpa_expiry_date_string (key->subkeys->expires);
+
+  g_queue_push_head (model->formatted, fmt);
+  g_hash_table_insert (model->formatted_index, row,
+                       g_queue_peek_head_link (model->formatted));
+
+  /* Expire the least recently used entry.  */
+  if (g_queue_get_length (model->formatted) > FORMATTED_CACHE_SIZE)
+    {
+      fmt = g_queue_pop_tail (model->formatted);
+      g_hash_table_remove (model->formatted_index, fmt->row);
+      release_formatted (fmt);
+      fmt = g_queue_peek_head (model->formatted);
+    }
+
+  return fmt;
+}
+
+
+/* Remove the formatted strings of ROW from the cache.  */
+static void
+forget_formatted (GpaKeyListModel *model, struct row_s *row)
+{
+  GList *link;
+
+  link = g_hash_table_lookup (model->formatted_index, row);
+  if (!link)
+    return;
+  g_hash_table_remove (model->formatted_index, row);
+  release_formatted (link->data);
+  g_queue_delete_link (model->formatted, link);
+}
+
+
+static void
+release_cached (struct gpa_keycache_row_s *cached)
+{
+  if (!cached)
+    return;
+  g_free ((char *) cached->fpr);
+  g_free ((char *) cached->keytype);
+  g_free ((char *) cached->created);
+  g_free ((char *) cached->expiry);
+  g_free ((char *) cached->ownertrust);
+  g_free ((char *) cached->validity);
+  g_free ((char *) cached->userid);
+  g_free (cached);
+}
+
+
+static void
+release_row (struct row_s *row)
+{
+  if (row->key)
+    gpgme_key_unref (row->key);
+  release_cached (row->cached);
+  g_free (row->sort_key);
+  g_free (row);
+}
+
+
+/* Store the value of COLUMN of ROW in VALUE, which must already be
+   initialized to the column type.  */
+static void
+row_get_value (GpaKeyListModel *model, struct row_s *row, gint column,
+               GValue *value)
+{
+  gpgme_key_t key = row->key;
+  struct gpa_keycache_row_s *cached = row->cached;
+
+  if (!key)
+    {
+      if (!cached)
+        return;
+      switch (column)
+        {
+        case GPA_KEYLIST_COLUMN_IMAGE:
+          if (cached->flags & GPA_KEYCACHE_FLAG_CARDKEY)
+            g_value_set_static_string (value, GPA_STOCK_SECRET_CARDKEY);
+          else if (cached->flags & GPA_KEYCACHE_FLAG_SECRET)
+            g_value_set_static_string (value, GPA_STOCK_SECRET_KEY);
+          else
+            g_value_set_static_string (value, GPA_STOCK_PUBLIC_KEY);
+          break;
+        case GPA_KEYLIST_COLUMN_KEYTYPE:
+          g_value_set_string (value, cached->keytype);
+          break;
+        case GPA_KEYLIST_COLUMN_CREATED:
+          g_value_set_string (value, cached->created);
+          break;
+        case GPA_KEYLIST_COLUMN_EXPIRY:
+          g_value_set_string (value, cached->expiry);
+          break;
+        case GPA_KEYLIST_COLUMN_OWNERTRUST:
+          g_value_set_string (value, cached->ownertrust);
+          break;
+        case GPA_KEYLIST_COLUMN_VALIDITY:
+          g_value_set_string (value, cached->validity);
+          break;
+        case GPA_KEYLIST_COLUMN_USERID:
+          g_value_set_string (value, cached->userid);
+          break;
+        case GPA_KEYLIST_COLUMN_KEY:
+          g_value_set_pointer (value, NULL);
+          break;
+        case GPA_KEYLIST_COLUMN_HAS_SECRET:
+          g_value_set_int (value, !!(cached->flags & GPA_KEYCACHE_FLAG_SECRET));
+          break;
+        case GPA_KEYLIST_COLUMN_CREATED_TS:
+          g_value_set_ulong (value, cached->created_ts);
+          break;
+        case GPA_KEYLIST_COLUMN_EXPIRY_TS:
+          g_value_set_ulong (value, cached->expiry_ts);
+          break;
+        case GPA_KEYLIST_COLUMN_OWNERTRUST_VALUE:
+          g_value_set_ulong (value, cached->ownertrust_value);
+          break;
+        case GPA_KEYLIST_COLUMN_VALIDITY_VALUE:
+          g_value_set_long (value, cached->validity_value);
+          break;
+        }
+      return;
+    }
+
+  switch (column)
+    {
+    case GPA_KEYLIST_COLUMN_IMAGE:
+      g_value_set_static_string (value, get_key_pixbuf (key));
+      break;
+    case GPA_KEYLIST_COLUMN_KEYTYPE:
+      g_value_set_static_string
+        (value, (key->protocol == GPGME_PROTOCOL_OpenPGP? "P" :
+                 key->protocol == GPGME_PROTOCOL_CMS? "X" : "?"));
+      break;
+    case GPA_KEYLIST_COLUMN_CREATED:
+      g_value_set_string (value, get_formatted (model, row)->created);
+      break;
+    case GPA_KEYLIST_COLUMN_EXPIRY:
+      g_value_set_string (value, get_formatted (model, row)->expiry);
+      break;
+    case GPA_KEYLIST_COLUMN_OWNERTRUST:
+      g_value_set_string (value, gpa_key_ownertrust_string (key));
+      break;
+    case GPA_KEYLIST_COLUMN_VALIDITY:
+      g_value_set_string (value, gpa_key_validity_string (key));
+      break;
+    case GPA_KEYLIST_COLUMN_USERID:
+      g_value_set_string (value, get_formatted (model, row)->userid);
+      break;
+    case GPA_KEYLIST_COLUMN_KEY:
+      g_value_set_pointer (value, key);
+      break;
+    case GPA_KEYLIST_COLUMN_HAS_SECRET:
+      g_value_set_int (value,
+                       (!is_zero_fpr (key->subkeys->fpr)
+                        && gpa_keytable_lookup_key
+                        (gpa_keytable_get_secret_instance (),
+                         key->subkeys->fpr)));
+      break;
+    case GPA_KEYLIST_COLUMN_CREATED_TS:
+      g_value_set_ulong (value, key->subkeys->timestamp);
+      break;
+    case GPA_KEYLIST_COLUMN_EXPIRY_TS:
+      /* Set "no expiration" to a large value for sorting */
+      g_value_set_ulong (value, (key->subkeys->expires ?
+                                 key->subkeys->expires : G_MAXULONG));
+      break;
+    case GPA_KEYLIST_COLUMN_OWNERTRUST_VALUE:
+      g_value_set_ulong (value, key->owner_trust);
+      break;
+    case GPA_KEYLIST_COLUMN_VALIDITY_VALUE:
+      /* Set an appropiate value for sorting revoked and expired
+       * keys. This includes a hack for forcing a value to a range
+       * outside the usual validity values */
+      if (key->subkeys->revoked)
+        g_value_set_long (value, GPGME_VALIDITY_UNKNOWN-2);
+      else if (key->subkeys->expired)
+        g_value_set_long (value, GPGME_VALIDITY_UNKNOWN-1);
+      else if (key->uids)
+        g_value_set_long (value, key->uids->validity);
+      else
+        g_value_set_long (value, GPGME_VALIDITY_UNKNOWN);
+      break;
+    }
+}
+
+
+/* Return the collation key for the string in the sort column of
+   ROW.  The strings are formatted directly so that sorting does not
+   push the rows on screen out of the cache of formatted strings.  */
+static const gchar *
+get_sort_key (GpaKeyListModel *model, struct row_s *row)
+{
+  gint column = model->sort_column_id;
+  gpgme_key_t key = row->key;
+  gchar *str = NULL;
+
+  if (row->sort_key)
+    return row->sort_key;
+
+  if (key && column == GPA_KEYLIST_COLUMN_USERID)
+    {
+      if (key->protocol == GPGME_PROTOCOL_CMS)
+        str = gpa_format_dn (key->uids? key->uids->uid : NULL);
+      else
+        str = gpa_gpgme_key_get_userid (key->uids);
+    }
+  else if (key && column == GPA_KEYLIST_COLUMN_CREATED)
+    str = gpa_creation_date_string (key->subkeys->timestamp);
+  else if (key && column == GPA_KEYLIST_COLUMN_EXPIRY)
+    str = gpa_expiry_date_string (key->subkeys->expires);
+  else
+    {
+      GValue value = {0};
+
+      g_value_init (&value, G_TYPE_STRING);
+      row_get_value (model, row, column, &value);
+      str = g_value_dup_string (&value);
+      g_value_unset (&value);
+    }
+
+  /* A missing string sorts before all others.  */
+  row->sort_key = g_utf8_collate_key (str? str : "", -1);
+  g_free (str);
+  return row->sort_key;
+}
+
+
+/* Helper for sortable_set_sort_column_id.  */
+static void
+forget_sort_key (gpointer data, gpointer user_data)
+{
+  struct row_s *row = data;
+
+  g_free (row->sort_key);
+  row->sort_key = NULL;
+}
+
+
+/* Compare two rows according to the sort order of MODEL.  */
+static gint
+compare_rows (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+  GpaKeyListModel *model = user_data;
+  gint column = model->sort_column_id;
+  GValue value_a = {0};
+  GValue value_b = {0};
+  gint result = 0;
+
+  if (column < 0 || column >= GPA_KEYLIST_N_COLUMNS
+      || column == GPA_KEYLIST_COLUMN_KEY)
+    return 0;
+
+  if (G_TYPE_FUNDAMENTAL (column_types[column]) == G_TYPE_STRING)
+    {
+      result = strcmp (get_sort_key (model, (struct row_s *) a),
+                       get_sort_key (model, (struct row_s *) b));
+      if (model->sort_order == GTK_SORT_DESCENDING)
+        result = -result;
+      return result;
+    }
+
+  g_value_init (&value_a, column_types[column]);
+  g_value_init (&value_b, column_types[column]);
+  row_get_value (model, (struct row_s *) a, column, &value_a);
+  row_get_value (model, (struct row_s *) b, column, &value_b);
+
+  switch (G_TYPE_FUNDAMENTAL (column_types[column]))
+    {
+    case G_TYPE_INT:
+      result = (g_value_get_int (&value_a) < g_value_get_int (&value_b)? -1 :
+                g_value_get_int (&value_a) > g_value_get_int (&value_b));
+      break;
+    case G_TYPE_ULONG:
+      result = (g_value_get_ulong (&value_a) < g_value_get_ulong (&value_b)?
+                -1 : g_value_get_ulong (&value_a)
+                > g_value_get_ulong (&value_b));
+      break;
+    case G_TYPE_LONG:
+      result = (g_value_get_long (&value_a) < g_value_get_long (&value_b)?
+                -1 : g_value_get_long (&value_a)
+                > g_value_get_long (&value_b));
+      break;
+    }
+  g_value_unset (&value_a);
+  g_value_unset (&value_b);
+
+  if (model->sort_order == GTK_SORT_DESCENDING)
+    result = -result;
+  return result;
+}
+
+
+static gboolean
+is_sorted (GpaKeyListModel *model)
+{
+  return model->sort_column_id >= 0;
+}
+
+
+/* Helper for resort.  */
+static void
+set_old_pos (gpointer data, gpointer user_data)
+{
+  struct row_s *row = data;
+  gint *pos = user_data;
+
+  row->old_pos = (*pos)++;
+}
+
+
+/* Sort all rows and tell the view about the new order.  */
+static void
+resort (GpaKeyListModel *model)
+{
+  GSequenceIter *seqiter;
+  GtkTreePath *path;
+  gint *new_order;
+  gint pos, length;
+
+  length = g_sequence_get_length (model->rows);
+  if (!is_sorted (model) || length < 2)
+    return;
+
+  pos = 0;
+  g_sequence_foreach (model->rows, set_old_pos, &pos);
+  g_sequence_sort (model->rows, compare_rows, model);
+
+  new_order = g_new (gint, length);
+  pos = 0;
+  for (seqiter = g_sequence_get_begin_iter (model->rows);
+       !g_sequence_iter_is_end (seqiter);
+       seqiter = g_sequence_iter_next (seqiter))
+    {
+      struct row_s *row = g_sequence_get (seqiter);
+
+      new_order[pos++] = row->old_pos;
+    }
+
+  path = gtk_tree_path_new ();
+  gtk_tree_model_rows_reordered (GTK_TREE_MODEL (model), path, NULL,
+                                 new_order);
+  gtk_tree_path_free (path);
+  g_free (new_order);
+}
+
+
+/* Insert ROW and emit the "row-inserted" signal.  */
+static void
+insert_row (GpaKeyListModel *model, struct row_s *row, GtkTreeIter *r_iter)
+{
+  GtkTreeIter iter;
+  GtkTreePath *path;
+
+  iter.stamp = model->stamp;
+  if (is_sorted (model))
+    iter.user_data = g_sequence_insert_sorted (model->rows, row,
+                                               compare_rows, model);
+  else
+    iter.user_data = g_sequence_append (model->rows, row);
+
+  path = gtk_tree_path_new_from_indices
+    (g_sequence_iter_get_position (iter.user_data), -1);
+  gtk_tree_model_row_inserted (GTK_TREE_MODEL (model), path, &iter);
+  gtk_tree_path_free (path);
+
+  if (r_iter)
+    *r_iter = iter;
+}
+
+
+
+/************************************************************
+ *****************   GtkTreeModel interface   ***************
+ ************************************************************/
+
+static GtkTreeModelFlags
+model_get_flags (GtkTreeModel *tree_model)
+{
+  return GTK_TREE_MODEL_ITERS_PERSIST | GTK_TREE_MODEL_LIST_ONLY;
+}
+
+
+static gint
+model_get_n_columns (GtkTreeModel *tree_model)
+{
+  return GPA_KEYLIST_N_COLUMNS;
+}
+
+
+static GType
+model_get_column_type (GtkTreeModel *tree_model, gint index)
+{
+  g_return_val_if_fail (index >= 0 && index < GPA_KEYLIST_N_COLUMNS,
+                        G_TYPE_INVALID);
+
+  return column_types[index];
+}
+
+
+static gboolean
+model_iter_nth_child (GtkTreeModel *tree_model, GtkTreeIter *iter,
+                      GtkTreeIter *parent, gint n)
+{
+  GpaKeyListModel *model = GPA_KEYLIST_MODEL (tree_model);
+
+  iter->stamp = 0;
+  if (parent || n < 0 || n >= g_sequence_get_length (model->rows))
+    return FALSE;
+
+  iter->stamp = model->stamp;
+  iter->user_data = g_sequence_get_iter_at_pos (model->rows, n);
+  return TRUE;
+}
+
+
+static gboolean
+model_get_iter (GtkTreeModel *tree_model, GtkTreeIter *iter,
+                GtkTreePath *path)
+{
+  iter->stamp = 0;
+  if (gtk_tree_path_get_depth (path) != 1)
+    return FALSE;
+
+  return model_iter_nth_child (tree_model, iter, NULL,
+                               gtk_tree_path_get_indices (path)[0]);
+}
+
+
+static GtkTreePath *
+model_get_path (GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+  GpaKeyListModel *model = GPA_KEYLIST_MODEL (tree_model);
+
+  g_return_val_if_fail (iter->stamp == model->stamp, NULL);
+
+  if (g_sequence_iter_is_end (iter->user_data))
+    return NULL;
+  return gtk_tree_path_new_from_indices
+    (g_sequence_iter_get_position (iter->user_data), -1);
+}
+
+
+static void
+model_get_value (GtkTreeModel *tree_model, GtkTreeIter *iter, gint column,
+                 GValue *value)
+{
+  GpaKeyListModel *model = GPA_KEYLIST_MODEL (tree_model);
+
+  g_return_if_fail (column >= 0 && column < GPA_KEYLIST_N_COLUMNS);
+  g_return_if_fail (iter->stamp == model->stamp);
+
+  g_value_init (value, column_types[column]);
+  row_get_value (model, g_sequence_get (iter->user_data), column, value);
+}
+
+
+static gboolean
+model_iter_next (GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+  GpaKeyListModel *model = GPA_KEYLIST_MODEL (tree_model);
+
+  g_return_val_if_fail (iter->stamp == model->stamp, FALSE);
+
+  iter->user_data = g_sequence_iter_next (iter->user_data);
+  if (g_sequence_iter_is_end (iter->user_data))
+    {
+      iter->stamp = 0;
+      return FALSE;
+    }
+  return TRUE;
+}
+
+
+static gboolean
+model_iter_children (GtkTreeModel *tree_model, GtkTreeIter *iter,
+                     GtkTreeIter *parent)
+{
+  return model_iter_nth_child (tree_model, iter, parent, 0);
+}
+
+
+static gboolean
+model_iter_has_child (GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+  return FALSE;
+}
+
+
+static gint
+model_iter_n_children (GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+  GpaKeyListModel *model = GPA_KEYLIST_MODEL (tree_model);
+
+  if (iter)
+    return 0;
+  return g_sequence_get_length (model->rows);
+}
+
+
+static gboolean
+model_iter_parent (GtkTreeModel *tree_model, GtkTreeIter *iter,
+                   GtkTreeIter *child)
+{
+  iter->stamp = 0;
+  return FALSE;
+}
+
+
+static void
+gpa_keylist_model_tree_model_init (GtkTreeModelIface *iface)
+{
+  iface->get_flags = model_get_flags;
+  iface->get_n_columns = model_get_n_columns;
+  iface->get_column_type = model_get_column_type;
+  iface->get_iter = model_get_iter;
+  iface->get_path = model_get_path;
+  iface->get_value = model_get_value;
+  iface->iter_next = model_iter_next;
+  iface->iter_children = model_iter_children;
+  iface->iter_has_child = model_iter_has_child;
+  iface->iter_n_children = model_iter_n_children;
+  iface->iter_nth_child = model_iter_nth_child;
+  iface->iter_parent = model_iter_parent;
+}
+
+
+
+/************************************************************
+ ***************   GtkTreeSortable interface   **************
+ ************************************************************/
+
+static gboolean
+sortable_get_sort_column_id (GtkTreeSortable *sortable,
+                             gint *sort_column_id, GtkSortType *order)
+{
+  GpaKeyListModel *model = GPA_KEYLIST_MODEL (sortable);
+
+  if (sort_column_id)
+    *sort_column_id = model->sort_column_id;
+  if (order)
+    *order = model->sort_order;
+  return is_sorted (model);
+}
+
+
+static void
+sortable_set_sort_column_id (GtkTreeSortable *sortable,
+                             gint sort_column_id, GtkSortType order)
+{
+  GpaKeyListModel *model = GPA_KEYLIST_MODEL (sortable);
+
+  if (model->sort_column_id == sort_column_id && model->sort_order == order)
+    return;
+  if (sort_column_id >= GPA_KEYLIST_N_COLUMNS
+      || sort_column_id == GPA_KEYLIST_COLUMN_KEY
+      || sort_column_id == GTK_TREE_SORTABLE_DEFAULT_SORT_COLUMN_ID)
+    {
+      g_warning ("%s: column %d can't be used for sorting",
+                 G_STRFUNC, sort_column_id);
+      return;
+    }
+
+  if (model->sort_column_id != sort_column_id)
+    g_sequence_foreach (model->rows, forget_sort_key, NULL);
+  model->sort_column_id = sort_column_id;
+  model->sort_order = order;
+  gtk_tree_sortable_sort_column_changed (sortable);
+  resort (model);
+}
+
+
+static void
+sortable_set_sort_func (GtkTreeSortable *sortable, gint sort_column_id,
+                        GtkTreeIterCompareFunc func, gpointer data,
+                        GDestroyNotify destroy)
+{
+  g_warning ("%s: custom sort functions are not supported", G_STRFUNC);
+}
+
+
+static void
+sortable_set_default_sort_func (GtkTreeSortable *sortable,
+                                GtkTreeIterCompareFunc func, gpointer data,
+                                GDestroyNotify destroy)
+{
+  g_warning ("%s: custom sort functions are not supported", G_STRFUNC);
+}
+
+
+static gboolean
+sortable_has_default_sort_func (GtkTreeSortable *sortable)
+{
+  return FALSE;
+}
+
+
+static void
+gpa_keylist_model_sortable_init (GtkTreeSortableIface *iface)
+{
+  iface->get_sort_column_id = sortable_get_sort_column_id;
+  iface->set_sort_column_id = sortable_set_sort_column_id;
+  iface->set_sort_func = sortable_set_sort_func;
+  iface->set_default_sort_func = sortable_set_default_sort_func;
+  iface->has_default_sort_func = sortable_has_default_sort_func;
+}
+
+
+
+/************************************************************
+ ******************   Object Management  ********************
+ ************************************************************/
+
+static void
+gpa_keylist_model_class_init (void *class_ptr, void *class_data)
+{
+  GpaKeyListModelClass *klass = class_ptr;
+
+  parent_class = g_type_class_peek_parent (klass);
+
+  G_OBJECT_CLASS (klass)->finalize = gpa_keylist_model_finalize;
+
+  column_types[GPA_KEYLIST_COLUMN_IMAGE] = G_TYPE_STRING;
+  column_types[GPA_KEYLIST_COLUMN_KEYTYPE] = G_TYPE_STRING;
+  column_types[GPA_KEYLIST_COLUMN_CREATED] = G_TYPE_STRING;
+  column_types[GPA_KEYLIST_COLUMN_EXPIRY] = G_TYPE_STRING;
+  column_types[GPA_KEYLIST_COLUMN_OWNERTRUST] = G_TYPE_STRING;
+  column_types[GPA_KEYLIST_COLUMN_VALIDITY] = G_TYPE_STRING;
+  column_types[GPA_KEYLIST_COLUMN_USERID] = G_TYPE_STRING;
+  column_types[GPA_KEYLIST_COLUMN_KEY] = G_TYPE_POINTER;
+  column_types[GPA_KEYLIST_COLUMN_HAS_SECRET] = G_TYPE_INT;
+  column_types[GPA_KEYLIST_COLUMN_CREATED_TS] = G_TYPE_ULONG;
+  column_types[GPA_KEYLIST_COLUMN_EXPIRY_TS] = G_TYPE_ULONG;
+  column_types[GPA_KEYLIST_COLUMN_OWNERTRUST_VALUE] = G_TYPE_ULONG;
+  column_types[GPA_KEYLIST_COLUMN_VALIDITY_VALUE] = G_TYPE_LONG;
+}
+
+
+static void
+gpa_keylist_model_init (GTypeInstance *instance, void *class_ptr)
+{
+  GpaKeyListModel *model = GPA_KEYLIST_MODEL (instance);
+
+  do
+    model->stamp = g_random_int ();
+  while (!model->stamp);
+  model->rows = g_sequence_new ((GDestroyNotify) release_row);
+  model->formatted = g_queue_new ();
+  model->formatted_index = g_hash_table_new (g_direct_hash, g_direct_equal);
+  model->sort_column_id = GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID;
+  model->sort_order = GTK_SORT_ASCENDING;
+}
+
+
+static void
+gpa_keylist_model_finalize (GObject *object)
+{
+  GpaKeyListModel *model = GPA_KEYLIST_MODEL (object);
+
+  g_hash_table_destroy (model->formatted_index);
+  g_queue_foreach (model->formatted, (GFunc) release_formatted, NULL);
+  g_queue_free (model->formatted);
+  g_sequence_free (model->rows);
+
+  parent_class->finalize (object);
+}
+
+
+/* Construct the class.  */
+GType
+gpa_keylist_model_get_type (void)
+{
+  static GType this_type = 0;
+
+  if (!this_type)
+    {
+      static const GTypeInfo this_info =
+	{
+	  sizeof (GpaKeyListModelClass),
+	  (GBaseInitFunc) NULL,
+	  (GBaseFinalizeFunc) NULL,
+	  gpa_keylist_model_class_init,
+	  (GClassFinalizeFunc) NULL,
+	  NULL, /* class_data */
+	  sizeof (GpaKeyListModel),
+	  0,    /* n_preallocs */
+	  gpa_keylist_model_init
+	};
+      static const GInterfaceInfo tree_model_info =
+        {
+          (GInterfaceInitFunc) gpa_keylist_model_tree_model_init,
+          NULL,
+          NULL
+        };
+      static const GInterfaceInfo sortable_info =
+        {
+          (GInterfaceInitFunc) gpa_keylist_model_sortable_init,
+          NULL,
+          NULL
+        };
+
+      this_type = g_type_register_static (G_TYPE_OBJECT,
+                                          "GpaKeyListModel",
+                                          &this_info, 0);
+      g_type_add_interface_static (this_type, GTK_TYPE_TREE_MODEL,
+                                   &tree_model_info);
+      g_type_add_interface_static (this_type, GTK_TYPE_TREE_SORTABLE,
+                                   &sortable_info);
+    }
+
+  return this_type;
+}
+
+
+
+/************************************************************
+ **********************  Public API  ************************
+ ************************************************************/
+
+/* Create a new empty key list model.  */
+GpaKeyListModel *
+gpa_keylist_model_new (void)
+{
+  return g_object_new (GPA_KEYLIST_MODEL_TYPE, NULL);
+}
+
+
+/* Append a row for KEY and store its iter at ITER unless ITER is
+   NULL.  If the model is sorted, the row is inserted at its sorted
+   position.  This function takes ownership of KEY.  */
+void
+gpa_keylist_model_append (GpaKeyListModel *model, gpgme_key_t key,
+                          GtkTreeIter *iter)
+{
+  struct row_s *row;
+
+  g_return_if_fail (GPA_IS_KEYLIST_MODEL (model));
+  g_return_if_fail (key != NULL);
+
+  row = g_malloc0 (sizeof *row);
+  row->key = key;
+  insert_row (model, row, iter);
+}
+
+
+/* Append a row with the values from the key cache row CACHED.  Such
+   a row has no key until gpa_keylist_model_set_key is used.  */
+void
+gpa_keylist_model_append_cached (GpaKeyListModel *model,
+                                 gpa_keycache_row_t cached,
+                                 GtkTreeIter *iter)
+{
+  struct row_s *row;
+
+  g_return_if_fail (GPA_IS_KEYLIST_MODEL (model));
+
+  row = g_malloc0 (sizeof *row);
+  row->cached = g_malloc (sizeof *row->cached);
+  *row->cached = *cached;
+  row->cached->fpr = g_strdup (cached->fpr);
+  row->cached->keytype = g_strdup (cached->keytype);
+  row->cached->created = g_strdup (cached->created);
+  row->cached->expiry = g_strdup (cached->expiry);
+  row->cached->ownertrust = g_strdup (cached->ownertrust);
+  row->cached->validity = g_strdup (cached->validity);
+  row->cached->userid = g_strdup (cached->userid);
+  insert_row (model, row, iter);
+}
+
+
+/* Replace the key of the row at ITER by KEY.  This function takes
+   ownership of KEY.  */
+void
+gpa_keylist_model_set_key (GpaKeyListModel *model, GtkTreeIter *iter,
+                           gpgme_key_t key)
+{
+  struct row_s *row;
+  GtkTreePath *path;
+  gint old_pos, new_pos;
+
+  g_return_if_fail (GPA_IS_KEYLIST_MODEL (model));
+  g_return_if_fail (iter->stamp == model->stamp);
+  g_return_if_fail (key != NULL);
+
+  row = g_sequence_get (iter->user_data);
+  forget_formatted (model, row);
+  if (row->key)
+    gpgme_key_unref (row->key);
+  row->key = key;
+  release_cached (row->cached);
+  row->cached = NULL;
+  g_free (row->sort_key);
+  row->sort_key = NULL;
+
+  /* Move the row if its sort position changed.  */
+  old_pos = g_sequence_iter_get_position (iter->user_data);
+  if (is_sorted (model))
+    {
+      g_sequence_sort_changed (iter->user_data, compare_rows, model);
+      new_pos = g_sequence_iter_get_position (iter->user_data);
+      if (new_pos != old_pos)
+        {
+          gint length = g_sequence_get_length (model->rows);
+          gint *new_order = g_new (gint, length);
+          gint i;
+
+          /* The rows between the old and the new position shift by
+             one.  */
+          for (i = 0; i < length; i++)
+            {
+              if (i == new_pos)
+                new_order[i] = old_pos;
+              else if (new_pos < old_pos && i > new_pos && i <= old_pos)
+                new_order[i] = i - 1;
+              else if (new_pos > old_pos && i >= old_pos && i < new_pos)
+                new_order[i] = i + 1;
+              else
+                new_order[i] = i;
+            }
+          path = gtk_tree_path_new ();
+          gtk_tree_model_rows_reordered (GTK_TREE_MODEL (model), path, NULL,
+                                         new_order);
+          gtk_tree_path_free (path);
+          g_free (new_order);
+        }
+    }
+  else
+    new_pos = old_pos;
+
+  path = gtk_tree_path_new_from_indices (new_pos, -1);
+  gtk_tree_model_row_changed (GTK_TREE_MODEL (model), path, iter);
+  gtk_tree_path_free (path);
+}
+
+
+/* Remove the row at ITER.  */
+void
+gpa_keylist_model_remove (GpaKeyListModel *model, GtkTreeIter *iter)
+{
+  GtkTreePath *path;
+  struct row_s *row;
+
+  g_return_if_fail (GPA_IS_KEYLIST_MODEL (model));
+  g_return_if_fail (iter->stamp == model->stamp);
+
+  path = gtk_tree_path_new_from_indices
+    (g_sequence_iter_get_position (iter->user_data), -1);
+  row = g_sequence_get (iter->user_data);
+  forget_formatted (model, row);
+  g_sequence_remove (iter->user_data);
+  iter->stamp = 0;
+  gtk_tree_model_row_deleted (GTK_TREE_MODEL (model), path);
+  gtk_tree_path_free (path);
+}
+
+
+/* Remove all rows.  */
+void
+gpa_keylist_model_clear (GpaKeyListModel *model)
+{
+  GtkTreeIter iter;
+  gint length;
+
+  g_return_if_fail (GPA_IS_KEYLIST_MODEL (model));
+
+  /* Remove the rows from the end so that no rows need to be moved.  */
+  while ((length = g_sequence_get_length (model->rows)))
+    {
+      iter.stamp = model->stamp;
+      iter.user_data = g_sequence_get_iter_at_pos (model->rows, length - 1);
+      gpa_keylist_model_remove (model, &iter);
+    }
+}
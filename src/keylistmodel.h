@@ -0,0 +1,110 @@
+/* keylistmodel.h - The tree model of the key list.
+   Copyright (C) 2026 g10 Code GmbH.
+
+   This file is part of GPA
+
+   GPA is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   GPA is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+   License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.  */
+
+/* The key list model holds only a reference to each key.  The column
+   values are computed when the view asks for them, which it does only
+   for the visible rows.  The formatted strings of recently shown rows
+   are kept in a small cache.  */
+
+#ifndef KEYLISTMODEL_H
+#define KEYLISTMODEL_H
+
+#include <gtk/gtk.h>
+#include <gpgme.h>
+#include "keycache.h"
+
+/* Symbols to access the columns.  */
+typedef enum
+{
+  /* These are the displayed columns */
+  GPA_KEYLIST_COLUMN_IMAGE,
+  GPA_KEYLIST_COLUMN_KEYTYPE,
+  GPA_KEYLIST_COLUMN_CREATED,
+  GPA_KEYLIST_COLUMN_EXPIRY,
+  GPA_KEYLIST_COLUMN_OWNERTRUST,
+  GPA_KEYLIST_COLUMN_VALIDITY,
+  GPA_KEYLIST_COLUMN_USERID,
+  /* This column contains the gpgme_key_t */
+  GPA_KEYLIST_COLUMN_KEY,
+  /* These columns are used only internally for sorting */
+  GPA_KEYLIST_COLUMN_HAS_SECRET,
+  GPA_KEYLIST_COLUMN_CREATED_TS,
+  GPA_KEYLIST_COLUMN_EXPIRY_TS,
+  GPA_KEYLIST_COLUMN_OWNERTRUST_VALUE,
+  GPA_KEYLIST_COLUMN_VALIDITY_VALUE,
+  GPA_KEYLIST_N_COLUMNS
+} GpaKeyListColumn;
+
+
+/* Declare the Object. */
+typedef struct _GpaKeyListModel      GpaKeyListModel;
+typedef struct _GpaKeyListModelClass GpaKeyListModelClass;
+
+GType gpa_keylist_model_get_type (void) G_GNUC_CONST;
+
+#define GPA_KEYLIST_MODEL_TYPE   (gpa_keylist_model_get_type ())
+
+#define GPA_KEYLIST_MODEL(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST ((obj), GPA_KEYLIST_MODEL_TYPE, \
+                               GpaKeyListModel))
+
+#define GPA_KEYLIST_MODEL_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST ((klass), \
+                            GPA_KEYLIST_MODEL_TYPE, GpaKeyListModelClass))
+
+#define GPA_IS_KEYLIST_MODEL(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GPA_KEYLIST_MODEL_TYPE))
+
+#define GPA_IS_KEYLIST_MODEL_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE ((klass), GPA_KEYLIST_MODEL_TYPE))
+
+#define GPA_KEYLIST_MODEL_GET_CLASS(obj) \
+  (G_TYPE_INSTANCE_GET_CLASS ((obj), \
+                              GPA_KEYLIST_MODEL_TYPE, GpaKeyListModelClass))
+
+
+/* The class specific API.  */
+
+/* Create a new empty key list model.  */
+GpaKeyListModel *gpa_keylist_model_new (void);
+
+/* Append a row for KEY and store its iter at ITER unless ITER is
+   NULL.  If the model is sorted, the row is inserted at its sorted
+   position.  This function takes ownership of KEY.  */
+void gpa_keylist_model_append (GpaKeyListModel *model, gpgme_key_t key,
+                               GtkTreeIter *iter);
+
+/* Append a row with the values from the key cache row ROW.  Such a
+   row has no key until gpa_keylist_model_set_key is used.  */
+void gpa_keylist_model_append_cached (GpaKeyListModel *model,
+                                      gpa_keycache_row_t row,
+                                      GtkTreeIter *iter);
+
+/* Replace the key of the row at ITER by KEY.  This function takes
+   ownership of KEY.  */
+void gpa_keylist_model_set_key (GpaKeyListModel *model, GtkTreeIter *iter,
+                                gpgme_key_t key);
+
+/* Remove the row at ITER.  */
+void gpa_keylist_model_remove (GpaKeyListModel *model, GtkTreeIter *iter);
+
+/* Remove all rows.  */
+void gpa_keylist_model_clear (GpaKeyListModel *model);
+
+
+#endif /*KEYLISTMODEL_H*/
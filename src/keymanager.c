@@ -62,6 +62,7 @@
 #include "gpaimportclipop.h"
 #include "gpaimportserverop.h"
 #include "gpaimportbykeyidop.h"
+#include "keyrefresh.h"
 
 #include "gpabackupop.h"
 
@@ -289,29 +290,107 @@ key_manager_current_key (GpaKeyManager *self)
 /* Action callbacks.  */
 
 
+/* Update the rows of all keys in the list KEYS of gpgme_key_t.  */
 static void
-gpa_key_manager_changed_wot_cb (gpointer data)
+key_manager_update_key_list (GpaKeyManager *self, GList *keys,
+                             gboolean with_secret)
+{
+  const char **fprs;
+  int idx = 0;
+
+  fprs = g_new0 (const char *, g_list_length (keys) + 1);
+  for (; keys; keys = g_list_next (keys))
+    {
+      gpgme_key_t key = keys->data;
+
+      if (key && key->subkeys && key->subkeys->fpr)
+        fprs[idx++] = key->subkeys->fpr;
+    }
+  gpa_keylist_update_keys (self->keylist, fprs, with_secret);
+  g_free (fprs);
+}
+
+
+/* Update the rows of all keys mentioned in the import result of
+   OP.  */
+static void
+key_manager_update_imported (GpaKeyManager *self, GpaImportOperation *op,
+                             gboolean with_secret)
+{
+  const char **fprs;
+
+  /* The operation may have used several contexts; thus we need to
+     use its accumulated list and not the result of its context.  */
+  fprs = gpa_import_operation_get_imported (op);
+  if (!fprs || !*fprs)
+    return;  /* Nothing has been imported, e.g. all keys failed.  */
+
+  gpa_keylist_update_keys (self->keylist, fprs, with_secret);
+  /* New keys and signatures may change the validity of other
+     keys.  */
+  gpa_keylist_refresh_validity (self->keylist);
+}
+
+
+/* The trust or the signatures of keys have been changed, or keys
+   have been deleted.  Only the rows of these keys are updated or
+   removed right away.  Because this also changes the computed
+   validity of other keys, the validity of all rows is refreshed
+   later.  */
+static void
+gpa_key_manager_changed_wot_cb (gpointer data, GpaKeyOperation *op)
 {
   GpaKeyManager *self = data;
-  gpa_keylist_start_reload (self->keylist);
+
+  if (GPA_IS_KEY_DELETE_OPERATION (op))
+    gpa_keylist_remove_keys
+      (self->keylist,
+       gpa_key_delete_operation_get_deleted (GPA_KEY_DELETE_OPERATION (op)));
+  else
+    key_manager_update_key_list (self, gpa_key_operation_keys (op), TRUE);
+  gpa_keylist_refresh_validity (self->keylist);
 }
 
 
 static void
-gpa_key_manager_changed_wot_secret_cb (gpointer data)
+gpa_key_manager_imported_cb (gpointer data, GpaImportOperation *op)
 {
   GpaKeyManager *self = data;
 
-  gpa_keylist_imported_secret_key (self->keylist);
-  gpa_keylist_start_reload (self->keylist);
+  key_manager_update_imported (self, op, FALSE);
+}
+
+
+static void
+gpa_key_manager_imported_secret_cb (gpointer data, GpaImportOperation *op)
+{
+  GpaKeyManager *self = data;
+
+  key_manager_update_imported (self, op, TRUE);
 }
 
+#ifdef ENABLE_KEYSERVER_SUPPORT
+/* Some keys have been changed by the background refresh.  */
+static void
+gpa_key_manager_refreshed_keys_cb (GpaKeyRefresher *refresher,
+                                   const char **fprs, gpointer data)
+{
+  GpaKeyManager *self = data;
+
+  gpa_keylist_update_keys (self->keylist, fprs, FALSE);
+}
+#endif /*ENABLE_KEYSERVER_SUPPORT*/
+
 static void
 gpa_key_manager_key_modified (GpaKeyEditDialog *dialog, gpgme_key_t key,
 				 gpointer data)
 {
   GpaKeyManager *self = data;
-  gpa_keylist_start_reload (self->keylist);
+  GList *keys = g_list_prepend (NULL, key);
+
+  key_manager_update_key_list (self, keys, TRUE);
+  g_list_free (keys);
+  gpa_keylist_refresh_validity (self->keylist);
 }
 
 
@@ -341,11 +420,11 @@ static void
 register_import_operation (GpaKeyManager *self, GpaImportOperation *op)
 {
   g_signal_connect_swapped (G_OBJECT (op), "imported_keys",
-			    G_CALLBACK (gpa_key_manager_changed_wot_cb),
+			    G_CALLBACK (gpa_key_manager_imported_cb),
 			    self);
   g_signal_connect_swapped
     (G_OBJECT (op), "imported_secret_keys",
-     G_CALLBACK (gpa_key_manager_changed_wot_secret_cb),
+     G_CALLBACK (gpa_key_manager_imported_secret_cb),
      self);
   g_signal_connect (G_OBJECT (op), "completed",
 		    G_CALLBACK (g_object_unref), self);
@@ -559,18 +638,17 @@ key_manager_refresh_keys (GtkAction *action, gpointer param)
   GpaImportByKeyidOperation *op;
   GList *selection;
 
-  /* FIXME: The refresh-from-server operation currently only supports
-     one key at a time.  */
-  if (!key_manager_has_single_selection (self))
+  if (!key_manager_has_selection (self))
     return;
 
   selection = gpa_keylist_get_selected_keys (self->keylist,
                                              GPGME_PROTOCOL_OPENPGP);
   if (selection)
     {
-      op = gpa_import_bykeyid_operation_new (GTK_WIDGET (self),
-                                             (gpgme_key_t) selection->data);
+      op = gpa_import_bykeyid_operation_new_for_keys (GTK_WIDGET (self),
+                                                      selection);
       register_import_operation (self, GPA_IMPORT_OPERATION (op));
+      g_list_free (selection);
     }
 }
 #endif /*ENABLE_KEYSERVER_SUPPORT*/
@@ -585,9 +663,7 @@ key_manager_send (GtkAction *action, gpointer param)
   GList *selection;
   GpaExportServerOperation *op;
 
-  /* FIXME: The export-to-server operation currently only supports
-     exporting one key at a time.  */
-  if (! key_manager_has_single_selection (self))
+  if (! key_manager_has_selection (self))
     return;
 
   selection = gpa_keylist_get_selected_keys (self->keylist,
@@ -888,8 +964,6 @@ key_manager_refresh (GtkAction *action, gpointer param)
   /* Hack: To force reloading of secret keys we claim that a secret
      key has been imported.  */
   gpa_keylist_imported_secret_key (self->keylist);
-
-  gpa_keylist_start_reload (self->keylist);
 }
 
 
@@ -1153,10 +1227,10 @@ key_manager_action_new (GpaKeyManager *self,
 #ifdef ENABLE_KEYSERVER_SUPPORT
   action = gtk_action_group_get_action (action_group, "ServerRefresh");
   add_selection_sensitive_action (self, action,
-                                  key_manager_has_single_selection);
+                                  key_manager_has_selection);
   action = gtk_action_group_get_action (action_group, "ServerSend");
   add_selection_sensitive_action (self, action,
-                                  key_manager_has_single_selection);
+                                  key_manager_has_selection);
 #endif /*ENABLE_KEYSERVER_SUPPORT*/
 
   action = gtk_action_group_get_action (action_group, "KeysSetOwnerTrust");
@@ -1432,6 +1506,7 @@ construct_widgets (GpaKeyManager *self)
 
   keylist = gpa_keylist_new (GTK_WIDGET (self));
   self->keylist = GPA_KEYLIST (keylist);
+  gpa_keylist_use_snapshot (self->keylist);
   if (gpa_options_get_detailed_view (gpa_options_get_instance()))
     gpa_keylist_set_detailed (self->keylist);
   else
@@ -1468,6 +1543,11 @@ construct_widgets (GpaKeyManager *self)
   g_signal_connect (G_OBJECT (self->ctx), "next_key",
 		    G_CALLBACK (key_manager_key_listed), self);
 
+#ifdef ENABLE_KEYSERVER_SUPPORT
+  g_signal_connect (G_OBJECT (gpa_key_refresher_get_instance ()),
+                    "refreshed_keys",
+                    G_CALLBACK (gpa_key_manager_refreshed_keys_cb), self);
+#endif
 }
 
 
@@ -1475,6 +1555,11 @@ construct_widgets (GpaKeyManager *self)
 static void
 gpa_key_manager_closed (GtkWidget *widget, gpointer param)
 {
+#ifdef ENABLE_KEYSERVER_SUPPORT
+  g_signal_handlers_disconnect_by_func
+    (G_OBJECT (gpa_key_refresher_get_instance ()),
+     G_CALLBACK (gpa_key_manager_refreshed_keys_cb), param);
+#endif
   this_instance = NULL;
 }
 
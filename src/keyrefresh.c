@@ -0,0 +1,701 @@
+/* keyrefresh.c - Scheduled refresh of the keys from the keyserver.
+   Copyright (C) 2026 g10 Code GmbH.
+
+   This file is part of GPA
+
+   GPA is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   GPA is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+   License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.  */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <glib.h>
+#include <gpgme.h>
+
+#include "gpa.h"
+#include "gpgmetools.h"
+#include "gpacontext.h"
+#include "keytable.h"
+#include "keyrefresh.h"
+
+
+/* The delay after the start of GPA before the first key listing for
+   the refresh is done.  */
+#define REFRESH_STARTUP_DELAY  300
+/* The minimum time between two refreshes.  The usual time is the
+   refresh window divided by the number of keys.  */
+#define REFRESH_MIN_GAP        60
+/* The maximum time we sleep in one go.  */
+#define REFRESH_MAX_SLEEP      (24 * 60 * 60)
+/* The delay before a failed refresh is retried.  It is doubled for
+   each further failure but never exceeds the refresh window.  */
+#define REFRESH_RETRY          (60 * 60)
+/* The relative amount of jitter applied to the refresh window.  */
+#define REFRESH_JITTER         0.2
+
+/* An entry of the schedule.  */
+struct entry_s
+{
+  gchar *fpr;
+  time_t due;          /* The time the key is to be refreshed.  */
+  int failures;        /* The number of failed refreshes in a row.  */
+};
+
+struct _GpaKeyRefresher
+{
+  GObject parent;
+
+  /* The context used for the refreshes.  */
+  GpaContext *context;
+
+  /* The refresh window in seconds or 0 if disabled.  */
+  time_t window;
+
+  gboolean started;
+  gboolean have_keys;  /* The schedule has been built.  */
+  gboolean running;    /* A refresh is in progress.  */
+  gchar *current_fpr;  /* The fingerprint of the key being refreshed.  */
+  guint timeout_id;
+
+  /* The entries sorted by their due time and an index mapping the
+     fingerprint to the sequence iter.  The entries own the
+     fingerprint strings.  */
+  GSequence *schedule;
+  GHashTable *entries;
+
+  /* The persistent store.  Maps a fingerprint to a pointer to the
+     time_t of the last successful refresh.  */
+  GHashTable *last_refresh;
+};
+
+/* Signals */
+enum
+{
+  REFRESHED_KEYS,
+  LAST_SIGNAL
+};
+
+static GObjectClass *parent_class;
+static guint signals[LAST_SIGNAL];
+
+/* The single instance.  */
+static GpaKeyRefresher *instance;
+
+static gboolean refresh_timeout_cb (gpointer data);
+static void refresh_done_cb (GpaContext *context, gpg_error_t err,
+                             GpaKeyRefresher *refresher);
+static void keytable_ready_cb (GpaKeyTable *keytable,
+                               GpaKeyRefresher *refresher);
+
+
+
+static void
+free_entry (gpointer data)
+{
+  struct entry_s *entry = data;
+
+  g_free (entry->fpr);
+  g_free (entry);
+}
+
+
+static gint
+compare_entries (gconstpointer a, gconstpointer b, gpointer data)
+{
+  const struct entry_s *ea = a;
+  const struct entry_s *eb = b;
+
+  return ea->due < eb->due ? -1 : ea->due > eb->due ? 1 : 0;
+}
+
+
+/* Return the refresh window jittered by up to REFRESH_JITTER.  */
+static time_t
+jittered_window (GpaKeyRefresher *refresher)
+{
+  return (time_t) (refresher->window
+                   * g_random_double_range (1.0 - REFRESH_JITTER,
+                                            1.0 + REFRESH_JITTER));
+}
+
+
+/* Return true if KEY shall be refreshed.  */
+static gboolean
+is_refreshable (gpgme_key_t key)
+{
+  return (key
+          && key->protocol == GPGME_PROTOCOL_OpenPGP
+          && !key->revoked
+          && !key->disabled
+          && key->subkeys
+          && key->subkeys->fpr
+          && *key->subkeys->fpr);
+}
+
+
+
+/* The persistent store.  It is a text file with one line per key
+   giving the fingerprint and the time of the last refresh.  */
+
+gchar *
+gpa_key_refresher_filename (void)
+{
+  const gchar *optfile;
+  gchar *dir, *fname;
+
+  optfile = gpa_options_get_file (gpa_options_get_instance ());
+  dir = optfile? g_path_get_dirname (optfile) : g_strdup (gnupg_homedir);
+  fname = g_build_filename (dir, "gpa-refresh.dat", NULL);
+  g_free (dir);
+  return fname;
+}
+
+
+static void
+load_store (GpaKeyRefresher *refresher)
+{
+  gchar *fname, *contents;
+  gchar **lines;
+  int i;
+
+  fname = gpa_key_refresher_filename ();
+  if (!g_file_get_contents (fname, &contents, NULL, NULL))
+    {
+      g_free (fname);
+      return;
+    }
+  g_free (fname);
+
+  lines = g_strsplit (contents, "\n", -1);
+  g_free (contents);
+  for (i = 0; lines[i]; i++)
+    {
+      gchar **fields = g_strsplit (lines[i], " ", 2);
+      time_t *stamp;
+
+      if (fields[0] && *fields[0] && fields[1])
+        {
+          stamp = g_new (time_t, 1);
+          *stamp = (time_t) g_ascii_strtoull (fields[1], NULL, 10);
+          g_hash_table_replace (refresher->last_refresh,
+                                g_strdup (fields[0]), stamp);
+        }
+      g_strfreev (fields);
+    }
+  g_strfreev (lines);
+}
+
+
+static void
+append_store_line (gpointer key, gpointer value, gpointer data)
+{
+  g_string_append_printf ((GString *) data, "%s %lu\n", (const char *) key,
+                          (unsigned long) *(time_t *) value);
+}
+
+
+static void
+save_store (GpaKeyRefresher *refresher)
+{
+  gchar *fname;
+  GString *string;
+  GError *error = NULL;
+
+  string = g_string_new (NULL);
+  g_hash_table_foreach (refresher->last_refresh, append_store_line, string);
+
+  fname = gpa_key_refresher_filename ();
+  if (!g_file_set_contents (fname, string->str, string->len, &error))
+    {
+      g_debug ("error writing `%s': %s", fname, error->message);
+      g_error_free (error);
+    }
+  g_free (fname);
+  g_string_free (string, TRUE);
+}
+
+
+
+/* Scheduling.  */
+
+/* Arrange for the next refresh.  */
+static void
+schedule_next (GpaKeyRefresher *refresher)
+{
+  struct entry_s *entry;
+  time_t now, delay, gap;
+  gint nkeys;
+
+  nkeys = g_sequence_get_length (refresher->schedule);
+  if (refresher->timeout_id || refresher->running || !refresher->window
+      || !refresher->have_keys || nkeys == 0)
+    return;
+
+  /* Even if many keys are overdue, the keyserver shall not see a
+     burst of requests.  Spacing the refreshes by the window divided
+     by the number of keys still refreshes all of them within the
+     window; the jitter hides the pattern.  */
+  gap = (time_t) ((double) refresher->window / nkeys
+                  * g_random_double_range (0.5, 1.5));
+  if (gap < REFRESH_MIN_GAP)
+    gap = REFRESH_MIN_GAP;
+
+  entry = g_sequence_get (g_sequence_get_begin_iter (refresher->schedule));
+  now = time (NULL);
+  delay = entry->due > now ? entry->due - now : 0;
+  if (delay < gap)
+    delay = gap;
+  if (delay > REFRESH_MAX_SLEEP)
+    delay = REFRESH_MAX_SLEEP;
+
+  refresher->timeout_id = g_timeout_add_seconds ((guint) delay,
+                                                 refresh_timeout_cb,
+                                                 refresher);
+}
+
+
+/* Stop the timer and forget the schedule.  */
+static void
+clear_schedule (GpaKeyRefresher *refresher)
+{
+  if (refresher->timeout_id)
+    {
+      g_source_remove (refresher->timeout_id);
+      refresher->timeout_id = 0;
+    }
+  g_hash_table_remove_all (refresher->entries);
+  /* g_sequence_remove_range frees the entries.  */
+  g_sequence_remove_range (g_sequence_get_begin_iter (refresher->schedule),
+                           g_sequence_get_end_iter (refresher->schedule));
+  refresher->have_keys = FALSE;
+}
+
+
+/* Add an entry for the key with FPR.  */
+static void
+add_entry (GpaKeyRefresher *refresher, const char *fpr, time_t now)
+{
+  struct entry_s *entry;
+  time_t *stamp;
+  GSequenceIter *iter;
+
+  entry = g_new0 (struct entry_s, 1);
+  entry->fpr = g_strdup (fpr);
+  stamp = g_hash_table_lookup (refresher->last_refresh, fpr);
+  if (stamp)
+    entry->due = *stamp + jittered_window (refresher);
+  else
+    /* Spread keys never refreshed over the whole window.  */
+    entry->due = now + (time_t) (refresher->window * g_random_double ());
+
+  iter = g_sequence_insert_sorted (refresher->schedule, entry,
+                                   compare_entries, NULL);
+  g_hash_table_insert (refresher->entries, entry->fpr, iter);
+}
+
+
+/* State for sync_key.  */
+struct sync_s
+{
+  GpaKeyRefresher *refresher;
+  GHashTable *seen;
+  time_t now;
+};
+
+
+/* Helper for sync_schedule to add KEY to the schedule.  */
+static void
+sync_key (gpgme_key_t key, gpointer data)
+{
+  struct sync_s *sync = data;
+
+  if (!is_refreshable (key))
+    return;
+  g_hash_table_insert (sync->seen, key->subkeys->fpr, key->subkeys->fpr);
+  if (!g_hash_table_lookup (sync->refresher->entries, key->subkeys->fpr))
+    add_entry (sync->refresher, key->subkeys->fpr, sync->now);
+}
+
+
+/* Bring the schedule in sync with the public keytable.  */
+static void
+sync_schedule (GpaKeyRefresher *refresher)
+{
+  struct sync_s sync;
+  GHashTable *seen;
+  GList *item, *gone = NULL;
+  GSequenceIter *iter;
+
+  if (!refresher->window)
+    return;
+
+  seen = g_hash_table_new (g_str_hash, g_str_equal);
+  sync.refresher = refresher;
+  sync.seen = seen;
+  sync.now = time (NULL);
+  gpa_keytable_foreach (gpa_keytable_get_public_instance (),
+                        sync_key, &sync);
+
+  /* Remove the keys which are gone.  Collect them first because the
+     sequence must not be modified while we walk it.  */
+  for (iter = g_sequence_get_begin_iter (refresher->schedule);
+       !g_sequence_iter_is_end (iter); iter = g_sequence_iter_next (iter))
+    {
+      struct entry_s *entry = g_sequence_get (iter);
+
+      if (!g_hash_table_lookup (seen, entry->fpr))
+        gone = g_list_prepend (gone, iter);
+    }
+  for (item = gone; item; item = g_list_next (item))
+    {
+      struct entry_s *entry = g_sequence_get (item->data);
+
+      g_hash_table_remove (refresher->last_refresh, entry->fpr);
+      g_hash_table_remove (refresher->entries, entry->fpr);
+      g_sequence_remove (item->data);
+    }
+  g_list_free (gone);
+  g_hash_table_destroy (seen);
+
+  refresher->have_keys = TRUE;
+  schedule_next (refresher);
+}
+
+
+/* Called as soon as the keytable has been listed for the first
+   time.  */
+static void
+keys_listed_cb (gpointer data)
+{
+  GpaKeyRefresher *refresher = data;
+
+  if (!gpa_keytable_is_ready (gpa_keytable_get_public_instance ()))
+    {
+      /* The listing failed - try again later.  */
+      if (!refresher->timeout_id && refresher->window)
+        refresher->timeout_id = g_timeout_add_seconds (REFRESH_RETRY,
+                                                       refresh_timeout_cb,
+                                                       refresher);
+      return;
+    }
+  sync_schedule (refresher);
+}
+
+
+static void
+keytable_ready_cb (GpaKeyTable *keytable, GpaKeyRefresher *refresher)
+{
+  if (refresher->have_keys)
+    sync_schedule (refresher);
+}
+
+
+/* Start the refresh of the next due key.  */
+static void
+start_refresh (GpaKeyRefresher *refresher)
+{
+  GpaKeyTable *keytable = gpa_keytable_get_public_instance ();
+  GSequenceIter *iter;
+  struct entry_s *entry;
+  gpgme_key_t keys[2];
+  gpg_error_t err;
+
+  if (!gpa_keytable_is_ready (keytable))
+    {
+      /* A listing is in progress; the keytable will tell us when it
+         is done.  */
+      return;
+    }
+
+  iter = g_sequence_get_begin_iter (refresher->schedule);
+  if (g_sequence_iter_is_end (iter))
+    return;
+  entry = g_sequence_get (iter);
+  if (entry->due > time (NULL))
+    {
+      schedule_next (refresher);
+      return;
+    }
+
+  keys[0] = gpa_keytable_lookup_key (keytable, entry->fpr);
+  keys[1] = NULL;
+  if (!keys[0])
+    {
+      /* The key has been deleted in the meantime.  */
+      g_hash_table_remove (refresher->entries, entry->fpr);
+      g_sequence_remove (iter);
+      schedule_next (refresher);
+      return;
+    }
+
+  if (!refresher->context)
+    {
+      refresher->context = gpa_context_new ();
+      g_signal_connect (G_OBJECT (refresher->context), "done",
+                        G_CALLBACK (refresh_done_cb), refresher);
+    }
+
+  g_free (refresher->current_fpr);
+  refresher->current_fpr = g_strdup (entry->fpr);
+  refresher->running = TRUE;
+
+  gpgme_set_protocol (refresher->context->ctx, GPGME_PROTOCOL_OpenPGP);
+  err = gpgme_op_import_keys_start (refresher->context->ctx, keys);
+  if (err)
+    refresh_done_cb (refresher->context, err, refresher);
+}
+
+
+static gboolean
+refresh_timeout_cb (gpointer data)
+{
+  GpaKeyRefresher *refresher = data;
+
+  refresher->timeout_id = 0;
+  if (!refresher->window)
+    ;
+  else if (!refresher->have_keys)
+    gpa_keytable_when_ready (gpa_keytable_get_public_instance (),
+                             keys_listed_cb, refresher);
+  else
+    start_refresh (refresher);
+
+  return FALSE;
+}
+
+
+static void
+refresh_done_cb (GpaContext *context, gpg_error_t err,
+                 GpaKeyRefresher *refresher)
+{
+  GSequenceIter *iter = NULL;
+  struct entry_s *entry = NULL;
+  time_t now = time (NULL);
+
+  refresher->running = FALSE;
+  if (refresher->current_fpr)
+    iter = g_hash_table_lookup (refresher->entries, refresher->current_fpr);
+  if (iter)
+    entry = g_sequence_get (iter);
+
+  if (err)
+    {
+      /* This is a background job; thus we don't bother the user.  */
+      g_debug ("refreshing key %s failed: %s",
+               refresher->current_fpr? refresher->current_fpr : "?",
+               gpg_strerror (err));
+      if (entry)
+        {
+          time_t delay = REFRESH_RETRY;
+          int i;
+
+          entry->failures++;
+          for (i = 1; i < entry->failures && delay < refresher->window; i++)
+            delay *= 2;
+          if (delay > refresher->window)
+            delay = refresher->window;
+          entry->due = now + delay;
+        }
+    }
+  else
+    {
+      gpgme_import_result_t result;
+      gpgme_import_status_t imp;
+      GPtrArray *fprs;
+
+      if (entry)
+        {
+          time_t *stamp = g_new (time_t, 1);
+
+          *stamp = now;
+          g_hash_table_replace (refresher->last_refresh,
+                                g_strdup (entry->fpr), stamp);
+          entry->failures = 0;
+          entry->due = now + jittered_window (refresher);
+        }
+      save_store (refresher);
+
+      /* Tell about the keys which have actually changed.  */
+      fprs = g_ptr_array_new ();
+      result = gpgme_op_import_result (context->ctx);
+      for (imp = result? result->imports : NULL; imp; imp = imp->next)
+        if (!imp->result && imp->status && imp->fpr)
+          g_ptr_array_add (fprs, imp->fpr);
+      if (fprs->len)
+        {
+          g_ptr_array_add (fprs, NULL);
+          gpa_keytable_keyring_changed ();
+          g_signal_emit (refresher, signals[REFRESHED_KEYS], 0, fprs->pdata);
+        }
+      g_ptr_array_free (fprs, TRUE);
+    }
+
+  if (iter)
+    g_sequence_sort_changed (iter, compare_entries, NULL);
+  g_free (refresher->current_fpr);
+  refresher->current_fpr = NULL;
+
+  schedule_next (refresher);
+}
+
+
+/* The refresh window has been changed.  */
+static void
+options_changed_cb (GpaOptions *options, GpaKeyRefresher *refresher)
+{
+  time_t window;
+
+  window = (time_t) gpa_options_get_auto_refresh_days (options) * 24*60*60;
+  if (window == refresher->window)
+    return;
+
+  clear_schedule (refresher);
+  refresher->window = window;
+  if (window)
+    refresher->timeout_id = g_timeout_add_seconds (REFRESH_MIN_GAP,
+                                                   refresh_timeout_cb,
+                                                   refresher);
+}
+
+
+
+/* GObject boilerplate.  */
+
+static void
+gpa_key_refresher_finalize (GObject *object)
+{
+  GpaKeyRefresher *refresher = GPA_KEY_REFRESHER (object);
+
+  if (refresher->timeout_id)
+    g_source_remove (refresher->timeout_id);
+  if (refresher->context)
+    g_object_unref (refresher->context);
+  g_free (refresher->current_fpr);
+  g_hash_table_destroy (refresher->entries);
+  g_sequence_free (refresher->schedule);
+  g_hash_table_destroy (refresher->last_refresh);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+
+static void
+gpa_key_refresher_init (GpaKeyRefresher *refresher)
+{
+  refresher->context = NULL;
+  refresher->window = 0;
+  refresher->started = FALSE;
+  refresher->have_keys = FALSE;
+  refresher->running = FALSE;
+  refresher->current_fpr = NULL;
+  refresher->timeout_id = 0;
+  refresher->schedule = g_sequence_new (free_entry);
+  refresher->entries = g_hash_table_new (g_str_hash, g_str_equal);
+  refresher->last_refresh = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                   g_free, g_free);
+}
+
+
+static void
+gpa_key_refresher_class_init (GpaKeyRefresherClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  parent_class = g_type_class_peek_parent (klass);
+
+  object_class->finalize = gpa_key_refresher_finalize;
+
+  klass->refreshed_keys = NULL;
+  signals[REFRESHED_KEYS] =
+    g_signal_new ("refreshed_keys",
+                  G_TYPE_FROM_CLASS (object_class),
+                  G_SIGNAL_RUN_FIRST,
+                  G_STRUCT_OFFSET (GpaKeyRefresherClass, refreshed_keys),
+                  NULL, NULL,
+                  g_cclosure_marshal_VOID__POINTER,
+                  G_TYPE_NONE, 1, G_TYPE_POINTER);
+}
+
+
+GType
+gpa_key_refresher_get_type (void)
+{
+  static GType refresher_type = 0;
+
+  if (!refresher_type)
+    {
+      static const GTypeInfo refresher_info =
+      {
+        sizeof (GpaKeyRefresherClass),
+        (GBaseInitFunc) NULL,
+        (GBaseFinalizeFunc) NULL,
+        (GClassInitFunc) gpa_key_refresher_class_init,
+        NULL,           /* class_finalize */
+        NULL,           /* class_data */
+        sizeof (GpaKeyRefresher),
+        0,              /* n_preallocs */
+        (GInstanceInitFunc) gpa_key_refresher_init,
+      };
+
+      refresher_type = g_type_register_static (G_TYPE_OBJECT,
+                                               "GpaKeyRefresher",
+                                               &refresher_info, 0);
+    }
+
+  return refresher_type;
+}
+
+
+
+/* API */
+
+GpaKeyRefresher *
+gpa_key_refresher_get_instance (void)
+{
+  if (!instance)
+    instance = g_object_new (GPA_KEY_REFRESHER_TYPE, NULL);
+  return instance;
+}
+
+
+void
+gpa_key_refresher_start (GpaKeyRefresher *refresher)
+{
+  GpaOptions *options = gpa_options_get_instance ();
+
+  g_return_if_fail (GPA_IS_KEY_REFRESHER (refresher));
+
+  if (refresher->started)
+    return;
+  refresher->started = TRUE;
+
+  /* Older versions of GnuPG can't import keys by their description;
+     the keyserver helpers would need to be used instead.  */
+  if (!is_gpg_version_at_least ("2.1.0"))
+    return;
+
+  load_store (refresher);
+  g_signal_connect (G_OBJECT (options), "changed_auto_refresh",
+                    G_CALLBACK (options_changed_cb), refresher);
+  g_signal_connect (G_OBJECT (gpa_keytable_get_public_instance ()), "ready",
+                    G_CALLBACK (keytable_ready_cb), refresher);
+
+  refresher->window = ((time_t) gpa_options_get_auto_refresh_days (options)
+                       * 24*60*60);
+  if (refresher->window)
+    refresher->timeout_id = g_timeout_add_seconds (REFRESH_STARTUP_DELAY,
+                                                   refresh_timeout_cb,
+                                                   refresher);
+}
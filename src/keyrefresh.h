@@ -0,0 +1,72 @@
+/* keyrefresh.h - Scheduled refresh of the keys from the keyserver.
+   Copyright (C) 2026 g10 Code GmbH.
+
+   This file is part of GPA
+
+   GPA is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   GPA is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+   License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.  */
+
+/* The key refresher fetches every OpenPGP public key from the
+   keyserver once per refresh window (the "auto-refresh-days" option).
+   The keys are fetched one at a time at jittered intervals spread
+   over the window; the time of the last refresh of each key is kept
+   in a file so that the schedule survives a restart.  Singleton
+   object.  */
+
+#ifndef KEYREFRESH_H
+#define KEYREFRESH_H
+#ifdef ENABLE_KEYSERVER_SUPPORT
+
+#include <glib.h>
+#include <glib-object.h>
+#include <gpgme.h>
+
+/* GObject stuff */
+#define GPA_KEY_REFRESHER_TYPE	  (gpa_key_refresher_get_type ())
+#define GPA_KEY_REFRESHER(obj)	  (G_TYPE_CHECK_INSTANCE_CAST ((obj), GPA_KEY_REFRESHER_TYPE, GpaKeyRefresher))
+#define GPA_KEY_REFRESHER_CLASS(klass)  (G_TYPE_CHECK_CLASS_CAST ((klass), GPA_KEY_REFRESHER_TYPE, GpaKeyRefresherClass))
+#define GPA_IS_KEY_REFRESHER(obj)	  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GPA_KEY_REFRESHER_TYPE))
+#define GPA_IS_KEY_REFRESHER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), GPA_KEY_REFRESHER_TYPE))
+#define GPA_KEY_REFRESHER_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), GPA_KEY_REFRESHER_TYPE, GpaKeyRefresherClass))
+
+typedef struct _GpaKeyRefresher GpaKeyRefresher;
+typedef struct _GpaKeyRefresherClass GpaKeyRefresherClass;
+
+struct _GpaKeyRefresherClass {
+  GObjectClass parent_class;
+
+  /* Signal handlers */
+
+  /* Emitted after a refresh which changed some keys.  FPRS is a NULL
+     terminated array with the fingerprints of these keys; the
+     handler is expected to reload them.  */
+  void (*refreshed_keys) (GpaKeyRefresher *refresher, const char **fprs);
+};
+
+GType gpa_key_refresher_get_type (void) G_GNUC_CONST;
+
+/* API */
+
+/* Return the key refresher object.  */
+GpaKeyRefresher *gpa_key_refresher_get_instance (void);
+
+/* Start the scheduled refresh.  Nothing is done if the refresh has
+   been disabled or the backend does not support it.  */
+void gpa_key_refresher_start (GpaKeyRefresher *refresher);
+
+/* Return the name of the file with the refresh times.  The caller
+   must free the result.  */
+gchar *gpa_key_refresher_filename (void);
+
+#endif /*ENABLE_KEYSERVER_SUPPORT*/
+#endif /*KEYREFRESH_H*/
@@ -27,8 +27,13 @@
 #include "gtktools.h"
 
 /* Internal */
-static void first_half_done_cb (GpaContext *context, gpg_error_t err,
-                                GpaKeyTable *keytable);
+struct waiter_s;
+static void release_waiter (struct waiter_s *waiter);
+struct request_s;
+static void release_request (struct request_s *req);
+static void next_request (GpaKeyTable *keytable);
+static void done_cb (GpaContext *context, gpg_error_t err,
+                     GpaKeyTable *keytable);
 static void next_key_cb (GpaContext *context, gpgme_key_t key,
 			 GpaKeyTable *keytable);
 
@@ -38,7 +43,38 @@ static void gpa_keytable_init (GpaKeyTable *keytable);
 static void gpa_keytable_class_init (GpaKeyTableClass *klass);
 static void gpa_keytable_finalize (GObject *object);
 
+/* Signals */
+enum
+{
+  READY,
+  KEYRING_CHANGED,
+  LAST_SIGNAL
+};
+
 static GObjectClass *parent_class = NULL;
+static guint signals [LAST_SIGNAL] = { 0 };
+
+/* A lookup waiting for the keytable to become ready.  Either LOOKUP
+   or READY is set.  */
+struct waiter_s
+{
+  gchar *fpr;
+  GpaKeyTableLookupFunc lookup;
+  GpaKeyTableEndFunc ready;
+  gpointer data;
+};
+
+/* A listing requested while another listing is running.  */
+struct request_s
+{
+  GpaKeyTableNextFunc next;
+  GpaKeyTableEndFunc end;
+  gpointer data;
+  gboolean use_cache;   /* List the cached keys if there are any.  */
+  gboolean new_key;
+  gchar *fpr;
+  gchar **patterns;
+};
 
 GType
 gpa_keytable_get_type (void)
@@ -76,6 +112,24 @@ gpa_keytable_class_init (GpaKeyTableClass *klass)
   parent_class = g_type_class_peek_parent (klass);
 
   object_class->finalize = gpa_keytable_finalize;
+
+  /* Signals */
+  signals[READY] =
+          g_signal_new ("ready",
+                        G_TYPE_FROM_CLASS (object_class),
+                        G_SIGNAL_RUN_FIRST,
+                        G_STRUCT_OFFSET (GpaKeyTableClass, ready),
+                        NULL, NULL,
+                        g_cclosure_marshal_VOID__VOID,
+                        G_TYPE_NONE, 0);
+  signals[KEYRING_CHANGED] =
+          g_signal_new ("keyring_changed",
+                        G_TYPE_FROM_CLASS (object_class),
+                        G_SIGNAL_RUN_FIRST,
+                        G_STRUCT_OFFSET (GpaKeyTableClass, keyring_changed),
+                        NULL, NULL,
+                        g_cclosure_marshal_VOID__VOID,
+                        G_TYPE_NONE, 0);
 }
 
 static void
@@ -86,20 +140,32 @@ gpa_keytable_init (GpaKeyTable *keytable)
   keytable->next = NULL;
   keytable->end = NULL;
   keytable->data = NULL;
-  keytable->did_first_half = 0;
-  keytable->first_half_err = 0;
+  keytable->pending = 0;
+  keytable->requests = g_queue_new ();
+  keytable->pgp_err = 0;
+  keytable->cms_err = 0;
   keytable->context = gpa_context_new ();
+  keytable->cms_context = NULL;
   keytable->keys = NULL;
   keytable->secret = FALSE;
   keytable->initialized = FALSE;
   keytable->new_key = FALSE;
   keytable->tmp_list = NULL;
+  keytable->cms_tmp_list = NULL;
+  keytable->patterns = NULL;
+  keytable->waiters = NULL;
+  keytable->fpr_index = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                               g_free, NULL);
+  keytable->keyid_index = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                 g_free, NULL);
+  keytable->keygrip_index = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                   g_free, NULL);
   /* Note, that the next_key and done signals are emitted by means of
      gpgme events with the help of gpacontext.c:gpa_context_event_cb.  */
   g_signal_connect (G_OBJECT (keytable->context), "next_key",
 		    G_CALLBACK (next_key_cb), keytable);
   g_signal_connect (G_OBJECT (keytable->context), "done",
-		    G_CALLBACK (first_half_done_cb), keytable);
+		    G_CALLBACK (done_cb), keytable);
 }
 
 static void
@@ -108,56 +174,267 @@ gpa_keytable_finalize (GObject *object)
   GpaKeyTable *keytable = GPA_KEYTABLE (object);
 
   g_object_unref (keytable->context);
+  if (keytable->cms_context)
+    g_object_unref (keytable->cms_context);
+  g_hash_table_destroy (keytable->fpr_index);
+  g_hash_table_destroy (keytable->keyid_index);
+  g_hash_table_destroy (keytable->keygrip_index);
+  g_strfreev (keytable->patterns);
   g_list_foreach (keytable->keys, (GFunc) gpgme_key_unref, NULL);
   g_list_free (keytable->keys);
+  g_list_foreach (keytable->waiters, (GFunc) release_waiter, NULL);
+  g_list_free (keytable->waiters);
+  g_queue_foreach (keytable->requests, (GFunc) release_request, NULL);
+  g_queue_free (keytable->requests);
 }
 
 /* Internal functions */
 
+/* Insert NAME into INDEX unless it is already there.  We keep the
+   first entry so that lookups return the same key a linear search
+   over the list would have returned.  */
 static void
-reload_cache (GpaKeyTable *keytable, const char *fpr)
+index_insert (GHashTable *index, const char *name, GList *link)
 {
-  gpg_error_t err;
+  if (name && *name && !g_hash_table_lookup (index, name))
+    g_hash_table_insert (index, g_strdup (name), link);
+}
 
-  /* We select the Open PGP protocol here.  At the end
-     first_half_done_cb will do another keylist_start for X,509.  */
-  keytable->did_first_half = 0;
-  keytable->first_half_err = 0;
-  keytable->fpr = fpr;
-  gpgme_set_protocol (keytable->context->ctx, GPGME_PROTOCOL_OpenPGP);
-  err = gpgme_op_keylist_start (keytable->context->ctx, fpr,
-				keytable->secret);
-  if (gpg_err_code (err) != GPG_ERR_NO_ERROR)
+
+/* Remove NAME from INDEX if it refers to LINK.  */
+static void
+index_remove (GHashTable *index, const char *name, GList *link)
+{
+  if (name && *name && g_hash_table_lookup (index, name) == link)
+    g_hash_table_remove (index, name);
+}
+
+
+/* Add the key stored at LINK to all indices.  */
+static void
+index_add_key (GpaKeyTable *keytable, GList *link)
+{
+  gpgme_key_t key = link->data;
+  gpgme_subkey_t subkey;
+
+  if (!key->subkeys)
+    return;
+
+  index_insert (keytable->fpr_index, key->subkeys->fpr, link);
+  for (subkey = key->subkeys; subkey; subkey = subkey->next)
     {
-      gpa_gpgme_warning (err);
-      if (keytable->end)
-	{
-	  keytable->end (keytable->data);
-	}
-      return;
+      index_insert (keytable->keyid_index, subkey->keyid, link);
+#ifdef GPGME_KEYLIST_MODE_WITH_KEYGRIP
+      index_insert (keytable->keygrip_index, subkey->keygrip, link);
+#endif
+    }
+}
+
+
+/* Remove the key stored at LINK from all indices.  */
+static void
+index_remove_key (GpaKeyTable *keytable, GList *link)
+{
+  gpgme_key_t key = link->data;
+  gpgme_subkey_t subkey;
+
+  if (!key->subkeys)
+    return;
+
+  index_remove (keytable->fpr_index, key->subkeys->fpr, link);
+  for (subkey = key->subkeys; subkey; subkey = subkey->next)
+    {
+      index_remove (keytable->keyid_index, subkey->keyid, link);
+#ifdef GPGME_KEYLIST_MODE_WITH_KEYGRIP
+      index_remove (keytable->keygrip_index, subkey->keygrip, link);
+#endif
+    }
+}
+
+
+/* Drop all indices and rebuild them from the list of keys.  */
+static void
+index_rebuild (GpaKeyTable *keytable)
+{
+  GList *link;
+
+  g_hash_table_remove_all (keytable->fpr_index);
+  g_hash_table_remove_all (keytable->keyid_index);
+  g_hash_table_remove_all (keytable->keygrip_index);
+  for (link = keytable->keys; link; link = g_list_next (link))
+    index_add_key (keytable, link);
+}
+
+
+/* Merge the freshly listed keys in TMP_LIST into the cache.  Keys
+   already in the cache are replaced in place, new keys are appended
+   in listing order.  */
+static void
+merge_new_keys (GpaKeyTable *keytable)
+{
+  GList *link, *next, *fresh = NULL;
+  GHashTable *listed = NULL;
+  int idx;
+
+  if (keytable->patterns)
+    listed = g_hash_table_new (g_str_hash, g_str_equal);
+
+  for (link = keytable->tmp_list; link; link = next)
+    {
+      gpgme_key_t key = link->data;
+      GList *old = NULL;
+
+      next = g_list_next (link);
+      if (key->subkeys)
+        old = g_hash_table_lookup (keytable->fpr_index, key->subkeys->fpr);
+      if (listed && key->subkeys && key->subkeys->fpr)
+        g_hash_table_insert (listed, key->subkeys->fpr, key);
+      if (old)
+        {
+          index_remove_key (keytable, old);
+          gpgme_key_unref ((gpgme_key_t) old->data);
+          old->data = key;
+          index_add_key (keytable, old);
+        }
+      else
+        fresh = g_list_prepend (fresh, key);
     }
+  g_list_free (keytable->tmp_list);
   keytable->tmp_list = NULL;
+
+  /* Remove keys we explicitly asked for but which have not been
+     listed; they have been deleted from the keyring.  */
+  if (listed)
+    {
+      for (idx = 0; keytable->patterns[idx]; idx++)
+        {
+          const char *fpr = keytable->patterns[idx];
+
+          if (g_hash_table_lookup (listed, fpr))
+            continue;
+          link = g_hash_table_lookup (keytable->fpr_index, fpr);
+          if (!link)
+            continue;
+          index_remove_key (keytable, link);
+          gpgme_key_unref ((gpgme_key_t) link->data);
+          keytable->keys = g_list_delete_link (keytable->keys, link);
+        }
+      g_hash_table_destroy (listed);
+    }
+
+  if (!fresh)
+    return;
+
+  /* FRESH is in reverse listing order; restore it and index the new
+     links after they have been attached to the cache.  */
+  fresh = g_list_reverse (fresh);
+  keytable->keys = g_list_concat (keytable->keys, fresh);
+  for (link = fresh; link; link = g_list_next (link))
+    index_add_key (keytable, link);
+}
+
+
+/* Start a key listing on CONTEXT.  */
+static gpg_error_t
+start_keylist (GpaKeyTable *keytable, GpaContext *context)
+{
+  if (keytable->patterns)
+    return gpgme_op_keylist_ext_start (context->ctx,
+                                       (const char **) keytable->patterns,
+                                       keytable->secret, 0);
+  else
+    return gpgme_op_keylist_start (context->ctx, keytable->fpr,
+                                   keytable->secret);
 }
 
+
+/* Return the context for X.509 listings, creating it if needed.  */
+static GpaContext *
+get_cms_context (GpaKeyTable *keytable)
+{
+  if (!keytable->cms_context)
+    {
+      keytable->cms_context = gpa_context_new ();
+      gpgme_set_protocol (keytable->cms_context->ctx, GPGME_PROTOCOL_CMS);
+      g_signal_connect (G_OBJECT (keytable->cms_context), "next_key",
+                        G_CALLBACK (next_key_cb), keytable);
+      g_signal_connect (G_OBJECT (keytable->cms_context), "done",
+                        G_CALLBACK (done_cb), keytable);
+    }
+  return keytable->cms_context;
+}
+
+
 static void
-done_cb (GpaContext *context, gpg_error_t err, GpaKeyTable *keytable)
+release_waiter (struct waiter_s *waiter)
 {
-  if (err || keytable->first_half_err)
+  g_free (waiter->fpr);
+  g_free (waiter);
+}
+
+
+/* Serve all queued lookups.  If the listing failed, the lookups get
+   no key.  */
+static void
+run_waiters (GpaKeyTable *keytable)
+{
+  GList *waiters, *item;
+
+  /* The callbacks may queue new lookups; thus we detach the list
+     first.  */
+  waiters = g_list_reverse (keytable->waiters);
+  keytable->waiters = NULL;
+  for (item = waiters; item; item = g_list_next (item))
+    {
+      struct waiter_s *waiter = item->data;
+
+      if (waiter->ready)
+        waiter->ready (waiter->data);
+      else
+        waiter->lookup (waiter->fpr,
+                        gpa_keytable_lookup_key (keytable, waiter->fpr),
+                        waiter->data);
+      release_waiter (waiter);
+    }
+  g_list_free (waiters);
+}
+
+
+/* All listings have finished; update the cache.  */
+static void
+finish_listing (GpaKeyTable *keytable)
+{
+  /* Reverse the lists to have the keys come up in the same order they
+   * were listed; OpenPGP keys first.  */
+  keytable->tmp_list = g_list_concat (g_list_reverse (keytable->tmp_list),
+                                      g_list_reverse (keytable->cms_tmp_list));
+  keytable->cms_tmp_list = NULL;
+
+  if (keytable->pgp_err || keytable->cms_err)
     {
-      if (keytable->first_half_err)
-        gpa_gpgme_warning (keytable->first_half_err);
-      if (err)
-        gpa_gpgme_warning (err);
+      if (keytable->pgp_err)
+        gpa_gpgme_warning (keytable->pgp_err);
+      if (keytable->cms_err)
+        gpa_gpgme_warning (keytable->cms_err);
+      g_list_foreach (keytable->tmp_list, (GFunc) gpgme_key_unref, NULL);
+      g_list_free (keytable->tmp_list);
+      keytable->tmp_list = NULL;
+      g_strfreev (keytable->patterns);
+      keytable->patterns = NULL;
+      if (keytable->end)
+	{
+	  keytable->end (keytable->data);
+	}
+      run_waiters (keytable);
+      next_request (keytable);
       return;
     }
-  /* Reverse the list to have the keys come up in the same order they
-   * were listed */
-  keytable->tmp_list = g_list_reverse (keytable->tmp_list);
+
   if (keytable->new_key)
     {
-      /* Append the new key(s)
+      /* Append the new key(s) or replace the cached versions.
        */
-      keytable->keys = g_list_concat (keytable->keys, keytable->tmp_list);
+      merge_new_keys (keytable);
     }
   else
     {
@@ -170,46 +447,47 @@ done_cb (GpaContext *context, gpg_error_t err, GpaKeyTable *keytable)
 	  g_list_free (keytable->keys);
 	}
       keytable->keys = keytable->tmp_list;
+      keytable->tmp_list = NULL;
+      index_rebuild (keytable);
     }
+  g_strfreev (keytable->patterns);
+  keytable->patterns = NULL;
+  keytable->new_key = FALSE;
   keytable->initialized = TRUE;
   if (keytable->end)
     {
       keytable->end (keytable->data);
     }
+  run_waiters (keytable);
+  g_signal_emit (keytable, signals[READY], 0);
+  next_request (keytable);
 }
 
 
+/* Start the OpenPGP and the X.509 listing.  Both run concurrently;
+   the results are merged by finish_listing when both are done.  */
 static void
-first_half_done_cb (GpaContext *context, gpg_error_t err,
-                    GpaKeyTable *keytable)
+reload_cache (GpaKeyTable *keytable, const char *fpr)
 {
-  if (keytable->did_first_half || !cms_hack)
-    {
-      /* We are here for the second time and thus we continue with the
-         real done handler.  We do this also if the CMS_HACK has not
-         been enabled.  We reset the protocol to OpenPGP because some
-         old code might assume that it is in OpenPGP mode.  */
-      keytable->fpr = NULL; /* Not needed anymore.  */
-      gpgme_set_protocol (keytable->context->ctx, GPGME_PROTOCOL_OpenPGP);
-      done_cb (context, err, keytable);
-      return;
-    }
+  gpg_error_t err;
 
-  /* Now continue with a key listing for X.509 keys but save the error
-     of the the PGP key listing.  */
-  keytable->first_half_err = err;
-  keytable->did_first_half = 1;
+  keytable->listing = TRUE;
+  keytable->pgp_err = 0;
+  keytable->cms_err = 0;
+  keytable->pending = 0;
+  keytable->tmp_list = NULL;
+  keytable->cms_tmp_list = NULL;
+  keytable->fpr = fpr;
 
-  gpgme_set_protocol (context->ctx, GPGME_PROTOCOL_CMS);
-  err = gpgme_op_keylist_start (keytable->context->ctx,
-                                keytable->fpr,
-				keytable->secret);
-  keytable->fpr = NULL; /* Not needed anymore.  */
+  err = start_keylist (keytable, keytable->context);
   if (err)
-    {
-      if (keytable->first_half_err)
-        gpa_gpgme_warning (keytable->first_half_err);
+    keytable->pgp_err = err;
+  else
+    keytable->pending++;
 
+  if (cms_hack)
+    {
+      err = start_keylist (keytable, get_cms_context (keytable));
       if ((gpg_err_code (err) == GPG_ERR_INV_ENGINE
            || gpg_err_code (err) == GPG_ERR_UNSUPPORTED_PROTOCOL)
           && gpg_err_source (err) == GPG_ERR_SOURCE_GPGME)
@@ -223,25 +501,45 @@ first_half_done_cb (GpaContext *context, gpg_error_t err,
                "Please install a CMS engine or invoke this program\n"
                "with the option --disable-x509 ."), NULL);
           cms_hack = 0;
-          err = 0;
         }
+      else if (err)
+        keytable->cms_err = err;
       else
-        gpa_gpgme_warning (err);
-      if (keytable->end)
-	{
-	  keytable->end (keytable->data);
-	}
+        keytable->pending++;
     }
+
+  keytable->fpr = NULL; /* Not needed anymore.  */
+  if (!keytable->pending)
+    finish_listing (keytable);
+}
+
+
+/* Called by the "done" signal of both contexts.  */
+static void
+done_cb (GpaContext *context, gpg_error_t err, GpaKeyTable *keytable)
+{
+  if (context == keytable->cms_context)
+    keytable->cms_err = err;
+  else
+    keytable->pgp_err = err;
+
+  if (keytable->pending > 0)
+    keytable->pending--;
+  if (!keytable->pending)
+    finish_listing (keytable);
 }
 
 
 static void
 next_key_cb (GpaContext *context, gpgme_key_t key, GpaKeyTable *keytable)
 {
-  keytable->tmp_list = g_list_prepend (keytable->tmp_list, key);
-  gpgme_key_ref (key);
+  if (context == keytable->cms_context)
+    keytable->cms_tmp_list = g_list_prepend (keytable->cms_tmp_list, key);
+  else
+    keytable->tmp_list = g_list_prepend (keytable->tmp_list, key);
   if (keytable->next)
     {
+      gpgme_key_ref (key);
       keytable->next (key, keytable->data);
     }
 }
@@ -307,6 +605,82 @@ GpaKeyTable *gpa_keytable_get_secret_instance ()
   return secret_instance;
 }
 
+static void
+release_request (struct request_s *req)
+{
+  g_free (req->fpr);
+  g_strfreev (req->patterns);
+  g_free (req);
+}
+
+
+/* Start the listing requested by REQ and release REQ.  */
+static void
+start_request (GpaKeyTable *keytable, struct request_s *req)
+{
+  /* Set up callbacks */
+  keytable->next = req->next;
+  keytable->end = req->end;
+  keytable->data = req->data;
+  /* List keys */
+  if (req->use_cache && keytable->keys)
+    {
+      /* There is a cached list */
+      list_cache (keytable);
+    }
+  else
+    {
+      keytable->new_key = req->new_key;
+      g_strfreev (keytable->patterns);
+      keytable->patterns = req->patterns;
+      req->patterns = NULL;
+      reload_cache (keytable, req->fpr);
+    }
+  release_request (req);
+}
+
+
+/* Start the listing requested by REQ, or queue it if a listing is
+   running.  Starting a listing while another one is running would
+   replace the callbacks and the temporary lists of the latter.  */
+static void
+submit_request (GpaKeyTable *keytable, struct request_s *req)
+{
+  if (keytable->listing)
+    g_queue_push_tail (keytable->requests, req);
+  else
+    start_request (keytable, req);
+}
+
+
+/* The current listing has finished; start the next queued one.  */
+static void
+next_request (GpaKeyTable *keytable)
+{
+  struct request_s *req;
+
+  keytable->listing = FALSE;
+  req = g_queue_pop_head (keytable->requests);
+  if (req)
+    start_request (keytable, req);
+}
+
+
+/* Return a new request for a listing.  */
+static struct request_s *
+new_request (GpaKeyTableNextFunc next, GpaKeyTableEndFunc end,
+             gpointer data)
+{
+  struct request_s *req;
+
+  req = g_malloc0 (sizeof *req);
+  req->next = next;
+  req->end = end;
+  req->data = data;
+  return req;
+}
+
+
 /* List all keys, return cached copies if they are available.
  *
  * The "next" function is called for every key, providing a new
@@ -315,7 +689,8 @@ GpaKeyTable *gpa_keytable_get_secret_instance ()
  * The "end" function is called when the listing is complete.
  *
  * This function MAY not do anything until the application goes back into
- * the GLib main loop.
+ * the GLib main loop.  If another listing is running, this one is
+ * started when the other has finished.
  */
 void
 gpa_keytable_list_keys (GpaKeyTable *keytable,
@@ -323,23 +698,14 @@ gpa_keytable_list_keys (GpaKeyTable *keytable,
                         GpaKeyTableEndFunc end,
                         gpointer data)
 {
+  struct request_s *req;
+
   g_return_if_fail (keytable != NULL);
   g_return_if_fail (GPA_IS_KEYTABLE (keytable));
 
-  /* Set up callbacks */
-  keytable->next = next;
-  keytable->end = end;
-  keytable->data = data;
-  /* List keys */
-  if (keytable->keys)
-    {
-      /* There is a cached list */
-      list_cache (keytable);
-    }
-  else
-    {
-      reload_cache (keytable, NULL);
-    }
+  req = new_request (next, end, data);
+  req->use_cache = TRUE;
+  submit_request (keytable, req);
 }
 
 /* Same as list_keys, but forces the internal cache to be rebuilt.
@@ -353,12 +719,7 @@ gpa_keytable_force_reload (GpaKeyTable *keytable,
   g_return_if_fail (keytable != NULL);
   g_return_if_fail (GPA_IS_KEYTABLE (keytable));
 
-  /* Set up callbacks */
-  keytable->next = next;
-  keytable->end = end;
-  keytable->data = data;
-  /* List keys */
-  reload_cache (keytable, NULL);
+  submit_request (keytable, new_request (next, end, data));
 }
 
 /* Load the key with the given fingerprint from GnuPG, replacing it in the
@@ -371,46 +732,242 @@ gpa_keytable_load_new (GpaKeyTable *keytable,
                        GpaKeyTableEndFunc end,
                        gpointer data)
 {
+  struct request_s *req;
+
   g_return_if_fail (keytable != NULL);
   g_return_if_fail (GPA_IS_KEYTABLE (keytable));
 
-  /* Set up callbacks */
-  keytable->next = next;
-  keytable->end = end;
-  keytable->data = data;
-  /* List keys */
-  keytable->new_key = TRUE;
-  reload_cache (keytable, fpr);
+  req = new_request (next, end, data);
+  req->new_key = TRUE;
+  req->fpr = g_strdup (fpr);
+  submit_request (keytable, req);
 }
 
-/* Return the key with a given fingerprint from the keytable, NULL if
-   there is none. No reference is provided.  */
-gpgme_key_t
-gpa_keytable_lookup_key (GpaKeyTable *keytable, const char *fpr)
+/* Load the keys with the fingerprints given by the NULL terminated
+ * array FPRS from GnuPG and update the keytable accordingly: Keys
+ * already in the keytable are replaced, new keys are added and keys
+ * which are not available anymore are removed.
+ */
+void
+gpa_keytable_reload_keys (GpaKeyTable *keytable,
+                          const char **fprs,
+                          GpaKeyTableNextFunc next,
+                          GpaKeyTableEndFunc end,
+                          gpointer data)
 {
-  if (keytable->initialized)
+  struct request_s *req;
+
+  g_return_if_fail (keytable != NULL);
+  g_return_if_fail (GPA_IS_KEYTABLE (keytable));
+  g_return_if_fail (fprs != NULL);
+
+  /* Nothing to do for an empty list.  */
+  if (!*fprs)
     {
-      GList *cur;
-      for (cur = keytable->keys; cur; cur = g_list_next (cur))
-	{
-	  gpgme_key_t key = (gpgme_key_t) cur->data;
-	  if (g_str_equal (fpr, key->subkeys->fpr))
-	    {
-	      return key;
-	    }
-	}
-      return NULL;
+      if (end)
+        end (data);
+      return;
     }
-  else
+
+  req = new_request (next, end, data);
+  req->new_key = TRUE;
+  req->patterns = g_strdupv ((gchar **) fprs);
+  submit_request (keytable, req);
+}
+
+
+/* Queue WAITER until KEYTABLE is ready and start a listing unless
+   one is already running.  */
+static void
+add_waiter (GpaKeyTable *keytable, struct waiter_s *waiter)
+{
+  keytable->waiters = g_list_prepend (keytable->waiters, waiter);
+  if (!keytable->listing)
     {
-      /* There is no list yet. We really, really, need to one, so we list it.
-       * FIXME: This is a hack and a basic problem. Hopefully it won't cause
-       * any real problems.
-       */
-      keytable->end = (GpaKeyTableEndFunc) gtk_main_quit;
-      reload_cache (keytable, NULL);
-      gtk_main ();
+      /* Nobody is listing the keys; do it ourselves.  */
+      keytable->next = NULL;
       keytable->end = NULL;
-      return gpa_keytable_lookup_key (keytable, fpr);
+      keytable->data = NULL;
+      keytable->new_key = FALSE;
+      reload_cache (keytable, NULL);
+    }
+}
+
+
+/* Remove the keys with the fingerprints given by the NULL terminated
+   array FPRS from KEYTABLE.  This is used after these keys have been
+   deleted from the keyring.  */
+void
+gpa_keytable_remove_keys (GpaKeyTable *keytable, const char **fprs)
+{
+  GList *link;
+  int idx;
+
+  g_return_if_fail (GPA_IS_KEYTABLE (keytable));
+  g_return_if_fail (fprs != NULL);
+
+  for (idx = 0; fprs[idx]; idx++)
+    {
+      link = g_hash_table_lookup (keytable->fpr_index, fprs[idx]);
+      if (!link)
+        continue;
+      index_remove_key (keytable, link);
+      gpgme_key_unref ((gpgme_key_t) link->data);
+      keytable->keys = g_list_delete_link (keytable->keys, link);
+    }
+}
+
+
+/* Call FUNC with each cached key of KEYTABLE and DATA.  No reference
+   is provided.  */
+void
+gpa_keytable_foreach (GpaKeyTable *keytable,
+                      GpaKeyTableNextFunc func, gpointer data)
+{
+  GList *item;
+
+  g_return_if_fail (GPA_IS_KEYTABLE (keytable));
+  g_return_if_fail (func != NULL);
+
+  for (item = keytable->keys; item; item = g_list_next (item))
+    func ((gpgme_key_t) item->data, data);
+}
+
+
+/* Return true if the keys have been listed and the lookup functions
+   may be used.  */
+gboolean
+gpa_keytable_is_ready (GpaKeyTable *keytable)
+{
+  g_return_val_if_fail (GPA_IS_KEYTABLE (keytable), FALSE);
+
+  return keytable->initialized;
+}
+
+
+/* Call FUNC with DATA as soon as the keys have been listed.  FUNC is
+   called right away if the keytable is already ready; it is also
+   called if the listing failed.  A listing is started if needed.  */
+void
+gpa_keytable_when_ready (GpaKeyTable *keytable,
+                         GpaKeyTableEndFunc func, gpointer data)
+{
+  struct waiter_s *waiter;
+
+  g_return_if_fail (GPA_IS_KEYTABLE (keytable));
+  g_return_if_fail (func != NULL);
+
+  if (keytable->initialized)
+    {
+      func (data);
+      return;
+    }
+
+  waiter = g_malloc0 (sizeof *waiter);
+  waiter->ready = func;
+  waiter->data = data;
+  add_waiter (keytable, waiter);
+}
+
+
+/* Look up the key with the fingerprint FPR and pass it to FUNC along
+   with DATA.  If the keytable is not yet ready, the lookup is queued
+   until the listing has finished.  */
+void
+gpa_keytable_lookup_key_async (GpaKeyTable *keytable, const char *fpr,
+                               GpaKeyTableLookupFunc func, gpointer data)
+{
+  struct waiter_s *waiter;
+
+  g_return_if_fail (GPA_IS_KEYTABLE (keytable));
+  g_return_if_fail (func != NULL);
+
+  if (keytable->initialized)
+    {
+      func (fpr, gpa_keytable_lookup_key (keytable, fpr), data);
+      return;
     }
+
+  waiter = g_malloc0 (sizeof *waiter);
+  waiter->fpr = g_strdup (fpr);
+  waiter->lookup = func;
+  waiter->data = data;
+  add_waiter (keytable, waiter);
+}
+
+
+/* Remove all queued lookups and ready callbacks using DATA.  This
+   must be called before DATA is destroyed.  */
+void
+gpa_keytable_cancel_lookups (GpaKeyTable *keytable, gpointer data)
+{
+  GList *item, *next;
+
+  g_return_if_fail (GPA_IS_KEYTABLE (keytable));
+
+  for (item = keytable->waiters; item; item = next)
+    {
+      struct waiter_s *waiter = item->data;
+
+      next = g_list_next (item);
+      if (waiter->data == data)
+        {
+          release_waiter (waiter);
+          keytable->waiters = g_list_delete_link (keytable->waiters, item);
+        }
+    }
+}
+
+
+/* Return the key stored under NAME in INDEX of KEYTABLE.  */
+static gpgme_key_t
+lookup_in_index (GpaKeyTable *keytable, GHashTable *index, const char *name)
+{
+  GList *link;
+
+  if (!keytable->initialized || !name)
+    return NULL;
+  link = g_hash_table_lookup (index, name);
+  return link? (gpgme_key_t) link->data : NULL;
+}
+
+
+/* Return the key with a given fingerprint from the keytable, NULL if
+   there is none or the keytable is not yet ready.  This function
+   never waits for a listing; use gpa_keytable_lookup_key_async if
+   the keytable might not be ready.  No reference is provided.  */
+gpgme_key_t
+gpa_keytable_lookup_key (GpaKeyTable *keytable, const char *fpr)
+{
+  return lookup_in_index (keytable, keytable->fpr_index, fpr);
+}
+
+
+/* Return the key with a given key ID (of the primary key or any
+   subkey) from the keytable, NULL if there is none or the keytable
+   is not yet ready.  No reference is provided.  */
+gpgme_key_t
+gpa_keytable_lookup_key_by_keyid (GpaKeyTable *keytable, const char *keyid)
+{
+  return lookup_in_index (keytable, keytable->keyid_index, keyid);
+}
+
+
+/* Return the key owning the subkey with the given keygrip from the
+   keytable, NULL if there is none, the keytable is not yet ready or
+   keygrips are not supported by GPGME.  No reference is provided.  */
+gpgme_key_t
+gpa_keytable_lookup_key_by_keygrip (GpaKeyTable *keytable,
+                                    const char *keygrip)
+{
+  return lookup_in_index (keytable, keytable->keygrip_index, keygrip);
+}
+
+
+/* Emit the "keyring_changed" signal of the public keytable.  */
+void
+gpa_keytable_keyring_changed (void)
+{
+  g_signal_emit (gpa_keytable_get_public_instance (),
+                 signals[KEYRING_CHANGED], 0);
 }
@@ -42,11 +42,18 @@ typedef struct _GpaKeyTableClass GpaKeyTableClass;
 
 typedef void (*GpaKeyTableNextFunc) (gpgme_key_t key, gpointer data);
 typedef void (*GpaKeyTableEndFunc) (gpointer data);
+/* Called with the key matching FPR or NULL if there is none.  No
+   reference is provided.  */
+typedef void (*GpaKeyTableLookupFunc) (const char *fpr, gpgme_key_t key,
+                                       gpointer data);
 
 struct _GpaKeyTable {
   GObject parent;
 
+  /* The contexts used for OpenPGP and X.509 listings.  Both listings
+     run concurrently.  CMS_CONTEXT is NULL if X.509 is disabled.  */
   GpaContext *context;
+  GpaContext *cms_context;
 
   gboolean secret;
   gboolean new_key;
@@ -55,14 +62,42 @@ struct _GpaKeyTable {
   GpaKeyTableEndFunc end;
   gpointer data;
   const char *fpr;
-  int did_first_half;
-  gpg_error_t first_half_err;
-
-  GList *keys, *tmp_list;
+  /* If not NULL, a NULL terminated array with the fingerprints to
+     list.  Cached keys matching one of them but not listed anymore
+     are removed from the cache.  */
+  gchar **patterns;
+  /* The number of listings still running.  */
+  int pending;
+  /* True from the start of a listing until its callbacks have been
+     called.  */
+  gboolean listing;
+  /* Listings requested while LISTING was set; they are started one
+     after the other.  */
+  GQueue *requests;
+  /* The errors of the OpenPGP and the X.509 listings.  */
+  gpg_error_t pgp_err;
+  gpg_error_t cms_err;
+
+  GList *keys, *tmp_list, *cms_tmp_list;
+
+  /* Indices into KEYS.  They map the fingerprint of the primary key,
+     the key IDs of all subkeys and (if available) the keygrips of
+     all subkeys to the GList link holding the key.  The strings are
+     owned by the hash tables.  */
+  GHashTable *fpr_index;
+  GHashTable *keyid_index;
+  GHashTable *keygrip_index;
+
+  /* Lookups waiting for the first listing to finish.  */
+  GList *waiters;
 };
 
 struct _GpaKeyTableClass {
   GObjectClass parent_class;
+
+  /* Signal handlers */
+  void (*ready) (GpaKeyTable *keytable);
+  void (*keyring_changed) (GpaKeyTable *keytable);
 };
 
 GType gpa_keytable_get_type (void) G_GNUC_CONST;
@@ -104,8 +139,70 @@ void gpa_keytable_load_new (GpaKeyTable *keytable,
 			    GpaKeyTableEndFunc end,
 			    gpointer data);
 
+/* Load the keys with the fingerprints given by the NULL terminated
+ * array FPRS from GnuPG and update the keytable accordingly: Keys
+ * already in the keytable are replaced, new keys are added and keys
+ * which are not available anymore are removed.
+ */
+void gpa_keytable_reload_keys (GpaKeyTable *keytable,
+                               const char **fprs,
+                               GpaKeyTableNextFunc next,
+                               GpaKeyTableEndFunc end,
+                               gpointer data);
+
+/* Remove the keys with the fingerprints given by the NULL terminated
+ * array FPRS from the keytable without listing anything.
+ */
+void gpa_keytable_remove_keys (GpaKeyTable *keytable, const char **fprs);
+
+/* Call FUNC with each key of the keytable and DATA.  No reference
+ * is provided and FUNC must not change the keytable.
+ */
+void gpa_keytable_foreach (GpaKeyTable *keytable,
+                           GpaKeyTableNextFunc func, gpointer data);
+
+/* Return true if the keys have been listed and the lookup functions
+   may be used.  */
+gboolean gpa_keytable_is_ready (GpaKeyTable *keytable);
+
+/* Call FUNC with DATA as soon as the keys have been listed.  FUNC is
+   called right away if the keytable is already ready; it is also
+   called if the listing failed.  A listing is started if needed.  */
+void gpa_keytable_when_ready (GpaKeyTable *keytable,
+                              GpaKeyTableEndFunc func, gpointer data);
+
+/* Look up the key with the fingerprint FPR and pass it to FUNC along
+   with DATA.  If the keytable is not yet ready, the lookup is queued
+   until the listing has finished.  */
+void gpa_keytable_lookup_key_async (GpaKeyTable *keytable, const char *fpr,
+                                    GpaKeyTableLookupFunc func,
+                                    gpointer data);
+
+/* Remove all queued lookups and ready callbacks using DATA.  This
+   must be called before DATA is destroyed.  */
+void gpa_keytable_cancel_lookups (GpaKeyTable *keytable, gpointer data);
+
 /* Return the key with a given fingerprint from the keytable, NULL if
-   there is none. No reference is provided.  */
+   there is none or the keytable is not yet ready.  This function
+   never waits for a listing; use gpa_keytable_lookup_key_async if
+   the keytable might not be ready.  No reference is provided.  */
 gpgme_key_t gpa_keytable_lookup_key (GpaKeyTable *keytable, const char *fpr);
 
+/* Return the key with a given key ID (of the primary key or any
+   subkey) from the keytable, NULL if there is none or the keytable
+   is not yet ready.  No reference is provided.  */
+gpgme_key_t gpa_keytable_lookup_key_by_keyid (GpaKeyTable *keytable,
+                                              const char *keyid);
+
+/* Return the key owning the subkey with the given keygrip from the
+   keytable, NULL if there is none, the keytable is not yet ready or
+   keygrips are not supported by GPGME.  No reference is provided.  */
+gpgme_key_t gpa_keytable_lookup_key_by_keygrip (GpaKeyTable *keytable,
+                                                const char *keygrip);
+
+/* Tell the users of keys that GPA has changed the keyring.  This
+   emits the "keyring_changed" signal of the public keytable; caches
+   of keys connect to it.  It does not reload any keys.  */
+void gpa_keytable_keyring_changed (void);
+
 #endif /* KEYTABLE_H */
@@ -30,6 +30,9 @@
 #include <string.h>
 #include <errno.h>
 #include <ctype.h>
+#ifdef G_OS_UNIX
+#include <unistd.h>
+#endif
 
 #include "confdialog.h" /* gpa_read_configured_keyserver */
 
@@ -51,6 +54,7 @@ enum
   CHANGED_DEFAULT_KEYSERVER,
   CHANGED_BACKUP_GENERATED,
   CHANGED_VIEW,
+  CHANGED_AUTO_REFRESH,
   LAST_SIGNAL
 };
 
@@ -116,6 +120,7 @@ gpa_options_class_init (GpaOptionsClass *klass)
   klass->changed_default_keyserver = gpa_options_save_settings;
   klass->changed_backup_generated = gpa_options_save_settings;
   klass->changed_view = gpa_options_save_settings;
+  klass->changed_auto_refresh = gpa_options_save_settings;
 
   /* Signals */
   make_signal (CHANGED_UI_MODE, object_class,
@@ -137,6 +142,9 @@ gpa_options_class_init (GpaOptionsClass *klass)
   make_signal (CHANGED_BACKUP_GENERATED, object_class,
                "changed_backup_generated",
                G_STRUCT_OFFSET (GpaOptionsClass, changed_backup_generated));
+  make_signal (CHANGED_AUTO_REFRESH, object_class,
+               "changed_auto_refresh",
+               G_STRUCT_OFFSET (GpaOptionsClass, changed_auto_refresh));
 }
 
 static void
@@ -150,6 +158,9 @@ gpa_options_init (GpaOptions *options)
   options->default_key_fpr = NULL;
   options->default_keyserver = NULL;
   options->detailed_view = FALSE;
+  options->auto_refresh_days = 0;
+  options->max_jobs = 0;
+  options->server_threads = FALSE;
 }
 
 static void
@@ -414,6 +425,56 @@ gpa_options_get_backup_generated (GpaOptions *options)
   return options->backup_generated;
 }
 
+/* Set the number of days after which a key is refreshed from the
+   keyserver.  0 disables the scheduled refresh.  */
+void
+gpa_options_set_auto_refresh_days (GpaOptions *options, gint days)
+{
+  int change;
+
+  if (days < 0)
+    days = 0;
+  change = (options->auto_refresh_days != days);
+  options->auto_refresh_days = days;
+  if (change)
+    g_signal_emit (options, signals[CHANGED_AUTO_REFRESH], 0);
+}
+
+gint
+gpa_options_get_auto_refresh_days (GpaOptions *options)
+{
+  return options->auto_refresh_days;
+}
+
+/* Return the number of online processors.  */
+static gint
+get_processor_count (void)
+{
+#if GLIB_CHECK_VERSION (2, 36, 0)
+  return g_get_num_processors ();
+#elif defined (G_OS_UNIX) && defined (_SC_NPROCESSORS_ONLN)
+  long n = sysconf (_SC_NPROCESSORS_ONLN);
+
+  return n > 0? (gint) n : 1;
+#else
+  return 1;
+#endif
+}
+
+gint
+gpa_options_get_max_jobs (GpaOptions *options)
+{
+  if (options->max_jobs > 0)
+    return options->max_jobs;
+  return get_processor_count ();
+}
+
+gboolean
+gpa_options_get_server_threads (GpaOptions *options)
+{
+  return options->server_threads;
+}
+
 static void
 gpa_options_save_settings (GpaOptions *options)
 {
@@ -454,6 +515,19 @@ gpa_options_save_settings (GpaOptions *options)
         {
           fprintf (options_file, "%s\n", "detailed-view");
         }
+      if (options->auto_refresh_days)
+        {
+          fprintf (options_file, "auto-refresh-days %d\n",
+                   options->auto_refresh_days);
+        }
+      if (options->max_jobs)
+        {
+          fprintf (options_file, "max-jobs %d\n", options->max_jobs);
+        }
+      if (options->server_threads)
+        {
+          fprintf (options_file, "%s\n", "server-threads");
+        }
       fclose (options_file);
     }
 
@@ -496,6 +570,8 @@ typedef enum
    PARSE_OPTIONS_STATE_START,
    PARSE_OPTIONS_STATE_HAVE_KEY,
    PARSE_OPTIONS_STATE_HAVE_KEYSERVER,
+   PARSE_OPTIONS_STATE_HAVE_REFRESH_DAYS,
+   PARSE_OPTIONS_STATE_HAVE_MAX_JOBS,
  } ParseOptionsState;
 
 /* This MUST be called ONLY from gpa_options_new (). We don't emit any
@@ -552,6 +628,18 @@ gpa_options_read_settings (GpaOptions *options)
                 {
                   options->detailed_view = TRUE;
                 }
+              else if (g_str_equal (next_word, "auto-refresh-days"))
+                {
+                  state = PARSE_OPTIONS_STATE_HAVE_REFRESH_DAYS;
+                }
+              else if (g_str_equal (next_word, "max-jobs"))
+                {
+                  state = PARSE_OPTIONS_STATE_HAVE_MAX_JOBS;
+                }
+              else if (g_str_equal (next_word, "server-threads"))
+                {
+                  options->server_threads = TRUE;
+                }
               break;
             case PARSE_OPTIONS_STATE_HAVE_KEY:
               options->default_key_fpr = g_strdup (next_word);
@@ -562,6 +650,14 @@ gpa_options_read_settings (GpaOptions *options)
               /* options->default_keyserver = g_strdup (next_word); */
               state = PARSE_OPTIONS_STATE_START;
               break;
+            case PARSE_OPTIONS_STATE_HAVE_REFRESH_DAYS:
+              options->auto_refresh_days = MAX (0, atoi (next_word));
+              state = PARSE_OPTIONS_STATE_START;
+              break;
+            case PARSE_OPTIONS_STATE_HAVE_MAX_JOBS:
+              options->max_jobs = MAX (0, atoi (next_word));
+              state = PARSE_OPTIONS_STATE_START;
+              break;
             default:
               /* Can't happen */
               return;
@@ -50,6 +50,17 @@ struct _GpaOptions {
   gchar *default_keyserver;
 
   gboolean detailed_view;
+
+  /* Refresh all keys from the keyserver every that many days.  0
+     disables the scheduled refresh.  */
+  gint auto_refresh_days;
+
+  /* The maximum number of backend processes an operation may run at
+     the same time.  0 uses the number of processors.  */
+  gint max_jobs;
+
+  /* Run the non-interactive UI server commands in threads.  */
+  gboolean server_threads;
 };
 
 struct _GpaOptionsClass {
@@ -62,6 +73,7 @@ struct _GpaOptionsClass {
   void (*changed_default_keyserver) (GpaOptions *options);
   void (*changed_backup_generated) (GpaOptions *options);
   void (*changed_view) (GpaOptions *options);
+  void (*changed_auto_refresh) (GpaOptions *options);
 };
 
 GType gpa_options_get_type (void) G_GNUC_CONST;
@@ -109,5 +121,17 @@ gboolean gpa_options_get_backup_generated (GpaOptions *options);
 void gpa_options_set_detailed_view (GpaOptions *options, gboolean value);
 gboolean gpa_options_get_detailed_view (GpaOptions *options);
 
+/* Set the number of days after which a key is refreshed from the
+   keyserver.  0 disables the scheduled refresh.  */
+void gpa_options_set_auto_refresh_days (GpaOptions *options, gint days);
+gint gpa_options_get_auto_refresh_days (GpaOptions *options);
+
+/* Return the maximum number of backend processes an operation may
+   run at the same time.  This is always at least 1.  */
+gint gpa_options_get_max_jobs (GpaOptions *options);
+
+/* Return true if the UI server may run commands in threads.  */
+gboolean gpa_options_get_server_threads (GpaOptions *options);
+
 #endif /*OPTIONS_H*/
 
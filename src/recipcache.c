@@ -0,0 +1,207 @@
+/* recipcache.c - Cache of the keys found for mail addresses.
+   Copyright (C) 2026 g10 Code GmbH.
+
+   This file is part of GPA
+
+   GPA is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   GPA is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+   License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.  */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <string.h>
+#include <time.h>
+#include <glib.h>
+#include <gpgme.h>
+
+#include "keytable.h"
+#include "recipcache.h"
+
+
+/* Entries with keys are dropped after this many seconds.  Changes
+   by GPA clear the cache; this catches changes by other programs.  */
+#define CACHE_TTL (30 * 60)
+
+/* Entries without a key are dropped earlier because a key may be
+   located on a keyserver at any time.  */
+#define CACHE_TTL_NO_KEY (5 * 60)
+
+
+/* An entry of the cache.  */
+struct entry_s
+{
+  /* NULL terminated array of keys.  */
+  gpgme_key_t *keys;
+
+  /* The time the entry becomes invalid.  */
+  time_t expires;
+};
+
+
+/* The table mapping the protocol and the normalized mailbox to an
+   entry.  */
+static GHashTable *cache;
+
+/* True if we are connected to the "keyring_changed" signal.  */
+static gboolean connected;
+
+
+static void
+release_entry (struct entry_s *entry)
+{
+  int idx;
+
+  for (idx = 0; entry->keys[idx]; idx++)
+    gpgme_key_unref (entry->keys[idx]);
+  g_free (entry->keys);
+  g_free (entry);
+}
+
+
+gchar *
+gpa_recipcache_address (const char *mailbox)
+{
+  const char *s, *e;
+
+  s = strchr (mailbox, '<');
+  if (s)
+    {
+      s++;
+      e = strchr (s, '>');
+      if (!e)
+        e = s + strlen (s);
+    }
+  else
+    {
+      s = mailbox;
+      e = s + strlen (s);
+    }
+  if (!memchr (s, '@', e - s))
+    return NULL;
+  return g_ascii_strdown (s, e - s);
+}
+
+
+/* Return the key of the table for MAILBOX and PROTOCOL.  The caller
+   must free the result.  */
+static gchar *
+make_key (const char *mailbox, gpgme_protocol_t protocol)
+{
+  gchar *address, *folded, *key;
+
+  address = gpa_recipcache_address (mailbox);
+  if (address)
+    {
+      key = g_strdup_printf ("%d:%s", protocol, address);
+      g_free (address);
+    }
+  else
+    {
+      folded = g_utf8_casefold (mailbox, -1);
+      key = g_strdup_printf ("%d:%s", protocol, folded);
+      g_free (folded);
+    }
+  return key;
+}
+
+
+gboolean
+gpa_recipcache_get (const char *mailbox, gpgme_protocol_t protocol,
+                    gpgme_key_t **r_keys)
+{
+  struct entry_s *entry;
+  gchar *key;
+  int idx;
+
+  *r_keys = NULL;
+  if (!cache)
+    return FALSE;
+
+  key = make_key (mailbox, protocol);
+  entry = g_hash_table_lookup (cache, key);
+  if (entry && entry->expires <= time (NULL))
+    {
+      g_hash_table_remove (cache, key);
+      entry = NULL;
+    }
+  g_free (key);
+  if (!entry)
+    return FALSE;
+
+  for (idx = 0; entry->keys[idx]; idx++)
+    ;
+  *r_keys = g_new (gpgme_key_t, idx + 1);
+  for (idx = 0; entry->keys[idx]; idx++)
+    {
+      gpgme_key_ref (entry->keys[idx]);
+      (*r_keys)[idx] = entry->keys[idx];
+    }
+  (*r_keys)[idx] = NULL;
+
+  return TRUE;
+}
+
+
+void
+gpa_recipcache_put (const char *mailbox, gpgme_protocol_t protocol,
+                    gpgme_key_t *keys)
+{
+  struct entry_s *entry;
+  gpgme_subkey_t subkey;
+  time_t now = time (NULL);
+  int nkeys, idx;
+
+  if (!cache)
+    cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                   (GDestroyNotify) release_entry);
+  if (!connected)
+    {
+      g_signal_connect (gpa_keytable_get_public_instance (),
+                        "keyring_changed",
+                        G_CALLBACK (gpa_recipcache_clear), NULL);
+      connected = TRUE;
+    }
+
+  for (nkeys = 0; keys && keys[nkeys]; nkeys++)
+    ;
+
+  entry = g_malloc0 (sizeof *entry);
+  entry->keys = g_new (gpgme_key_t, nkeys + 1);
+  entry->expires = now + (nkeys? CACHE_TTL : CACHE_TTL_NO_KEY);
+  for (idx = 0; idx < nkeys; idx++)
+    {
+      gpgme_key_ref (keys[idx]);
+      entry->keys[idx] = keys[idx];
+
+      /* The entry is not valid beyond the expiration of a key.  */
+      for (subkey = keys[idx]->subkeys; subkey; subkey = subkey->next)
+        if (subkey->can_encrypt && subkey->expires > 0
+            && subkey->expires < entry->expires)
+          entry->expires = subkey->expires;
+    }
+  entry->keys[nkeys] = NULL;
+
+  g_hash_table_replace (cache, make_key (mailbox, protocol), entry);
+}
+
+
+void
+gpa_recipcache_clear (void)
+{
+  if (cache)
+    {
+      g_hash_table_destroy (cache);
+      cache = NULL;
+    }
+}
@@ -0,0 +1,51 @@
+/* recipcache.h - Cache of the keys found for mail addresses.
+   Copyright (C) 2026 g10 Code GmbH.
+
+   This file is part of GPA
+
+   GPA is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   GPA is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+   License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.  */
+
+/* The recipient cache remembers the candidate keys found for a
+   mailbox and protocol so that the same recipients can be resolved
+   again without running the backend.  The cache is cleared whenever
+   GPA changes the keyring (import, delete, edit, generate, refresh).
+   Entries are also dropped when one of their keys expires and after
+   a while to catch changes made by other programs.  */
+
+#ifndef RECIPCACHE_H
+#define RECIPCACHE_H
+
+#include <glib.h>
+#include <gpgme.h>
+
+/* Return the lowercased mail address of MAILBOX or NULL if MAILBOX
+   does not look like a mail address.  The caller must free the
+   result.  */
+gchar *gpa_recipcache_address (const char *mailbox);
+
+/* Look up MAILBOX for PROTOCOL.  Returns FALSE if it is not cached.
+   Otherwise a NULL terminated array with new references of the
+   candidate keys is stored at R_KEYS; the array may be empty.  */
+gboolean gpa_recipcache_get (const char *mailbox, gpgme_protocol_t protocol,
+                             gpgme_key_t **r_keys);
+
+/* Store the NULL terminated array KEYS as the candidate keys of
+   MAILBOX for PROTOCOL.  KEYS may be NULL if no key was found.  */
+void gpa_recipcache_put (const char *mailbox, gpgme_protocol_t protocol,
+                         gpgme_key_t *keys);
+
+/* Drop all entries.  This is called when the keyring changed.  */
+void gpa_recipcache_clear (void);
+
+#endif /*RECIPCACHE_H*/
@@ -26,10 +26,16 @@
 #include "i18n.h"
 
 #include "gtktools.h"
+#include "gpacontext.h"
+#include "recipcache.h"
 #include "selectkeydlg.h"
 #include "recipientdlg.h"
 
 
+/* Forward declaration.  */
+struct lookup_s;
+
+
 struct _RecipientDlg
 {
   GtkDialog parent;
@@ -56,6 +62,9 @@ struct _RecipientDlg
 
   /* The selected protocol.  This is also set by update_statushint.  */
   gpgme_protocol_t selected_protocol;
+
+  /* The running lookup of the recipients' keys or NULL.  */
+  struct lookup_s *lookup;
 };
 
 
@@ -96,6 +105,9 @@ struct keyinfo_s
 
   /* If set, indicates that the KEYS array has been truncated.  */
   int truncated:1;
+
+  /* If set, the keys are still being looked up.  */
+  int pending:1;
 };
 
 
@@ -119,6 +131,50 @@ struct userdata_s
 };
 
 
+/* A row of the recipient list as seen by a lookup.  */
+struct lookup_row_s
+{
+  struct userdata_s *info;
+  GtkTreeIter iter;
+
+  /* The key last added to the row.  This is used to add a key only
+     once even if several user IDs match.  */
+  gpgme_key_t last_key;
+};
+
+
+/* An asynchronous lookup of the keys for all recipients.  All
+   mailboxes not found in the recipient cache are passed in one
+   keylisting per protocol; both protocols run at the same time.  The
+   found keys are assigned to the rows by their mail addresses.  */
+struct lookup_s
+{
+  /* The dialog or NULL if the lookup has been canceled.  */
+  RecipientDlg *dialog;
+  GtkListStore *store;
+
+  GpaContext *pgp_ctx;
+  GpaContext *cms_ctx;
+
+  /* Number of keylistings still running.  */
+  int running;
+
+  /* The mailboxes to look up for each protocol.  */
+  char **pgp_patterns;
+  char **cms_patterns;
+
+  /* All rows (struct lookup_row_s).  */
+  GSList *all_rows;
+
+  /* A table mapping lowercased mail addresses to a list of rows.  */
+  GHashTable *rows;
+
+  /* Rows whose mailbox is not a mail address.  They are matched by
+     substring.  */
+  GSList *other_rows;
+};
+
+
 /* Identifiers for the columns of the RECPLIST.  */
 enum
   {
@@ -225,6 +281,7 @@ update_statushint (RecipientDlg *dialog)
   GtkTreeModel *model;
   GtkTreeIter iter;
   int missing_keys = 0;
+  int pending_keys = 0;
   int ambiguous_pgp_keys = 0;
   int ambiguous_x509_keys = 0;
   int n_pgp_keys = 0;
@@ -264,6 +321,8 @@ update_statushint (RecipientDlg *dialog)
             missing_keys++;  /* Oops */
           else if (info->ignore_recipient)
             ;
+          else if (info->pgp.pending || info->x509.pending)
+            pending_keys++;
           else if (!info->pgp.keys && !info->x509.keys)
             missing_keys++;
           else if ((req_protocol == GPGME_PROTOCOL_OpenPGP && !has_pgp)
@@ -302,7 +361,9 @@ update_statushint (RecipientDlg *dialog)
     sel_protocol = req_protocol;
 
 
-  if (missing_keys)
+  if (pending_keys)
+    hint = _("Looking up the keys of the recipients...");
+  else if (missing_keys)
     hint = _("You need to select a key for each recipient.\n"
              "To select a key right-click on the respective line.");
   else if ((sel_protocol == GPGME_PROTOCOL_OpenPGP
@@ -435,6 +496,8 @@ update_recplist_row (GtkListStore *store, GtkTreeIter *iter,
       key = info->x509.keys[0];
       infostr = gpa_gpgme_key_get_userid (key->uids);
     }
+  else if (info->pgp.pending || info->x509.pending)
+    infostr = g_strdup (_("[Looking up keys...]"));
   else
     infostr = g_strdup (_("[Right-click to select]"));
 
@@ -461,104 +524,344 @@ update_recplist_row (GtkListStore *store, GtkTreeIter *iter,
 }
 
 
-/* Parse one recipient, this is the working horse of parse_recipeints. */
+/* Add KEY to the row ROW of LOOKUP.  */
 static void
-parse_one_recipient (gpgme_ctx_t ctx, GtkListStore *store, GtkTreeIter *iter,
-                     struct userdata_s *info)
+lookup_add_key (struct lookup_s *lookup, struct lookup_row_s *row,
+                gpgme_key_t key)
 {
-  static int have_locate = -1;
-  gpgme_key_t key = NULL;
-  gpgme_keylist_mode_t mode;
+  struct keyinfo_s *keyinfo;
+
+  if (key->protocol == GPGME_PROTOCOL_CMS)
+    keyinfo = &row->info->x509;
+  else
+    keyinfo = &row->info->pgp;
+
+  /* Keys selected by the user are not touched.  */
+  if (!keyinfo->pending || keyinfo->truncated || row->last_key == key)
+    return;
+  row->last_key = key;
+
+  gpgme_key_ref (key);
+  if (append_key_to_keyinfo (keyinfo, key) >= TRUNCATE_KEYSEARCH_AT)
+    {
+      /* Note that the truncation flag is not 100% correct.  In case
+         no other key would be found we have not actually truncated
+         the search.  */
+      keyinfo->truncated = 1;
+    }
+  update_recplist_row (lookup->store, &row->iter, row->info);
+}
 
-  if (have_locate == -1)
-    have_locate = is_gpg_version_at_least ("2.0.10");
 
-  g_return_if_fail (info);
+/* A key has been listed.  Assign it to the matching rows.  We own
+   KEY; the rows take their own references.  */
+static void
+lookup_next_key_cb (GpaContext *context, gpgme_key_t key,
+                    struct lookup_s *lookup)
+{
+  gpgme_user_id_t uid;
+  GSList *item;
 
-  clear_keyinfo (&info->pgp);
-  gpgme_set_protocol (ctx, GPGME_PROTOCOL_OpenPGP);
-  mode = gpgme_get_keylist_mode (ctx);
-  if (have_locate)
-    gpgme_set_keylist_mode (ctx, (mode | (GPGME_KEYLIST_MODE_LOCAL
-                                          | GPGME_KEYLIST_MODE_EXTERN)));
-  if (!gpgme_op_keylist_start (ctx, info->mailbox, 0))
+  if (!lookup->dialog)
+    goto leave;
+  if (key->revoked || key->disabled || key->expired || !key->can_encrypt)
+    goto leave;
+
+  for (uid = key->uids; uid; uid = uid->next)
     {
-      while (!gpgme_op_keylist_next (ctx, &key))
+      char *address;
+
+      address = gpa_recipcache_address (uid->email && *uid->email
+                                 ? uid->email : (uid->uid? uid->uid : ""));
+      if (address)
         {
-          if (key->revoked || key->disabled || key->expired
-              || !key->can_encrypt)
-            gpgme_key_unref (key);
-          else if (append_key_to_keyinfo (&info->pgp, key)
-                   >= TRUNCATE_KEYSEARCH_AT)
+          for (item = g_hash_table_lookup (lookup->rows, address); item;
+               item = g_slist_next (item))
+            lookup_add_key (lookup, item->data, key);
+          g_free (address);
+        }
+
+      if (lookup->other_rows && uid->uid)
+        {
+          char *uidstr = g_utf8_casefold (uid->uid, -1);
+
+          for (item = lookup->other_rows; item; item = g_slist_next (item))
             {
-              /* Note that the truncation flag is not 100% correct.  In
-                 case the next iteration would not yield a new key we
-                 have not actually truncated the search.  */
-              info->pgp.truncated = 1;
-              break;
+              struct lookup_row_s *row = item->data;
+              char *mailbox = g_utf8_casefold (row->info->mailbox, -1);
+
+              if (strstr (uidstr, mailbox))
+                lookup_add_key (lookup, row, key);
+              g_free (mailbox);
             }
+          g_free (uidstr);
         }
     }
-  gpgme_op_keylist_end (ctx);
-  gpgme_set_keylist_mode (ctx, mode);
 
-  clear_keyinfo (&info->x509);
-  gpgme_set_protocol (ctx, GPGME_PROTOCOL_CMS);
-  if (!gpgme_op_keylist_start (ctx, info->mailbox, 0))
+ leave:
+  gpgme_key_unref (key);
+}
+
+
+static void
+free_lookup_row_list (gpointer data)
+{
+  g_slist_free (data);
+}
+
+
+static gboolean
+release_lookup_cb (gpointer data)
+{
+  struct lookup_s *lookup = data;
+
+  if (lookup->pgp_ctx)
+    g_object_unref (lookup->pgp_ctx);
+  if (lookup->cms_ctx)
+    g_object_unref (lookup->cms_ctx);
+  g_strfreev (lookup->pgp_patterns);
+  g_strfreev (lookup->cms_patterns);
+  g_hash_table_destroy (lookup->rows);
+  g_slist_free (lookup->other_rows);
+  g_slist_foreach (lookup->all_rows, (GFunc) g_free, NULL);
+  g_slist_free (lookup->all_rows);
+  g_free (lookup);
+
+  return FALSE;
+}
+
+
+/* Mark the lookup for PROTOCOL as finished.  If COMPLETE is set the
+   keylisting succeeded and the results are stored in the recipient
+   cache.  */
+static void
+lookup_finish_protocol (struct lookup_s *lookup, gpgme_protocol_t protocol,
+                        gboolean complete)
+{
+  GSList *item;
+
+  if (!lookup->dialog)
+    return;
+
+  for (item = lookup->all_rows; item; item = g_slist_next (item))
     {
-      while (!gpgme_op_keylist_next (ctx, &key))
+      struct lookup_row_s *row = item->data;
+      struct keyinfo_s *keyinfo;
+
+      keyinfo = (protocol == GPGME_PROTOCOL_CMS
+                 ? &row->info->x509 : &row->info->pgp);
+      if (keyinfo->pending)
         {
-          if (key->revoked || key->disabled || key->expired
-              || !key->can_encrypt)
-            gpgme_key_unref (key);
-          else if (append_key_to_keyinfo (&info->x509,key)
-                   >= TRUNCATE_KEYSEARCH_AT)
-            {
-              info->x509.truncated = 1;
-              break;
-            }
+          if (complete && !keyinfo->truncated)
+            gpa_recipcache_put (row->info->mailbox, protocol, keyinfo->keys);
+          keyinfo->pending = 0;
+          update_recplist_row (lookup->store, &row->iter, row->info);
         }
     }
-  gpgme_op_keylist_end (ctx);
-
-  update_recplist_row (store, iter, info);
 }
 
 
-/* Parse the list of recipients, find possible keys and update the
-   store.  */
+/* A keylisting of LOOKUP has finished.  */
 static void
-parse_recipients (GtkListStore *store)
+lookup_done_cb (GpaContext *context, gpg_error_t err,
+                struct lookup_s *lookup)
 {
-  GtkTreeModel *model;
-  GtkTreeIter iter;
+  if (err && gpg_err_code (err) != GPG_ERR_CANCELED)
+    g_debug ("recipient lookup failed: %s <%s>",
+             gpg_strerror (err), gpg_strsource (err));
+
+  lookup_finish_protocol (lookup, (context == lookup->cms_ctx
+                                   ? GPGME_PROTOCOL_CMS
+                                   : GPGME_PROTOCOL_OpenPGP), !err);
+
+  if (!--lookup->running)
+    {
+      if (lookup->dialog)
+        lookup->dialog->lookup = NULL;
+      /* We are called by the context; thus release it later.  */
+      g_idle_add (release_lookup_cb, lookup);
+    }
+}
+
+
+/* Start the keylisting for PROTOCOL.  Returns the context or NULL
+   if the keylisting could not be started.  */
+static GpaContext *
+lookup_start_protocol (struct lookup_s *lookup, gpgme_protocol_t protocol)
+{
+  static int have_locate = -1;
+  GpaContext *context;
+  gpgme_keylist_mode_t mode;
   gpg_error_t err;
-  gpgme_ctx_t ctx;
+  char **patterns;
+
+  patterns = (protocol == GPGME_PROTOCOL_CMS
+              ? lookup->cms_patterns : lookup->pgp_patterns);
+  if (!*patterns)
+    return NULL;  /* Everything was found in the cache.  */
 
-  err = gpgme_new (&ctx);
+  if (have_locate == -1)
+    have_locate = is_gpg_version_at_least ("2.0.10");
+
+  context = gpa_context_new ();
+  gpgme_set_protocol (context->ctx, protocol);
+  if (protocol == GPGME_PROTOCOL_OpenPGP && have_locate)
+    {
+      mode = gpgme_get_keylist_mode (context->ctx);
+      gpgme_set_keylist_mode (context->ctx,
+                              (mode | (GPGME_KEYLIST_MODE_LOCAL
+                                       | GPGME_KEYLIST_MODE_EXTERN)));
+    }
+  g_signal_connect (G_OBJECT (context), "next_key",
+                    G_CALLBACK (lookup_next_key_cb), lookup);
+  g_signal_connect (G_OBJECT (context), "done",
+                    G_CALLBACK (lookup_done_cb), lookup);
+
+  err = gpgme_op_keylist_ext_start (context->ctx,
+                                    (const char **) patterns, 0, 0);
   if (err)
-    gpa_gpgme_error (err);
+    {
+      g_debug ("error starting the recipient lookup: %s <%s>",
+               gpg_strerror (err), gpg_strsource (err));
+      g_object_unref (context);
+      lookup_finish_protocol (lookup, protocol, FALSE);
+      return NULL;
+    }
+  lookup->running++;
+  return context;
+}
+
+
+/* Cancel the running lookup of DIALOG.  */
+static void
+cancel_lookup (RecipientDlg *dialog)
+{
+  struct lookup_s *lookup = dialog->lookup;
+
+  if (!lookup)
+    return;
+
+  dialog->lookup = NULL;
+  lookup->dialog = NULL;
+  if (lookup->pgp_ctx && gpa_context_busy (lookup->pgp_ctx))
+    gpgme_cancel (lookup->pgp_ctx->ctx);
+  if (lookup->cms_ctx && gpa_context_busy (lookup->cms_ctx))
+    gpgme_cancel (lookup->cms_ctx->ctx);
+}
+
+
+/* Take the keys for KEYINFO from the recipient cache.  Returns FALSE
+   if MAILBOX is not cached for PROTOCOL.  */
+static gboolean
+keyinfo_from_cache (struct keyinfo_s *keyinfo, const char *mailbox,
+                    gpgme_protocol_t protocol)
+{
+  gpgme_key_t *keys;
+  int idx;
+
+  if (!gpa_recipcache_get (mailbox, protocol, &keys))
+    return FALSE;
 
+  clear_keyinfo (keyinfo);
+  for (idx = 0; keys[idx]; idx++)
+    append_key_to_keyinfo (keyinfo, keys[idx]);
+  g_free (keys);
+  keyinfo->pending = 0;
+  return TRUE;
+}
+
+
+/* Start looking up the keys for all recipients in STORE.  The rows
+   are updated as keys are found.  */
+static void
+start_lookup (RecipientDlg *dialog, GtkListStore *store)
+{
+  struct lookup_s *lookup;
+  GtkTreeModel *model = GTK_TREE_MODEL (store);
+  GtkTreeIter iter;
+  GPtrArray *pgp_patterns;
+  GPtrArray *cms_patterns;
 
-  model = GTK_TREE_MODEL (store);
-  /* Walk through the list, reading each row. */
+  lookup = g_malloc0 (sizeof *lookup);
+  lookup->dialog = dialog;
+  lookup->store = store;
+  lookup->rows = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                        g_free, free_lookup_row_list);
+  pgp_patterns = g_ptr_array_new ();
+  cms_patterns = g_ptr_array_new ();
 
   if (gtk_tree_model_get_iter_first (model, &iter))
     do
       {
+        struct lookup_row_s *row;
         struct userdata_s *info;
-
-        gtk_tree_model_get (model, &iter,
-                            RECPLIST_USERDATA, &info,
-                            -1);
-
-        /* Do something with the data */
-        /*g_print ("parsing mailbox `%s'\n", info? info->mailbox:"(null)");*/
-        parse_one_recipient (ctx, store, &iter,info);
+        char *address;
+        GSList *list;
+
+        gtk_tree_model_get (model, &iter, RECPLIST_USERDATA, &info, -1);
+        if (!info)
+          continue;
+
+        info->pgp.pending = 0;
+        info->x509.pending = 0;
+        if (!keyinfo_from_cache (&info->pgp, info->mailbox,
+                                 GPGME_PROTOCOL_OpenPGP))
+          {
+            info->pgp.pending = 1;
+            g_ptr_array_add (pgp_patterns, g_strdup (info->mailbox));
+          }
+        if (!keyinfo_from_cache (&info->x509, info->mailbox,
+                                 GPGME_PROTOCOL_CMS))
+          {
+            info->x509.pending = 1;
+            g_ptr_array_add (cms_patterns, g_strdup (info->mailbox));
+          }
+        update_recplist_row (store, &iter, info);
+        if (!info->pgp.pending && !info->x509.pending)
+          continue;
+
+        row = g_malloc0 (sizeof *row);
+        row->info = info;
+        row->iter = iter;
+        lookup->all_rows = g_slist_prepend (lookup->all_rows, row);
+
+        address = gpa_recipcache_address (info->mailbox);
+        if (!address)
+          lookup->other_rows = g_slist_prepend (lookup->other_rows, row);
+        else if ((list = g_hash_table_lookup (lookup->rows, address)))
+          {
+            /* Keep the head of the list so that the table entry stays
+               valid.  */
+            list->next = g_slist_prepend (list->next, row);
+            g_free (address);
+          }
+        else
+          g_hash_table_insert (lookup->rows, address,
+                               g_slist_prepend (NULL, row));
       }
     while (gtk_tree_model_iter_next (model, &iter));
 
-  gpgme_release (ctx);
+  g_ptr_array_add (pgp_patterns, NULL);
+  lookup->pgp_patterns = (char **) g_ptr_array_free (pgp_patterns, FALSE);
+  g_ptr_array_add (cms_patterns, NULL);
+  lookup->cms_patterns = (char **) g_ptr_array_free (cms_patterns, FALSE);
+
+  if (!lookup->all_rows)
+    {
+      /* All recipients were found in the cache.  */
+      release_lookup_cb (lookup);
+      return;
+    }
+
+  dialog->lookup = lookup;
+  lookup->running++;  /* Do not finish while starting.  */
+  lookup->pgp_ctx = lookup_start_protocol (lookup, GPGME_PROTOCOL_OpenPGP);
+  lookup->cms_ctx = lookup_start_protocol (lookup, GPGME_PROTOCOL_CMS);
+  if (!--lookup->running)
+    {
+      dialog->lookup = NULL;
+      release_lookup_cb (lookup);
+    }
 }
 
 
@@ -662,12 +965,14 @@ select_key_response_cb (SelectKeyDlg *seldlg, int response, void *user_data)
               if (key->protocol == GPGME_PROTOCOL_OpenPGP)
                 {
                   clear_keyinfo (&info->pgp);
+                  info->pgp.pending = 0;
                   gpgme_key_ref (key);
                   append_key_to_keyinfo (&info->pgp, key);
                 }
               else if (key->protocol == GPGME_PROTOCOL_CMS)
                 {
                   clear_keyinfo (&info->x509);
+                  info->x509.pending = 0;
                   gpgme_key_ref (key);
                   append_key_to_keyinfo (&info->x509, key);
                 }
@@ -909,6 +1214,7 @@ recipient_dlg_set_property (GObject *object, guint prop_id,
 static void
 recipient_dlg_finalize (GObject *object)
 {
+  cancel_lookup (RECIPIENT_DLG (object));
   /* Fixme:  Release the store.  */
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -1129,6 +1435,7 @@ recipient_dlg_set_recipients (RecipientDlg *dialog, GSList *recipients,
   store = GTK_LIST_STORE (gtk_tree_view_get_model
                           (GTK_TREE_VIEW (dialog->clist_keys)));
 
+  cancel_lookup (dialog);
   gtk_list_store_clear (store);
   for (recp = recipients; recp; recp = g_slist_next (recp))
     {
@@ -1149,7 +1456,7 @@ recipient_dlg_set_recipients (RecipientDlg *dialog, GSList *recipients,
         }
     }
 
-  parse_recipients (store);
+  start_lookup (dialog, store);
   dialog->freeze_update_statushint--;
   update_statushint (dialog);
 }
@@ -571,6 +571,17 @@ server_send_keys (const gchar *server, const gchar *keyid,
 gboolean
 server_get_key (const gchar *server, const gchar *keyid,
                 gpgme_data_t *data, GtkWidget *parent)
+{
+  const gchar *keyids[2];
+
+  keyids[0] = keyid;
+  keyids[1] = NULL;
+  return server_get_keys (server, keyids, data, parent);
+}
+
+gboolean
+server_get_keys (const gchar *server, const gchar **keyids,
+                 gpgme_data_t *data, GtkWidget *parent)
 {
   gchar *keyserver = g_strdup (server);
   gchar *command_filename, *output_filename;
@@ -596,7 +607,8 @@ server_get_key (const gchar *server, const gchar *keyid,
   /* Write the command to the file */
   write_command (command, scheme, host, port, opaque, "GET");
   /* Write the keys to the file */
-  fprintf (command, "0x%s\n", keyid);
+  for (; *keyids; keyids++)
+    fprintf (command, "0x%s\n", *keyids);
   fclose (command);
   success = invoke_helper (server, scheme, command_filename,
                            &output_filename, parent);
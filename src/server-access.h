@@ -38,5 +38,10 @@ gboolean server_send_keys (const gchar *server, const gchar *keyid,
 gboolean server_get_key (const gchar *server, const gchar *keyid,
                          gpgme_data_t *data, GtkWidget *parent);
 
+/* Same as server_get_key but for all keyids in the NULL terminated
+   array KEYIDS.  */
+gboolean server_get_keys (const gchar *server, const gchar **keyids,
+                          gpgme_data_t *data, GtkWidget *parent);
+
 #endif /*ENABLE_KEYSERVER_SUPPORT*/
 #endif /*SERVER_ACCESS_H*/
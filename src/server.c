@@ -26,6 +26,7 @@
 #include <string.h>
 #include <errno.h>
 #ifndef HAVE_W32_SYSTEM
+# include <fcntl.h>
 # include <sys/socket.h>
 # include <sys/un.h>
 #endif /*HAVE_W32_SYSTEM*/
@@ -44,8 +45,13 @@
 #include "gpafileencryptop.h"
 #include "gpafilesignop.h"
 #include "gpafiledecryptop.h"
+#include "gpafilebatchop.h"
 #include "gpafileverifyop.h"
 #include "gpafileimportop.h"
+#include "gpafilechecksumop.h"
+#include "verifydlg.h"
+#include "serverjob.h"
+#include "signercache.h"
 
 
 #define set_error(e,t) assuan_set_error (ctx, gpg_error (e), (t))
@@ -58,6 +64,14 @@ struct conn_ctrl_s
   /* True if we are currently processing a command.  */
   int in_command;
 
+  /* The channel of the connection, the source id of its watch and of
+     the idle handler for lines already read by Assuan.  While a
+     command is processed the watch is removed so that the client
+     does not send more commands.  */
+  GIOChannel *channel;
+  guint watch_id;
+  guint idle_id;
+
   /* NULL or continuation function for a command.  */
   void (*cont_cmd) (assuan_context_t, gpg_error_t);
 
@@ -127,6 +141,9 @@ static assuan_sock_nonce_t socket_nonce;
 
 /* Forward declarations.  */
 static void run_server_continuation (assuan_context_t ctx, gpg_error_t err);
+static gboolean receive_cb (GIOChannel *channel, GIOCondition condition,
+                            void *data);
+static void resume_input (assuan_context_t ctx);
 
 
 
@@ -247,7 +264,7 @@ my_gpgme_write_cb (void *opaque, const void *buffer, size_t size)
   else
     {
       errno = EIO;
-      retval = 1;
+      retval = -1;
     }
 
   return retval;
@@ -460,6 +477,44 @@ translate_io_streams (assuan_context_t ctx)
 }
 
 
+/* Return true if FD can be handed directly to GPGME.  The backend
+   process then reads or writes FD on its own and the data does not
+   pass through GPA.  This requires a blocking descriptor.  */
+static int
+use_direct_fd (int fd)
+{
+#ifdef HAVE_W32_SYSTEM
+  (void)fd;
+  return 0;
+#else
+  int flags;
+
+  flags = fcntl (fd, F_GETFL);
+  return flags != -1 && !(flags & O_NONBLOCK);
+#endif
+}
+
+
+/* Create a channel for FD.  */
+static GIOChannel *
+new_io_channel (int fd)
+{
+  GIOChannel *channel;
+
+#ifdef HAVE_W32_SYSTEM
+  channel = g_io_channel_win32_new_fd (fd);
+#else
+  channel = g_io_channel_unix_new (fd);
+#endif
+  if (channel)
+    {
+      g_io_channel_set_encoding (channel, NULL, NULL);
+      g_io_channel_set_buffered (channel, FALSE);
+    }
+  return channel;
+}
+
+
 static gpg_error_t
 prepare_io_streams (assuan_context_t ctx,
                     gpgme_data_t *r_input_data, gpgme_data_t *r_output_data,
@@ -477,73 +532,62 @@ prepare_io_streams (assuan_context_t ctx,
 
   if (ctrl->input_fd != -1 && r_input_data)
     {
-#ifdef HAVE_W32_SYSTEM
-      ctrl->input_channel = g_io_channel_win32_new_fd (ctrl->input_fd);
-#else
-      ctrl->input_channel = g_io_channel_unix_new (ctrl->input_fd);
-#endif
-      if (!ctrl->input_channel)
+      if (use_direct_fd (ctrl->input_fd))
+        err = gpgme_data_new_from_fd (r_input_data, ctrl->input_fd);
+      else
         {
-          /* g_debug ("error creating input channel"); */
-          err = gpg_error (GPG_ERR_EIO);
-          goto leave;
+          ctrl->input_channel = new_io_channel (ctrl->input_fd);
+          if (!ctrl->input_channel)
+            {
+              /* g_debug ("error creating input channel"); */
+              err = gpg_error (GPG_ERR_EIO);
+              goto leave;
+            }
+          err = gpgme_data_new_from_cbs (r_input_data,
+                                         &my_gpgme_data_cbs, ctrl);
         }
-      g_io_channel_set_encoding (ctrl->input_channel, NULL, NULL);
-      g_io_channel_set_buffered (ctrl->input_channel, FALSE);
+      if (err)
+        goto leave;
     }
 
   if (ctrl->output_fd != -1 && r_output_data)
     {
-#ifdef HAVE_W32_SYSTEM
-      ctrl->output_channel = g_io_channel_win32_new_fd (ctrl->output_fd);
-#else
-      ctrl->output_channel = g_io_channel_unix_new (ctrl->output_fd);
-#endif
-      if (!ctrl->output_channel)
-        {
-          g_debug ("error creating output channel");
-          err = gpg_error (GPG_ERR_EIO);
-          goto leave;
-        }
-      g_io_channel_set_encoding (ctrl->output_channel, NULL, NULL);
-      g_io_channel_set_buffered (ctrl->output_channel, FALSE);
-    }
-
-  if (ctrl->message_fd != -1 && r_message_data)
-    {
-#ifdef HAVE_W32_SYSTEM
-      ctrl->message_channel = g_io_channel_win32_new_fd (ctrl->message_fd);
-#else
-      ctrl->message_channel = g_io_channel_unix_new (ctrl->message_fd);
-#endif
-      if (!ctrl->message_channel)
+      if (use_direct_fd (ctrl->output_fd))
+        err = gpgme_data_new_from_fd (r_output_data, ctrl->output_fd);
+      else
         {
-          g_debug ("error creating message channel");
-          err = gpg_error (GPG_ERR_EIO);
-          goto leave;
+          ctrl->output_channel = new_io_channel (ctrl->output_fd);
+          if (!ctrl->output_channel)
+            {
+              g_debug ("error creating output channel");
+              err = gpg_error (GPG_ERR_EIO);
+              goto leave;
+            }
+          err = gpgme_data_new_from_cbs (r_output_data,
+                                         &my_gpgme_data_cbs, ctrl);
         }
-      g_io_channel_set_encoding (ctrl->message_channel, NULL, NULL);
-      g_io_channel_set_buffered (ctrl->message_channel, FALSE);
-    }
-
-  if (ctrl->input_channel)
-    {
-      err = gpgme_data_new_from_cbs (r_input_data, &my_gpgme_data_cbs, ctrl);
-      if (err)
-        goto leave;
-    }
-  if (ctrl->output_channel)
-    {
-      err = gpgme_data_new_from_cbs (r_output_data, &my_gpgme_data_cbs, ctrl);
       if (err)
         goto leave;
       if (ctrl->output_binary)
         gpgme_data_set_encoding (*r_output_data, GPGME_DATA_ENCODING_BINARY);
     }
-  if (ctrl->message_channel)
+
+  if (ctrl->message_fd != -1 && r_message_data)
     {
-      err = gpgme_data_new_from_cbs (r_message_data,
-				     &my_gpgme_message_cbs, ctrl);
+      if (use_direct_fd (ctrl->message_fd))
+        err = gpgme_data_new_from_fd (r_message_data, ctrl->message_fd);
+      else
+        {
+          ctrl->message_channel = new_io_channel (ctrl->message_fd);
+          if (!ctrl->message_channel)
+            {
+              g_debug ("error creating message channel");
+              err = gpg_error (GPG_ERR_EIO);
+              goto leave;
+            }
+          err = gpgme_data_new_from_cbs (r_message_data,
+                                         &my_gpgme_message_cbs, ctrl);
+        }
       if (err)
         goto leave;
     }
@@ -557,6 +601,18 @@ prepare_io_streams (assuan_context_t ctx,
 }
 
 
+/* Return true if prepare_io_streams handed all descriptors directly
+   to GPGME.  Only then may the data objects be used by a server job:
+   the callbacks used for the other descriptors access the connection
+   and the main loop and thus must run in the main thread.  */
+static int
+direct_io_streams (conn_ctrl_t ctrl)
+{
+  return (!ctrl->input_channel && !ctrl->output_channel
+          && !ctrl->message_channel);
+}
+
+
 
 static const char hlp_session[] =
   "SESSION <number> [<string>]\n"
@@ -645,6 +701,163 @@ cmd_message (assuan_context_t ctx, char *line)
 
 
 
+/* Write a SIGSTATUS line for each signature of the verify result
+   RES.  */
+static void
+write_sigstatus (assuan_context_t ctx, gpgme_verify_result_t res)
+{
+  gpgme_signature_t sig;
+
+  for (sig = res->signatures; sig; sig = sig->next)
+    {
+      char *line;
+
+      line = gpa_gpgme_get_sigstatus (sig);
+      /* FIXME: Error handling.  */
+      assuan_write_status (ctx, "SIGSTATUS", line);
+      g_free (line);
+    }
+}
+
+
+/* The verify dialog of a server job has been closed.  */
+static void
+job_dialog_response_cb (GtkDialog *dialog, gint response, gpointer user_data)
+{
+  assuan_context_t ctx = user_data;
+
+  gtk_widget_destroy (GTK_WIDGET (dialog));
+  run_server_continuation (ctx, 0);
+}
+
+
+/* Complete the command which started the finished JOB.  */
+static void
+finish_job (server_job_t job, gpg_error_t err)
+{
+  assuan_context_t ctx = job->opaque;
+  conn_ctrl_t ctrl = assuan_get_pointer (ctx);
+  gpgme_verify_result_t res;
+  GtkWidget *dialog;
+
+  if (!err && !ctrl->client_died
+      && (job->type == SERVER_JOB_VERIFY
+          || (job->type == SERVER_JOB_DECRYPT && !job->no_verify)))
+    {
+      res = gpgme_op_verify_result (job->ctx);
+      write_sigstatus (ctx, res);
+
+      /* A decrypt only shows the dialog for signed messages.  */
+      if (job->show_result
+          && (job->type == SERVER_JOB_VERIFY || res->signatures))
+        {
+          dialog = gpa_file_verify_dialog_new (NULL);
+          if (ctrl->session_title)
+            gpa_file_verify_dialog_set_title
+              (GPA_FILE_VERIFY_DIALOG (dialog), ctrl->session_title);
+          gpa_file_verify_dialog_add_file (GPA_FILE_VERIFY_DIALOG (dialog),
+                                           _("Document"), NULL, NULL,
+                                           res->signatures);
+          g_signal_connect (G_OBJECT (dialog), "response",
+                            G_CALLBACK (job_dialog_response_cb), ctx);
+          server_job_release (job);
+          gtk_widget_show_all (dialog);
+
+          /* We will complete later in the response callback.  */
+          return;
+        }
+    }
+
+  server_job_release (job);
+  run_server_continuation (ctx, err);
+}
+
+
+/* The keys of the signers of a finished job have been looked up.  */
+static void
+job_signers_known_cb (gpointer data)
+{
+  finish_job (data, 0);
+}
+
+
+/* A server job has finished.  This is called in the main thread and
+   completes the command which started the job.  */
+static void
+job_done_cb (server_job_t job, gpg_error_t err, void *opaque)
+{
+  assuan_context_t ctx = opaque;
+  conn_ctrl_t ctrl = assuan_get_pointer (ctx);
+  gpgme_verify_result_t res;
+
+  g_debug ("server job done: ERR=%s <%s>",
+           gpg_strerror (err), gpg_strsource (err));
+
+  /* Look up the keys of the signers first so that the descriptions
+     name them.  */
+  if (!err && !ctrl->client_died
+      && (job->type == SERVER_JOB_VERIFY
+          || (job->type == SERVER_JOB_DECRYPT && !job->no_verify)))
+    {
+      res = gpgme_op_verify_result (job->ctx);
+      if (!gpa_signercache_resolve (res->signatures,
+                                    job_signers_known_cb, job))
+        return;
+    }
+
+  finish_job (job, err);
+}
+
+
+/* Start encrypting INPUT_DATA to OUTPUT_DATA in a worker thread for
+   the keys prepared by PREP_ENCRYPT.  This takes ownership of the
+   data objects.  */
+static gpg_error_t
+start_encrypt_job (assuan_context_t ctx, gpgme_protocol_t protocol,
+                   gpgme_data_t input_data, gpgme_data_t output_data)
+{
+  conn_ctrl_t ctrl = assuan_get_pointer (ctx);
+  gpg_error_t err;
+  server_job_t job;
+  int idx;
+
+  job = server_job_new (SERVER_JOB_ENCRYPT, protocol);
+  job->input = input_data;
+  job->output = output_data;
+
+  for (idx = 0; ctrl->recipient_keys[idx]; idx++)
+    ;
+  job->keys = g_malloc0_n (idx + 1, sizeof *job->keys);
+  for (idx = 0; ctrl->recipient_keys[idx]; idx++)
+    {
+      gpgme_key_ref (ctrl->recipient_keys[idx]);
+      job->keys[idx] = ctrl->recipient_keys[idx];
+    }
+
+  err = assuan_write_status (ctx, "PROTOCOL",
+                             protocol == GPGME_PROTOCOL_CMS? "CMS":"OpenPGP");
+  if (err)
+    {
+      server_job_release (job);
+      return err;
+    }
+
+  /* Set the output encoding.  An encoding requested by the client is
+     kept.  */
+  if (gpgme_data_get_encoding (output_data) != GPGME_DATA_ENCODING_NONE)
+    ;
+  else if (protocol == GPGME_PROTOCOL_CMS)
+    gpgme_data_set_encoding (output_data, GPGME_DATA_ENCODING_BASE64);
+  else
+    job->armor = 1;
+
+  server_job_start (job, job_done_cb, ctx);
+  return 0;
+}
+
+
+
+
 /* Continuation for cmd_encrypt.  */
 static void
 cont_encrypt (assuan_context_t ctx, gpg_error_t err)
@@ -701,6 +914,21 @@ cmd_encrypt (assuan_context_t ctx, char *line)
     goto leave;
 
   ctrl->cont_cmd = cont_encrypt;
+
+  /* Without a dialog the encryption may run in a thread.  */
+  if (ctrl->recipient_keys && *ctrl->recipient_keys
+      && direct_io_streams (ctrl) && server_job_available ())
+    {
+      err = start_encrypt_job (ctx, protocol, input_data, output_data);
+      input_data = output_data = NULL;
+      if (err)
+        {
+          ctrl->cont_cmd = NULL;
+          goto leave;
+        }
+      return not_finished (ctrl);
+    }
+
   op = gpa_stream_encrypt_operation_new (NULL, input_data, output_data,
                                          ctrl->recipients,
                                          ctrl->recipient_keys,
@@ -985,6 +1213,20 @@ cmd_decrypt (assuan_context_t ctx, char *line)
 
   ctrl->cont_cmd = cont_decrypt;
 
+  if (direct_io_streams (ctrl) && server_job_available ())
+    {
+      server_job_t job;
+
+      job = server_job_new (SERVER_JOB_DECRYPT, protocol);
+      job->no_verify = no_verify;
+      job->show_result = 1;
+      job->input = input_data;
+      job->output = output_data;
+      input_data = output_data = NULL;
+      server_job_start (job, job_done_cb, ctx);
+      return not_finished (ctrl);
+    }
+
   op = gpa_stream_decrypt_operation_new (NULL, input_data, output_data,
 					 no_verify, protocol,
                                          ctrl->session_title);
@@ -1120,6 +1362,20 @@ cmd_verify (assuan_context_t ctx, char *line)
 
   ctrl->cont_cmd = cont_verify;
 
+  if (direct_io_streams (ctrl) && server_job_available ())
+    {
+      server_job_t job;
+
+      job = server_job_new (SERVER_JOB_VERIFY, protocol);
+      job->show_result = !silent;
+      job->input = input_data;
+      job->output = output_data;
+      job->message = message_data;
+      input_data = output_data = message_data = NULL;
+      server_job_start (job, job_done_cb, ctx);
+      return not_finished (ctrl);
+    }
+
   op = gpa_stream_verify_operation_new (NULL, input_data, message_data,
 					output_data, silent, protocol,
                                         ctrl->session_title);
@@ -1414,10 +1670,10 @@ impl_decrypt_verify_files (assuan_context_t ctx, int decrypt, int verify)
       return assuan_process_done (ctx, err);
     }
 
-  /* FIXME: Needs a root window.  Need to enable "verify".  */
+  /* FIXME: Needs a root window.  */
   if (decrypt && verify)
     op = (GpaFileOperation *)
-      gpa_file_decrypt_verify_operation_new (NULL, ctrl->files);
+      gpa_file_batch_operation_new (NULL, ctrl->files);
   else if (decrypt)
     op = (GpaFileOperation *)
       gpa_file_decrypt_operation_new (NULL, ctrl->files);
@@ -1526,6 +1782,32 @@ cmd_import_files (assuan_context_t ctx, char *line)
 }
 
 
+
+/* Create checksum files for the files or, if VERIFY is set, verify
+   the given checksum files.  */
+static gpg_error_t
+impl_checksum_files (assuan_context_t ctx, int verify)
+{
+  gpg_error_t err = 0;
+  conn_ctrl_t ctrl = assuan_get_pointer (ctx);
+  GpaFileChecksumOperation *op;
+
+  if (! ctrl->files)
+    {
+      err = set_error (GPG_ERR_ASS_SYNTAX, "no files specified");
+      return assuan_process_done (ctx, err);
+    }
+
+  op = gpa_file_checksum_operation_new (NULL, ctrl->files, verify);
+
+  /* Ownership of CTRL->files was passed to callee.  */
+  ctrl->files = NULL;
+  g_signal_connect (G_OBJECT (op), "completed",
+		    G_CALLBACK (g_object_unref), NULL);
+
+  return assuan_process_done (ctx, err);
+}
+
 
 /* CHECKSUM_CREATE_FILES --nohup  */
 static gpg_error_t
@@ -1546,8 +1828,7 @@ cmd_checksum_create_files (assuan_context_t ctx, char *line)
       return assuan_process_done (ctx, err);
     }
 
-  err = set_error (GPG_ERR_NOT_IMPLEMENTED, "not implemented");
-  return assuan_process_done (ctx, err);
+  return impl_checksum_files (ctx, 0);
 }
 
 
@@ -1570,8 +1851,7 @@ cmd_checksum_verify_files (assuan_context_t ctx, char *line)
       return assuan_process_done (ctx, err);
     }
 
-  err = set_error (GPG_ERR_NOT_IMPLEMENTED, "not implemented");
-  return assuan_process_done (ctx, err);
+  return impl_checksum_files (ctx, 1);
 }
 
 
@@ -1744,6 +2024,12 @@ connection_finish (assuan_context_t ctx)
     {
       conn_ctrl_t ctrl = assuan_get_pointer (ctx);
 
+      if (ctrl->watch_id)
+        g_source_remove (ctrl->watch_id);
+      if (ctrl->idle_id)
+        g_source_remove (ctrl->idle_id);
+      if (ctrl->channel)
+        g_io_channel_unref (ctrl->channel);
       reset_notify (ctx, NULL);
       assuan_release (ctx);
       g_free (ctrl);
@@ -1772,6 +2058,7 @@ run_server_continuation (assuan_context_t ctx, gpg_error_t err)
     {
       g_debug ("no continuation defined; using default");
       assuan_process_done (ctx, err);
+      resume_input (ctx);
     }
   else if (ctrl->client_died)
     {
@@ -1783,11 +2070,108 @@ run_server_continuation (assuan_context_t ctx, gpg_error_t err)
       cont_cmd = ctrl->cont_cmd;
       ctrl->cont_cmd = NULL;
       cont_cmd (ctx, err);
+      /* Unless the continuation registered another one, the command
+         has finished.  */
+      resume_input (ctx);
     }
   g_debug ("leaving gpa_run_server_continuation");
 }
 
 
+/* Process the next command from the connection CTX.  Returns FALSE
+   if the connection has been finished or the client has
+   disconnected.  */
+static gboolean
+process_input (assuan_context_t ctx)
+{
+  conn_ctrl_t ctrl = assuan_get_pointer (ctx);
+  gpg_error_t err;
+  int done = 0;
+
+  ctrl->in_command++;
+  err = assuan_process_next (ctx, &done);
+  ctrl->in_command--;
+  if (err)
+    {
+      g_debug ("assuan_process_next returned: %s <%s>",
+               gpg_strerror (err), gpg_strsource (err));
+    }
+  else
+    {
+      g_debug ("assuan_process_next returned: %s",
+               done ? "done" : "success");
+    }
+  if (gpg_err_code (err) == GPG_ERR_EAGAIN)
+    ; /* Ignore.  */
+  else if (!err && done)
+    {
+      if (ctrl->cont_cmd)
+        ctrl->client_died = 1; /* Need to delay the cleanup.  */
+      else
+        connection_finish (ctx);
+      return FALSE;
+    }
+  else if (gpg_err_code (err) == GPG_ERR_UNFINISHED)
+    {
+      if (!ctrl->is_unfinished)
+        {
+          /* It is quite possible that some other subsystem
+             returns that error code.  Tell the user about
+             this curiosity and finish the command.  */
+          g_debug ("note: Unfinished error code not emitted by us");
+          if (ctrl->cont_cmd)
+            g_debug ("OOPS: pending continuation!");
+          assuan_process_done (ctx, err);
+        }
+    }
+  else
+    assuan_process_done (ctx, err);
+
+  return TRUE;
+}
+
+
+/* This function is called by the main event loop to process command
+   lines which Assuan has already read from the connection.  */
+static gboolean
+pending_input_cb (void *data)
+{
+  assuan_context_t ctx = data;
+  conn_ctrl_t ctrl = assuan_get_pointer (ctx);
+
+  ctrl->idle_id = 0;
+  if (ctrl->cont_cmd || ctrl->in_command)
+    return FALSE;  /* Resumed when the command has finished.  */
+
+  if (process_input (ctx))
+    resume_input (ctx);
+  return FALSE;
+}
+
+
+/* Read the next command from the connection CTX unless a command is
+   still being processed.  Complete lines already buffered by Assuan
+   are processed from an idle handler because the channel does not
+   signal them.  */
+static void
+resume_input (assuan_context_t ctx)
+{
+  conn_ctrl_t ctrl = assuan_get_pointer (ctx);
+
+  if (!ctrl || ctrl->cont_cmd || ctrl->in_command || ctrl->client_died)
+    return;
+
+  if (assuan_pending_line (ctx))
+    {
+      if (!ctrl->idle_id)
+        ctrl->idle_id = g_idle_add (pending_input_cb, ctx);
+    }
+  else if (!ctrl->watch_id)
+    ctrl->watch_id = g_io_add_watch (ctrl->channel, G_IO_IN,
+                                     receive_cb, ctx);
+}
+
+
 /* This function is called by the main event loop if data can be read
    from the status channel.  */
 static gboolean
@@ -1795,64 +2179,29 @@ receive_cb (GIOChannel *channel, GIOCondition condition, void *data)
 {
   assuan_context_t ctx = data;
   conn_ctrl_t ctrl = assuan_get_pointer (ctx);
-  gpg_error_t err;
+  guint watch_id;
 
   assert (ctrl);
   if (condition & G_IO_IN)
     {
       g_debug ("receive_cb");
-      if (ctrl->cont_cmd)
-        {
-          g_debug ("  input received while waiting for continuation");
-          g_usleep (2000000);
-        }
-      else if (ctrl->in_command)
-        {
-          g_debug ("  input received while still processing command");
-          g_usleep (2000000);
-        }
-      else
+      if (ctrl->cont_cmd || ctrl->in_command)
         {
-	  int done = 0;
-          ctrl->in_command++;
-          err = assuan_process_next (ctx, &done);
-          ctrl->in_command--;
-	  if (err)
-	    {
-	      g_debug ("assuan_process_next returned: %s <%s>",
-		       gpg_strerror (err), gpg_strsource (err));
-	    }
-	  else
-	    {
-	      g_debug ("assuan_process_next returned: %s",
-		       done ? "done" : "success");
-	    }
-          if (gpg_err_code (err) == GPG_ERR_EAGAIN)
-            ; /* Ignore.  */
-          else if (!err && done)
-            {
-              if (ctrl->cont_cmd)
-                ctrl->client_died = 1; /* Need to delay the cleanup.  */
-              else
-                connection_finish (ctx);
-              return FALSE; /* Remove from the watch.  */
-            }
-          else if (gpg_err_code (err) == GPG_ERR_UNFINISHED)
-            {
-              if (!ctrl->is_unfinished)
-                {
-                  /* It is quite possible that some other subsystem
-                     returns that error code.  Tell the user about
-                     this curiosity and finish the command.  */
-                  g_debug ("note: Unfinished error code not emitted by us");
-                  if (ctrl->cont_cmd)
-                    g_debug ("OOPS: pending continuation!");
-                  assuan_process_done (ctx, err);
-                }
-            }
-          else
-            assuan_process_done (ctx, err);
+          /* Stop watching the channel until the command has
+             finished.  The input stays in the socket buffer and
+             thus the client waits for us.  */
+          g_debug ("  input received while processing command; pausing");
+          ctrl->watch_id = 0;
+          return FALSE; /* Remove from the watch.  */
         }
+
+      /* The watch is removed if the connection is finished.  */
+      watch_id = ctrl->watch_id;
+      ctrl->watch_id = 0;
+      if (!process_input (ctx))
+        return FALSE; /* Remove from the watch.  */
+      ctrl->watch_id = watch_id;
+      resume_input (ctx);
     }
   return TRUE;
 }
@@ -1870,6 +2219,7 @@ accept_connection_cb (GIOChannel *listen_channel,
   struct sockaddr_un paddr;
   socklen_t plen = sizeof paddr;
   assuan_context_t ctx;
+  conn_ctrl_t ctrl;
   GIOChannel *channel;
   unsigned int source_id;
 
@@ -1916,6 +2266,9 @@ accept_connection_cb (GIOChannel *listen_channel,
       g_io_channel_shutdown (channel, 0, NULL);
       goto leave;
     }
+  ctrl = assuan_get_pointer (ctx);
+  ctrl->channel = channel;
+  ctrl->watch_id = source_id;
   err = assuan_accept (ctx);
   if (err)
     {
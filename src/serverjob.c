@@ -0,0 +1,203 @@
+/* serverjob.c - Run UI server commands in worker threads.
+   Copyright (C) 2026 g10 Code GmbH.
+
+   This file is part of GPA.
+
+   GPA is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   GPA is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+   License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.  */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <glib.h>
+#include <gpgme.h>
+
+#include "gpa.h"
+#include "serverjob.h"
+
+
+#ifdef ENABLE_SERVER_THREADS
+/* The pool of worker threads.  */
+static GThreadPool *job_pool;
+#endif
+
+
+/* Return true if server jobs are available.  They require a thread
+   safe GPGME and are only used if enabled by the "server-threads"
+   option.  Because GPA's own passphrase dialog can't be used from a
+   thread, jobs also require that pinentry is used (that is the
+   X.509 support has not been disabled).  */
+gboolean
+server_job_available (void)
+{
+#ifdef ENABLE_SERVER_THREADS
+  return (cms_hack && g_thread_supported ()
+          && gpa_options_get_server_threads (gpa_options_get_instance ()));
+#else
+  return FALSE;
+#endif
+}
+
+
+server_job_t
+server_job_new (server_job_type_t type, gpgme_protocol_t protocol)
+{
+  server_job_t job;
+
+  job = g_malloc0 (sizeof *job);
+  job->type = type;
+  job->protocol = protocol;
+
+  return job;
+}
+
+
+void
+server_job_release (server_job_t job)
+{
+  int idx;
+
+  if (!job)
+    return;
+
+  if (job->keys)
+    {
+      for (idx = 0; job->keys[idx]; idx++)
+        gpgme_key_unref (job->keys[idx]);
+      g_free (job->keys);
+    }
+  gpgme_data_release (job->input);
+  gpgme_data_release (job->output);
+  gpgme_data_release (job->message);
+  if (job->ctx)
+    gpgme_release (job->ctx);
+  g_free (job);
+}
+
+
+/* The result of a job as passed to the main thread.  */
+struct job_result_s
+{
+  server_job_t job;
+  gpg_error_t err;
+};
+
+
+/* Run the completion callback in the main thread.  */
+static gboolean
+job_done_cb (gpointer data)
+{
+  struct job_result_s *result = data;
+  server_job_t job = result->job;
+  gpg_error_t err = result->err;
+
+  g_free (result);
+  job->done (job, err, job->opaque);
+
+  return FALSE;
+}
+
+
+/* Hand the result of JOB over to the main thread.  */
+static void
+job_done (server_job_t job, gpg_error_t err)
+{
+  struct job_result_s *result;
+
+  result = g_malloc (sizeof *result);
+  result->job = job;
+  result->err = err;
+  g_idle_add (job_done_cb, result);
+}
+
+
+#ifdef ENABLE_SERVER_THREADS
+/* The worker thread function.  Note that nothing but JOB may be used
+   here.  */
+static void
+job_worker (gpointer data, gpointer user_data)
+{
+  server_job_t job = data;
+  gpg_error_t err;
+
+  (void)user_data;
+
+  err = gpgme_new (&job->ctx);
+  if (!err)
+    err = gpgme_set_protocol (job->ctx, job->protocol);
+  if (!err)
+    switch (job->type)
+      {
+      case SERVER_JOB_ENCRYPT:
+        gpgme_set_armor (job->ctx, job->armor);
+        /* We always trust the keys because the recipient selection
+           dialog has already sorted unusable out.  */
+        err = gpgme_op_encrypt (job->ctx, job->keys,
+                                GPGME_ENCRYPT_ALWAYS_TRUST,
+                                job->input, job->output);
+        break;
+
+      case SERVER_JOB_DECRYPT:
+        if (job->no_verify)
+          err = gpgme_op_decrypt (job->ctx, job->input, job->output);
+        else
+          err = gpgme_op_decrypt_verify (job->ctx, job->input, job->output);
+        break;
+
+      case SERVER_JOB_VERIFY:
+        err = gpgme_op_verify (job->ctx, job->input, job->message,
+                               job->output);
+        break;
+
+      default:
+        err = gpg_error (GPG_ERR_BUG);
+        break;
+      }
+
+  job_done (job, err);
+}
+#endif /*ENABLE_SERVER_THREADS*/
+
+
+void
+server_job_start (server_job_t job, server_job_done_t done, void *opaque)
+{
+#ifdef ENABLE_SERVER_THREADS
+  GError *error = NULL;
+#endif
+
+  job->done = done;
+  job->opaque = opaque;
+
+#ifdef ENABLE_SERVER_THREADS
+  if (!job_pool)
+    {
+      job_pool = g_thread_pool_new (job_worker, NULL,
+                                    gpa_options_get_max_jobs
+                                    (gpa_options_get_instance ()),
+                                    FALSE, &error);
+      if (!job_pool)
+        {
+          g_debug ("error creating the server thread pool: %s",
+                   error->message);
+          g_error_free (error);
+          job_done (job, gpg_error (GPG_ERR_GENERAL));
+          return;
+        }
+    }
+  g_thread_pool_push (job_pool, job, NULL);
+#else
+  job_done (job, gpg_error (GPG_ERR_NOT_SUPPORTED));
+#endif
+}
@@ -0,0 +1,89 @@
+/* serverjob.h - Run UI server commands in worker threads.
+   Copyright (C) 2026 g10 Code GmbH.
+
+   This file is part of GPA.
+
+   GPA is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   GPA is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+   License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.  */
+
+/* A server job runs the crypto part of a command which needs no
+   dialog on a thread of a pool, using its own gpgme context.  The
+   completion callback is run in the main thread; it may use the
+   results of the context and show dialogs.  */
+
+#ifndef SERVERJOB_H
+#define SERVERJOB_H
+
+#include <glib.h>
+#include <gpgme.h>
+
+typedef enum
+  {
+    SERVER_JOB_ENCRYPT,
+    SERVER_JOB_DECRYPT,
+    SERVER_JOB_VERIFY
+  } server_job_type_t;
+
+typedef struct server_job_s *server_job_t;
+
+/* Called in the main thread when JOB has finished with ERR.  */
+typedef void (*server_job_done_t) (server_job_t job, gpg_error_t err,
+                                   void *opaque);
+
+struct server_job_s
+{
+  server_job_type_t type;
+  gpgme_protocol_t protocol;
+
+  /* ENCRYPT: The recipients and whether to create armored output.  */
+  gpgme_key_t *keys;
+  int armor;
+
+  /* DECRYPT: Do not verify a signature.  */
+  int no_verify;
+
+  /* DECRYPT and VERIFY: Show the signatures in a dialog.  This is
+     only used by the completion callback.  */
+  int show_result;
+
+  /* The data objects as used by the gpgme operations.  They are
+     owned by the job and must not use callbacks which depend on the
+     main thread; in practice they are created from file
+     descriptors.  */
+  gpgme_data_t input;
+  gpgme_data_t output;
+  gpgme_data_t message;
+
+  /* The context of the job; it holds the results.  */
+  gpgme_ctx_t ctx;
+
+  server_job_done_t done;
+  void *opaque;
+};
+
+/* Return true if server jobs are available.  */
+gboolean server_job_available (void);
+
+/* Create a new job of TYPE.  */
+server_job_t server_job_new (server_job_type_t type,
+                             gpgme_protocol_t protocol);
+
+/* Run JOB on a worker thread.  DONE is called with OPAQUE when the
+   job has finished; this also happens on error.  */
+void server_job_start (server_job_t job, server_job_done_t done,
+                       void *opaque);
+
+/* Release JOB.  */
+void server_job_release (server_job_t job);
+
+#endif /*SERVERJOB_H*/
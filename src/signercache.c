@@ -0,0 +1,323 @@
+/* signercache.c - Lookup of the keys of signers.
+   Copyright (C) 2026 g10 Code GmbH.
+
+   This file is part of GPA
+
+   GPA is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   GPA is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+   License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.  */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <string.h>
+
+#include "gpa.h"
+#include "gpacontext.h"
+#include "keytable.h"
+#include "signercache.h"
+
+
+/* A call waiting for the lookups to finish.  */
+struct waiter_s
+{
+  GpaSignerCacheFunc func;
+  gpointer data;
+};
+
+
+/* The table mapping a fingerprint or key ID to the key.  NULL is
+   stored if no key was found.  */
+static GHashTable *signers;
+
+/* The fingerprints waiting for the next listing.  */
+static GPtrArray *queued;
+
+/* The NULL terminated array of the fingerprints currently listed.  */
+static gchar **listing;
+
+/* The contexts for the OpenPGP and X.509 listings and the number of
+   listings still running.  */
+static GpaContext *pgp_ctx;
+static GpaContext *cms_ctx;
+static int running;
+
+static GList *waiters;
+
+
+/* Return true if FPR is the fingerprint or a key ID of KEY.  */
+static gboolean
+key_matches (gpgme_key_t key, const char *fpr)
+{
+  gpgme_subkey_t subkey;
+  size_t fprlen = strlen (fpr);
+  size_t len;
+
+  for (subkey = key->subkeys; subkey; subkey = subkey->next)
+    {
+      if (!subkey->fpr)
+        continue;
+      len = strlen (subkey->fpr);
+      if (len >= fprlen
+          && !g_ascii_strcasecmp (subkey->fpr + len - fprlen, fpr))
+        return TRUE;
+    }
+  return FALSE;
+}
+
+
+/* A key has been listed.  We own KEY; the cache takes its own
+   references.  */
+static void
+next_key_cb (GpaContext *context, gpgme_key_t key, gpointer user_data)
+{
+  int idx;
+
+  for (idx = 0; listing[idx]; idx++)
+    if (!g_hash_table_lookup (signers, listing[idx])
+        && key_matches (key, listing[idx]))
+      {
+        gpgme_key_ref (key);
+        g_hash_table_replace (signers, g_strdup (listing[idx]), key);
+      }
+  gpgme_key_unref (key);
+}
+
+
+static gboolean start_listing (gpointer user_data);
+
+static void
+done_cb (GpaContext *context, gpg_error_t err, gpointer user_data)
+{
+  GList *list;
+  struct waiter_s *waiter;
+  int idx;
+
+  if (err && gpg_err_code (err) != GPG_ERR_EOF)
+    g_debug ("signer lookup failed: %s <%s>",
+             gpg_strerror (err), gpg_strsource (err));
+
+  if (--running > 0)
+    return;
+
+  /* Remember the fingerprints without a key so that we do not look
+     them up again.  */
+  for (idx = 0; listing[idx]; idx++)
+    if (!g_hash_table_lookup_extended (signers, listing[idx], NULL, NULL))
+      g_hash_table_insert (signers, g_strdup (listing[idx]), NULL);
+  g_strfreev (listing);
+  listing = NULL;
+
+  if (queued)
+    {
+      start_listing (NULL);
+      return;
+    }
+
+  list = waiters;
+  waiters = NULL;
+  while (list)
+    {
+      waiter = list->data;
+      list = g_list_delete_link (list, list);
+      waiter->func (waiter->data);
+      g_free (waiter);
+    }
+}
+
+
+/* Return a new context for PROTOCOL connected to our handlers.  */
+static GpaContext *
+new_context (gpgme_protocol_t protocol)
+{
+  GpaContext *context;
+
+  context = gpa_context_new ();
+  gpgme_set_protocol (context->ctx, protocol);
+  g_signal_connect (G_OBJECT (context), "next_key",
+                    G_CALLBACK (next_key_cb), NULL);
+  g_signal_connect (G_OBJECT (context), "done",
+                    G_CALLBACK (done_cb), NULL);
+  return context;
+}
+
+
+/* Start a listing of all queued fingerprints.  OpenPGP and X.509
+   are listed concurrently.  */
+static gboolean
+start_listing (gpointer user_data)
+{
+  gpg_error_t err;
+
+  g_ptr_array_add (queued, NULL);
+  listing = (gchar **) g_ptr_array_free (queued, FALSE);
+  queued = NULL;
+
+  /* We count the listing being started so that a failing start
+     does not finish the lookup early.  */
+  running = 1;
+
+  if (!pgp_ctx)
+    pgp_ctx = new_context (GPGME_PROTOCOL_OpenPGP);
+  err = gpgme_op_keylist_ext_start (pgp_ctx->ctx, (const char **) listing,
+                                    0, 0);
+  if (err)
+    g_debug ("signer lookup failed: %s <%s>",
+             gpg_strerror (err), gpg_strsource (err));
+  else
+    running++;
+
+  if (cms_hack)
+    {
+      if (!cms_ctx)
+        cms_ctx = new_context (GPGME_PROTOCOL_CMS);
+      err = gpgme_op_keylist_ext_start (cms_ctx->ctx,
+                                        (const char **) listing, 0, 0);
+      if (err)
+        g_debug ("signer lookup failed: %s <%s>",
+                 gpg_strerror (err), gpg_strsource (err));
+      else
+        running++;
+    }
+
+  done_cb (NULL, 0, NULL);
+  return FALSE;
+}
+
+
+/* Queue FPR for the next listing and start it unless a listing is
+   already running.  */
+static void
+queue_lookup (const char *fpr)
+{
+  int idx;
+
+  if (listing)
+    for (idx = 0; listing[idx]; idx++)
+      if (!g_ascii_strcasecmp (listing[idx], fpr))
+        return;
+
+  if (!queued)
+    queued = g_ptr_array_new ();
+  for (idx = 0; idx < queued->len; idx++)
+    if (!g_ascii_strcasecmp (g_ptr_array_index (queued, idx), fpr))
+      return;
+  g_ptr_array_add (queued, g_strdup (fpr));
+
+  /* The listing is started from the main loop so that all signers of
+     a verification result end up in the same listing.  */
+  if (!listing && queued->len == 1)
+    g_idle_add (start_listing, NULL);
+}
+
+
+gpgme_key_t
+gpa_signercache_lookup (const char *fpr, gboolean *r_pending)
+{
+  GpaKeyTable *keytable;
+  gpgme_key_t key = NULL;
+  size_t len;
+
+  if (r_pending)
+    *r_pending = FALSE;
+  if (!fpr || !*fpr)
+    return NULL;
+
+  /* Once the keys have been listed the keytable knows all keys of
+     the keyring.  */
+  keytable = gpa_keytable_get_public_instance ();
+  len = strlen (fpr);
+  if (gpa_keytable_is_ready (keytable) && len >= 16)
+    {
+      if (len > 16)
+        key = gpa_keytable_lookup_key (keytable, fpr);
+      if (!key)
+        key = gpa_keytable_lookup_key_by_keyid (keytable, fpr + len - 16);
+      if (key)
+        gpgme_key_ref (key);
+      return key;
+    }
+
+  if (!signers)
+    {
+      signers = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                       (GDestroyNotify) gpgme_key_unref);
+      g_signal_connect (keytable, "keyring_changed",
+                        G_CALLBACK (gpa_signercache_clear), NULL);
+    }
+  if (g_hash_table_lookup_extended (signers, fpr, NULL, (gpointer *) &key))
+    {
+      if (key)
+        gpgme_key_ref (key);
+      return key;
+    }
+
+  queue_lookup (fpr);
+  if (r_pending)
+    *r_pending = TRUE;
+  return NULL;
+}
+
+
+gboolean
+gpa_signercache_resolve (gpgme_signature_t sigs,
+                         GpaSignerCacheFunc func, gpointer data)
+{
+  struct waiter_s *waiter;
+  gpgme_signature_t sig;
+  gpgme_key_t key;
+  gboolean pending, any = FALSE;
+
+  for (sig = sigs; sig; sig = sig->next)
+    {
+      key = gpa_signercache_lookup (sig->fpr, &pending);
+      gpgme_key_unref (key);
+      if (pending)
+        any = TRUE;
+    }
+  if (!any)
+    return TRUE;
+
+  waiter = g_malloc0 (sizeof *waiter);
+  waiter->func = func;
+  waiter->data = data;
+  waiters = g_list_append (waiters, waiter);
+  return FALSE;
+}
+
+
+void
+gpa_signercache_cancel (gpointer data)
+{
+  GList *list, *next;
+  struct waiter_s *waiter;
+
+  for (list = waiters; list; list = next)
+    {
+      next = g_list_next (list);
+      waiter = list->data;
+      if (waiter->data == data)
+        {
+          g_free (waiter);
+          waiters = g_list_delete_link (waiters, list);
+        }
+    }
+}
+
+
+void
+gpa_signercache_clear (void)
+{
+  if (signers)
+    g_hash_table_remove_all (signers);
+}
@@ -0,0 +1,55 @@
+/* signercache.h - Lookup of the keys of signers.
+   Copyright (C) 2026 g10 Code GmbH.
+
+   This file is part of GPA
+
+   GPA is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   GPA is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+   License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.  */
+
+/* The signer cache finds the key of a signer without blocking.  The
+   indices of the public keytable are used if the keys have already
+   been listed.  Otherwise the fingerprints not yet known are
+   collected and looked up by a single key listing; the result,
+   including the fact that no key was found, is remembered until the
+   keyring changes.  */
+
+#ifndef SIGNERCACHE_H
+#define SIGNERCACHE_H
+
+#include <glib.h>
+#include <gpgme.h>
+
+/* Called when all pending lookups have finished.  */
+typedef void (*GpaSignerCacheFunc) (gpointer data);
+
+/* Return a new reference of the key with the fingerprint or key ID
+   FPR, or NULL if it is not known.  If the key still needs to be
+   looked up, a lookup is started and TRUE is stored at R_PENDING if
+   that is not NULL.  */
+gpgme_key_t gpa_signercache_lookup (const char *fpr, gboolean *r_pending);
+
+/* Make sure that the keys of all signers in SIGS are known.  Returns
+   TRUE if they are; otherwise FUNC will be called with DATA after
+   the keys have been looked up.  */
+gboolean gpa_signercache_resolve (gpgme_signature_t sigs,
+                                  GpaSignerCacheFunc func, gpointer data);
+
+/* Remove all pending calls using DATA.  This must be called before
+   DATA is destroyed.  */
+void gpa_signercache_cancel (gpointer data);
+
+/* Forget all looked up keys.  This is called when the keyring
+   changed.  */
+void gpa_signercache_clear (void);
+
+#endif /*SIGNERCACHE_H*/
@@ -0,0 +1,334 @@
+/* textdata.c - Data objects for texts of the clipboard.
+   Copyright (C) 2026 g10 Code GmbH.
+
+   This file is part of GPA
+
+   GPA is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   GPA is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+   License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.  */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "gpa.h"
+#include "textdata.h"
+
+
+/* The size of the chunks of a rope.  */
+#define ROPE_CHUNK_SIZE 65536
+
+/* The number of characters the reader takes from the text buffer at
+   once.  */
+#define READ_CHUNK_CHARS 16384
+
+
+struct gpa_text_rope_s
+{
+  GQueue *chunks;       /* The chunks as GStrings.  */
+  gsize offset;         /* Bytes consumed of the first chunk.  */
+  gsize length;         /* Bytes not yet consumed.  */
+  gsize written;        /* Bytes written in total.  */
+
+  gpa_text_rope_notify_t notify;
+  void *notify_opaque;
+};
+
+
+/* State of a data object reading a text buffer.  */
+struct text_reader_s
+{
+  GtkTextBuffer *buffer;
+  GtkTextMark *mark;    /* The end of the current slice.  */
+  GtkTextMark *end;     /* The end of the text to read.  */
+  gchar *slice;         /* The current slice of the text.  */
+  gsize slice_len;
+  gsize slice_off;      /* Read position within SLICE.  */
+  off_t offset;         /* Read position within the text.  */
+};
+
+
+
+/* The rope.  */
+
+gpa_text_rope_t
+gpa_text_rope_new (void)
+{
+  gpa_text_rope_t rope;
+
+  rope = g_malloc0 (sizeof *rope);
+  rope->chunks = g_queue_new ();
+  return rope;
+}
+
+
+void
+gpa_text_rope_release (gpa_text_rope_t rope)
+{
+  GString *chunk;
+
+  if (!rope)
+    return;
+  while ((chunk = g_queue_pop_head (rope->chunks)))
+    g_string_free (chunk, TRUE);
+  g_queue_free (rope->chunks);
+  g_free (rope);
+}
+
+
+void
+gpa_text_rope_set_notify (gpa_text_rope_t rope,
+                          gpa_text_rope_notify_t func, void *opaque)
+{
+  rope->notify = func;
+  rope->notify_opaque = opaque;
+}
+
+
+gsize
+gpa_text_rope_length (gpa_text_rope_t rope)
+{
+  return rope->length;
+}
+
+
+const char *
+gpa_text_rope_peek (gpa_text_rope_t rope, gsize *r_len)
+{
+  GString *chunk;
+
+  chunk = g_queue_peek_head (rope->chunks);
+  if (!chunk)
+    {
+      *r_len = 0;
+      return NULL;
+    }
+  *r_len = chunk->len - rope->offset;
+  return chunk->str + rope->offset;
+}
+
+
+void
+gpa_text_rope_consume (gpa_text_rope_t rope, gsize len)
+{
+  GString *chunk;
+
+  chunk = g_queue_peek_head (rope->chunks);
+  g_return_if_fail (chunk && len <= chunk->len - rope->offset);
+
+  rope->offset += len;
+  rope->length -= len;
+  /* The last chunk is kept until it is full so that writing may
+     continue to fill it.  */
+  if (rope->offset == chunk->len
+      && (chunk->len == ROPE_CHUNK_SIZE || rope->chunks->length > 1))
+    {
+      g_string_free (g_queue_pop_head (rope->chunks), TRUE);
+      rope->offset = 0;
+    }
+}
+
+
+/* Append LENGTH bytes from DATA to ROPE.  */
+static void
+rope_append (gpa_text_rope_t rope, const char *data, gsize length)
+{
+  GString *chunk;
+  gsize n;
+
+  chunk = g_queue_peek_tail (rope->chunks);
+  while (length)
+    {
+      if (!chunk || chunk->len == ROPE_CHUNK_SIZE)
+        {
+          chunk = g_string_sized_new (ROPE_CHUNK_SIZE);
+          g_queue_push_tail (rope->chunks, chunk);
+        }
+      n = MIN (length, ROPE_CHUNK_SIZE - chunk->len);
+      g_string_append_len (chunk, data, n);
+      rope->length += n;
+      rope->written += n;
+      data += n;
+      length -= n;
+    }
+}
+
+
+
+/* The reader.  */
+
+static ssize_t
+reader_read_cb (void *handle, void *buffer, size_t size)
+{
+  struct text_reader_s *reader = handle;
+  GtkTextIter start, end, limit;
+  size_t n;
+
+  if (reader->slice_off == reader->slice_len)
+    {
+      /* Take the next slice of the text.  */
+      gtk_text_buffer_get_iter_at_mark (reader->buffer, &start, reader->mark);
+      gtk_text_buffer_get_iter_at_mark (reader->buffer, &limit, reader->end);
+      if (gtk_text_iter_compare (&start, &limit) >= 0)
+        return 0;
+      end = start;
+      gtk_text_iter_forward_chars (&end, READ_CHUNK_CHARS);
+      if (gtk_text_iter_compare (&end, &limit) > 0)
+        end = limit;
+      g_free (reader->slice);
+      reader->slice = gtk_text_buffer_get_text (reader->buffer,
+                                                &start, &end, TRUE);
+      reader->slice_len = strlen (reader->slice);
+      reader->slice_off = 0;
+      gtk_text_buffer_move_mark (reader->buffer, reader->mark, &end);
+    }
+
+  n = MIN (size, reader->slice_len - reader->slice_off);
+  memcpy (buffer, reader->slice + reader->slice_off, n);
+  reader->slice_off += n;
+  reader->offset += n;
+  return n;
+}
+
+
+/* Only seeking within the current slice and back to the start is
+   supported.  This is what gpgme_data_identify needs.  */
+static off_t
+reader_seek_cb (void *handle, off_t offset, int whence)
+{
+  struct text_reader_s *reader = handle;
+  off_t slice_start = reader->offset - reader->slice_off;
+  GtkTextIter iter;
+
+  if (whence == SEEK_CUR)
+    offset += reader->offset;
+  else if (whence != SEEK_SET)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  if (offset >= slice_start && offset <= slice_start + reader->slice_len)
+    {
+      reader->slice_off = offset - slice_start;
+      reader->offset = offset;
+    }
+  else if (!offset)
+    {
+      gtk_text_buffer_get_start_iter (reader->buffer, &iter);
+      gtk_text_buffer_move_mark (reader->buffer, reader->mark, &iter);
+      g_free (reader->slice);
+      reader->slice = NULL;
+      reader->slice_len = reader->slice_off = 0;
+      reader->offset = 0;
+    }
+  else
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  return reader->offset;
+}
+
+
+static void
+reader_release_cb (void *handle)
+{
+  struct text_reader_s *reader = handle;
+
+  g_free (reader->slice);
+  gtk_text_buffer_delete_mark (reader->buffer, reader->mark);
+  gtk_text_buffer_delete_mark (reader->buffer, reader->end);
+  g_object_unref (reader->buffer);
+  g_free (reader);
+}
+
+
+static struct gpgme_data_cbs reader_cbs =
+  {
+    reader_read_cb,
+    NULL,
+    reader_seek_cb,
+    reader_release_cb
+  };
+
+
+gpg_error_t
+gpa_text_data_new_reader (gpgme_data_t *r_dh, GtkTextBuffer *buffer)
+{
+  struct text_reader_s *reader;
+  GtkTextIter iter;
+  gpg_error_t err;
+
+  reader = g_malloc0 (sizeof *reader);
+  reader->buffer = g_object_ref (buffer);
+  gtk_text_buffer_get_start_iter (buffer, &iter);
+  reader->mark = gtk_text_buffer_create_mark (buffer, NULL, &iter, TRUE);
+  gtk_text_buffer_get_end_iter (buffer, &iter);
+  reader->end = gtk_text_buffer_create_mark (buffer, NULL, &iter, TRUE);
+
+  err = gpgme_data_new_from_cbs (r_dh, &reader_cbs, reader);
+  if (err)
+    reader_release_cb (reader);
+  return err;
+}
+
+
+
+/* The writer.  */
+
+static ssize_t
+writer_write_cb (void *handle, const void *buffer, size_t size)
+{
+  gpa_text_rope_t rope = handle;
+
+  rope_append (rope, buffer, size);
+  if (rope->notify)
+    rope->notify (rope, rope->notify_opaque);
+  return size;
+}
+
+
+static off_t
+writer_seek_cb (void *handle, off_t offset, int whence)
+{
+  gpa_text_rope_t rope = handle;
+
+  if ((whence == SEEK_CUR && !offset)
+      || (whence == SEEK_END && !offset)
+      || (whence == SEEK_SET && offset == rope->written))
+    return rope->written;
+
+  errno = EINVAL;
+  return -1;
+}
+
+
+static struct gpgme_data_cbs writer_cbs =
+  {
+    NULL,
+    writer_write_cb,
+    writer_seek_cb,
+    NULL
+  };
+
+
+gpg_error_t
+gpa_text_data_new_writer (gpgme_data_t *r_dh, gpa_text_rope_t rope)
+{
+  return gpgme_data_new_from_cbs (r_dh, &writer_cbs, rope);
+}
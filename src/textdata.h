@@ -0,0 +1,74 @@
+/* textdata.h - Data objects for texts of the clipboard.
+   Copyright (C) 2026 g10 Code GmbH.
+
+   This file is part of GPA
+
+   GPA is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   GPA is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+   License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.  */
+
+/* Operations on the text of the clipboard window don't copy the text
+   into one large buffer.  The input is read by gpgme directly from
+   the text buffer, a slice at a time.  The output is collected in a
+   rope, a list of chunks of bounded size, which is filled by gpgme
+   and consumed chunk by chunk while the operation is still
+   running.  */
+
+#ifndef TEXTDATA_H
+#define TEXTDATA_H
+
+#include <gtk/gtk.h>
+#include <gpgme.h>
+
+typedef struct gpa_text_rope_s *gpa_text_rope_t;
+
+/* Called after data has been appended to a rope.  */
+typedef void (*gpa_text_rope_notify_t) (gpa_text_rope_t rope, void *opaque);
+
+/* Create a new empty rope.  */
+gpa_text_rope_t gpa_text_rope_new (void);
+
+/* Release ROPE and all its chunks.  */
+void gpa_text_rope_release (gpa_text_rope_t rope);
+
+/* Call FUNC with OPAQUE whenever data has been appended to ROPE.
+   FUNC may be NULL to remove the notification.  */
+void gpa_text_rope_set_notify (gpa_text_rope_t rope,
+                               gpa_text_rope_notify_t func, void *opaque);
+
+/* Return the number of bytes appended to ROPE which have not yet been
+   consumed.  */
+gsize gpa_text_rope_length (gpa_text_rope_t rope);
+
+/* Return the oldest data of ROPE which has not yet been consumed and
+   store its length at R_LEN.  This is not necessarily all the data
+   available; *R_LEN is 0 if there is none.  */
+const char *gpa_text_rope_peek (gpa_text_rope_t rope, gsize *r_len);
+
+/* Drop the first LEN bytes of the data returned by the last call to
+   gpa_text_rope_peek.  */
+void gpa_text_rope_consume (gpa_text_rope_t rope, gsize len);
+
+/* Create a data object at R_DH which reads the text of BUFFER in
+   UTF-8, including invisible text.  Only the text present at the time
+   of the call is read; text appended later is ignored.  The data
+   object keeps a reference to BUFFER; the text read should not be
+   modified while it is in use.  */
+gpg_error_t gpa_text_data_new_reader (gpgme_data_t *r_dh,
+                                      GtkTextBuffer *buffer);
+
+/* Create a data object at R_DH which appends all data written to it
+   to ROPE.  ROPE must not be released before the data object.  */
+gpg_error_t gpa_text_data_new_writer (gpgme_data_t *r_dh,
+                                      gpa_text_rope_t rope);
+
+#endif /*TEXTDATA_H*/
@@ -28,6 +28,7 @@
 #include "gtktools.h"
 #include "gpawidgets.h"
 #include "verifydlg.h"
+#include "signercache.h"
 
 /* Properties */
 enum
@@ -78,17 +79,6 @@ gpa_file_verify_dialog_set_property (GObject     *object,
     }
 }
 
-static void
-gpa_file_verify_dialog_finalize (GObject *object)
-{
-  GpaFileVerifyDialog *dialog = GPA_FILE_VERIFY_DIALOG (object);
-
-  g_object_unref (dialog->ctx);
-
-  G_OBJECT_CLASS (parent_class)->finalize (object);
-}
-
-
 static void
 gpa_file_verify_dialog_init (GpaFileVerifyDialog *dialog)
 {
@@ -107,9 +97,6 @@ gpa_file_verify_dialog_constructor (GType type,
 				      n_construct_properties,
 				      construct_properties);
   dialog = GPA_FILE_VERIFY_DIALOG (object);
-  /* Initialize */
-
-  dialog->ctx = gpa_context_new ();
   /* Set up the dialog */
   gtk_dialog_add_buttons (GTK_DIALOG (dialog),
 			  _("_Close"), GTK_RESPONSE_CLOSE, NULL);
@@ -136,7 +123,6 @@ gpa_file_verify_dialog_class_init (GpaFileVerifyDialogClass *klass)
   parent_class = g_type_class_peek_parent (klass);
 
   object_class->constructor = gpa_file_verify_dialog_constructor;
-  object_class->finalize = gpa_file_verify_dialog_finalize;
   object_class->set_property = gpa_file_verify_dialog_set_property;
   object_class->get_property = gpa_file_verify_dialog_get_property;
 
@@ -192,6 +178,14 @@ typedef struct
   char *keydesc;
 } SignatureData;
 
+/* The signatures of a page whose signers are still being looked up.
+   It is attached to the list store.  */
+struct pending_page_s
+{
+  GtkListStore *store;
+  gpgme_signature_t sigs;
+};
+
 typedef enum
 {
   SIG_KEYID_COLUMN,
@@ -296,8 +290,7 @@ add_signature_to_model (GtkListStore *store, SignatureData *data)
 
 /* Fill the list of signatures with the data from the verification */
 static void
-fill_sig_model (GtkListStore *store, gpgme_signature_t sigs,
-		gpgme_ctx_t ctx)
+fill_sig_model (GtkListStore *store, gpgme_signature_t sigs)
 {
   SignatureData *data;
   gpgme_signature_t sig;
@@ -310,17 +303,75 @@ fill_sig_model (GtkListStore *store, gpgme_signature_t sigs,
       data->summary = sig->summary;
       data->created = sig->timestamp;
       data->expire = sig->exp_timestamp;
-      data->sigdesc = gpa_gpgme_get_signature_desc (ctx, sig,
-                                                    &data->keydesc, &data->key);
+      data->sigdesc = gpa_gpgme_get_signature_desc (sig, &data->keydesc,
+                                                    &data->key);
       add_signature_to_model (store, data);
     }
 }
 
 
+/* Return a copy of the fields of SIGS used by fill_sig_model.  The
+   verification result may be gone by the time the signers are
+   known.  */
+static gpgme_signature_t
+copy_signatures (gpgme_signature_t sigs)
+{
+  gpgme_signature_t head = NULL;
+  gpgme_signature_t *tail = &head;
+  gpgme_signature_t sig;
+
+  for (sig = sigs; sig; sig = sig->next)
+    {
+      *tail = g_malloc0 (sizeof **tail);
+      (*tail)->summary = sig->summary;
+      (*tail)->fpr = g_strdup (sig->fpr);
+      (*tail)->status = sig->status;
+      (*tail)->timestamp = sig->timestamp;
+      (*tail)->exp_timestamp = sig->exp_timestamp;
+      (*tail)->validity = sig->validity;
+      tail = &(*tail)->next;
+    }
+  return head;
+}
+
+
+static void
+release_pending_page (struct pending_page_s *page)
+{
+  gpgme_signature_t sig;
+
+  gpa_signercache_cancel (page);
+  while (page->sigs)
+    {
+      sig = page->sigs;
+      page->sigs = sig->next;
+      g_free (sig->fpr);
+      g_free (sig);
+    }
+  g_free (page);
+}
+
+
+/* The signers of a page have been looked up.  Fill the list again
+   to show their keys.  */
+static void
+signers_known_cb (gpointer data)
+{
+  struct pending_page_s *page = data;
+
+  gtk_list_store_clear (page->store);
+  fill_sig_model (page->store, page->sigs);
+
+  /* This releases PAGE.  */
+  g_object_set_data (G_OBJECT (page->store), "gpa-pending-page", NULL);
+}
+
+
 /* Create the list of signatures */
 static GtkWidget *
-signature_list (gpgme_signature_t sigs, gpgme_ctx_t ctx)
+signature_list (gpgme_signature_t sigs)
 {
+  struct pending_page_s *page;
   GtkTreeViewColumn *column;
   GtkCellRenderer *renderer;
   GtkListStore *store;
@@ -356,14 +407,27 @@ signature_list (gpgme_signature_t sigs, gpgme_ctx_t ctx)
 						     NULL);
   gtk_tree_view_append_column (GTK_TREE_VIEW (list), column);
 
-  fill_sig_model (store, sigs, ctx);
+  /* The keys of the signers might not yet be known; in this case
+     the list is filled again after they have been looked up.  */
+  page = g_malloc0 (sizeof *page);
+  if (gpa_signercache_resolve (sigs, signers_known_cb, page))
+    g_free (page);
+  else
+    {
+      page->store = store;
+      page->sigs = copy_signatures (sigs);
+      g_object_set_data_full (G_OBJECT (store), "gpa-pending-page", page,
+                              (GDestroyNotify) release_pending_page);
+    }
+
+  fill_sig_model (store, sigs);
 
   return list;
 }
 
 static GtkWidget *
 verify_file_page (gpgme_signature_t sigs, const gchar *signed_file,
-		  const gchar *signature_file, gpgme_ctx_t ctx)
+		  const gchar *signature_file)
 {
   GtkWidget *vbox;
   GtkWidget *list;
@@ -390,7 +454,7 @@ verify_file_page (gpgme_signature_t sigs, const gchar *signed_file,
   gtk_misc_set_alignment (GTK_MISC (label), 0.0, 0.5);
   gtk_box_pack_start_defaults (GTK_BOX (vbox), label);
 
-  list = signature_list (sigs, ctx);
+  list = signature_list (sigs);
   scrolled = gtk_scrolled_window_new (NULL, NULL);
   gtk_scrolled_window_set_shadow_type (GTK_SCROLLED_WINDOW (scrolled),
                                        GTK_SHADOW_IN);
@@ -433,8 +497,7 @@ void gpa_file_verify_dialog_add_file (GpaFileVerifyDialog *dialog,
 {
   GtkWidget *page;
 
-  page = verify_file_page (sigs, signed_file, signature_file,
-			   dialog->ctx->ctx);
+  page = verify_file_page (sigs, signed_file, signature_file);
 
   gtk_notebook_append_page (GTK_NOTEBOOK (dialog->notebook), page,
 			    gtk_label_new (filename));
@@ -41,8 +41,6 @@ struct _GpaFileVerifyDialog {
   GtkDialog parent;
 
   GtkWidget *notebook;
-  /* Context for retrieving signature's keys */
-  GpaContext *ctx;
 };
 
 struct _GpaFileVerifyDialogClass {